@@ -368,6 +368,10 @@ function BuildServer(settings, family, platform)
 	
 	local game_server = Compile(settings, CollectRecursive("src/game/server/*.cpp"), SharedServerFiles())
 	
+	-- the game benchmark runs the game server without the engine server
+	Link(settings, "game_bench", libs["zlib"], libs["md5"], libs["json"], Compile(settings, "src/tools/game_bench.cpp"), game_server)
+	Link(settings, "prediction_bench", libs["zlib"], libs["md5"], libs["json"], Compile(settings, "src/tools/prediction_bench.cpp"))
+
 	return Link(settings, "teeworlds_srv", libs["zlib"], libs["md5"], libs["json"], server, game_server)
 end
 
@@ -375,7 +379,9 @@ function BuildTools(settings)
 	local tools = {}
 	for i,v in ipairs(Collect("src/tools/*.cpp", "src/tools/*.c")) do
 		local toolname = PathFilename(PathBase(v))
-		tools[i] = Link(settings, toolname, Compile(settings, v), libs["zlib"], libs["md5"], libs["wavpack"], libs["png"], libs["json"])
+		if toolname ~= "game_bench" and toolname ~= "prediction_bench" then
+			table.insert(tools, Link(settings, toolname, Compile(settings, v), libs["zlib"], libs["md5"], libs["wavpack"], libs["png"], libs["json"]))
+		end
 	end
 	PseudoTarget(settings.link.Output(settings, "pseudo_tools") .. settings.link.extension, tools)
 end
@@ -29,6 +29,37 @@ static void digest_str(const unsigned char *digest, size_t digest_len, char *str
 	}
 }
 
+static int hex_value(char c)
+{
+	if(c >= '0' && c <= '9')
+		return c - '0';
+	if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static int digest_from_str(unsigned char *digest, size_t digest_len, const char *str)
+{
+	unsigned i;
+	if(str_length(str) != (int)digest_len * 2)
+	{
+		return 1;
+	}
+	for(i = 0; i < digest_len; i++)
+	{
+		int high = hex_value(str[i * 2]);
+		int low = hex_value(str[i * 2 + 1]);
+		if(high < 0 || low < 0)
+		{
+			return 1;
+		}
+		digest[i] = (high << 4) | low;
+	}
+	return 0;
+}
+
 SHA256_DIGEST sha256(const void *message, size_t message_len)
 {
 	SHA256_CTX ctxt;
@@ -42,6 +73,11 @@ void sha256_str(SHA256_DIGEST digest, char *str, size_t max_len)
 	digest_str(digest.data, sizeof(digest.data), str, max_len);
 }
 
+int sha256_from_str(SHA256_DIGEST *out, const char *str)
+{
+	return digest_from_str(out->data, sizeof(out->data), str);
+}
+
 int sha256_comp(SHA256_DIGEST digest1, SHA256_DIGEST digest2)
 {
 	return mem_comp(digest1.data, digest2.data, sizeof(digest1.data));
@@ -60,6 +96,11 @@ void md5_str(MD5_DIGEST digest, char *str, size_t max_len)
 	digest_str(digest.data, sizeof(digest.data), str, max_len);
 }
 
+int md5_from_str(MD5_DIGEST *out, const char *str)
+{
+	return digest_from_str(out->data, sizeof(out->data), str);
+}
+
 int md5_comp(MD5_DIGEST digest1, MD5_DIGEST digest2)
 {
 	return mem_comp(digest1.data, digest2.data, sizeof(digest1.data));
@@ -24,8 +24,18 @@
 	#include <netinet/in.h>
 	#include <fcntl.h>
 	#include <pthread.h>
+	#include <sys/mman.h>
 	#include <arpa/inet.h>
 
+	#if defined(CONF_PLATFORM_LINUX)
+		#include <linux/futex.h>
+		#include <sys/epoll.h>
+		#include <sys/eventfd.h>
+		#include <sys/syscall.h>
+	#else
+		#include <poll.h>
+	#endif
+
 	#include <dirent.h>
 
 	#if defined(CONF_PLATFORM_MACOS)
@@ -38,6 +48,7 @@
 	#include <winsock2.h>
 	#include <ws2tcpip.h>
 	#include <fcntl.h>
+	#include <io.h>
 	#include <direct.h>
 	#include <errno.h>
 	#include <process.h>
@@ -56,6 +67,8 @@
 	#include <sys/filio.h>
 #endif
 
+#include "tl/threading.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -78,9 +91,73 @@ static NETSTATS network_stats = {0};
 
 static NETSOCKET invalid_socket = {NETTYPE_INVALID, -1, -1};
 
+/* asynchronous logging: every logging thread owns a ring of records
+   which the logger thread formats and hands to the loggers */
+#if defined(CONF_FAMILY_WINDOWS) && !defined(__GNUC__)
+	#define LOG_THREAD_LOCAL __declspec(thread)
+#else
+	#define LOG_THREAD_LOCAL __thread
+#endif
+
+enum
+{
+	LOG_MAX_RINGS = 32,
+	LOG_RING_SIZE = 64*1024,
+	LOG_MAX_LINE = 4*1024,
+};
+
+typedef struct
+{
+	unsigned size; /* 0 skips to the end of the ring */
+	unsigned seq;
+	time_t time;
+	unsigned short sys_len;
+	unsigned short msg_len;
+} LOG_RECORD;
+
+typedef struct
+{
+	volatile unsigned owned;
+	volatile unsigned write_pos;
+	volatile unsigned read_pos;
+	volatile unsigned dropped;
+	unsigned dropped_reported;
+	unsigned char *volatile buffer;
+} LOG_RING;
+
+static LOG_RING log_rings[LOG_MAX_RINGS];
+static LOG_THREAD_LOCAL LOG_RING *log_thread_ring = 0;
+static LOG_THREAD_LOCAL int log_thread_no_ring = 0;
+static LOG_THREAD_LOCAL int log_thread_is_logger = 0;
+static volatile unsigned log_seq = 0;
+static volatile unsigned log_writers = 0;
+static volatile unsigned log_sleeping = 0;
+static volatile unsigned log_running = 0;
+static void *log_thread = 0;
+static SEMAPHORE log_sphore;
+static DBG_LOGGER_STATS log_stats = {0};
+
+/* rings of threads that ended are taken over by new ones */
+static void log_ring_release(void *ring)
+{
+	sync_barrier_release();
+	((LOG_RING *)ring)->owned = 0;
+}
+
+#if defined(CONF_FAMILY_UNIX)
+static pthread_key_t log_ring_key;
+static pthread_once_t log_ring_key_once = PTHREAD_ONCE_INIT;
+
+static void log_ring_key_init(void)
+{
+	pthread_key_create(&log_ring_key, log_ring_release);
+}
+#endif
+
 static void dbg_logger_finish(void)
 {
 	int i;
+	dbg_logger_async_stop();
 	for(i = 0; i < num_loggers; i++)
 	{
 		if(loggers[i].finish)
@@ -101,6 +178,7 @@ void dbg_logger(DBG_LOGGER logger, DBG_LOGGER_FINISH finish, void *user)
 	data.finish = finish;
 	data.user = user;
 	loggers[num_loggers] = data;
+	sync_barrier_release();
 	num_loggers++;
 }
 
@@ -108,6 +186,8 @@ void dbg_assert_imp(const char *filename, int line, int test, const char *msg)
 {
 	if(!test)
 	{
+		/* get everything out before breaking */
+		dbg_logger_async_stop();
 		dbg_msg("assert", "%s(%d): %s", filename, line, msg);
 		dbg_break();
 	}
@@ -118,31 +198,260 @@ void dbg_break()
 	*((volatile unsigned*)0) = 0x0;
 }
 
-void dbg_msg(const char *sys, const char *fmt, ...)
+static void dbg_msg_dispatch(const char *timestr, const char *sys, const char *msg)
 {
-	va_list args;
-	char str[1024*4];
-	char *msg;
-	int i, len;
+	char str[LOG_MAX_LINE];
+	int i;
+	str_format(str, sizeof(str), "[%s][%s]: %s", timestr, sys, msg);
+	for(i = 0; i < num_loggers; i++)
+		loggers[i].logger(str, loggers[i].user);
+}
+
+static LOG_RING *log_ring_get(void)
+{
+	int i;
+	if(log_thread_ring || log_thread_no_ring)
+		return log_thread_ring;
+
+	for(i = 0; i < LOG_MAX_RINGS; i++)
+	{
+		LOG_RING *ring = &log_rings[i];
+		if(atomic_compswap(&ring->owned, 0, 1) != 0)
+			continue;
+		if(!ring->buffer)
+			ring->buffer = (unsigned char *)mem_alloc(LOG_RING_SIZE);
+#if defined(CONF_FAMILY_UNIX)
+		pthread_once(&log_ring_key_once, log_ring_key_init);
+		pthread_setspecific(log_ring_key, ring);
+#endif
+		log_thread_ring = ring;
+		return ring;
+	}
+
+	/* too many threads, this one logs synchronously */
+	log_thread_no_ring = 1;
+	return 0;
+}
+
+static void log_ring_put(void)
+{
+	if(!log_thread_ring)
+		return;
+#if defined(CONF_FAMILY_UNIX)
+	pthread_setspecific(log_ring_key, 0);
+#endif
+	log_ring_release(log_thread_ring);
+	log_thread_ring = 0;
+}
+
+static int log_ring_push(LOG_RING *ring, const char *sys, const char *msg, int msg_len)
+{
+	LOG_RECORD *record;
+	int sys_len = str_length(sys);
+	unsigned size = (sizeof(LOG_RECORD)+sys_len+1+msg_len+1+7)&~7u;
+	unsigned write_pos = ring->write_pos;
+	unsigned offset = write_pos&(LOG_RING_SIZE-1);
+	unsigned padding = LOG_RING_SIZE-offset < size ? LOG_RING_SIZE-offset : 0;
+	unsigned read_pos = ring->read_pos;
+	sync_barrier_acquire();
+
+	if(LOG_RING_SIZE-(write_pos-read_pos) < padding+size)
+	{
+		ring->dropped++;
+		return 0;
+	}
+	if(padding)
+	{
+		if(padding >= sizeof(LOG_RECORD))
+			((LOG_RECORD *)(ring->buffer+offset))->size = 0;
+		write_pos += padding;
+		offset = 0;
+	}
+
+	record = (LOG_RECORD *)(ring->buffer+offset);
+	record->size = size;
+	record->seq = atomic_inc(&log_seq);
+	record->time = time(0);
+	record->sys_len = sys_len;
+	record->msg_len = msg_len;
+	mem_copy(record+1, sys, sys_len+1);
+	mem_copy((char *)(record+1)+sys_len+1, msg, msg_len+1);
+
+	sync_barrier_release();
+	ring->write_pos = write_pos+size;
+	return 1;
+}
+
+static LOG_RECORD *log_ring_peek(LOG_RING *ring)
+{
+	unsigned read_pos = ring->read_pos;
+	unsigned write_pos = ring->write_pos;
+	sync_barrier_acquire();
+	while(read_pos != write_pos)
+	{
+		unsigned offset = read_pos&(LOG_RING_SIZE-1);
+		LOG_RECORD *record = (LOG_RECORD *)(ring->buffer+offset);
+		if(LOG_RING_SIZE-offset >= sizeof(LOG_RECORD) && record->size != 0)
+			return record;
+		read_pos += LOG_RING_SIZE-offset;
+		ring->read_pos = read_pos;
+	}
+	return 0;
+}
+
+static int log_pending(void)
+{
+	int i;
+	for(i = 0; i < LOG_MAX_RINGS; i++)
+	{
+		if(log_rings[i].buffer && log_rings[i].read_pos != log_rings[i].write_pos)
+			return 1;
+	}
+	return 0;
+}
 
+/* writes everything queued, oldest first over all threads */
+static void log_drain(void)
+{
 	char timestr[80];
-	str_timestamp_format(timestr, sizeof(timestr), FORMAT_SPACE);
+	time_t last_time = 0;
+	int i;
+	timestr[0] = 0;
 
-	str_format(str, sizeof(str), "[%s][%s]: ", timestr, sys);
+	while(1)
+	{
+		LOG_RING *oldest_ring = 0;
+		LOG_RECORD *oldest = 0;
+		const char *sys;
 
-	len = str_length(str);
-	msg = (char *)str + len;
+		for(i = 0; i < LOG_MAX_RINGS; i++)
+		{
+			LOG_RECORD *record;
+			if(!log_rings[i].buffer)
+				continue;
+			record = log_ring_peek(&log_rings[i]);
+			if(record && (!oldest || (int)(record->seq-oldest->seq) < 0))
+			{
+				oldest = record;
+				oldest_ring = &log_rings[i];
+			}
+		}
+		if(!oldest)
+			break;
+
+		if(!timestr[0] || oldest->time != last_time)
+		{
+			str_timestamp_ex(oldest->time, timestr, sizeof(timestr), FORMAT_SPACE);
+			last_time = oldest->time;
+		}
+		sys = (const char *)(oldest+1);
+		dbg_msg_dispatch(timestr, sys, sys+oldest->sys_len+1);
+		log_stats.num_logged++;
+
+		sync_barrier_release();
+		oldest_ring->read_pos += oldest->size;
+	}
+
+	for(i = 0; i < LOG_MAX_RINGS; i++)
+	{
+		LOG_RING *ring = &log_rings[i];
+		unsigned dropped = ring->dropped;
+		if(dropped != ring->dropped_reported)
+		{
+			char msg[64];
+			str_format(msg, sizeof(msg), "dropped %u messages", dropped-ring->dropped_reported);
+			str_timestamp_format(timestr, sizeof(timestr), FORMAT_SPACE);
+			dbg_msg_dispatch(timestr, "logger", msg);
+			log_stats.num_dropped += dropped-ring->dropped_reported;
+			ring->dropped_reported = dropped;
+		}
+	}
+}
+
+static void log_thread_run(void *user)
+{
+	log_thread_is_logger = 1;
+	while(1)
+	{
+		int running = log_running;
+		log_drain();
+		if(!running)
+			break;
+
+		/* sleep until a thread queues something */
+		log_sleeping = 1;
+		sync_barrier();
+		if(log_pending() && atomic_compswap(&log_sleeping, 1, 0) == 1)
+			continue;
+		sphore_wait(&log_sphore);
+	}
+}
+
+void dbg_logger_async_start()
+{
+	if(log_running)
+		return;
+	log_sleeping = 0;
+	sphore_init(&log_sphore);
+	log_running = 1;
+	sync_barrier();
+	log_thread = thread_init(log_thread_run, 0);
+}
+
+void dbg_logger_async_stop()
+{
+	/* only one thread stops the logger, an assert can race a regular stop */
+	if(log_thread_is_logger || atomic_compswap(&log_running, 1, 0) != 1)
+		return;
+
+	/* threads already queueing finish first */
+	while(log_writers)
+		thread_yield();
+
+	sphore_signal(&log_sphore);
+	thread_wait(log_thread);
+	thread_destroy(log_thread);
+	log_thread = 0;
+	sphore_destroy(&log_sphore);
+}
+
+void dbg_logger_stats(DBG_LOGGER_STATS *stats)
+{
+	*stats = log_stats;
+}
+
+void dbg_msg(const char *sys, const char *fmt, ...)
+{
+	va_list args;
+	char msg[LOG_MAX_LINE];
+	char timestr[80];
+	int len;
+	LOG_RING *ring;
 
 	va_start(args, fmt);
 #if defined(CONF_FAMILY_WINDOWS) && !defined(__GNUC__)
-	_vsprintf_p(msg, sizeof(str)-len, fmt, args);
+	len = _vsprintf_p(msg, sizeof(msg), fmt, args);
 #else
-	vsnprintf(msg, sizeof(str)-len, fmt, args);
+	len = vsnprintf(msg, sizeof(msg), fmt, args);
 #endif
 	va_end(args);
+	if(len < 0 || len >= (int)sizeof(msg))
+		len = str_length(msg);
 
-	for(i = 0; i < num_loggers; i++)
-		loggers[i].logger(str, loggers[i].user);
+	atomic_inc(&log_writers);
+	if(log_running && !log_thread_is_logger && (ring = log_ring_get()))
+	{
+		int pushed = log_ring_push(ring, sys, msg, len);
+		sync_barrier();
+		if(pushed && log_sleeping && atomic_compswap(&log_sleeping, 1, 0) == 1)
+			sphore_signal(&log_sphore);
+		atomic_dec(&log_writers);
+		return;
+	}
+	atomic_dec(&log_writers);
+
+	str_timestamp_format(timestr, sizeof(timestr), FORMAT_SPACE);
+	dbg_msg_dispatch(timestr, sys, msg);
 }
 
 #if defined(CONF_FAMILY_WINDOWS)
@@ -540,6 +849,44 @@ int io_error(IOHANDLE io)
 	return ferror((FILE*)io);
 }
 
+const void *io_map(IOHANDLE io, unsigned *size)
+{
+	long int length = io_length(io);
+	*size = 0;
+	if(length <= 0)
+		return 0;
+	{
+#if defined(CONF_FAMILY_WINDOWS)
+		HANDLE file = (HANDLE)_get_osfhandle(_fileno((FILE*)io));
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		void *data;
+		if(!mapping)
+			return 0;
+		data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, length);
+		CloseHandle(mapping);
+		if(!data)
+			return 0;
+#else
+		void *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno((FILE*)io), 0);
+		if(data == MAP_FAILED)
+			return 0;
+#endif
+		*size = (unsigned)length;
+		return data;
+	}
+}
+
+void io_unmap(const void *data, unsigned size)
+{
+	if(!data)
+		return;
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	munmap((void *)data, size);
+#endif
+}
+
 #define ASYNC_BUFSIZE 8 * 1024
 #define ASYNC_LOCAL_BUFSIZE 64 * 1024
 
@@ -874,6 +1221,7 @@ static unsigned long __stdcall thread_run(void *user)
 	void *u = data->u;
 	free(data);
 	threadfunc(u);
+	log_ring_put();
 	return 0;
 }
 
@@ -963,6 +1311,18 @@ void cpu_relax()
 #endif
 }
 
+int cpu_count()
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#endif
+}
+
 
 
 #if defined(CONF_FAMILY_UNIX)
@@ -1099,6 +1459,115 @@ void sphore_destroy(SEMAPHORE *sem)
 
 #endif
 
+#if defined(CONF_PLATFORM_LINUX)
+void atomic_wait(volatile unsigned *address, unsigned expected)
+{
+	syscall(SYS_futex, (unsigned *)address, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+void atomic_notify_one(volatile unsigned *address)
+{
+	syscall(SYS_futex, (unsigned *)address, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+void atomic_notify_all(volatile unsigned *address)
+{
+	syscall(SYS_futex, (unsigned *)address, FUTEX_WAKE_PRIVATE, 0x7fffffff, NULL, NULL, 0);
+}
+#else
+/* addresses share buckets, so a notify wakes every waiter of its bucket.
+   every waiter sleeps on its own semaphore, a shared one could be taken
+   by a waiter that was not meant */
+enum
+{
+	ATOMIC_WAIT_BUCKETS=64
+};
+
+typedef struct ATOMIC_WAITER
+{
+	SEMAPHORE sphore;
+	struct ATOMIC_WAITER *next;
+} ATOMIC_WAITER;
+
+typedef struct
+{
+	LOCK lock;
+	ATOMIC_WAITER *first;
+} ATOMIC_WAIT_BUCKET;
+
+static ATOMIC_WAIT_BUCKET atomic_wait_buckets[ATOMIC_WAIT_BUCKETS];
+static volatile unsigned atomic_wait_state = 0;
+
+static ATOMIC_WAIT_BUCKET *atomic_wait_bucket(volatile unsigned *address)
+{
+	if(atomic_wait_state != 2)
+	{
+		if(atomic_compswap(&atomic_wait_state, 0, 1) == 0)
+		{
+			int i;
+			for(i = 0; i < ATOMIC_WAIT_BUCKETS; i++)
+			{
+				atomic_wait_buckets[i].lock = lock_create();
+				atomic_wait_buckets[i].first = 0;
+			}
+			sync_barrier();
+			atomic_wait_state = 2;
+		}
+		else
+		{
+			while(atomic_wait_state != 2)
+				thread_yield();
+		}
+		sync_barrier();
+	}
+	return &atomic_wait_buckets[((size_t)address>>2)%ATOMIC_WAIT_BUCKETS];
+}
+
+void atomic_wait(volatile unsigned *address, unsigned expected)
+{
+	ATOMIC_WAIT_BUCKET *bucket = atomic_wait_bucket(address);
+	ATOMIC_WAITER waiter;
+	int wait = 0;
+	lock_wait(bucket->lock);
+	if(*address == expected)
+	{
+		sphore_init(&waiter.sphore);
+		waiter.next = bucket->first;
+		bucket->first = &waiter;
+		wait = 1;
+	}
+	lock_unlock(bucket->lock);
+	if(wait)
+	{
+		sphore_wait(&waiter.sphore);
+		sphore_destroy(&waiter.sphore);
+	}
+}
+
+void atomic_notify_one(volatile unsigned *address)
+{
+	atomic_notify_all(address);
+}
+
+void atomic_notify_all(volatile unsigned *address)
+{
+	ATOMIC_WAIT_BUCKET *bucket = atomic_wait_bucket(address);
+	ATOMIC_WAITER *waiter;
+	sync_barrier();
+	lock_wait(bucket->lock);
+	waiter = bucket->first;
+	bucket->first = 0;
+	lock_unlock(bucket->lock);
+	while(waiter)
+	{
+		/* the waiter is gone once it is signaled */
+		ATOMIC_WAITER *next = waiter->next;
+		sphore_signal(&waiter->sphore);
+		waiter = next;
+	}
+}
+#endif
+
 
 /* -----  time ----- */
 int64 time_get()
@@ -1861,11 +2330,16 @@ int net_tcp_connect_non_blocking(NETSOCKET sock, NETADDR bindaddr)
 int net_tcp_send(NETSOCKET sock, const void *data, int size)
 {
 	int bytes = -1;
+#if defined(MSG_NOSIGNAL)
+	const int flags = MSG_NOSIGNAL; /* a closed connection must not kill the process */
+#else
+	const int flags = 0;
+#endif
 
 	if(sock.ipv4sock >= 0)
-		bytes = send((int)sock.ipv4sock, (const char*)data, size, 0);
+		bytes = send((int)sock.ipv4sock, (const char*)data, size, flags);
 	if(sock.ipv6sock >= 0)
-		bytes = send((int)sock.ipv6sock, (const char*)data, size, 0);
+		bytes = send((int)sock.ipv6sock, (const char*)data, size, flags);
 
 	return bytes;
 }
@@ -2393,6 +2867,424 @@ int net_socket_read_wait(NETSOCKET sock, int time)
 	return 0;
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+struct NETPOLLINTERNAL
+{
+	int epoll_fd;
+	int wake_fd;
+};
+
+NETPOLL net_poll_create()
+{
+	struct epoll_event event;
+	NETPOLL poll = (NETPOLL)mem_alloc(sizeof(*poll));
+	poll->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	poll->wake_fd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+	if(poll->epoll_fd < 0 || poll->wake_fd < 0)
+	{
+		net_poll_destroy(poll);
+		return 0;
+	}
+
+	/* the wake up is told apart by the set itself as user */
+	mem_zero(&event, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = poll;
+	epoll_ctl(poll->epoll_fd, EPOLL_CTL_ADD, poll->wake_fd, &event);
+	return poll;
+}
+
+void net_poll_destroy(NETPOLL poll)
+{
+	if(poll->epoll_fd >= 0)
+		close(poll->epoll_fd);
+	if(poll->wake_fd >= 0)
+		close(poll->wake_fd);
+	mem_free(poll);
+}
+
+static int priv_net_poll_ctl(NETPOLL poll, int op, NETSOCKET sock, int events, void *user)
+{
+	struct epoll_event event;
+	int fds[2];
+	int i, result = 0;
+	fds[0] = sock.ipv4sock;
+	fds[1] = sock.ipv6sock;
+
+	mem_zero(&event, sizeof(event));
+	event.events = ((events&NETPOLL_READ) ? EPOLLIN : 0) | ((events&NETPOLL_WRITE) ? EPOLLOUT : 0);
+	event.data.ptr = user;
+	for(i = 0; i < 2; i++)
+	{
+		if(fds[i] >= 0 && epoll_ctl(poll->epoll_fd, op, fds[i], &event) != 0)
+			result = -1;
+	}
+	return result;
+}
+
+int net_poll_add(NETPOLL poll, NETSOCKET sock, int events, void *user)
+{
+	return priv_net_poll_ctl(poll, EPOLL_CTL_ADD, sock, events, user);
+}
+
+int net_poll_modify(NETPOLL poll, NETSOCKET sock, int events, void *user)
+{
+	return priv_net_poll_ctl(poll, EPOLL_CTL_MOD, sock, events, user);
+}
+
+int net_poll_remove(NETPOLL poll, NETSOCKET sock)
+{
+	return priv_net_poll_ctl(poll, EPOLL_CTL_DEL, sock, 0, 0);
+}
+
+int net_poll_wait(NETPOLL poll, NETPOLL_EVENT *events, int max_events, int timeout)
+{
+	struct epoll_event aEvents[64];
+	int i, num, result = 0;
+
+	num = epoll_wait(poll->epoll_fd, aEvents, max_events < 64 ? max_events : 64, timeout);
+	if(num < 0)
+		return errno == EINTR ? 0 : -1;
+
+	for(i = 0; i < num; i++)
+	{
+		if(aEvents[i].data.ptr == poll)
+		{
+			uint64_t value;
+			ssize_t bytes = read(poll->wake_fd, &value, sizeof(value));
+			(void)bytes;
+			continue;
+		}
+		events[result].user = aEvents[i].data.ptr;
+		events[result].events = ((aEvents[i].events&EPOLLIN) ? NETPOLL_READ : 0) | ((aEvents[i].events&EPOLLOUT) ? NETPOLL_WRITE : 0) |
+			((aEvents[i].events&(EPOLLERR|EPOLLHUP)) ? NETPOLL_ERROR : 0);
+		result++;
+	}
+	return result;
+}
+
+void net_poll_wake(NETPOLL poll)
+{
+	uint64_t value = 1;
+	ssize_t bytes = write(poll->wake_fd, &value, sizeof(value));
+	(void)bytes;
+}
+#else
+#if defined(CONF_FAMILY_WINDOWS)
+	/* WSAPoll is only there since vista, the headers don't declare it
+	   for the windows version built for. it is looked up at runtime, with
+	   select as fallback. the layout and flags are the ones of WSAPOLLFD */
+	typedef struct
+	{
+		SOCKET fd;
+		short events;
+		short revents;
+	} NETPOLLFD;
+
+	enum
+	{
+		NETPOLL_POLLIN = 0x0300, /* POLLRDNORM|POLLRDBAND */
+		NETPOLL_POLLOUT = 0x0010, /* POLLWRNORM */
+		NETPOLL_POLLERR = 0x0001,
+		NETPOLL_POLLHUP = 0x0002,
+		NETPOLL_POLLNVAL = 0x0004
+	};
+
+	typedef int (WSAAPI *NETPOLLFUNC)(NETPOLLFD *fds, ULONG num, INT timeout);
+#else
+	typedef struct pollfd NETPOLLFD;
+
+	enum
+	{
+		NETPOLL_POLLIN = POLLIN,
+		NETPOLL_POLLOUT = POLLOUT,
+		NETPOLL_POLLERR = POLLERR,
+		NETPOLL_POLLHUP = POLLHUP,
+		NETPOLL_POLLNVAL = POLLNVAL
+	};
+#endif
+
+#if defined(CONF_FAMILY_WINDOWS)
+/* the windows fd_set is a counted array, so it can be made as big as needed */
+typedef struct
+{
+	u_int fd_count;
+	SOCKET fd_array[1];
+} NETPOLLSET;
+
+static int priv_net_poll_select(NETPOLLFD *fds, int num, int timeout)
+{
+	NETPOLLSET *sets[3];
+	struct timeval tv;
+	int i, k, result;
+
+	for(k = 0; k < 3; k++)
+	{
+		sets[k] = (NETPOLLSET *)mem_alloc(sizeof(NETPOLLSET)+num*sizeof(SOCKET));
+		sets[k]->fd_count = 0;
+	}
+	for(i = 0; i < num; i++)
+	{
+		fds[i].revents = 0;
+		if(fds[i].events&NETPOLL_POLLIN)
+			sets[0]->fd_array[sets[0]->fd_count++] = fds[i].fd;
+		if(fds[i].events&NETPOLL_POLLOUT)
+			sets[1]->fd_array[sets[1]->fd_count++] = fds[i].fd;
+		sets[2]->fd_array[sets[2]->fd_count++] = fds[i].fd;
+	}
+
+	tv.tv_sec = timeout/1000;
+	tv.tv_usec = (timeout%1000)*1000;
+	result = select(0, (fd_set *)sets[0], (fd_set *)sets[1], (fd_set *)sets[2], timeout < 0 ? NULL : &tv);
+	if(result > 0)
+	{
+		/* select leaves only the ready sockets in the sets */
+		for(i = 0; i < num; i++)
+		{
+			for(k = 0; k < (int)sets[0]->fd_count; k++)
+				if(sets[0]->fd_array[k] == fds[i].fd)
+					fds[i].revents |= NETPOLL_POLLIN;
+			for(k = 0; k < (int)sets[1]->fd_count; k++)
+				if(sets[1]->fd_array[k] == fds[i].fd)
+					fds[i].revents |= NETPOLL_POLLOUT;
+			for(k = 0; k < (int)sets[2]->fd_count; k++)
+				if(sets[2]->fd_array[k] == fds[i].fd)
+					fds[i].revents |= NETPOLL_POLLERR;
+		}
+	}
+
+	for(k = 0; k < 3; k++)
+		mem_free(sets[k]);
+	return result;
+}
+#endif
+
+struct NETPOLLINTERNAL
+{
+	LOCK lock;
+	NETPOLLFD *fds; /* the first one is the wake up socket */
+	void **users;
+	int num_fds;
+	int max_fds;
+	unsigned num_changes; /* removals and user changes */
+
+	/* copies for the waiting thread, the set can change meanwhile */
+	NETPOLLFD *wait_fds;
+	void **wait_users;
+	int max_wait_fds;
+
+	int wake_sock;
+#if defined(CONF_FAMILY_WINDOWS)
+	NETPOLLFUNC wsapoll;
+#endif
+};
+
+static int priv_net_poll_sys(NETPOLL set, NETPOLLFD *fds, int num, int timeout)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	if(set->wsapoll)
+		return set->wsapoll(fds, num, timeout);
+	return priv_net_poll_select(fds, num, timeout);
+#else
+	(void)set;
+	return poll(fds, num, timeout);
+#endif
+}
+
+static int priv_net_poll_reserve(NETPOLLFD **fds, void ***users, int *max_fds, int num)
+{
+	NETPOLLFD *new_fds;
+	void **new_users;
+	int new_max = *max_fds ? *max_fds : 16;
+	if(num <= *max_fds)
+		return 0;
+	while(new_max < num)
+		new_max *= 2;
+
+	new_fds = (NETPOLLFD *)mem_alloc(new_max*sizeof(NETPOLLFD));
+	new_users = (void **)mem_alloc(new_max*sizeof(void *));
+	if(*max_fds)
+	{
+		mem_copy(new_fds, *fds, *max_fds*sizeof(NETPOLLFD));
+		mem_copy(new_users, *users, *max_fds*sizeof(void *));
+		mem_free(*fds);
+		mem_free(*users);
+	}
+	*fds = new_fds;
+	*users = new_users;
+	*max_fds = new_max;
+	return 0;
+}
+
+NETPOLL net_poll_create()
+{
+	/* a udp socket connected to itself to wake the wait up */
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	NETPOLL poll = (NETPOLL)mem_alloc(sizeof(*poll));
+	int sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+	mem_zero(poll, sizeof(*poll));
+	mem_zero(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+		getsockname(sock, (struct sockaddr *)&addr, &addr_len) != 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		if(sock >= 0)
+			priv_net_close_socket(sock);
+		mem_free(poll);
+		return 0;
+	}
+	{
+		NETSOCKET wake_sock = {NETTYPE_IPV4, sock, -1};
+		net_set_non_blocking(wake_sock);
+	}
+
+	poll->wake_sock = sock;
+#if defined(CONF_FAMILY_WINDOWS)
+	poll->wsapoll = (NETPOLLFUNC)GetProcAddress(GetModuleHandleA("ws2_32.dll"), "WSAPoll");
+#endif
+	poll->lock = lock_create();
+	priv_net_poll_reserve(&poll->fds, &poll->users, &poll->max_fds, 1);
+	poll->fds[0].fd = sock;
+	poll->fds[0].events = NETPOLL_POLLIN;
+	poll->users[0] = poll;
+	poll->num_fds = 1;
+	return poll;
+}
+
+void net_poll_destroy(NETPOLL poll)
+{
+	priv_net_close_socket(poll->wake_sock);
+	lock_destroy(poll->lock);
+	mem_free(poll->fds);
+	mem_free(poll->users);
+	if(poll->max_wait_fds)
+	{
+		mem_free(poll->wait_fds);
+		mem_free(poll->wait_users);
+	}
+	mem_free(poll);
+}
+
+static int priv_net_poll_set(NETPOLL poll, NETSOCKET sock, int events, void *user, int add, int remove)
+{
+	int fds[2];
+	int i, k, result = 0;
+	fds[0] = sock.ipv4sock;
+	fds[1] = sock.ipv6sock;
+
+	lock_wait(poll->lock);
+	for(i = 0; i < 2; i++)
+	{
+		if(fds[i] < 0)
+			continue;
+		for(k = 1; k < poll->num_fds; k++)
+		{
+			if((int)poll->fds[k].fd == fds[i])
+				break;
+		}
+		if(k == poll->num_fds)
+		{
+			if(!add)
+			{
+				result = -1;
+				continue;
+			}
+			priv_net_poll_reserve(&poll->fds, &poll->users, &poll->max_fds, poll->num_fds+1);
+			poll->num_fds++;
+		}
+		else if(remove)
+		{
+			poll->num_fds--;
+			poll->fds[k] = poll->fds[poll->num_fds];
+			poll->users[k] = poll->users[poll->num_fds];
+			poll->num_changes++;
+			continue;
+		}
+		else if(poll->users[k] != user)
+			poll->num_changes++;
+		poll->fds[k].fd = fds[i];
+		poll->fds[k].events = ((events&NETPOLL_READ) ? NETPOLL_POLLIN : 0) | ((events&NETPOLL_WRITE) ? NETPOLL_POLLOUT : 0);
+		poll->fds[k].revents = 0;
+		poll->users[k] = user;
+	}
+	lock_unlock(poll->lock);
+
+	net_poll_wake(poll);
+	return result;
+}
+
+int net_poll_add(NETPOLL poll, NETSOCKET sock, int events, void *user)
+{
+	return priv_net_poll_set(poll, sock, events, user, 1, 0);
+}
+
+int net_poll_modify(NETPOLL poll, NETSOCKET sock, int events, void *user)
+{
+	return priv_net_poll_set(poll, sock, events, user, 0, 0);
+}
+
+int net_poll_remove(NETPOLL poll, NETSOCKET sock)
+{
+	return priv_net_poll_set(poll, sock, 0, 0, 0, 1);
+}
+
+int net_poll_wait(NETPOLL poll, NETPOLL_EVENT *events, int max_events, int timeout)
+{
+	int i, k, num, result = 0;
+	unsigned num_changes;
+
+	lock_wait(poll->lock);
+	num = poll->num_fds;
+	num_changes = poll->num_changes;
+	priv_net_poll_reserve(&poll->wait_fds, &poll->wait_users, &poll->max_wait_fds, num);
+	mem_copy(poll->wait_fds, poll->fds, num*sizeof(NETPOLLFD));
+	mem_copy(poll->wait_users, poll->users, num*sizeof(void *));
+	lock_unlock(poll->lock);
+
+	if(priv_net_poll_sys(poll, poll->wait_fds, num, timeout) < 0)
+		return net_errno() == EINTR ? 0 : -1;
+
+	/* the copies are stale for sockets that were removed or changed meanwhile */
+	lock_wait(poll->lock);
+	for(i = 0; i < num && result < max_events; i++)
+	{
+		const int revents = poll->wait_fds[i].revents;
+		if(!revents)
+			continue;
+		if(i == 0)
+		{
+			char aBuf[16];
+			while(recv(poll->wake_sock, aBuf, sizeof(aBuf), 0) > 0);
+			continue;
+		}
+		if(poll->num_changes != num_changes)
+		{
+			for(k = 1; k < poll->num_fds; k++)
+			{
+				if(poll->fds[k].fd == poll->wait_fds[i].fd)
+					break;
+			}
+			if(k == poll->num_fds || poll->users[k] != poll->wait_users[i])
+				continue;
+		}
+		events[result].user = poll->wait_users[i];
+		events[result].events = ((revents&NETPOLL_POLLIN) ? NETPOLL_READ : 0) | ((revents&NETPOLL_POLLOUT) ? NETPOLL_WRITE : 0) |
+			((revents&(NETPOLL_POLLERR|NETPOLL_POLLHUP|NETPOLL_POLLNVAL)) ? NETPOLL_ERROR : 0);
+		result++;
+	}
+	lock_unlock(poll->lock);
+	return result;
+}
+
+void net_poll_wake(NETPOLL poll)
+{
+	char c = 0;
+	send(poll->wake_sock, &c, 1, 0);
+}
+#endif
+
 int time_timestamp()
 {
 	return time(0);
@@ -381,6 +381,39 @@ int io_flush(IOHANDLE io);
 */
 int io_error(IOHANDLE io);
 
+/*
+	Function: io_map
+		Maps the whole file into memory.
+
+	Parameters:
+		io - Handle to the file.
+		size - Pointer that receives the size of the mapping.
+
+	Returns:
+		Returns a pointer to the file contents, NULL if the file could not be
+		mapped (e.g. because it is empty).
+
+	Remarks:
+		The mapping is read-only.
+		It stays valid after the file is closed and has to be released with
+		<io_unmap>.
+		Changes to the file show through the mapping and accessing it after
+		the file got truncated crashes, so mapped files have to be replaced
+		atomically by renaming a new file over them.
+		On Windows a mapped file can't be replaced at all.
+*/
+const void *io_map(IOHANDLE io, unsigned *size);
+
+/*
+	Function: io_unmap
+		Releases a mapping created by <io_map>.
+
+	Parameters:
+		data - Pointer returned by <io_map>.
+		size - Size of the mapping.
+*/
+void io_unmap(const void *data, unsigned size);
+
 /*
 	Function: io_stdin
 		Returns an <IOHANDLE> to the standard input.
@@ -600,6 +633,12 @@ void thread_detach(void *thread);
 */
 void cpu_relax();
 
+/*
+	Function: cpu_count
+		Returns the number of logical processors, at least 1.
+*/
+int cpu_count();
+
 /* Group: Locks */
 typedef void* LOCK;
 
@@ -627,6 +666,37 @@ void sphore_wait(SEMAPHORE *sem);
 void sphore_signal(SEMAPHORE *sem);
 void sphore_destroy(SEMAPHORE *sem);
 
+/* Group: Atomic waits */
+/*
+	Function: atomic_wait
+		Sleeps while the value at the address equals the expected
+		one, until another thread calls atomic_notify_one or
+		atomic_notify_all for the address.
+
+	Parameters:
+		address - The value to wait on.
+		expected - The value that means keep waiting.
+
+	Remarks:
+		- May return without a notify, check the value in a loop.
+		- Comparing and going to sleep is atomic with respect to
+		notifies, change the value before notifying.
+		- Uses futexes on linux and a table of semaphores elsewhere.
+*/
+void atomic_wait(volatile unsigned *address, unsigned expected);
+
+/*
+	Function: atomic_notify_one
+		Wakes at least one thread waiting on the address.
+*/
+void atomic_notify_one(volatile unsigned *address);
+
+/*
+	Function: atomic_notify_all
+		Wakes all threads waiting on the address.
+*/
+void atomic_notify_all(volatile unsigned *address);
+
 /* Group: Timer */
 #ifdef __GNUC__
 /* if compiled with -pedantic-errors it will complain about long
@@ -992,6 +1062,103 @@ int net_tcp_recv(NETSOCKET sock, void *data, int maxsize);
 */
 int net_tcp_close(NETSOCKET sock);
 
+/* Group: Network Polling */
+typedef struct NETPOLLINTERNAL *NETPOLL;
+
+enum
+{
+	NETPOLL_READ = 1,
+	NETPOLL_WRITE = 2,
+	NETPOLL_ERROR = 4,
+};
+
+typedef struct
+{
+	void *user;
+	int events;
+} NETPOLL_EVENT;
+
+/*
+	Function: net_poll_create
+		Creates a set of sockets to wait for. Uses epoll on Linux,
+		poll on other unix systems and WSAPoll on Windows, or select
+		before Windows Vista.
+
+	Returns:
+		The socket set, 0 on failure.
+*/
+NETPOLL net_poll_create();
+
+/*
+	Function: net_poll_destroy
+		Destroys a socket set, the sockets stay open.
+*/
+void net_poll_destroy(NETPOLL poll);
+
+/*
+	Function: net_poll_add
+		Adds a socket to the set.
+
+	Parameters:
+		poll - Socket set.
+		sock - Socket to wait for, it must not be in the set yet.
+		events - NETPOLL_READ and/or NETPOLL_WRITE.
+		user - Returned with the events of this socket.
+
+	Returns:
+		0 on success. Negative value on failure.
+
+	Remarks:
+		- Sockets can be added, modified and removed while another
+		  thread waits for the set, the wait is woken up for it.
+*/
+int net_poll_add(NETPOLL poll, NETSOCKET sock, int events, void *user);
+
+/*
+	Function: net_poll_modify
+		Changes the events to wait for of a socket in the set.
+*/
+int net_poll_modify(NETPOLL poll, NETSOCKET sock, int events, void *user);
+
+/*
+	Function: net_poll_remove
+		Removes a socket from the set, before it is closed.
+*/
+int net_poll_remove(NETPOLL poll, NETSOCKET sock);
+
+/*
+	Function: net_poll_wait
+		Waits until sockets of the set are ready or the wait is woken up.
+
+	Parameters:
+		poll - Socket set.
+		events - Array to fill with the ready sockets.
+		max_events - Size of the array.
+		timeout - Maximum time to wait in milliseconds, -1 waits
+			until something happens.
+
+	Returns:
+		Number of events written, 0 on timeout or wake up. Negative
+		value on failure.
+
+	Remarks:
+		- A socket with both an IPv4 and an IPv6 part can be reported
+		  twice.
+		- Sockets removed from the set, or modified with another user,
+		  before the wait returns are not reported with the old user.
+		  Changes after it returns have to be checked by the caller.
+		- Errors and hang ups are reported as NETPOLL_ERROR whatever
+		  the events waited for, until the socket is removed. With
+		  select a hang up is only seen as readable.
+*/
+int net_poll_wait(NETPOLL poll, NETPOLL_EVENT *events, int max_events, int timeout);
+
+/*
+	Function: net_poll_wake
+		Makes a wait on the socket set return, from any thread.
+*/
+void net_poll_wake(NETPOLL poll);
+
 /* Group: Strings */
 
 /*
@@ -1732,6 +1899,50 @@ void dbg_logger_stdout();
 void dbg_logger_debugger();
 void dbg_logger_file(IOHANDLE logfile);
 
+/*
+	Function: dbg_logger_async_start
+		Moves the work of <dbg_msg> to a background thread. Messages are
+		formatted by the calling thread and queued in a ring owned by
+		that thread, the logger thread adds the timestamps and calls the
+		loggers in the order the messages were queued.
+
+	Remarks:
+		- Messages that don't fit into the ring of a thread are dropped
+		and counted, the logger reports how many.
+		- At most 32 threads own a ring at a time, further ones and
+		every thread while the logger thread isn't running log
+		synchronously. The ring of a thread that ended is reused by
+		the next one, on Windows only for threads started with
+		<thread_init>.
+		- Registered loggers are called from the logger thread.
+
+	See Also:
+		<dbg_logger_async_stop>
+*/
+void dbg_logger_async_start();
+
+/*
+	Function: dbg_logger_async_stop
+		Writes all queued messages and stops the logger thread, messages
+		are logged synchronously again afterwards. Called on exit and
+		by a failing <dbg_assert>, only the first of concurrent calls
+		stops the thread.
+*/
+void dbg_logger_async_stop();
+
+typedef struct
+{
+	unsigned num_logged;
+	unsigned num_dropped;
+} DBG_LOGGER_STATS;
+
+/*
+	Function: dbg_logger_stats
+		Gets the number of messages the logger thread wrote and the
+		number of messages that were dropped because a ring was full.
+*/
+void dbg_logger_stats(DBG_LOGGER_STATS *stats);
+
 #if defined(CONF_FAMILY_WINDOWS)
 void dbg_console_init();
 void dbg_console_cleanup();
@@ -1740,10 +1951,10 @@ void dbg_console_hide();
 
 typedef struct
 {
-	int sent_packets;
-	int sent_bytes;
-	int recv_packets;
-	int recv_bytes;
+	int64 sent_packets;
+	int64 sent_bytes;
+	int64 recv_packets;
+	int64 recv_bytes;
 } NETSTATS;
 
 
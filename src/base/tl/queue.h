@@ -0,0 +1,189 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef BASE_TL_QUEUE_H
+#define BASE_TL_QUEUE_H
+
+#include "threading.h"
+
+/*
+	Class: spsc_queue
+		Bounded lock-free queue for one producing and one consuming thread.
+
+	Remarks:
+		- SIZE has to be a power of two.
+		- push and pop never block, they fail when the queue is full or empty.
+		- The counters wrap around, that is fine as long as SIZE fits twice.
+*/
+template <class T, int SIZE>
+class spsc_queue
+{
+	enum
+	{
+		MASK=SIZE-1
+	};
+
+	// the producer and the consumer each write their own line
+	volatile unsigned head;
+	char head_padding[64-sizeof(unsigned)];
+	volatile unsigned tail;
+	char tail_padding[64-sizeof(unsigned)];
+	T items[SIZE];
+
+public:
+	spsc_queue()
+	{
+		dbg_assert((SIZE&MASK) == 0, "queue size has to be a power of two");
+		head = 0;
+		tail = 0;
+	}
+
+	/*
+		Function: push
+			Adds an item at the end, producer only.
+
+		Returns:
+			false if the queue is full.
+	*/
+	bool push(const T &item)
+	{
+		unsigned t = tail;
+		if(t-atomic_load(&head) == (unsigned)SIZE)
+			return false;
+		items[t&MASK] = item;
+		atomic_store(&tail, t+1);
+		return true;
+	}
+
+	/*
+		Function: pop
+			Takes the first item, consumer only.
+
+		Returns:
+			false if the queue is empty.
+	*/
+	bool pop(T *item)
+	{
+		unsigned h = head;
+		if(atomic_load(&tail) == h)
+			return false;
+		*item = items[h&MASK];
+		atomic_store(&head, h+1);
+		return true;
+	}
+
+	/*
+		Function: size
+			Number of items, only a hint unless called by the producer
+			or the consumer while the other one is idle.
+	*/
+	int size() const { return (int)(atomic_load(&tail)-atomic_load(&head)); }
+};
+
+/*
+	Class: mpmc_queue
+		Bounded lock-free queue for any number of producing and consuming
+		threads.
+
+	Remarks:
+		- SIZE has to be a power of two.
+		- push and pop never block, they fail when the queue is full or empty.
+		- Every slot carries a sequence number telling whether it is
+		free for the producer or filled for the consumer of this round,
+		so producers and consumers only race among themselves.
+*/
+template <class T, int SIZE>
+class mpmc_queue
+{
+	enum
+	{
+		MASK=SIZE-1
+	};
+
+	struct slot
+	{
+		volatile unsigned sequence;
+		T item;
+	};
+
+	volatile unsigned head;
+	char head_padding[64-sizeof(unsigned)];
+	volatile unsigned tail;
+	char tail_padding[64-sizeof(unsigned)];
+	slot slots[SIZE];
+
+public:
+	mpmc_queue()
+	{
+		dbg_assert((SIZE&MASK) == 0, "queue size has to be a power of two");
+		head = 0;
+		tail = 0;
+		for(int i = 0; i < SIZE; i++)
+			slots[i].sequence = i;
+	}
+
+	/*
+		Function: push
+			Adds an item at the end.
+
+		Returns:
+			false if the queue is full.
+	*/
+	bool push(const T &item)
+	{
+		unsigned t = tail;
+		slot *s;
+		while(1)
+		{
+			s = &slots[t&MASK];
+			int diff = (int)(atomic_load(&s->sequence)-t);
+			if(diff == 0)
+			{
+				unsigned prev = atomic_compswap(&tail, t, t+1);
+				if(prev == t)
+					break;
+				t = prev;
+			}
+			else if(diff < 0)
+				return false;
+			else
+				t = tail;
+		}
+		s->item = item;
+		atomic_store(&s->sequence, t+1);
+		return true;
+	}
+
+	/*
+		Function: pop
+			Takes the first item.
+
+		Returns:
+			false if the queue is empty.
+	*/
+	bool pop(T *item)
+	{
+		unsigned h = head;
+		slot *s;
+		while(1)
+		{
+			s = &slots[h&MASK];
+			int diff = (int)(atomic_load(&s->sequence)-(h+1));
+			if(diff == 0)
+			{
+				unsigned prev = atomic_compswap(&head, h, h+1);
+				if(prev == h)
+					break;
+				h = prev;
+			}
+			else if(diff < 0)
+				return false;
+			else
+				h = head;
+		}
+		*item = s->item;
+		atomic_store(&s->sequence, h+(unsigned)SIZE);
+		return true;
+	}
+};
+
+#endif // BASE_TL_QUEUE_H
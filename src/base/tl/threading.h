@@ -8,32 +8,91 @@
 /*
 	atomic_inc - should return the value after increment
 	atomic_dec - should return the value after decrement
+	atomic_add - should return the value after the addition
+	atomic_exchange - should return the value before the exchange
 	atomic_compswap - should return the value before the eventual swap
+	atomic_load - reads with acquire semantics, later accesses stay after it
+	atomic_store - writes with release semantics, earlier accesses stay before it
 	sync_barrier - creates a full hardware fence
+	sync_barrier_acquire, sync_barrier_release - one sided fences
+
+	the read-modify-write ones are full barriers. sleeping until a value
+	changes is done with atomic_wait and atomic_notify from base/system.h
+
+	everything but atomic_load, atomic_store and the pointer atomic_compswap
+	can be used from C as well
 */
 
+#if defined(__cplusplus)
+	#define ATOMIC_INLINE inline
+#elif defined(_MSC_VER)
+	#define ATOMIC_INLINE static __inline
+#else
+	#define ATOMIC_INLINE static inline
+#endif
+
 #if defined(__GNUC__)
 
-	inline unsigned atomic_inc(volatile unsigned *pValue)
+	ATOMIC_INLINE unsigned atomic_inc(volatile unsigned *pValue)
 	{
 		return __sync_add_and_fetch(pValue, 1);
 	}
 
-	inline unsigned atomic_dec(volatile unsigned *pValue)
+	ATOMIC_INLINE unsigned atomic_dec(volatile unsigned *pValue)
 	{
 		return __sync_add_and_fetch(pValue, -1);
 	}
 
-	inline unsigned atomic_compswap(volatile unsigned *pValue, unsigned comperand, unsigned value)
+	ATOMIC_INLINE unsigned atomic_add(volatile unsigned *pValue, unsigned Amount)
+	{
+		return __sync_add_and_fetch(pValue, Amount);
+	}
+
+	ATOMIC_INLINE unsigned atomic_exchange(volatile unsigned *pValue, unsigned Value)
+	{
+		return __atomic_exchange_n(pValue, Value, __ATOMIC_SEQ_CST);
+	}
+
+	ATOMIC_INLINE unsigned atomic_compswap(volatile unsigned *pValue, unsigned comperand, unsigned value)
 	{
 		return __sync_val_compare_and_swap(pValue, comperand, value);
 	}
 
-	inline void sync_barrier()
+#if defined(__cplusplus)
+	template<typename T>
+	inline T *atomic_compswap(T *volatile *ppValue, T *pComperand, T *pValue)
+	{
+		return __sync_val_compare_and_swap(ppValue, pComperand, pValue);
+	}
+
+	template<typename T>
+	inline T atomic_load(const volatile T *pValue)
+	{
+		return __atomic_load_n(pValue, __ATOMIC_ACQUIRE);
+	}
+
+	template<typename T>
+	inline void atomic_store(volatile T *pValue, T Value)
+	{
+		__atomic_store_n(pValue, Value, __ATOMIC_RELEASE);
+	}
+#endif
+
+	ATOMIC_INLINE void sync_barrier()
 	{
 		__sync_synchronize();
 	}
 
+	ATOMIC_INLINE void sync_barrier_acquire()
+	{
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	}
+
+	ATOMIC_INLINE void sync_barrier_release()
+	{
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+	}
+
 #elif defined(_MSC_VER)
 	#include <intrin.h>
 
@@ -42,29 +101,84 @@
 	#endif
 	#include <windows.h>
 
-	inline unsigned atomic_inc(volatile unsigned *pValue)
+	// x86 does not reorder loads with later accesses or stores with
+	// earlier ones, only the compiler has to be kept from doing so. arm
+	// does, so it needs a hardware fence on top
+	#if defined(_M_ARM64)
+		#define ATOMIC_FENCE() (_ReadWriteBarrier(), __dmb(_ARM64_BARRIER_ISH))
+	#elif defined(_M_ARM)
+		#define ATOMIC_FENCE() (_ReadWriteBarrier(), __dmb(_ARM_BARRIER_ISH))
+	#else
+		#define ATOMIC_FENCE() _ReadWriteBarrier()
+	#endif
+
+	ATOMIC_INLINE unsigned atomic_inc(volatile unsigned *pValue)
 	{
 		return _InterlockedIncrement((volatile long *)pValue);
 	}
 
-	inline unsigned atomic_dec(volatile unsigned *pValue)
+	ATOMIC_INLINE unsigned atomic_dec(volatile unsigned *pValue)
 	{
 		return _InterlockedDecrement((volatile long *)pValue);
 	}
 
-	inline unsigned atomic_compswap(volatile unsigned *pValue, unsigned comperand, unsigned value)
+	ATOMIC_INLINE unsigned atomic_add(volatile unsigned *pValue, unsigned Amount)
+	{
+		return _InterlockedExchangeAdd((volatile long *)pValue, (long)Amount) + Amount;
+	}
+
+	ATOMIC_INLINE unsigned atomic_exchange(volatile unsigned *pValue, unsigned Value)
+	{
+		return _InterlockedExchange((volatile long *)pValue, (long)Value);
+	}
+
+	ATOMIC_INLINE unsigned atomic_compswap(volatile unsigned *pValue, unsigned comperand, unsigned value)
 	{
 		return _InterlockedCompareExchange((volatile long *)pValue, (long)value, (long)comperand);
 	}
 
-	inline void sync_barrier()
+#if defined(__cplusplus)
+	template<typename T>
+	inline T *atomic_compswap(T *volatile *ppValue, T *pComperand, T *pValue)
+	{
+		return (T *)_InterlockedCompareExchangePointer((void *volatile *)ppValue, pValue, pComperand);
+	}
+
+	template<typename T>
+	inline T atomic_load(const volatile T *pValue)
+	{
+		T Value = *pValue;
+		ATOMIC_FENCE();
+		return Value;
+	}
+
+	template<typename T>
+	inline void atomic_store(volatile T *pValue, T Value)
+	{
+		ATOMIC_FENCE();
+		*pValue = Value;
+	}
+#endif
+
+	ATOMIC_INLINE void sync_barrier()
 	{
 		MemoryBarrier();
 	}
+
+	ATOMIC_INLINE void sync_barrier_acquire()
+	{
+		ATOMIC_FENCE();
+	}
+
+	ATOMIC_INLINE void sync_barrier_release()
+	{
+		ATOMIC_FENCE();
+	}
 #else
 	#error missing atomic implementation for this compiler
 #endif
 
+#if defined(__cplusplus)
 class semaphore
 {
 	SEMAPHORE sem;
@@ -112,4 +226,6 @@ public:
 	}
 };
 
+#endif
+
 #endif // BASE_TL_THREADING_H
@@ -7,6 +7,7 @@
 
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 #include <engine/client.h>
 #include <engine/config.h>
@@ -28,6 +29,7 @@
 #include <engine/shared/datafile.h>
 #include <engine/shared/demo.h>
 #include <engine/shared/filecollection.h>
+#include <engine/shared/mapcache.h>
 #include <engine/shared/mapchecker.h>
 #include <engine/shared/network.h>
 #include <engine/shared/packer.h>
@@ -133,6 +135,159 @@ void CGraph::Render(IGraphics *pGraphics, IGraphics::CTextureHandle FontTexture,
 }
 
 
+void CFrameTimeHistogram::Init()
+{
+	mem_zero(m_aBuckets, sizeof(m_aBuckets));
+	m_Total = 0.0f;
+}
+
+void CFrameTimeHistogram::Add(float FrameTime)
+{
+	// fade out the old frames, roughly the last thousand frames are shown
+	static const float s_Fade = 0.999f;
+	for(int i = 0; i < NUM_BUCKETS; i++)
+		m_aBuckets[i] *= s_Fade;
+	m_Total = m_Total*s_Fade + 1.0f;
+
+	int Bucket = clamp((int)(FrameTime*1000.0f), 0, NUM_BUCKETS-1);
+	m_aBuckets[Bucket] += 1.0f;
+}
+
+float CFrameTimeHistogram::Percentile(float Percentile) const
+{
+	float Wanted = m_Total*Percentile;
+	float Count = 0.0f;
+	for(int i = 0; i < NUM_BUCKETS; i++)
+	{
+		Count += m_aBuckets[i];
+		if(Count >= Wanted)
+			return i+1.0f;
+	}
+	return (float)NUM_BUCKETS;
+}
+
+void CFrameTimeHistogram::Render(IGraphics *pGraphics, IGraphics::CTextureHandle FontTexture, float x, float y, float w, float h, const char *pDescription)
+{
+	pGraphics->TextureClear();
+
+	pGraphics->QuadsBegin();
+	pGraphics->SetColor(0, 0, 0, 0.75f);
+	IGraphics::CQuadItem QuadItem(x, y, w, h);
+	pGraphics->QuadsDrawTL(&QuadItem, 1);
+
+	float Max = 1.0f;
+	for(int i = 0; i < NUM_BUCKETS; i++)
+		Max = maximum(Max, m_aBuckets[i]);
+
+	// green below 60 fps, yellow below 30 fps, red above
+	float BarWidth = w/NUM_BUCKETS;
+	for(int i = 0; i < NUM_BUCKETS; i++)
+	{
+		if(i < 17)
+			pGraphics->SetColor(0.2f, 1.0f, 0.2f, 0.75f);
+		else if(i < 34)
+			pGraphics->SetColor(1.0f, 1.0f, 0.2f, 0.75f);
+		else
+			pGraphics->SetColor(1.0f, 0.2f, 0.2f, 0.75f);
+		float BarHeight = m_aBuckets[i]/Max*(h-20.0f);
+		IGraphics::CQuadItem Bar(x+i*BarWidth, y+h-BarHeight, BarWidth-1.0f, BarHeight);
+		pGraphics->QuadsDrawTL(&Bar, 1);
+	}
+	pGraphics->QuadsEnd();
+
+	pGraphics->TextureSet(FontTexture);
+	pGraphics->QuadsBegin();
+	pGraphics->QuadsText(x+2, y+2, 16, pDescription);
+
+	char aBuf[64];
+	str_format(aBuf, sizeof(aBuf), "p50 %.0fms p99 %.0fms", Percentile(0.5f), Percentile(0.99f));
+	pGraphics->QuadsText(x+w-8*str_length(aBuf)-8, y+2, 16, aBuf);
+	pGraphics->QuadsEnd();
+}
+
+
+CSnapshotDecoder::CSnapshotDecoder()
+{
+	m_pDelta = 0x0;
+	m_Busy = 0;
+	m_Shutdown = false;
+	m_pThread = 0x0;
+}
+
+void CSnapshotDecoder::ThreadFunc(void *pUser)
+{
+	CSnapshotDecoder *pThis = (CSnapshotDecoder *)pUser;
+
+	while(!pThis->m_Shutdown)
+	{
+		// one activity per Run() or Stop()
+		pThis->m_Activity.wait();
+		if(atomic_load(&pThis->m_Busy))
+		{
+			// hand the results over with the store, they are visible to
+			// whoever sees the decoder idle
+			pThis->Decode(&pThis->m_Task);
+			atomic_store(&pThis->m_Busy, 0u);
+			atomic_notify_all(&pThis->m_Busy);
+		}
+	}
+}
+
+void CSnapshotDecoder::Decode(CTask *pTask)
+{
+	const void *pDeltaData = m_pDelta->EmptyDelta();
+	int DeltaSize = sizeof(int) * 3;
+
+	pTask->m_IntSize = 0;
+	pTask->m_SnapSize = -1;
+	if(pTask->m_DataSize)
+	{
+		pTask->m_IntSize = CVariableInt::Decompress(pTask->m_aData, pTask->m_DataSize, m_aDeltaData, sizeof(m_aDeltaData));
+		if(pTask->m_IntSize < 0)
+			return;
+
+		pDeltaData = m_aDeltaData;
+		DeltaSize = pTask->m_IntSize;
+	}
+
+	pTask->m_SnapSize = m_pDelta->UnpackDelta(pTask->m_pDeltaShot, pTask->Snapshot(), pDeltaData, DeltaSize);
+	if(pTask->m_SnapSize >= 0)
+		pTask->m_SnapCrc = pTask->Snapshot()->Crc();
+}
+
+void CSnapshotDecoder::Start(CSnapshotDelta *pDelta)
+{
+	m_pDelta = pDelta;
+	m_Shutdown = false;
+	m_pThread = thread_init(ThreadFunc, this);
+}
+
+void CSnapshotDecoder::Stop()
+{
+	if(!m_pThread)
+		return;
+	WaitForIdle();
+	m_Shutdown = true;
+	m_Activity.signal();
+	thread_wait(m_pThread);
+	thread_destroy(m_pThread);
+	m_pThread = 0x0;
+}
+
+void CSnapshotDecoder::Run()
+{
+	WaitForIdle();
+	atomic_store(&m_Busy, 1u);
+	m_Activity.signal();
+}
+
+void CSnapshotDecoder::WaitForIdle()
+{
+	while(atomic_load(&m_Busy))
+		atomic_wait(&m_Busy, 1);
+}
+
+
 void CSmoothTime::Init(int64 Target)
 {
 	m_Snap = time_get();
@@ -262,6 +417,8 @@ CClient::CClient() : m_DemoPlayer(&m_SnapshotDelta), m_DemoRecorder(&m_SnapshotD
 	m_AckGameTick = -1;
 	m_CurrentRecvTick = 0;
 	m_RconAuthed = 0;
+	m_SnapshotDecodePending = false;
+	m_FrameTimeHistogram.Init();
 
 	// version-checking
 	m_aVersionStr[0] = '0';
@@ -284,6 +441,8 @@ CClient::CClient() : m_DemoPlayer(&m_SnapshotDelta), m_DemoRecorder(&m_SnapshotD
 	m_aMapdownloadName[0] = 0;
 	m_MapdownloadFileTemp = 0;
 	m_MapdownloadChunk = 0;
+	m_MapdownloadWindow = 0;
+	m_MapdownloadAcked = 0;
 	m_MapdownloadSha256 = SHA256_ZEROED;
 	m_MapdownloadSha256Present = false;
 	m_MapdownloadCrc = 0;
@@ -360,6 +519,19 @@ void CClient::SendReady()
 	SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
 }
 
+void CClient::SendMapRequest()
+{
+	CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA, true);
+	if(m_MapdownloadWindow)
+	{
+		// the server keeps the window full, tell it how much arrived
+		Msg.AddInt(m_MapdownloadWindow);
+		Msg.AddInt(m_MapdownloadChunk);
+		m_MapdownloadAcked = m_MapdownloadChunk;
+	}
+	SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+}
+
 void CClient::SendRconAuth(const char *pName, const char *pPassword)
 {
 	if(RconAuthed())
@@ -478,6 +650,8 @@ void CClient::OnEnterGame()
 	m_CurrentInput = 0;
 
 	// reset snapshots
+	m_SnapshotDecoder.WaitForIdle();
+	m_SnapshotDecodePending = false;
 	m_aSnapshots[SNAP_CURRENT] = 0;
 	m_aSnapshots[SNAP_PREV] = 0;
 	m_SnapshotStorage.PurgeAll();
@@ -583,6 +757,8 @@ void CClient::DisconnectWithReason(const char *pReason)
 
 	// disable all downloads
 	m_MapdownloadChunk = 0;
+	m_MapdownloadWindow = 0;
+	m_MapdownloadAcked = 0;
 	if(m_MapdownloadFileTemp)
 	{
 		io_close(m_MapdownloadFileTemp);
@@ -602,6 +778,8 @@ void CClient::DisconnectWithReason(const char *pReason)
 	m_aServerPassword[0] = 0;
 
 	// clear snapshots
+	m_SnapshotDecoder.WaitForIdle();
+	m_SnapshotDecodePending = false;
 	m_aSnapshots[SNAP_CURRENT] = 0;
 	m_aSnapshots[SNAP_PREV] = 0;
 	m_ReceivedSnapshots = 0;
@@ -735,7 +913,7 @@ void CClient::DebugRender()
 		{
 			if(m_SnapshotDelta.GetDataRate(i))
 			{
-				str_format(aBuffer, sizeof(aBuffer), "%4d %20s: %8d %8d %8d", i, GameClient()->GetItemName(i), m_SnapshotDelta.GetDataRate(i)/8, m_SnapshotDelta.GetDataUpdates(i),
+				str_format(aBuffer, sizeof(aBuffer), "%4d %20s: %8lld %8lld %8lld", i, GameClient()->GetItemName(i), m_SnapshotDelta.GetDataRate(i)/8, m_SnapshotDelta.GetDataUpdates(i),
 					(m_SnapshotDelta.GetDataRate(i)/m_SnapshotDelta.GetDataUpdates(i))/8);
 				Graphics()->QuadsText(2, 100+y*12, 16, aBuffer);
 				y++;
@@ -762,6 +940,7 @@ void CClient::DebugRender()
 		m_InputtimeMarginGraph.Render(Graphics(), s_Font, x, sp*5+h+sp, w, h, "Prediction Margin");
 		m_GametimeMarginGraph.Scale();
 		m_GametimeMarginGraph.Render(Graphics(), s_Font, x, sp*5+h+sp+h+sp, w, h, "Gametime Margin");
+		m_FrameTimeHistogram.Render(Graphics(), s_Font, x, sp*5+h+sp+h+sp+h+sp, w, h, "Frame Time");
 	}
 }
 
@@ -833,6 +1012,7 @@ const char *CClient::LoadMap(const char *pName, const char *pFilename, const SHA
 	str_copy(m_aCurrentMapPath, pFilename, sizeof(m_aCurrentMapPath));
 	m_CurrentMapSha256 = m_pMap->Sha256();
 	m_CurrentMapCrc = m_pMap->Crc();
+	m_MapCache.Add(m_CurrentMapSha256, pFilename);
 
 	return 0x0;
 }
@@ -879,6 +1059,16 @@ const char *CClient::LoadMapSearch(const char *pMapName, const SHA256_DIGEST *pW
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "client", aBuf);
 	SetState(IClient::STATE_LOADING);
 
+	// look the map up by its content, whatever it was called before
+	if(pWantedSha256 && m_MapCache.Find(*pWantedSha256))
+	{
+		str_copy(aBuf, m_MapCache.Find(*pWantedSha256), sizeof(aBuf));
+		pError = LoadMap(pMapName, aBuf, pWantedSha256, WantedCrc);
+		if(!pError)
+			return pError;
+		m_MapCache.Remove(aBuf);
+	}
+
 	// try the normal maps folder
 	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
 	pError = LoadMap(pMapName, aBuf, pWantedSha256, WantedCrc);
@@ -1122,6 +1312,105 @@ void CClient::ProcessConnlessPacket(CNetChunk *pPacket)
 	}
 }
 
+void CClient::ApplyDecodedSnapshot()
+{
+	// called on the main thread once the decoder is idle
+	m_SnapshotDecodePending = false;
+	CSnapshotDecoder::CTask *pTask = m_SnapshotDecoder.Task();
+	const int GameTick = pTask->m_GameTick;
+	const int DeltaTick = pTask->m_DeltaTick;
+	const int Crc = pTask->m_Crc;
+	CSnapshot *pSnapshot = pTask->Snapshot();
+	int SnapSize = pTask->m_SnapSize;
+
+	if(pTask->m_IntSize < 0) // failure during decompression, bail
+		return;
+
+	if(SnapSize < 0)
+	{
+		char aBuf[64];
+		str_format(aBuf, sizeof(aBuf), "delta unpack failed! (%d)", SnapSize);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", aBuf);
+		return;
+	}
+
+	if(pTask->m_CheckCrc && pTask->m_SnapCrc != Crc)
+	{
+		if(Config()->m_Debug)
+		{
+			char aBuf[256];
+			str_format(aBuf, sizeof(aBuf), "snapshot crc error #%d - tick=%d wantedcrc=%d gotcrc=%d compressed_size=%d delta_tick=%d",
+				m_SnapCrcErrors, GameTick, Crc, pTask->m_SnapCrc, pTask->m_DataSize, DeltaTick);
+			m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", aBuf);
+		}
+
+		m_SnapCrcErrors++;
+		if(m_SnapCrcErrors > 10)
+		{
+			// to many errors, send reset
+			m_AckGameTick = -1;
+			SendInput();
+			m_SnapCrcErrors = 0;
+		}
+		return;
+	}
+	else
+	{
+		if(m_SnapCrcErrors)
+			m_SnapCrcErrors--;
+	}
+
+	// purge old snapshots
+	int PurgeTick = DeltaTick;
+	if(m_aSnapshots[SNAP_PREV] && m_aSnapshots[SNAP_PREV]->m_Tick < PurgeTick)
+		PurgeTick = m_aSnapshots[SNAP_PREV]->m_Tick;
+	if(m_aSnapshots[SNAP_CURRENT] && m_aSnapshots[SNAP_CURRENT]->m_Tick < PurgeTick)
+		PurgeTick = m_aSnapshots[SNAP_CURRENT]->m_Tick;
+	m_SnapshotStorage.PurgeUntil(PurgeTick);
+
+	// add new
+	m_SnapshotStorage.Add(GameTick, pTask->m_RecvTime, SnapSize, pSnapshot, 1);
+
+	// add snapshot to demo
+	if(m_DemoRecorder.IsRecording())
+	{
+		// build up snapshot and add local messages
+		m_DemoRecSnapshotBuilder.Init(pSnapshot);
+		GameClient()->OnDemoRecSnap();
+		SnapSize = m_DemoRecSnapshotBuilder.Finish(pSnapshot);
+
+		// write snapshot
+		m_DemoRecorder.RecordSnapshot(GameTick, pSnapshot, SnapSize);
+	}
+
+	// apply snapshot, cycle pointers
+	m_ReceivedSnapshots++;
+
+	// we got two snapshots until we see us self as connected
+	if(m_ReceivedSnapshots == 2)
+	{
+		// start at 200ms and work from there
+		m_PredictedTime.Init(GameTick * time_freq() / SERVER_TICK_SPEED);
+		m_PredictedTime.SetAdjustSpeed(1, 1000.0f);
+		m_GameTime.Init((GameTick - 1) * time_freq() / SERVER_TICK_SPEED);
+		m_aSnapshots[SNAP_PREV] = m_SnapshotStorage.m_pFirst;
+		m_aSnapshots[SNAP_CURRENT] = m_SnapshotStorage.m_pLast;
+		SetState(IClient::STATE_ONLINE);
+	}
+
+	// adjust game time
+	if(m_ReceivedSnapshots > 2)
+	{
+		int64 Now = m_GameTime.Get(pTask->m_RecvTime);
+		int64 TickStart = GameTick * time_freq() / SERVER_TICK_SPEED;
+		int64 TimeLeft = (TickStart-Now)*1000 / time_freq();
+		m_GameTime.Update(&m_GametimeMarginGraph, (GameTick - 1) * time_freq() / SERVER_TICK_SPEED, TimeLeft, 0);
+	}
+
+	// ack snapshot
+	m_AckGameTick = GameTick;
+}
+
 void CClient::ProcessServerPacket(CNetChunk *pPacket)
 {
 	CMsgUnpacker Unpacker(pPacket->m_pData, pPacket->m_DataSize);
@@ -1141,6 +1430,9 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 			if(Unpacker.Error())
 				return;
 			const SHA256_DIGEST *pMapSha256 = (const SHA256_DIGEST *)Unpacker.GetRaw(sizeof(*pMapSha256));
+			int MapWindow = Unpacker.GetInt(); // older servers don't stream the map
+			if(Unpacker.Error())
+				MapWindow = 0;
 			const char *pError = 0;
 
 			// check for valid standard map
@@ -1189,6 +1481,8 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 					m_MapdownloadChunk = 0;
 					m_MapdownloadChunkNum = MapChunkNum;
 					m_MapDownloadChunkSize = MapChunkSize;
+					m_MapdownloadWindow = maximum(MapWindow, 0);
+					m_MapdownloadAcked = 0;
 					m_MapdownloadSha256 = pMapSha256 ? *pMapSha256 : SHA256_ZEROED;
 					m_MapdownloadSha256Present = pMapSha256;
 					m_MapdownloadCrc = MapCrc;
@@ -1196,8 +1490,7 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 					m_MapdownloadAmount = 0;
 
 					// request first chunk package of map data
-					CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA, true);
-					SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+					SendMapRequest();
 
 					if(Config()->m_Debug)
 						m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client/network", "requested first chunk package");
@@ -1244,11 +1537,10 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 				else
 					DisconnectWithReason(pError);
 			}
-			else if(m_MapdownloadChunk%m_MapdownloadChunkNum == 0)
+			else if(m_MapdownloadWindow ? m_MapdownloadChunk-m_MapdownloadAcked >= maximum(m_MapdownloadWindow/4, 1) : m_MapdownloadChunk%m_MapdownloadChunkNum == 0)
 			{
-				// request next chunk package of map data
-				CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA, true);
-				SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+				// request next chunk package of map data, or move the window
+				SendMapRequest();
 
 				if(Config()->m_Debug)
 					m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client/network", "requested next chunk package");
@@ -1398,15 +1690,19 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 				{
 					static CSnapshot s_Emptysnap;
 					CSnapshot *pDeltaShot = &s_Emptysnap;
-					unsigned char aTmpBuffer2[CSnapshot::MAX_SIZE];
-					unsigned char aTmpBuffer3[CSnapshot::MAX_SIZE];
-					CSnapshot *pTmpBuffer3 = (CSnapshot*)aTmpBuffer3;	// Fix compiler warning for strict-aliasing
 
 					int CompleteSize = (NumParts-1) * MAX_SNAPSHOT_PACKSIZE + PartSize;
 
 					// reset snapshoting
 					m_SnapshotParts = 0;
 
+					// the previous snapshot has to be stored first, it can be the delta of this one
+					if(m_SnapshotDecodePending)
+					{
+						m_SnapshotDecoder.WaitForIdle();
+						ApplyDecodedSnapshot();
+					}
+
 					// find snapshot that we should use as delta
 					s_Emptysnap.Clear();
 
@@ -1433,108 +1729,18 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 						}
 					}
 
-					// decompress snapshot
-					const void *pDeltaData = m_SnapshotDelta.EmptyDelta();
-					int DeltaSize = sizeof(int) * 3;
-
-					if(CompleteSize)
-					{
-						int IntSize = CVariableInt::Decompress(m_aSnapshotIncomingData, CompleteSize, aTmpBuffer2, sizeof(aTmpBuffer2));
-
-						if(IntSize < 0) // failure during decompression, bail
-							return;
-
-						pDeltaData = aTmpBuffer2;
-						DeltaSize = IntSize;
-					}
-
-					// unpack delta
-					int SnapSize = m_SnapshotDelta.UnpackDelta(pDeltaShot, pTmpBuffer3, pDeltaData, DeltaSize);
-					if(SnapSize < 0)
-					{
-						char aBuf[64];
-						str_format(aBuf, sizeof(aBuf), "delta unpack failed! (%d)", SnapSize);
-						m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", aBuf);
-						return;
-					}
-
-					if(Unpacker.Type() != NETMSG_SNAPEMPTY && pTmpBuffer3->Crc() != Crc)
-					{
-						if(Config()->m_Debug)
-						{
-							char aBuf[256];
-							str_format(aBuf, sizeof(aBuf), "snapshot crc error #%d - tick=%d wantedcrc=%d gotcrc=%d compressed_size=%d delta_tick=%d",
-								m_SnapCrcErrors, GameTick, Crc, pTmpBuffer3->Crc(), CompleteSize, DeltaTick);
-							m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", aBuf);
-						}
-
-						m_SnapCrcErrors++;
-						if(m_SnapCrcErrors > 10)
-						{
-							// to many errors, send reset
-							m_AckGameTick = -1;
-							SendInput();
-							m_SnapCrcErrors = 0;
-						}
-						return;
-					}
-					else
-					{
-						if(m_SnapCrcErrors)
-							m_SnapCrcErrors--;
-					}
-
-					// purge old snapshots
-					int PurgeTick = DeltaTick;
-					if(m_aSnapshots[SNAP_PREV] && m_aSnapshots[SNAP_PREV]->m_Tick < PurgeTick)
-						PurgeTick = m_aSnapshots[SNAP_PREV]->m_Tick;
-					if(m_aSnapshots[SNAP_CURRENT] && m_aSnapshots[SNAP_CURRENT]->m_Tick < PurgeTick)
-						PurgeTick = m_aSnapshots[SNAP_CURRENT]->m_Tick;
-					m_SnapshotStorage.PurgeUntil(PurgeTick);
-
-					// add new
-					m_SnapshotStorage.Add(GameTick, time_get(), SnapSize, pTmpBuffer3, 1);
-
-					// add snapshot to demo
-					if(m_DemoRecorder.IsRecording())
-					{
-						// build up snapshot and add local messages
-						m_DemoRecSnapshotBuilder.Init(pTmpBuffer3);
-						GameClient()->OnDemoRecSnap();
-						SnapSize = m_DemoRecSnapshotBuilder.Finish(pTmpBuffer3);
-
-						// write snapshot
-						m_DemoRecorder.RecordSnapshot(GameTick, pTmpBuffer3, SnapSize);
-					}
-
-					// apply snapshot, cycle pointers
-					m_ReceivedSnapshots++;
-
-					m_CurrentRecvTick = GameTick;
-
-					// we got two snapshots until we see us self as connected
-					if(m_ReceivedSnapshots == 2)
-					{
-						// start at 200ms and work from there
-						m_PredictedTime.Init(GameTick * time_freq() / SERVER_TICK_SPEED);
-						m_PredictedTime.SetAdjustSpeed(1, 1000.0f);
-						m_GameTime.Init((GameTick - 1) * time_freq() / SERVER_TICK_SPEED);
-						m_aSnapshots[SNAP_PREV] = m_SnapshotStorage.m_pFirst;
-						m_aSnapshots[SNAP_CURRENT] = m_SnapshotStorage.m_pLast;
-						SetState(IClient::STATE_ONLINE);
-					}
-
-					// adjust game time
-					if(m_ReceivedSnapshots > 2)
-					{
-						int64 Now = m_GameTime.Get(time_get());
-						int64 TickStart = GameTick * time_freq() / SERVER_TICK_SPEED;
-						int64 TimeLeft = (TickStart-Now)*1000 / time_freq();
-						m_GameTime.Update(&m_GametimeMarginGraph, (GameTick - 1) * time_freq() / SERVER_TICK_SPEED, TimeLeft, 0);
-					}
-
-					// ack snapshot
-					m_AckGameTick = GameTick;
+					// decompress and unpack the snapshot on the worker thread
+					CSnapshotDecoder::CTask *pTask = m_SnapshotDecoder.Task();
+					pTask->m_GameTick = GameTick;
+					pTask->m_DeltaTick = DeltaTick;
+					pTask->m_Crc = Crc;
+					pTask->m_CheckCrc = Unpacker.Type() != NETMSG_SNAPEMPTY;
+					pTask->m_RecvTime = time_get();
+					pTask->m_pDeltaShot = pDeltaShot;
+					pTask->m_DataSize = CompleteSize;
+					mem_copy(pTask->m_aData, m_aSnapshotIncomingData, CompleteSize);
+					m_SnapshotDecoder.Run();
+					m_SnapshotDecodePending = true;
 				}
 			}
 		}
@@ -1593,6 +1799,10 @@ void CClient::PumpNetwork()
 		if(Packet.m_Flags&NETSENDFLAG_CONNLESS)
 			ProcessConnlessPacket(&Packet);
 	}
+
+	// store the snapshot as soon as the decoder is done with it
+	if(m_SnapshotDecodePending && m_SnapshotDecoder.IsIdle())
+		ApplyDecodedSnapshot();
 }
 
 void CClient::OnDemoPlayerSnapshot(void *pData, int Size)
@@ -1646,6 +1856,9 @@ void CClient::Update()
 	}
 	else if(State() == IClient::STATE_ONLINE && m_ReceivedSnapshots >= 3)
 	{
+		if(m_SnapshotDecodePending && m_SnapshotDecoder.IsIdle())
+			ApplyDecodedSnapshot();
+
 		// switch snapshot
 		int Repredict = 0;
 		int64 Freq = time_freq();
@@ -1915,6 +2128,7 @@ void CClient::Run()
 {
 	m_LocalStartTime = time_get();
 	m_SnapshotParts = 0;
+	m_SnapshotDecoder.Start(&m_SnapshotDelta);
 
 	// init SDL
 	{
@@ -1972,6 +2186,9 @@ void CClient::Run()
 		}
 	}
 
+	// index the downloaded maps by their hash
+	m_MapCache.Init(Storage(), "downloadedmaps");
+
 	// init font rendering
 	m_pTextRender->Init();
 
@@ -2094,6 +2311,9 @@ void CClient::Run()
 
 			Update();
 
+			// the changes of this frame for the other threads
+			m_pConfigManager->PublishSnapshot();
+
 			const bool SkipFrame = LimitFps();
 
 			if(!SkipFrame && (!Config()->m_GfxAsyncRender || m_pGraphics->IsIdle()))
@@ -2109,6 +2329,7 @@ void CClient::Run()
 				if(m_RenderFrameTime > m_RenderFrameTimeHigh)
 					m_RenderFrameTimeHigh = m_RenderFrameTime;
 				m_FpsGraph.Add(1.0f/m_RenderFrameTime, 1,1,1);
+				m_FrameTimeHistogram.Add(m_RenderFrameTime);
 
 				m_LastRenderTime = Now;
 
@@ -2168,6 +2389,7 @@ void CClient::Run()
 
 	GameClient()->OnShutdown();
 	Disconnect();
+	m_SnapshotDecoder.Stop();
 
 	m_pInput->Shutdown();
 	m_pGraphics->Shutdown();
@@ -4,6 +4,7 @@
 #define ENGINE_CLIENT_CLIENT_H
 
 #include <base/hash.h>
+#include <base/tl/threading.h>
 
 class CGraph
 {
@@ -51,6 +52,75 @@ public:
 };
 
 
+// render frame times in 1 ms buckets, older frames fade out
+class CFrameTimeHistogram
+{
+	enum
+	{
+		NUM_BUCKETS=40,
+	};
+
+	float m_aBuckets[NUM_BUCKETS];
+	float m_Total;
+
+public:
+	void Init();
+	void Add(float FrameTime);
+	float Percentile(float Percentile) const;
+	void Render(IGraphics *pGraphics, IGraphics::CTextureHandle FontTexture, float x, float y, float w, float h, const char *pDescription);
+};
+
+
+// decodes received snapshots on a worker thread, one at a time
+class CSnapshotDecoder
+{
+public:
+	class CTask
+	{
+	public:
+		int m_GameTick;
+		int m_DeltaTick;
+		int m_Crc;
+		bool m_CheckCrc;
+		int64 m_RecvTime;
+		const CSnapshot *m_pDeltaShot;
+		int m_DataSize;
+		char m_aData[CSnapshot::MAX_SIZE];
+
+		// results, negative sizes on errors
+		int m_IntSize;
+		int m_SnapSize;
+		int m_SnapCrc;
+		int m_aSnapshot[CSnapshot::MAX_SIZE/sizeof(int)];
+
+		CSnapshot *Snapshot() { return (CSnapshot *)m_aSnapshot; }
+	};
+
+private:
+	class CSnapshotDelta *m_pDelta;
+	CTask m_Task;
+	volatile unsigned m_Busy; // set while the worker owns the task
+	volatile bool m_Shutdown;
+	semaphore m_Activity;
+	void *m_pThread;
+	int m_aDeltaData[CSnapshot::MAX_SIZE/sizeof(int)];
+
+	static void ThreadFunc(void *pUser);
+	void Decode(CTask *pTask);
+
+public:
+	CSnapshotDecoder();
+	void Start(class CSnapshotDelta *pDelta);
+	void Stop();
+
+	// the task may only be touched while the decoder is idle
+	CTask *Task() { return &m_Task; }
+	void Run();
+	bool IsIdle() const { return atomic_load(&m_Busy) == 0; }
+	void WaitForIdle();
+};
+
+
 class CClient : public IClient, public CDemoPlayer::IListener
 {
 	// needed interfaces
@@ -133,10 +203,13 @@ class CClient : public IClient, public CDemoPlayer::IListener
 	int m_MapdownloadChunk;
 	int m_MapdownloadChunkNum;
 	int m_MapDownloadChunkSize;
+	int m_MapdownloadWindow; // chunks in flight when the server streams the map, 0 otherwise
+	int m_MapdownloadAcked;
 	SHA256_DIGEST m_MapdownloadSha256;
 	bool m_MapdownloadSha256Present;
 	int m_MapdownloadCrc;
 	int m_MapdownloadAmount;
+	CMapCache m_MapCache;
 	int m_MapdownloadTotalsize;
 
 	// time
@@ -158,6 +231,7 @@ class CClient : public IClient, public CDemoPlayer::IListener
 	CGraph m_InputtimeMarginGraph;
 	CGraph m_GametimeMarginGraph;
 	CGraph m_FpsGraph;
+	CFrameTimeHistogram m_FrameTimeHistogram;
 
 	// the game snapshots are modifiable by the game
 	class CSnapshotStorage m_SnapshotStorage;
@@ -171,6 +245,10 @@ class CClient : public IClient, public CDemoPlayer::IListener
 	class CSnapshotBuilder m_DemoRecSnapshotBuilder;
 
 	class CSnapshotDelta m_SnapshotDelta;
+	CSnapshotDecoder m_SnapshotDecoder;
+	bool m_SnapshotDecodePending;
+
+	void ApplyDecodedSnapshot();
 
 	//
 	class CServerInfo m_CurrentServerInfo;
@@ -212,6 +290,7 @@ public:
 	void SendInfo();
 	void SendEnterGame();
 	void SendReady();
+	void SendMapRequest();
 	void SendInput();
 	void SendRconAuth(const char *pName, const char *pPassword);
 	virtual void SendRcon(const char *pCmd);
@@ -408,26 +408,58 @@ int CGraphics_Threaded::LoadPNG(CImageInfo *pImg, const char *pFilename, int Sto
 		return 0;
 	}
 
+	void *pData;
+	unsigned DataSize;
+	io_read_all(File, &pData, &DataSize);
+	io_close(File);
+
+	int Result = LoadPNGData(pImg, pData, DataSize, aCompleteFilename);
+	mem_free(pData);
+	return Result;
+}
+
+struct CPngReader
+{
+	const unsigned char *m_pData;
+	unsigned m_DataSize;
+	unsigned m_Pos;
+};
+
+static unsigned PngReadMemory(void *pOutput, unsigned long Size, unsigned long Numel, void *pUser)
+{
+	// like fread, or fseek without output
+	CPngReader *pReader = (CPngReader *)pUser;
+	unsigned long Num = Size ? minimum(Numel, (pReader->m_DataSize-pReader->m_Pos)/Size) : 0;
+	if(pOutput)
+		mem_copy(pOutput, pReader->m_pData+pReader->m_Pos, Num*Size);
+	pReader->m_Pos += Num*Size;
+	return Num;
+}
+
+int CGraphics_Threaded::LoadPNGData(CImageInfo *pImg, const void *pFileData, unsigned FileSize, const char *pFilename)
+{
+	CPngReader Reader;
+	Reader.m_pData = (const unsigned char *)pFileData;
+	Reader.m_DataSize = FileSize;
+	Reader.m_Pos = 0;
+
 	png_init(0, 0);
 	png_t Png;
-	int Error = png_open_read(&Png, 0, File);
+	int Error = png_open_read(&Png, PngReadMemory, &Reader);
 	if(Error != PNG_NO_ERROR)
 	{
-		dbg_msg("game/png", "failed to read file. filename='%s'", aCompleteFilename);
-		io_close(File);
+		dbg_msg("game/png", "failed to read file. filename='%s'", pFilename);
 		return 0;
 	}
 
 	if(Png.depth != 8 || (Png.color_type != PNG_TRUECOLOR && Png.color_type != PNG_TRUECOLOR_ALPHA) || Png.width > (2<<12) || Png.height > (2<<12))
 	{
-		dbg_msg("game/png", "invalid format. filename='%s'", aCompleteFilename);
-		io_close(File);
+		dbg_msg("game/png", "invalid format. filename='%s'", pFilename);
 		return 0;
 	}
 
 	unsigned char *pBuffer = (unsigned char *)mem_alloc(Png.width * Png.height * Png.bpp);
 	png_get_data(&Png, pBuffer);
-	io_close(File);
 
 	pImg->m_Width = Png.width;
 	pImg->m_Height = Png.height;
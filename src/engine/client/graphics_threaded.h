@@ -424,6 +424,7 @@ public:
 	// simple uncompressed RGBA loaders
 	virtual IGraphics::CTextureHandle LoadTexture(const char *pFilename, int StorageType, int StoreFormat, int Flags);
 	virtual int LoadPNG(CImageInfo *pImg, const char *pFilename, int StorageType);
+	virtual int LoadPNGData(CImageInfo *pImg, const void *pFileData, unsigned FileSize, const char *pFilename);
 
 	void ScreenshotDirect(const char *pFilename);
 
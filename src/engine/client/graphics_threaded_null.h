@@ -49,6 +49,7 @@ public:
 	// simple uncompressed RGBA loaders
 	virtual IGraphics::CTextureHandle LoadTexture(const char *pFilename, int StorageType, int StoreFormat, int Flags) { return CreateTextureHandle(0); };
 	virtual int LoadPNG(CImageInfo *pImg, const char *pFilename, int StorageType) { return 0; };
+	virtual int LoadPNGData(CImageInfo *pImg, const void *pFileData, unsigned FileSize, const char *pFilename) { return 0; };
 
 	virtual void TextureSet(CTextureHandle TextureID) {};
 
@@ -70,7 +70,19 @@ static int m_NextVoice = 0;
 static int *m_pMixBuffer = 0;	// buffer only used by the thread callback function
 static unsigned m_MaxFrames = 0;
 
-static IOHANDLE s_File;
+// a file being decoded
+struct CWvReader
+{
+	const unsigned char *m_pData;
+	unsigned m_Size;
+	unsigned m_Pos;
+};
+
+#if !defined(CONF_WAVPACK_OPEN_FILE_INPUT_EX)
+// the old interface has no user pointer and only one context, decoding
+// with it is guarded by the sound lock
+static CWvReader *s_pReader = 0;
+#endif
 
 static short Int2Short(int i)
 {
@@ -328,16 +340,18 @@ void CSound::RateConvert(int SampleID)
 	pSample->m_NumFrames = NumFrames;
 }
 
-static int ReadDataOld(void *pBuffer, int Size)
+static int ReadBytes(CWvReader *pReader, void *pBuffer, int Size)
 {
-	return io_read(s_File, pBuffer, Size);
+	int Read = minimum(Size, (int)(pReader->m_Size-pReader->m_Pos));
+	mem_copy(pBuffer, pReader->m_pData+pReader->m_Pos, Read);
+	pReader->m_Pos += Read;
+	return Read;
 }
 
 #if defined(CONF_WAVPACK_OPEN_FILE_INPUT_EX)
 static int ReadData(void *pId, void *pBuffer, int Size)
 {
-	(void)pId;
-	return ReadDataOld(pBuffer, Size);
+	return ReadBytes((CWvReader *)pId, pBuffer, Size);
 }
 
 static int ReturnFalse(void *pId)
@@ -348,30 +362,100 @@ static int ReturnFalse(void *pId)
 
 static unsigned int GetPos(void *pId)
 {
-	(void)pId;
-	return io_tell(s_File);
+	return ((CWvReader *)pId)->m_Pos;
 }
 
 static unsigned int GetLength(void *pId)
 {
-	(void)pId;
-	return io_length(s_File);
+	return ((CWvReader *)pId)->m_Size;
 }
 
 static int PushBackByte(void *pId, int Char)
 {
-	(void)pId;
-	return io_unread_byte(s_File, Char);
+	CWvReader *pReader = (CWvReader *)pId;
+	if(pReader->m_Pos == 0)
+		return -1;
+	pReader->m_Pos--;
+	return Char;
+}
+#else
+static int ReadDataOld(void *pBuffer, int Size)
+{
+	return ReadBytes(s_pReader, pBuffer, Size);
 }
 #endif
 
-ISound::CSampleHandle CSound::LoadWV(const char *pFilename)
+static void CloseWV(WavpackContext *pContext)
+{
+#if defined(CONF_WAVPACK_OPEN_FILE_INPUT_EX)
+	WavpackCloseFile(pContext);
+#else
+	(void)pContext;
+#endif
+}
+
+// decodes to 16 bit samples, returns 0 on failure
+static short *DecodeWV(const void *pFileData, unsigned FileSize, const char *pFilename, int *pNumFrames, int *pRate, int *pChannels)
 {
-	CSample *pSample;
-	int SampleID = -1;
 	char aError[100];
 	WavpackContext *pContext;
+	CWvReader Reader;
+	Reader.m_pData = (const unsigned char *)pFileData;
+	Reader.m_Size = FileSize;
+	Reader.m_Pos = 0;
+
+#if defined(CONF_WAVPACK_OPEN_FILE_INPUT_EX)
+	WavpackStreamReader Callback = {0};
+	Callback.can_seek = ReturnFalse;
+	Callback.get_length = GetLength;
+	Callback.get_pos = GetPos;
+	Callback.push_back_byte = PushBackByte;
+	Callback.read_bytes = ReadData;
+	pContext = WavpackOpenFileInputEx(&Callback, &Reader, 0, aError, 0, 0);
+#else
+	s_pReader = &Reader;
+	pContext = WavpackOpenFileInput(ReadDataOld, aError);
+#endif
+	if(!pContext)
+	{
+		dbg_msg("sound/wv", "failed to open %s: %s", pFilename, aError);
+		return 0;
+	}
+
+	int NumSamples = WavpackGetNumSamples(pContext);
+	int BitsPerSample = WavpackGetBitsPerSample(pContext);
+	int NumChannels = WavpackGetNumChannels(pContext);
+	*pRate = WavpackGetSampleRate(pContext);
+	if(NumChannels > 2)
+	{
+		dbg_msg("sound/wv", "file is not mono or stereo. filename='%s'", pFilename);
+		CloseWV(pContext);
+		return 0;
+	}
+
+	if(BitsPerSample != 16)
+	{
+		dbg_msg("sound/wv", "bps is %d, not 16, filname='%s'", BitsPerSample, pFilename);
+		CloseWV(pContext);
+		return 0;
+	}
+
+	int *pData = (int *)mem_alloc(4*NumSamples*NumChannels);
+	WavpackUnpackSamples(pContext, pData, NumSamples); // TODO: check return value
+	CloseWV(pContext);
+
+	short *pSamples = (short *)mem_alloc(2*NumSamples*NumChannels);
+	for(int i = 0; i < NumSamples*NumChannels; i++)
+		pSamples[i] = (short)pData[i];
+	mem_free(pData);
 
+	*pNumFrames = NumSamples;
+	*pChannels = NumChannels;
+	return pSamples;
+}
+
+ISound::CSampleHandle CSound::LoadWV(const char *pFilename)
+{
 	// don't waste memory on sound when we are stress testing
 #ifdef CONF_DEBUG
 	if(m_pConfig->m_DbgStress)
@@ -385,105 +469,64 @@ ISound::CSampleHandle CSound::LoadWV(const char *pFilename)
 	if(!m_pStorage)
 		return CSampleHandle();
 
-	lock_wait(m_SoundLock);
-	s_File = m_pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
-	if(!s_File)
+	void *pData;
+	unsigned DataSize;
+	if(!m_pStorage->ReadFile(pFilename, IStorage::TYPE_ALL, &pData, &DataSize))
 	{
 		dbg_msg("sound/wv", "failed to open file. filename='%s'", pFilename);
-		lock_unlock(m_SoundLock);
 		return CSampleHandle();
 	}
 
-	SampleID = AllocID();
-	if(SampleID < 0)
-	{
-		io_close(s_File);
-		s_File = 0;
-		lock_unlock(m_SoundLock);
-		return CSampleHandle();
-	}
-	pSample = &m_aSamples[SampleID];
+	CSampleHandle Sample = LoadWVData(pData, DataSize, pFilename);
+	mem_free(pData);
+	return Sample;
+}
 
-#if defined(CONF_WAVPACK_OPEN_FILE_INPUT_EX)
-	WavpackStreamReader Callback = {0};
-	Callback.can_seek = ReturnFalse;
-	Callback.get_length = GetLength;
-	Callback.get_pos = GetPos;
-	Callback.push_back_byte = PushBackByte;
-	Callback.read_bytes = ReadData;
-	pContext = WavpackOpenFileInputEx(&Callback, (void *)1, 0, aError, 0, 0);
-#else
-	pContext = WavpackOpenFileInput(ReadDataOld, aError);
+ISound::CSampleHandle CSound::LoadWVData(const void *pFileData, unsigned FileSize, const char *pFilename)
+{
+#ifdef CONF_DEBUG
+	if(m_pConfig->m_DbgStress)
+		return CSampleHandle();
 #endif
-	if (pContext)
-	{
-		int m_aSamples = WavpackGetNumSamples(pContext);
-		int BitsPerSample = WavpackGetBitsPerSample(pContext);
-		unsigned int SampleRate = WavpackGetSampleRate(pContext);
-		int m_aChannels = WavpackGetNumChannels(pContext);
-		int *pData;
-		int *pSrc;
-		short *pDst;
-		int i;
-
-		pSample->m_Channels = m_aChannels;
-		pSample->m_Rate = SampleRate;
-
-		if(pSample->m_Channels > 2)
-		{
-			dbg_msg("sound/wv", "file is not mono or stereo. filename='%s'", pFilename);
-			io_close(s_File);
-			s_File = 0;
-			lock_unlock(m_SoundLock);
-			return CSampleHandle();
-		}
-
-		/*
-		if(snd->rate != 44100)
-		{
-			dbg_msg("sound/wv", "file is %d Hz, not 44100 Hz. filename='%s'", snd->rate, filename);
-			return -1;
-		}*/
 
-		if(BitsPerSample != 16)
-		{
-			dbg_msg("sound/wv", "bps is %d, not 16, filname='%s'", BitsPerSample, pFilename);
-			io_close(s_File);
-			s_File = 0;
-			lock_unlock(m_SoundLock);
-			return CSampleHandle();
-		}
-
-		pData = (int *)mem_alloc(4*m_aSamples*m_aChannels);
-		WavpackUnpackSamples(pContext, pData, m_aSamples); // TODO: check return value
-		pSrc = pData;
-
-		pSample->m_pData = (short *)mem_alloc(2*m_aSamples*m_aChannels);
-		pDst = pSample->m_pData;
-
-		for (i = 0; i < m_aSamples*m_aChannels; i++)
-			*pDst++ = (short)*pSrc++;
+	if(!m_SoundEnabled)
+		return CSampleHandle();
 
-		mem_free(pData);
+	// decode without holding up the mixer or other loaders
+	int NumFrames, Rate, Channels;
+#if !defined(CONF_WAVPACK_OPEN_FILE_INPUT_EX)
+	lock_wait(m_SoundLock);
+#endif
+	short *pData = DecodeWV(pFileData, FileSize, pFilename, &NumFrames, &Rate, &Channels);
+#if !defined(CONF_WAVPACK_OPEN_FILE_INPUT_EX)
+	lock_unlock(m_SoundLock);
+#endif
+	if(!pData)
+		return CSampleHandle();
 
-		pSample->m_NumFrames = m_aSamples;
-		pSample->m_LoopStart = -1;
-		pSample->m_LoopEnd = -1;
-		pSample->m_PausedAt = 0;
-	}
-	else
+	lock_wait(m_SoundLock);
+	int SampleID = AllocID();
+	if(SampleID < 0)
 	{
-		dbg_msg("sound/wv", "failed to open %s: %s", pFilename, aError);
+		lock_unlock(m_SoundLock);
+		mem_free(pData);
+		return CSampleHandle();
 	}
 
-	io_close(s_File);
-	s_File = NULL;
+	CSample *pSample = &m_aSamples[SampleID];
+	pSample->m_pData = pData;
+	pSample->m_NumFrames = NumFrames;
+	pSample->m_Rate = Rate;
+	pSample->m_Channels = Channels;
+	pSample->m_LoopStart = -1;
+	pSample->m_LoopEnd = -1;
+	pSample->m_PausedAt = 0;
+	RateConvert(SampleID);
+	lock_unlock(m_SoundLock);
 
 	if(m_pConfig->m_Debug)
 		dbg_msg("sound/wv", "loaded %s", pFilename);
 
-	RateConvert(SampleID);
-	lock_unlock(m_SoundLock);
 	return CreateSampleHandle(SampleID);
 }
 
@@ -25,6 +25,7 @@ public:
 	virtual bool IsSoundEnabled() { return m_SoundEnabled != 0; }
 
 	virtual CSampleHandle LoadWV(const char *pFilename);
+	virtual CSampleHandle LoadWVData(const void *pFileData, unsigned FileSize, const char *pFilename);
 
 	virtual void SetListenerPos(float x, float y);
 	virtual void SetChannelVolume(int ChannelID, float Vol);
@@ -17,6 +17,13 @@ public:
 	virtual void Save(const char *pFilename=0) = 0;
 	virtual class CConfig *Values() = 0;
 
+	// the values as of the last publish, for other threads. they hold the
+	// reference for the duration of a job, acquiring and releasing never blocks
+	virtual const class CConfigSnapshot *AcquireSnapshot() = 0;
+	virtual void ReleaseSnapshot(const class CConfigSnapshot *pSnapshot) = 0;
+	// called by the main thread once per frame or tick, copies the values if they changed
+	virtual void PublishSnapshot() = 0;
+
 	virtual void RegisterCallback(SAVECALLBACKFUNC pfnFunc, void *pUserData) = 0;
 
 	virtual void WriteLine(const char *pLine) = 0;
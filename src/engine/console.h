@@ -63,7 +63,7 @@ public:
 		int GetAccessLevel() const { return m_AccessLevel; }
 	};
 
-	typedef void (*FPrintCallback)(const char *pStr, void *pUser, bool Highlighted);
+	typedef void (*FPrintCallback)(const char *pStr, void *pUser, int Level, const char *pFrom, bool Highlighted);
 	typedef void (*FPossibleCallback)(int Index, const char *pCmd, void *pUser);
 	typedef void (*FCommandCallback)(IResult *pResult, void *pUserData);
 	typedef void (*FChainCommandCallback)(IResult *pResult, void *pUserData, FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -29,6 +29,7 @@ public:
 	virtual void QueryNetLogHandles(IOHANDLE *pHDLSend, IOHANDLE *pHDLRecv) = 0;
 	virtual void HostLookup(CHostLookup *pLookup, const char *pHostname, int Nettype) = 0;
 	virtual void AddJob(CJob *pJob, JOBFUNC pfnFunc, void *pData) = 0;
+	CJobPool *JobPool() { return &m_JobPool; }
 };
 
 extern IEngine *CreateEngine(const char *pAppname);
@@ -137,6 +137,8 @@ public:
 	virtual int MemoryUsage() const = 0;
 
 	virtual int LoadPNG(CImageInfo *pImg, const char *pFilename, int StorageType) = 0;
+	// decodes a png that is already in memory, touches no graphics state and can run on other threads
+	virtual int LoadPNGData(CImageInfo *pImg, const void *pFileData, unsigned FileSize, const char *pFilename) = 0;
 
 	virtual int UnloadTexture(CTextureHandle *pIndex) = 0;
 	virtual CTextureHandle LoadTextureRaw(int Width, int Height, int Format, const void *pData, int StoreFormat, int Flags) = 0;
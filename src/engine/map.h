@@ -13,6 +13,7 @@ public:
 	virtual void *GetData(int Index) = 0;
 	virtual void *GetDataSwapped(int Index) = 0;
 	virtual void UnloadData(int Index) = 0;
+	virtual void PrefetchData(const int *pIndices, int Num) = 0;
 	virtual void *GetItem(int Index, int *Type, int *pID) = 0;
 	virtual void GetType(int Type, int *pStart, int *pNum) = 0;
 	virtual void *FindItem(int Type, int ID) = 0;
@@ -24,11 +25,14 @@ class IEngineMap : public IMap
 {
 	MACRO_INTERFACE("enginemap", 0)
 public:
-	virtual bool Load(const char *pMapName, class IStorage *pStorage=0) = 0;
+	virtual bool Load(const char *pMapName, class IStorage *pStorage=0, class CJobPool *pJobPool=0) = 0;
 	virtual bool IsLoaded() = 0;
 	virtual void Unload() = 0;
 	virtual SHA256_DIGEST Sha256() = 0;
 	virtual unsigned Crc() = 0;
+	virtual const void *FileData(unsigned *pSize) = 0; // the raw map file, valid until the map is unloaded
+	virtual bool FileChanged() = 0; // whether the map file changed on disk since it was loaded
+	virtual void Swap(IEngineMap *pOther) = 0; // exchanges the loaded maps
 };
 
 extern IEngineMap *CreateEngineMap();
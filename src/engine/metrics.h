@@ -0,0 +1,81 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_METRICS_H
+#define ENGINE_METRICS_H
+
+#include "kernel.h"
+
+/*
+	Numbers about the running engine, exported as Prometheus text.
+
+	Modules register their metrics once and keep the returned pointer,
+	updating it costs a plain add or store. Metrics are updated and
+	exported on the main thread. Values that a module already keeps
+	are better exported with a collector, it is only called on export.
+*/
+class IMetrics : public IInterface
+{
+	MACRO_INTERFACE("metrics", 0)
+public:
+	enum
+	{
+		TYPE_COUNTER=0,
+		TYPE_GAUGE,
+		TYPE_HISTOGRAM,
+
+		MAX_BUCKETS=16,
+	};
+
+	class CCounter
+	{
+	public:
+		int64 m_Value;
+		void Add(int64 Amount = 1) { m_Value += Amount; }
+	};
+
+	class CGauge
+	{
+	public:
+		int64 m_Value;
+		void Set(int64 Value) { m_Value = Value; }
+	};
+
+	class CHistogram
+	{
+	public:
+		int64 m_aBounds[MAX_BUCKETS]; // inclusive upper bounds, ascending
+		int64 m_aCounts[MAX_BUCKETS+1]; // the last one counts the rest
+		int m_NumBounds;
+		int64 m_Sum;
+		int64 m_Count;
+
+		void Observe(int64 Value)
+		{
+			int Bucket = 0;
+			while(Bucket < m_NumBounds && Value > m_aBounds[Bucket])
+				Bucket++;
+			m_aCounts[Bucket]++;
+			m_Sum += Value;
+			m_Count++;
+		}
+	};
+
+	// collectors call AddSample for every value of their metric
+	typedef void (*FCollectCallback)(IMetrics *pMetrics, void *pUser);
+	typedef void (*FExportCallback)(const char *pLine, void *pUser);
+
+	// registering a name again returns the existing metric or replaces the collector
+	virtual CCounter *RegisterCounter(const char *pName, const char *pHelp) = 0;
+	virtual CGauge *RegisterGauge(const char *pName, const char *pHelp) = 0;
+	virtual CHistogram *RegisterHistogram(const char *pName, const char *pHelp, const int64 *pBounds, int NumBounds) = 0;
+	virtual void RegisterCollector(const char *pName, int Type, const char *pHelp, FCollectCallback pfnCallback, void *pUser) = 0;
+
+	// pLabels like 'client="3"', or 0
+	virtual void AddSample(const char *pLabels, int64 Value) = 0;
+
+	virtual void Export(FExportCallback pfnCallback, void *pUser) = 0;
+};
+
+extern IMetrics *CreateMetrics();
+
+#endif
@@ -9,6 +9,7 @@
 #include <engine/engine.h>
 #include <engine/map.h>
 #include <engine/masterserver.h>
+#include <engine/metrics.h>
 #include <engine/server.h>
 #include <engine/storage.h>
 
@@ -18,6 +19,7 @@
 #include <engine/shared/demo.h>
 #include <engine/shared/econ.h>
 #include <engine/shared/filecollection.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/mapchecker.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
@@ -186,9 +188,8 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 
 		if(NetMatch(&Data, Server()->m_NetServer.ClientAddr(i)))
 		{
-			CNetHash NetHash(&Data);
 			char aBuf[256];
-			MakeBanInfo(pBanPool->Find(&Data, &NetHash), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
+			MakeBanInfo(pBanPool->Find(&Data), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
 			Server()->m_NetServer.Drop(i, aBuf);
 		}
 	}
@@ -252,6 +253,7 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_TickSpeed = SERVER_TICK_SPEED;
 
 	m_pGameServer = 0;
+	m_pMetrics = 0;
 
 	m_CurrentGameTick = 0;
 	m_RunServer = true;
@@ -260,6 +262,10 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 
 	m_pCurrentMapData = 0;
 	m_CurrentMapSize = 0;
+	m_CurrentMapChanged = false;
+	m_MapCheckTick = -1;
+	m_NumPreloadedMaps = 0;
+	m_PreloadMaps = false;
 
 	m_MapReload = false;
 
@@ -588,6 +594,7 @@ void CServer::DoSnapshot()
 
 				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
 				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+				m_pSnapshotSize->Observe(SnapshotSize);
 
 				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
 				{
@@ -698,13 +705,18 @@ int CServer::DelClientCallback(int ClientID, const char *pReason, void *pUser)
 
 void CServer::SendMap(int ClientID)
 {
+	// the window is fixed for the whole download
+	m_aClients[ClientID].m_MapChunksPerRequest = Config()->m_SvMapDownloadSpeed;
+	m_aClients[ClientID].m_MapWindow = minimum(Config()->m_SvMapWindow, int(MAP_WINDOW_MAX));
+
 	CMsgPacker Msg(NETMSG_MAP_CHANGE, true);
 	Msg.AddString(GetMapName(), 0);
 	Msg.AddInt(m_CurrentMapCrc);
 	Msg.AddInt(m_CurrentMapSize);
-	Msg.AddInt(m_MapChunksPerRequest);
+	Msg.AddInt(m_aClients[ClientID].m_MapChunksPerRequest);
 	Msg.AddInt(MAP_CHUNK_SIZE);
 	Msg.AddRaw(&m_CurrentMapSha256, sizeof(m_CurrentMapSha256));
+	Msg.AddInt(m_aClients[ClientID].m_MapWindow); // ignored by older clients
 	SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
 }
 
@@ -721,7 +733,7 @@ void CServer::SendRconLine(int ClientID, const char *pLine)
 	SendMsg(&Msg, MSGFLAG_VITAL, ClientID);
 }
 
-void CServer::SendRconLineAuthed(const char *pLine, void *pUser, bool Highlighted)
+void CServer::SendRconLineAuthed(const char *pLine, void *pUser, int Level, const char *pFrom, bool Highlighted)
 {
 	static bool s_ReentryGuard = false;
 	if(s_ReentryGuard)
@@ -842,10 +854,28 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 		{
 			if((pPacket->m_Flags&NET_CHUNKFLAG_VITAL) != 0 && (m_aClients[ClientID].m_State == CClient::STATE_CONNECTING || m_aClients[ClientID].m_State == CClient::STATE_CONNECTING_AS_SPEC))
 			{
+				if(CurrentMapChanged())
+					return;
+
 				int ChunkSize = MAP_CHUNK_SIZE;
 
+				// streaming clients send their window and how many chunks they got,
+				// older ones request the next package when they received the last one
+				int NumChunks = m_aClients[ClientID].m_MapChunksPerRequest;
+				int Window = Unpacker.GetInt();
+				int Received = Unpacker.GetInt();
+				if(!Unpacker.Error() && m_aClients[ClientID].m_MapWindow > 0)
+				{
+					Window = clamp(Window, 1, m_aClients[ClientID].m_MapWindow);
+					int Sent = m_aClients[ClientID].m_MapChunk;
+					if(Sent < 0 || Received < 0 || Received > Sent)
+						NumChunks = 0;
+					else
+						NumChunks = Received+Window-Sent;
+				}
+
 				// send map chunks
-				for(int i = 0; i < m_MapChunksPerRequest && m_aClients[ClientID].m_MapChunk >= 0; ++i)
+				for(int i = 0; i < NumChunks && m_aClients[ClientID].m_MapChunk >= 0; ++i)
 				{
 					int Chunk = m_aClients[ClientID].m_MapChunk;
 					int Offset = Chunk * ChunkSize;
@@ -859,9 +889,10 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 					else
 						m_aClients[ClientID].m_MapChunk++;
 
+					// demo playback ignores system messages, don't record the map
 					CMsgPacker Msg(NETMSG_MAP_DATA, true);
 					Msg.AddRaw(&m_pCurrentMapData[Offset], ChunkSize);
-					SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
+					SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH|MSGFLAG_NORECORD, ClientID);
 
 					if(Config()->m_Debug)
 					{
@@ -1215,14 +1246,43 @@ int CServer::LoadMap(const char *pMapName)
 	char aBuf[IO_MAX_PATH_LENGTH];
 	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
 
-	// check for valid standard map
-	if(!m_pMapChecker->ReadAndValidateMap(aBuf, IStorage::TYPE_ALL))
+	// take the map from the rotation if it is loaded and didn't change since
+	CPreloadedMap *pPreloaded = 0;
+	for(int i = 0; i < m_NumPreloadedMaps; i++)
+	{
+		CPreloadedMap *pMap = m_apPreloadedMaps[i];
+		if(pMap->m_Job.Status() == CJob::STATE_DONE && pMap->m_Loaded && str_comp(pMap->m_aName, pMapName) == 0 && !pMap->m_pMap->FileChanged())
+			pPreloaded = pMap;
+	}
+
+	// check for valid standard map, a preloaded one is hashed already
+	unsigned PreloadedSize;
+	SHA256_DIGEST PreloadedSha256;
+	if(pPreloaded)
+	{
+		pPreloaded->m_pMap->FileData(&PreloadedSize);
+		PreloadedSha256 = pPreloaded->m_pMap->Sha256();
+		if(!m_pMapChecker->IsMapValid(pMapName, &PreloadedSha256, pPreloaded->m_pMap->Crc(), PreloadedSize))
+		{
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapchecker", "invalid standard map");
+			return 0;
+		}
+	}
+	else if(!m_pMapChecker->ReadAndValidateMap(aBuf, IStorage::TYPE_ALL))
 	{
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapchecker", "invalid standard map");
 		return 0;
 	}
 
-	if(!m_pMap->Load(aBuf))
+	if(pPreloaded)
+	{
+		// the previous map gets unloaded, the game changed its data
+		m_pMap->Swap(pPreloaded->m_pMap);
+		pPreloaded->m_pMap->Unload();
+		pPreloaded->m_Loaded = false;
+		Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", "using preloaded map");
+	}
+	else if(!m_pMap->Load(aBuf))
 		return 0;
 
 	// stop recording when we change map
@@ -1245,17 +1305,126 @@ int CServer::LoadMap(const char *pMapName)
 
 	str_copy(m_aCurrentMap, pMapName, sizeof(m_aCurrentMap));
 
-	// load complete map into memory for download
+	// serve the download straight from the map file, see CurrentMapChanged
+	unsigned MapSize;
+	m_pCurrentMapData = (const unsigned char *)m_pMap->FileData(&MapSize);
+	m_CurrentMapSize = (int)MapSize;
+	m_CurrentMapChanged = false;
+	m_MapCheckTick = -1;
+
+	m_PreloadMaps = true;
+	return 1;
+}
+
+// the download is served from the map file which may be mapped, a file that
+// got overwritten or truncated would send other data than was announced.
+// maps have to be replaced by renaming, this only stops serving them and
+// reloads the map. it's checked once per tick
+bool CServer::CurrentMapChanged()
+{
+	if(!m_CurrentMapChanged && m_MapCheckTick != m_CurrentGameTick)
 	{
-		IOHANDLE File = Storage()->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
-		m_CurrentMapSize = (int)io_length(File);
-		if(m_pCurrentMapData)
-			mem_free(m_pCurrentMapData);
-		m_pCurrentMapData = (unsigned char *)mem_alloc(m_CurrentMapSize);
-		io_read(File, m_pCurrentMapData, m_CurrentMapSize);
-		io_close(File);
+		m_MapCheckTick = m_CurrentGameTick;
+		if(m_pMap->FileChanged())
+		{
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "map file changed on disk, reloading the map");
+			m_CurrentMapChanged = true;
+			m_MapReload = true;
+		}
 	}
-	return 1;
+	return m_CurrentMapChanged;
+}
+
+// returns the rest of the rotation after the next map, 0 at the end
+static const char *NextRotationMap(const char *pRotation, char *pName, int NameSize)
+{
+	while(*pRotation == ' ' || *pRotation == ',' || *pRotation == ';' || *pRotation == '\t')
+		pRotation++;
+	int Length = 0;
+	while(pRotation[Length] && pRotation[Length] != ' ' && pRotation[Length] != ',' && pRotation[Length] != ';' && pRotation[Length] != '\t')
+		Length++;
+	if(Length == 0)
+		return 0;
+	str_truncate(pName, NameSize, pRotation, Length);
+	return pRotation+Length;
+}
+
+static bool IsInRotation(const char *pRotation, const char *pMapName)
+{
+	char aName[64];
+	while((pRotation = NextRotationMap(pRotation, aName, sizeof(aName))))
+	{
+		if(str_comp(aName, pMapName) == 0)
+			return true;
+	}
+	return false;
+}
+
+int CServer::PreloadMapJob(void *pUser)
+{
+	CPreloadedMap *pMap = (CPreloadedMap *)pUser;
+	char aBuf[IO_MAX_PATH_LENGTH];
+	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMap->m_aName);
+	pMap->m_Loaded = pMap->m_pMap->Load(aBuf, pMap->m_pStorage, pMap->m_pJobPool);
+	return pMap->m_Loaded ? 0 : -1;
+}
+
+void CServer::PreloadMaps()
+{
+	m_PreloadMaps = false;
+
+	// drop maps that aren't needed anymore, the current one is loaded already
+	const char *pRotation = Config()->m_SvMapPreload ? Config()->m_SvMaprotation : "";
+	for(int i = 0; i < m_NumPreloadedMaps; i++)
+	{
+		CPreloadedMap *pMap = m_apPreloadedMaps[i];
+		if(pMap->m_Job.Status() != CJob::STATE_DONE)
+		{
+			m_PreloadMaps = true; // check again when it's done
+			continue;
+		}
+		if(str_comp(pMap->m_aName, m_aCurrentMap) != 0 && pMap->m_Loaded && IsInRotation(pRotation, pMap->m_aName))
+			continue;
+
+		pMap->m_pMap->Unload();
+		delete pMap->m_pMap;
+		delete pMap;
+		m_apPreloadedMaps[i--] = m_apPreloadedMaps[--m_NumPreloadedMaps];
+	}
+
+	// load the other maps of the rotation
+	char aName[64];
+	while(m_NumPreloadedMaps < MAX_PRELOADED_MAPS && (pRotation = NextRotationMap(pRotation, aName, sizeof(aName))))
+	{
+		bool Found = str_comp(aName, m_aCurrentMap) == 0;
+		for(int i = 0; i < m_NumPreloadedMaps && !Found; i++)
+			Found = str_comp(m_apPreloadedMaps[i]->m_aName, aName) == 0;
+		if(Found)
+			continue;
+
+		CPreloadedMap *pMap = new CPreloadedMap;
+		str_copy(pMap->m_aName, aName, sizeof(pMap->m_aName));
+		pMap->m_pMap = CreateEngineMap();
+		pMap->m_pStorage = Storage();
+		pMap->m_pJobPool = Kernel()->RequestInterface<IEngine>()->JobPool();
+		pMap->m_Loaded = false;
+		m_apPreloadedMaps[m_NumPreloadedMaps++] = pMap;
+		pMap->m_pJobPool->Add(&pMap->m_Job, PreloadMapJob, pMap, &m_PreloadGroup);
+	}
+}
+
+void CServer::FreePreloadedMaps()
+{
+	if(m_NumPreloadedMaps)
+		Kernel()->RequestInterface<IEngine>()->JobPool()->Wait(&m_PreloadGroup);
+	for(int i = 0; i < m_NumPreloadedMaps; i++)
+	{
+		CPreloadedMap *pMap = m_apPreloadedMaps[i];
+		pMap->m_pMap->Unload();
+		delete pMap->m_pMap;
+		delete pMap;
+	}
+	m_NumPreloadedMaps = 0;
 }
 
 void CServer::InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, CConfig *pConfig, IConsole *pConsole)
@@ -1265,12 +1434,121 @@ void CServer::InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterS
 
 void CServer::InitInterfaces(IKernel *pKernel)
 {
-	m_pConfig = pKernel->RequestInterface<IConfigManager>()->Values();
+	m_pConfigManager = pKernel->RequestInterface<IConfigManager>();
+	m_pConfig = m_pConfigManager->Values();
 	m_pConsole = pKernel->RequestInterface<IConsole>();
 	m_pGameServer = pKernel->RequestInterface<IGameServer>();
 	m_pMap = pKernel->RequestInterface<IEngineMap>();
 	m_pMapChecker = pKernel->RequestInterface<IMapChecker>();
 	m_pStorage = pKernel->RequestInterface<IStorage>();
+	m_pMetrics = pKernel->RequestInterface<IMetrics>();
+}
+
+void CServer::RegisterMetrics()
+{
+	static const int64 s_aDurationBounds[] = { 100, 250, 500, 1000, 2000, 5000, 10000, 20000, 50000 };
+	static const int64 s_aSizeBounds[] = { 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+	const int NumDurationBounds = sizeof(s_aDurationBounds)/sizeof(s_aDurationBounds[0]);
+
+	m_pTickCounter = m_pMetrics->RegisterCounter("tw_server_ticks_total", "Game ticks run");
+	m_pTickDuration = m_pMetrics->RegisterHistogram("tw_server_tick_duration_microseconds", "Time to run one game tick",
+		s_aDurationBounds, NumDurationBounds);
+	m_pSnapshotDuration = m_pMetrics->RegisterHistogram("tw_server_snapshot_duration_microseconds", "Time to build and send the snapshots of one tick",
+		s_aDurationBounds, NumDurationBounds);
+	m_pSnapshotSize = m_pMetrics->RegisterHistogram("tw_server_snapshot_bytes", "Compressed size of the snapshot deltas sent",
+		s_aSizeBounds, sizeof(s_aSizeBounds)/sizeof(s_aSizeBounds[0]));
+
+	m_pMetrics->RegisterCollector("tw_server_clients", IMetrics::TYPE_GAUGE, "Clients by state", CollectClients, this);
+	m_pMetrics->RegisterCollector("tw_client_latency_milliseconds", IMetrics::TYPE_GAUGE, "Latency of the ingame clients", CollectClientLatency, this);
+	m_pMetrics->RegisterCollector("tw_client_resent_chunks_total", IMetrics::TYPE_COUNTER, "Chunks resent to the clients since they connected", CollectClientResends, this);
+	m_pMetrics->RegisterCollector("tw_net_transferred_total", IMetrics::TYPE_COUNTER, "UDP packets and bytes sent and received", CollectNetStats, this);
+	m_pMetrics->RegisterCollector("tw_net_rate_limit_total", IMetrics::TYPE_COUNTER, "Packets checked and dropped by the rate limit", CollectRateLimit, this);
+	m_pMetrics->RegisterCollector("tw_snapshot_item_bits_total", IMetrics::TYPE_COUNTER, "Uncompressed bits of the updated snapshot items by type", CollectSnapshotItems, this);
+	m_pMetrics->RegisterCollector("tw_demo_recorder", IMetrics::TYPE_GAUGE, "State of the demo recorder and its writer thread", CollectDemo, this);
+}
+
+void CServer::CollectClients(IMetrics *pMetrics, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	static const char *s_apStates[] = { "empty", "auth", "connecting", "connecting_as_spec", "ready", "ingame" };
+	int aNum[CClient::STATE_INGAME+1] = { 0 };
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		aNum[pThis->m_aClients[i].m_State]++;
+
+	char aLabels[64];
+	for(int s = CClient::STATE_AUTH; s <= CClient::STATE_INGAME; s++)
+	{
+		str_format(aLabels, sizeof(aLabels), "state=\"%s\"", s_apStates[s]);
+		pMetrics->AddSample(aLabels, aNum[s]);
+	}
+}
+
+void CServer::CollectClientLatency(IMetrics *pMetrics, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	char aLabels[32];
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(pThis->m_aClients[i].m_State != CClient::STATE_INGAME)
+			continue;
+		str_format(aLabels, sizeof(aLabels), "client=\"%d\"", i);
+		pMetrics->AddSample(aLabels, pThis->m_aClients[i].m_Latency);
+	}
+}
+
+void CServer::CollectClientResends(IMetrics *pMetrics, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	char aLabels[32];
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(pThis->m_aClients[i].m_State == CClient::STATE_EMPTY)
+			continue;
+		str_format(aLabels, sizeof(aLabels), "client=\"%d\"", i);
+		pMetrics->AddSample(aLabels, pThis->m_NetServer.ClientResentChunks(i));
+	}
+}
+
+void CServer::CollectNetStats(IMetrics *pMetrics, void *pUser)
+{
+	NETSTATS Stats;
+	net_stats(&Stats);
+	pMetrics->AddSample("direction=\"sent\",unit=\"packets\"", Stats.sent_packets);
+	pMetrics->AddSample("direction=\"sent\",unit=\"bytes\"", Stats.sent_bytes);
+	pMetrics->AddSample("direction=\"received\",unit=\"packets\"", Stats.recv_packets);
+	pMetrics->AddSample("direction=\"received\",unit=\"bytes\"", Stats.recv_bytes);
+}
+
+void CServer::CollectRateLimit(IMetrics *pMetrics, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	const CNetRateLimiter::CStats *pStats = pThis->m_NetServer.RateLimiter()->Stats();
+	pMetrics->AddSample("result=\"checked\"", pStats->m_NumChecked);
+	pMetrics->AddSample("result=\"limited\"", pStats->m_NumLimited);
+	pMetrics->AddSample("result=\"evicted\"", pStats->m_NumEvicted);
+}
+
+void CServer::CollectSnapshotItems(IMetrics *pMetrics, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	char aLabels[32];
+	for(int i = 0; i <= CSnapshot::MAX_TYPE; i++)
+	{
+		if(!pThis->m_SnapshotDelta.GetDataUpdates(i))
+			continue;
+		str_format(aLabels, sizeof(aLabels), "type=\"%d\"", i);
+		pMetrics->AddSample(aLabels, pThis->m_SnapshotDelta.GetDataRate(i));
+	}
+}
+
+void CServer::CollectDemo(IMetrics *pMetrics, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	const CDemoRecorder::CStats *pStats = pThis->m_DemoRecorder.Stats();
+	pMetrics->AddSample("value=\"recording\"", pThis->m_DemoRecorder.IsRecording());
+	pMetrics->AddSample("value=\"queue_peak\"", pStats->m_QueuePeak);
+	pMetrics->AddSample("value=\"stalls\"", pStats->m_NumStalls);
+	pMetrics->AddSample("value=\"errors\"", pStats->m_NumErrors);
 }
 
 int CServer::Run()
@@ -1287,7 +1565,6 @@ int CServer::Run()
 		Free();
 		return -1;
 	}
-	m_MapChunksPerRequest = Config()->m_SvMapDownloadSpeed;
 
 	// start server
 	NETADDR BindAddr;
@@ -1311,8 +1588,10 @@ int CServer::Run()
 		Free();
 		return -1;
 	}
+	m_NetServer.SetRateLimit(Config()->m_SvRateLimit, Config()->m_SvRateLimitBurst);
+	RegisterMetrics();
 
-	m_Econ.Init(Config(), Console(), &m_ServerBan);
+	m_Econ.Init(Config(), Console(), &m_ServerBan, m_pMetrics);
 
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "server name is '%s'", Config()->m_SvName);
@@ -1344,6 +1623,9 @@ int CServer::Run()
 
 		while(m_RunServer)
 		{
+			if(m_PreloadMaps)
+				PreloadMaps();
+
 			// load new map
 			if(m_MapReload || m_CurrentGameTick >= 0x6FFFFFFF) //	force reload to make sure the ticks stay within a valid range
 			{
@@ -1387,6 +1669,7 @@ int CServer::Run()
 			bool ShouldSnap = false;
 			while(Now > TickStartTime(m_CurrentGameTick+1))
 			{
+				const int64 TickTime = time_get();
 				m_CurrentGameTick++;
 				NewTicks = true;
 				if((m_CurrentGameTick%2) == 0)
@@ -1409,13 +1692,19 @@ int CServer::Run()
 				}
 
 				GameServer()->OnTick();
+				m_pTickCounter->Add();
+				m_pTickDuration->Observe((time_get()-TickTime)*1000000/time_freq());
 			}
 
 			// snap game
 			if(NewTicks)
 			{
 				if(Config()->m_SvHighBandwidth || ShouldSnap)
+				{
+					const int64 SnapTime = time_get();
 					DoSnapshot();
+					m_pSnapshotDuration->Observe((time_get()-SnapTime)*1000000/time_freq());
+				}
 
 				UpdateClientRconCommands();
 				UpdateClientMapListEntries();
@@ -1426,6 +1715,9 @@ int CServer::Run()
 
 			PumpNetwork();
 
+			// the changes of this round for the other threads
+			m_pConfigManager->PublishSnapshot();
+
 			// wait for incoming data
 			m_NetServer.Wait(clamp(int((TickStartTime(m_CurrentGameTick+1)-time_get())*1000/time_freq()), 1, 1000/SERVER_TICK_SPEED/2));
 
@@ -1448,16 +1740,14 @@ int CServer::Run()
 
 void CServer::Free()
 {
+	FreePreloadedMaps();
+
 	if(m_pMap)
 	{
 		m_pMap->Unload();
 	}
 
-	if(m_pCurrentMapData)
-	{
-		mem_free(m_pCurrentMapData);
-		m_pCurrentMapData = 0;
-	}
+	m_pCurrentMapData = 0;
 }
 
 struct CSubdirCallbackUserdata
@@ -1563,6 +1853,29 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 	}
 }
 
+void CServer::ConRateLimitStatus(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	const CNetRateLimiter *pLimiter = pThis->m_NetServer.RateLimiter();
+	const CNetRateLimiter::CStats *pStats = pLimiter->Stats();
+	const int64 Now = time_get();
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "rate limit %s: checked=%lld limited=%lld evicted=%lld tracked=%d",
+		pLimiter->Enabled() ? "on" : "off", pStats->m_NumChecked, pStats->m_NumLimited, pStats->m_NumEvicted, pLimiter->NumTracked(Now));
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+
+	NETADDR aLimited[16];
+	const int NumLimited = pLimiter->GetLimited(aLimited, sizeof(aLimited)/sizeof(aLimited[0]), Now);
+	for(int i = 0; i < NumLimited; i++)
+	{
+		char aAddrStr[NETADDR_MAXSTRSIZE];
+		net_addr_str(&aLimited[i], aAddrStr, sizeof(aAddrStr), false);
+		str_format(aBuf, sizeof(aBuf), "limited addr=%s%s", aAddrStr, aLimited[i].type == NETTYPE_IPV6 ? "/64" : "");
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+}
+
 void CServer::ConShutdown(IConsole::IResult *pResult, void *pUser)
 {
 	CServer *pThis = static_cast<CServer *>(pUser);
@@ -1686,6 +1999,23 @@ void CServer::ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pU
 		((CServer *)pUserData)->m_NetServer.SetMaxClientsPerIP(pResult->GetInteger(0));
 }
 
+void CServer::ConchainMaxBansUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments())
+		((CServer *)pUserData)->m_ServerBan.SetMaxBans(pResult->GetInteger(0));
+}
+
+void CServer::ConchainRateLimitUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments())
+	{
+		CServer *pThis = static_cast<CServer *>(pUserData);
+		pThis->m_NetServer.SetRateLimit(pThis->Config()->m_SvRateLimit, pThis->Config()->m_SvRateLimitBurst);
+	}
+}
+
 void CServer::ConchainModCommandUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
 {
 	if(pResult->NumArguments() == 2)
@@ -1744,11 +2074,19 @@ void CServer::ConchainMapUpdate(IConsole::IResult *pResult, void *pUserData, ICo
 	}
 }
 
+void CServer::ConchainMapPreloadUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments() >= 1)
+		static_cast<CServer *>(pUserData)->m_PreloadMaps = true;
+}
+
 void CServer::RegisterCommands()
 {
 	// register console commands
 	Console()->Register("kick", "i[id] ?r[reason]", CFGFLAG_SERVER, ConKick, this, "Kick player with specified id for any reason");
 	Console()->Register("status", "", CFGFLAG_SERVER, ConStatus, this, "List players");
+	Console()->Register("rate_limit_status", "", CFGFLAG_SERVER, ConRateLimitStatus, this, "Show the packet rate limit counters and the limited addresses");
 	Console()->Register("shutdown", "?r[reason]", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER|CFGFLAG_BASICACCESS, ConLogout, this, "Logout of rcon");
 
@@ -1764,13 +2102,19 @@ void CServer::RegisterCommands()
 	Console()->Chain("sv_max_clients", ConchainMaxclientsUpdate, this);
 	Console()->Chain("sv_max_clients", ConchainSpecialInfoupdate, this);
 	Console()->Chain("sv_max_clients_per_ip", ConchainMaxclientsperipUpdate, this);
+	Console()->Chain("sv_max_bans", ConchainMaxBansUpdate, this);
+	Console()->Chain("sv_rate_limit", ConchainRateLimitUpdate, this);
+	Console()->Chain("sv_rate_limit_burst", ConchainRateLimitUpdate, this);
 	Console()->Chain("mod_command", ConchainModCommandUpdate, this);
 	Console()->Chain("console_output_level", ConchainConsoleOutputLevelUpdate, this);
 	Console()->Chain("sv_rcon_password", ConchainRconPasswordSet, this);
 	Console()->Chain("sv_map", ConchainMapUpdate, this);
+	Console()->Chain("sv_maprotation", ConchainMapPreloadUpdate, this);
+	Console()->Chain("sv_map_preload", ConchainMapPreloadUpdate, this);
 
 	// register console commands in sub parts
 	m_ServerBan.InitServerBan(Console(), Storage(), this);
+	m_ServerBan.SetMaxBans(Config()->m_SvMaxBans);
 	m_DemoRecorder.Init(Console(), Storage());
 	m_pGameServer->OnConsoleInit();
 }
@@ -1857,6 +2201,7 @@ int main(int argc, const char **argv)
 	IEngineMasterServer *pEngineMasterServer = CreateEngineMasterServer();
 	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_SERVER, argc, argv);
 	IConfigManager *pConfigManager = CreateConfigManager();
+	IMetrics *pMetrics = CreateMetrics();
 
 	pServer->InitRegister(&pServer->m_NetServer, pEngineMasterServer, pConfigManager->Values(), pConsole);
 
@@ -1872,6 +2217,7 @@ int main(int argc, const char **argv)
 		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pConsole);
 		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pStorage);
 		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pConfigManager);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pMetrics);
 		RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IEngineMasterServer*>(pEngineMasterServer)); // register as both
 		RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IMasterServer*>(pEngineMasterServer));
 
@@ -1921,6 +2267,7 @@ int main(int argc, const char **argv)
 	delete pEngineMasterServer;
 	delete pStorage;
 	delete pConfigManager;
+	delete pMetrics;
 
 	secure_random_uninit();
 	cmdline_free(argc, argv);
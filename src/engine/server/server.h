@@ -5,6 +5,7 @@
 
 #include <base/tl/sorted_array.h>
 
+#include <engine/metrics.h>
 #include <engine/server.h>
 #include <engine/shared/memheap.h>
 
@@ -64,6 +65,7 @@ public:
 class CServer : public IServer
 {
 	class IGameServer *m_pGameServer;
+	class IConfigManager *m_pConfigManager;
 	class CConfig *m_pConfig;
 	class IConsole *m_pConsole;
 	class IStorage *m_pStorage;
@@ -134,6 +136,8 @@ public:
 		int m_AuthTries;
 
 		int m_MapChunk;
+		int m_MapChunksPerRequest;
+		int m_MapWindow;
 		bool m_NoRconNote;
 		bool m_Quitting;
 		const IConsole::CCommandInfo *m_pRconCmdToSend;
@@ -153,6 +157,12 @@ public:
 
 	IEngineMap *m_pMap;
 	IMapChecker *m_pMapChecker;
+	IMetrics *m_pMetrics;
+
+	IMetrics::CCounter *m_pTickCounter;
+	IMetrics::CHistogram *m_pTickDuration;
+	IMetrics::CHistogram *m_pSnapshotDuration;
+	IMetrics::CHistogram *m_pSnapshotSize;
 
 	int64 m_GameStartTime;
 	bool m_RunServer;
@@ -166,13 +176,34 @@ public:
 	enum
 	{
 		MAP_CHUNK_SIZE=NET_MAX_PAYLOAD-NET_MAX_CHUNKHEADERSIZE-4, // msg type
+		MAP_WINDOW_MAX=16, // has to fit into the resend buffer of the connection
 	};
 	char m_aCurrentMap[64];
 	SHA256_DIGEST m_CurrentMapSha256;
 	unsigned m_CurrentMapCrc;
-	unsigned char *m_pCurrentMapData;
+	const unsigned char *m_pCurrentMapData; // points into the loaded map
 	int m_CurrentMapSize;
-	int m_MapChunksPerRequest;
+	bool m_CurrentMapChanged; // the map file changed on disk, it isn't served until it is reloaded
+	int m_MapCheckTick;
+
+	// maps of the rotation, loaded and hashed in the background
+	enum
+	{
+		MAX_PRELOADED_MAPS=16,
+	};
+	struct CPreloadedMap
+	{
+		char m_aName[64];
+		IEngineMap *m_pMap;
+		class IStorage *m_pStorage;
+		class CJobPool *m_pJobPool;
+		volatile bool m_Loaded;
+		CJob m_Job;
+	};
+	CPreloadedMap *m_apPreloadedMaps[MAX_PRELOADED_MAPS];
+	int m_NumPreloadedMaps;
+	CJobGroup m_PreloadGroup;
+	bool m_PreloadMaps;
 
 	// maplist
 	struct CMapListEntry
@@ -231,7 +262,7 @@ public:
 	void SendMap(int ClientID);
 	void SendConnectionReady(int ClientID);
 	void SendRconLine(int ClientID, const char *pLine);
-	static void SendRconLineAuthed(const char *pLine, void *pUser, bool Highlighted);
+	static void SendRconLineAuthed(const char *pLine, void *pUser, int Level, const char *pFrom, bool Highlighted);
 
 	void SendRconCmdAdd(const IConsole::CCommandInfo *pCommandInfo, int ClientID);
 	void SendRconCmdRem(const IConsole::CCommandInfo *pCommandInfo, int ClientID);
@@ -250,17 +281,31 @@ public:
 	virtual void ChangeMap(const char *pMap);
 	const char *GetMapName();
 	int LoadMap(const char *pMapName);
+	bool CurrentMapChanged();
+	static int PreloadMapJob(void *pUser);
+	void PreloadMaps();
+	void FreePreloadedMaps();
 
 	void InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, CConfig *pConfig, IConsole *pConsole);
 	void InitInterfaces(IKernel *pKernel);
+	void RegisterMetrics();
 	int Run();
 	void Free();
 
 	static int MapListEntryCallback(const char *pFilename, int IsDir, int DirType, void *pUser);
 	void InitMapList();
 
+	static void CollectClients(IMetrics *pMetrics, void *pUser);
+	static void CollectClientLatency(IMetrics *pMetrics, void *pUser);
+	static void CollectClientResends(IMetrics *pMetrics, void *pUser);
+	static void CollectNetStats(IMetrics *pMetrics, void *pUser);
+	static void CollectRateLimit(IMetrics *pMetrics, void *pUser);
+	static void CollectSnapshotItems(IMetrics *pMetrics, void *pUser);
+	static void CollectDemo(IMetrics *pMetrics, void *pUser);
+
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
+	static void ConRateLimitStatus(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
@@ -271,10 +316,13 @@ public:
 	static void ConchainPlayerSlotsUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMaxclientsUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainMaxBansUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainRateLimitUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainModCommandUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainConsoleOutputLevelUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainRconPasswordSet(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMapUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainMapPreloadUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 
 	void RegisterCommands();
 
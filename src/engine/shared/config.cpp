@@ -1,5 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/tl/threading.h>
+
 #include <engine/config.h>
 #include <engine/console.h>
 #include <engine/storage.h>
@@ -39,6 +41,16 @@ CConfigManager::CConfigManager()
 	m_ConfigFile = 0;
 	m_FlagMask = 0;
 	m_NumCallbacks = 0;
+	m_pSnapshot = 0;
+	m_aReaders[0] = 0;
+	m_aReaders[1] = 0;
+	m_ReaderPhase = 0;
+}
+
+CConfigManager::~CConfigManager()
+{
+	if(m_pSnapshot)
+		ReleaseSnapshot(m_pSnapshot);
 }
 
 void CConfigManager::Init(int FlagMask)
@@ -63,6 +75,8 @@ void CConfigManager::Reset()
 	#undef MACRO_CONFIG_INT
 	#undef MACRO_CONFIG_STR
 	#undef MACRO_CONFIG_UTF8STR
+
+	PublishSnapshot();
 }
 
 void CConfigManager::RestoreStrings()
@@ -118,6 +132,57 @@ void CConfigManager::Save(const char *pFilename)
 	}
 }
 
+const CConfigSnapshot *CConfigManager::AcquireSnapshot()
+{
+	while(true)
+	{
+		const unsigned Phase = m_ReaderPhase;
+		atomic_inc(&m_aReaders[Phase]);
+		if(Phase == m_ReaderPhase)
+		{
+			// the publisher waits for us before it drops this one
+			CConfigSnapshot *pSnapshot = atomic_load(&m_pSnapshot);
+			atomic_inc(&pSnapshot->m_Refs);
+			atomic_dec(&m_aReaders[Phase]);
+			return pSnapshot;
+		}
+		// published meanwhile, the old phase may not be waited for anymore
+		atomic_dec(&m_aReaders[Phase]);
+	}
+}
+
+void CConfigManager::ReleaseSnapshot(const CConfigSnapshot *pSnapshot)
+{
+	CConfigSnapshot *pOwned = const_cast<CConfigSnapshot *>(pSnapshot);
+	if(atomic_dec(&pOwned->m_Refs) == 0)
+		delete pOwned;
+}
+
+void CConfigManager::PublishSnapshot()
+{
+	CConfigSnapshot *pOld = m_pSnapshot;
+	if(pOld && mem_comp(&pOld->m_Values, &m_Values, sizeof(m_Values)) == 0)
+		return;
+
+	CConfigSnapshot *pSnapshot = new CConfigSnapshot;
+	mem_copy(&pSnapshot->m_Values, &m_Values, sizeof(m_Values));
+	pSnapshot->m_Version = pOld ? pOld->m_Version+1 : 0;
+	pSnapshot->m_Refs = 1; // the published one
+	m_pSnapshot = pSnapshot;
+	sync_barrier();
+
+	if(!pOld)
+		return;
+
+	// readers that could still see the old pointer are counted in the old phase
+	const unsigned OldPhase = m_ReaderPhase;
+	m_ReaderPhase = OldPhase^1;
+	sync_barrier();
+	while(atomic_load(&m_aReaders[OldPhase]))
+		thread_yield();
+	ReleaseSnapshot(pOld);
+}
+
 void CConfigManager::RegisterCallback(SAVECALLBACKFUNC pfnFunc, void *pUserData)
 {
 	dbg_assert(m_NumCallbacks < MAX_CALLBACKS, "too many config callbacks");
@@ -20,6 +20,34 @@ public:
 	#undef MACRO_CONFIG_UTF8STR
 };
 
+// immutable copy of the values, freed with the last reference
+class CConfigSnapshot
+{
+	friend class CConfigManager;
+
+	CConfig m_Values;
+	unsigned m_Version;
+	volatile unsigned m_Refs;
+
+public:
+	const CConfig *Values() const { return &m_Values; }
+	unsigned Version() const { return m_Version; }
+};
+
+// holds a snapshot for as long as it lives
+class CConfigSnapshotRef
+{
+	IConfigManager *m_pConfigManager;
+	const CConfigSnapshot *m_pSnapshot;
+
+public:
+	CConfigSnapshotRef(IConfigManager *pConfigManager) : m_pConfigManager(pConfigManager), m_pSnapshot(pConfigManager->AcquireSnapshot()) {}
+	~CConfigSnapshotRef() { m_pConfigManager->ReleaseSnapshot(m_pSnapshot); }
+
+	const CConfig *operator->() const { return m_pSnapshot->Values(); }
+	const CConfigSnapshot *Snapshot() const { return m_pSnapshot; }
+};
+
 enum
 {
 	CFGFLAG_SAVE=1,
@@ -52,8 +80,15 @@ class CConfigManager : public IConfigManager
 	int m_NumCallbacks;
 	CConfig m_Values;
 
+	// readers count themselves in the current phase while they take a
+	// reference, a publish flips the phase and waits for the old one to drain
+	CConfigSnapshot *volatile m_pSnapshot;
+	volatile unsigned m_aReaders[2];
+	volatile unsigned m_ReaderPhase;
+
 public:
 	CConfigManager();
+	~CConfigManager();
 
 	virtual void Init(int FlagMask);
 	virtual void Reset();
@@ -61,6 +96,10 @@ public:
 	virtual void Save(const char *pFilename);
 	virtual CConfig *Values() { return &m_Values; }
 
+	virtual const CConfigSnapshot *AcquireSnapshot();
+	virtual void ReleaseSnapshot(const CConfigSnapshot *pSnapshot);
+	virtual void PublishSnapshot();
+
 	virtual void RegisterCallback(SAVECALLBACKFUNC pfnFunc, void *pUserData);
 
 	virtual void WriteLine(const char *pLine);
@@ -273,17 +273,22 @@ void CConsole::SetPrintOutputLevel(int Index, int OutputLevel)
 
 void CConsole::Print(int Level, const char *pFrom, const char *pStr, bool Highlighted)
 {
-	char aTimeBuf[80];
-	str_timestamp_format(aTimeBuf, sizeof(aTimeBuf), FORMAT_TIME);
+	dbg_msg(pFrom ,"%s", pStr);
 
+	// only format the line if a callback wants it
 	char aBuf[1024];
-	str_format(aBuf, sizeof(aBuf), "[%s][%s]: %s", aTimeBuf, pFrom, pStr);
-	dbg_msg(pFrom ,"%s", pStr);
+	aBuf[0] = 0;
 	for(int i = 0; i < m_NumPrintCB; ++i)
 	{
 		if(Level <= m_aPrintCB[i].m_OutputLevel && m_aPrintCB[i].m_pfnPrintCallback)
 		{
-			m_aPrintCB[i].m_pfnPrintCallback(aBuf, m_aPrintCB[i].m_pPrintCallbackUserdata, Highlighted);
+			if(!aBuf[0])
+			{
+				char aTimeBuf[80];
+				str_timestamp_format(aTimeBuf, sizeof(aTimeBuf), FORMAT_TIME);
+				str_format(aBuf, sizeof(aBuf), "[%s][%s]: %s", aTimeBuf, pFrom, pStr);
+			}
+			m_aPrintCB[i].m_pfnPrintCallback(aBuf, m_aPrintCB[i].m_pPrintCallbackUserdata, Level, pFrom, Highlighted);
 		}
 	}
 }
@@ -459,7 +464,7 @@ int CConsole::PossibleMaps(const char *pStr, FPossibleCallback pfnCallback, void
 
 CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[HashName(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags&FlagMask && str_comp_nocase(pCommand->m_pName, pName) == 0)
 		{
@@ -819,6 +824,7 @@ CConsole::CConsole(int FlagMask)
 	m_pLastMapEntry = 0;
 	m_ExecutionQueue.Reset();
 	m_pFirstCommand = 0;
+	mem_zero(m_apCommandHash, sizeof(m_apCommandHash));
 	m_pFirstExec = 0;
 	mem_zero(m_aPrintCB, sizeof(m_aPrintCB));
 	m_NumPrintCB = 0;
@@ -923,14 +929,19 @@ void CConsole::ParseArguments(int NumArgs, const char **ppArguments)
 	}
 }
 
+unsigned CConsole::HashName(const char *pName)
+{
+	unsigned Hash = 5381;
+	for(; *pName; pName++)
+		Hash = ((Hash << 5) + Hash) + (unsigned char)str_uppercase(*pName);
+	return Hash%COMMAND_HASH_SIZE;
+}
+
 void CConsole::AddCommandSorted(CCommand *pCommand)
 {
 	if(!m_pFirstCommand || str_comp(pCommand->m_pName, m_pFirstCommand->m_pName) <= 0)
 	{
-		if(m_pFirstCommand && m_pFirstCommand->m_pNext)
-			pCommand->m_pNext = m_pFirstCommand;
-		else
-			pCommand->m_pNext = 0;
+		pCommand->m_pNext = m_pFirstCommand;
 		m_pFirstCommand = pCommand;
 	}
 	else
@@ -945,6 +956,25 @@ void CConsole::AddCommandSorted(CCommand *pCommand)
 			}
 		}
 	}
+
+	// same order within the bucket, so lookups find what a walk over the list would
+	CCommand **ppBucket = &m_apCommandHash[HashName(pCommand->m_pName)];
+	while(*ppBucket && str_comp(pCommand->m_pName, (*ppBucket)->m_pName) > 0)
+		ppBucket = &(*ppBucket)->m_pNextHash;
+	pCommand->m_pNextHash = *ppBucket;
+	*ppBucket = pCommand;
+}
+
+void CConsole::RemoveCommandHashed(CCommand *pCommand)
+{
+	for(CCommand **ppBucket = &m_apCommandHash[HashName(pCommand->m_pName)]; *ppBucket; ppBucket = &(*ppBucket)->m_pNextHash)
+	{
+		if(*ppBucket == pCommand)
+		{
+			*ppBucket = pCommand->m_pNextHash;
+			return;
+		}
+	}
 }
 
 void CConsole::Register(const char *pName, const char *pParams,
@@ -1032,6 +1062,7 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		RemoveCommandHashed(pRemoved);
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
 	}
@@ -1052,6 +1083,16 @@ void CConsole::DeregisterTempAll()
 			pCommand->m_pNext = pNext;
 		}
 	}
+	for(int i = 0; i < COMMAND_HASH_SIZE; i++)
+	{
+		for(CCommand **ppBucket = &m_apCommandHash[i]; *ppBucket;)
+		{
+			if((*ppBucket)->m_Temp)
+				*ppBucket = (*ppBucket)->m_pNextHash;
+			else
+				ppBucket = &(*ppBucket)->m_pNextHash;
+		}
+	}
 
 	m_TempCommands.Reset();
 	m_pRecycleList = 0;
@@ -1157,7 +1198,7 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::CCommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[HashName(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags&FlagMask && pCommand->m_Temp == Temp)
 		{
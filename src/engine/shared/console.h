@@ -14,6 +14,7 @@ class CConsole : public IConsole
 	public:
 		CCommand(bool BasicAccess) : CCommandInfo(BasicAccess) {}
 		CCommand *m_pNext;
+		CCommand *m_pNextHash;
 		int m_Flags;
 		bool m_Temp;
 		FCommandCallback m_pfnCallback;
@@ -34,11 +35,19 @@ class CConsole : public IConsole
 		void *m_pUserData;
 	};
 
+	enum
+	{
+		COMMAND_HASH_SIZE = 1024,
+	};
+
 	int m_FlagMask;
 	bool m_StoreCommands;
 	const char *m_apStrokeStr[2];
 	CCommand *m_pFirstCommand;
 
+	// commands by case insensitive name, each bucket in list order
+	CCommand *m_apCommandHash[COMMAND_HASH_SIZE];
+
 	class CExecFile
 	{
 	public:
@@ -166,7 +175,9 @@ class CConsole : public IConsole
 		}
 	} m_ExecutionQueue;
 
+	static unsigned HashName(const char *pName);
 	void AddCommandSorted(CCommand *pCommand);
+	void RemoveCommandHashed(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
 
 	struct CMapListEntryTemp {
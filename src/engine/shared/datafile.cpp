@@ -2,11 +2,14 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include "datafile.h"
 
+#include <algorithm>
+
 #include <base/hash_ctxt.h>
 #include <base/math.h>
 #include <base/system.h>
 #include <engine/storage.h>
 #include <zlib.h>
+#include "jobs.h"
 
 static const int DEBUG=0;
 
@@ -59,7 +62,6 @@ struct CDatafileInfo
 
 struct CDatafile
 {
-	IOHANDLE m_File;
 	SHA256_DIGEST m_Sha256;
 	unsigned m_Crc;
 	CDatafileInfo m_Info;
@@ -67,54 +69,88 @@ struct CDatafile
 	int m_DataStartOffset;
 	char **m_ppDataPtrs;
 	int *m_pDataSizes;
+	bool *m_pDataOwned;
 	char *m_pData;
+
+	// the whole file, mapped read-only or read into memory when it can't
+	// be mapped. the compressed data is used from here and everything else
+	// is copied out
+	const char *m_pFileData;
+	unsigned m_FileSize;
+	bool m_FileMapped;
+
+	// where the file was opened and when it was last modified then, a
+	// mapping sees changes done to the file in place
+	char m_aPath[IO_MAX_PATH_LENGTH];
+	time_t m_Modified;
 };
 
+static void FreeFileData(const char *pFileData, unsigned FileSize, bool Mapped)
+{
+	if(Mapped)
+		io_unmap(pFileData, FileSize);
+	else
+		mem_free((void *)pFileData);
+}
+
 bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
 {
 	dbg_msg("datafile", "loading. filename='%s'", pFilename);
 
-	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType);
+	char aPath[IO_MAX_PATH_LENGTH];
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType, aPath, sizeof(aPath));
 	if(!File)
 	{
 		dbg_msg("datafile", "could not open '%s'", pFilename);
 		return false;
 	}
 
+	time_t Created, Modified;
+	if(fs_file_time(aPath, &Created, &Modified))
+		aPath[0] = 0;
 
-	// take the hashes of the file and store them
-	SHA256_CTX Sha256Ctx;
-	sha256_init(&Sha256Ctx);
-	unsigned Crc = crc32(0L, 0x0, 0);
+	// map the file if possible, read it whole otherwise. windows doesn't
+	// allow to replace a mapped file, so it is always read there
+	unsigned FileSize = 0;
+	bool Mapped = true;
+#if defined(CONF_FAMILY_WINDOWS)
+	const char *pFileData = 0;
+#else
+	const char *pFileData = (const char *)io_map(File, &FileSize);
+#endif
+	if(!pFileData)
 	{
-		enum
-		{
-			BUFFER_SIZE = 64*1024
-		};
-
-		unsigned char aBuffer[BUFFER_SIZE];
-
-		while(1)
+		Mapped = false;
+		long Length = io_length(File);
+		char *pBuffer = Length > 0 ? (char *)mem_alloc(Length) : 0;
+		if(!pBuffer || io_read(File, pBuffer, Length) != (unsigned)Length)
 		{
-			unsigned Bytes = io_read(File, aBuffer, BUFFER_SIZE);
-			if(Bytes == 0)
-				break;
-			sha256_update(&Sha256Ctx, aBuffer, Bytes);
-			Crc = crc32(Crc, aBuffer, Bytes);
+			dbg_msg("datafile", "could not read '%s'", pFilename);
+			mem_free(pBuffer);
+			io_close(File);
+			return false;
 		}
-
-		io_seek(File, 0, IOSEEK_START);
+		pFileData = pBuffer;
+		FileSize = (unsigned)Length;
 	}
+	io_close(File);
+
+	// take the hashes of the file and store them
+	SHA256_CTX Sha256Ctx;
+	sha256_init(&Sha256Ctx);
+	sha256_update(&Sha256Ctx, pFileData, FileSize);
+	unsigned Crc = crc32(crc32(0L, 0x0, 0), (const Bytef *)pFileData, FileSize);
 
 	// TODO: change this header
 	CDatafileHeader Header;
-	io_read(File, &Header, sizeof(Header));
+	mem_zero(&Header, sizeof(Header));
+	mem_copy(&Header, pFileData, minimum((unsigned)sizeof(Header), FileSize));
 	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
 	{
 		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
 		{
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
-			io_close(File);
+			FreeFileData(pFileData, FileSize, Mapped);
 			return 0;
 		}
 	}
@@ -125,7 +161,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
-		io_close(File);
+		FreeFileData(pFileData, FileSize, Mapped);
 		return 0;
 	}
 
@@ -141,9 +177,10 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	AllocSize += sizeof(CDatafile); // add space for info structure
 	AllocSize += Header.m_NumRawData*sizeof(void*); // add space for data pointers
 	AllocSize += Header.m_NumRawData*sizeof(int); // add space for data sizes
+	AllocSize += Header.m_NumRawData*sizeof(bool); // add space for data ownership
 	if(Size > (int64(1)<<31) || Header.m_NumItemTypes < 0 || Header.m_NumItems < 0 || Header.m_NumRawData < 0 || Header.m_ItemSize < 0)
 	{
-		io_close(File);
+		FreeFileData(pFileData, FileSize, Mapped);
 		dbg_msg("datafile", "unable to load file, invalid file information");
 		return false;
 	}
@@ -153,20 +190,27 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
 	pTmpDataFile->m_ppDataPtrs = (char **)(pTmpDataFile+1);
 	pTmpDataFile->m_pDataSizes = (int *)(pTmpDataFile->m_ppDataPtrs + Header.m_NumRawData);
-	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
-	pTmpDataFile->m_File = File;
+	pTmpDataFile->m_pDataOwned = (bool *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
+	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataOwned + Header.m_NumRawData);
 	pTmpDataFile->m_Sha256 = sha256_finish(&Sha256Ctx);
 	pTmpDataFile->m_Crc = Crc;
+	pTmpDataFile->m_pFileData = pFileData;
+	pTmpDataFile->m_FileSize = FileSize;
+	pTmpDataFile->m_FileMapped = Mapped;
+	str_copy(pTmpDataFile->m_aPath, aPath, sizeof(pTmpDataFile->m_aPath));
+	pTmpDataFile->m_Modified = Modified;
 
 	// clear the data pointers and sizes
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData*sizeof(void*));
 	mem_zero(pTmpDataFile->m_pDataSizes, Header.m_NumRawData*sizeof(int));
+	mem_zero(pTmpDataFile->m_pDataOwned, Header.m_NumRawData*sizeof(bool));
 
-	// read types, offsets, sizes and item data
-	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
+	// copy types, offsets, sizes and item data, users may change them
+	unsigned ReadSize = (unsigned)maximum(minimum((int64)FileSize-(int64)sizeof(CDatafileHeader), Size), (int64)0);
+	mem_copy(pTmpDataFile->m_pData, pFileData + sizeof(CDatafileHeader), ReadSize);
 	if(ReadSize != Size)
 	{
-		io_close(pTmpDataFile->m_File);
+		FreeFileData(pFileData, FileSize, Mapped);
 		mem_free(pTmpDataFile);
 		pTmpDataFile = 0;
 		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", unsigned(Size), ReadSize);
@@ -292,39 +336,54 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 		int SwapSize = DataSize;
 #endif
 
+		// the data straight from the file
+		int64 Offset = (int64)m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index];
+		if(DataSize < 0 || Offset < 0 || Offset+DataSize > m_pDataFile->m_FileSize)
+		{
+			dbg_msg("datafile", "data index=%d is outside of the file", Index);
+			return 0;
+		}
+		if(m_pDataFile->m_FileMapped && FileChanged())
+		{
+			dbg_msg("datafile", "data index=%d not loaded, the file changed since it was opened", Index);
+			return 0;
+		}
+		const char *pFileData = m_pDataFile->m_pFileData+Offset;
+
 		if(m_pDataFile->m_Header.m_Version == 4)
 		{
 			// v4 has compressed data
-			void *pTemp = (char *)mem_alloc(DataSize);
 			unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
 			unsigned long s;
 
 			dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%lu", Index, DataSize, UncompressedSize);
 			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(UncompressedSize);
 			m_pDataFile->m_pDataSizes[Index] = UncompressedSize;
+			m_pDataFile->m_pDataOwned[Index] = true;
 
-			// read the compressed data
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, pTemp, DataSize);
-
-			// decompress the data, TODO: check for errors
+			// decompress the data
 			s = UncompressedSize;
-			uncompress((Bytef*)m_pDataFile->m_ppDataPtrs[Index], &s, (Bytef*)pTemp, DataSize);
+			int Result = uncompress((Bytef*)m_pDataFile->m_ppDataPtrs[Index], &s, (const Bytef*)pFileData, DataSize);
 #if defined(CONF_ARCH_ENDIAN_BIG)
 			SwapSize = s;
 #endif
 
-			// clean up the temporary buffers
-			mem_free(pTemp);
+			if(Result != Z_OK)
+			{
+				dbg_msg("datafile", "failed to decompress data index=%d error=%d", Index, Result);
+				UnloadData(Index);
+				return 0;
+			}
 		}
 		else
 		{
-			// load the data
+			// copy the data, users may change it but the file image is
+			// read-only
 			dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
 			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(DataSize);
 			m_pDataFile->m_pDataSizes[Index] = DataSize;
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+			m_pDataFile->m_pDataOwned[Index] = true;
+			mem_copy(m_pDataFile->m_ppDataPtrs[Index], pFileData, DataSize);
 		}
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
@@ -336,6 +395,120 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 	return m_pDataFile->m_ppDataPtrs[Index];
 }
 
+// zlib work on data blocks, one job each
+struct CDataBlockJob
+{
+	CJob m_Job;
+	int m_Level; // compression level, -2 to decompress
+	int m_Index;
+	const char *m_pSrc;
+	int m_SrcSize;
+	char *m_pDst;
+	unsigned long m_DstSize;
+	int m_Result;
+
+	bool operator<(const CDataBlockJob &Other) const { return m_SrcSize > Other.m_SrcSize; }
+};
+
+enum
+{
+	DATABLOCK_DECOMPRESS=-2,
+};
+
+static int DataBlockJob(void *pUser)
+{
+	CDataBlockJob *pJob = (CDataBlockJob *)pUser;
+	if(pJob->m_Level == DATABLOCK_DECOMPRESS)
+		pJob->m_Result = uncompress((Bytef*)pJob->m_pDst, &pJob->m_DstSize, (const Bytef*)pJob->m_pSrc, pJob->m_SrcSize);
+	else
+		pJob->m_Result = compress2((Bytef*)pJob->m_pDst, &pJob->m_DstSize, (const Bytef*)pJob->m_pSrc, pJob->m_SrcSize, pJob->m_Level);
+	return 0;
+}
+
+// runs all jobs on the pool and the calling thread, or only on the
+// calling thread without a pool
+static void RunDataBlockJobs(CDataBlockJob *pJobs, int NumJobs, int Level, CJobPool *pPool)
+{
+	// biggest first, so the threads finish at about the same time
+	std::sort(pJobs, pJobs+NumJobs);
+
+	CJobGroup Group;
+	for(int i = 0; i < NumJobs; i++)
+	{
+		pJobs[i].m_Level = Level;
+		if(pPool)
+			pPool->Add(&pJobs[i].m_Job, DataBlockJob, &pJobs[i], &Group);
+		else
+			DataBlockJob(&pJobs[i]);
+	}
+	if(pPool)
+		pPool->Wait(&Group);
+}
+
+void CDataFileReader::PrefetchData(const int *pIndices, int Num, CJobPool *pPool)
+{
+	if(!m_pDataFile)
+		return;
+
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	// whether the data gets swapped is only known when it's accessed
+	return;
+#endif
+
+	if(!pIndices)
+		Num = m_pDataFile->m_Header.m_NumRawData;
+	if(Num <= 0 || (m_pDataFile->m_FileMapped && FileChanged()))
+		return;
+
+	// set up the buffers here, the threads only decompress
+	CDataBlockJob *pJobs = (CDataBlockJob *)mem_alloc(Num*sizeof(CDataBlockJob));
+	int NumJobs = 0;
+	for(int i = 0; i < Num; i++)
+	{
+		int Index = pIndices ? pIndices[i] : i;
+		if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData || m_pDataFile->m_ppDataPtrs[Index])
+			continue;
+
+		// there is nothing to decompress in older files
+		if(m_pDataFile->m_Header.m_Version != 4)
+		{
+			GetDataImpl(Index, 0);
+			continue;
+		}
+
+		CDataBlockJob *pJob = &pJobs[NumJobs];
+		pJob->m_Index = Index;
+		pJob->m_SrcSize = GetFileDataSize(Index);
+		int64 Offset = (int64)m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index];
+		if(pJob->m_SrcSize < 0 || Offset < 0 || Offset+pJob->m_SrcSize > m_pDataFile->m_FileSize)
+			continue;
+		pJob->m_pSrc = m_pDataFile->m_pFileData+Offset;
+
+		pJob->m_DstSize = m_pDataFile->m_Info.m_pDataSizes[Index];
+		pJob->m_pDst = (char *)mem_alloc(pJob->m_DstSize);
+		m_pDataFile->m_ppDataPtrs[Index] = pJob->m_pDst;
+		m_pDataFile->m_pDataSizes[Index] = pJob->m_DstSize;
+		m_pDataFile->m_pDataOwned[Index] = true;
+		NumJobs++;
+	}
+
+	RunDataBlockJobs(pJobs, NumJobs, DATABLOCK_DECOMPRESS, pPool);
+
+	for(int i = 0; i < NumJobs; i++)
+	{
+		// broken blocks are not loaded, like on access
+		if(pJobs[i].m_Result != Z_OK)
+		{
+			dbg_msg("datafile", "failed to decompress data index=%d error=%d", pJobs[i].m_Index, pJobs[i].m_Result);
+			UnloadData(pJobs[i].m_Index);
+		}
+	}
+	mem_free(pJobs);
+
+	if(NumJobs)
+		dbg_msg("datafile", "decompressed %d data blocks on %d threads", NumJobs, pPool ? pPool->NumThreads()+1 : 1);
+}
+
 void *CDataFileReader::GetData(int Index)
 {
 	return GetDataImpl(Index, 0);
@@ -357,6 +530,7 @@ void CDataFileReader::ReplaceData(int Index, char *pData, int Size)
 	UnloadData(Index);
 	m_pDataFile->m_ppDataPtrs[Index] = pData;
 	m_pDataFile->m_pDataSizes[Index] = Size;
+	m_pDataFile->m_pDataOwned[Index] = true;
 }
 
 void CDataFileReader::UnloadData(int Index)
@@ -364,9 +538,11 @@ void CDataFileReader::UnloadData(int Index)
 	if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
 		return;
 
-	mem_free(m_pDataFile->m_ppDataPtrs[Index]);
+	if(m_pDataFile->m_pDataOwned[Index])
+		mem_free(m_pDataFile->m_ppDataPtrs[Index]);
 	m_pDataFile->m_ppDataPtrs[Index] = 0x0;
 	m_pDataFile->m_pDataSizes[Index] = 0;
+	m_pDataFile->m_pDataOwned[Index] = false;
 }
 
 int CDataFileReader::GetFileItemSize(int Index) const
@@ -457,11 +633,12 @@ bool CDataFileReader::Close()
 	int i;
 	for(i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
 	{
-		mem_free(m_pDataFile->m_ppDataPtrs[i]);
+		if(m_pDataFile->m_pDataOwned[i])
+			mem_free(m_pDataFile->m_ppDataPtrs[i]);
 		m_pDataFile->m_pDataSizes[i] = 0;
 	}
 
-	io_close(m_pDataFile->m_File);
+	FreeFileData(m_pDataFile->m_pFileData, m_pDataFile->m_FileSize, m_pDataFile->m_FileMapped);
 	mem_free(m_pDataFile);
 	m_pDataFile = 0;
 	return true;
@@ -479,6 +656,31 @@ unsigned CDataFileReader::Crc() const
 	return m_pDataFile->m_Crc;
 }
 
+const void *CDataFileReader::FileData(unsigned *pSize) const
+{
+	if(!m_pDataFile)
+		return 0;
+	*pSize = m_pDataFile->m_FileSize;
+	return m_pDataFile->m_pFileData;
+}
+
+bool CDataFileReader::FileChanged() const
+{
+	if(!m_pDataFile || !m_pDataFile->m_aPath[0])
+		return false;
+
+	time_t Created, Modified;
+	if(fs_file_time(m_pDataFile->m_aPath, &Created, &Modified) || Modified != m_pDataFile->m_Modified)
+		return true;
+
+	IOHANDLE File = io_open(m_pDataFile->m_aPath, IOFLAG_READ);
+	if(!File)
+		return true;
+	long Length = io_length(File);
+	io_close(File);
+	return Length != (long)m_pDataFile->m_FileSize;
+}
+
 bool CDataFileReader::CheckSha256(IOHANDLE Handle, const void *pSha256)
 {
 	// read the hash of the file
@@ -504,6 +706,8 @@ bool CDataFileReader::CheckSha256(IOHANDLE Handle, const void *pSha256)
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = 0;
+	m_CompressionLevel = Z_DEFAULT_COMPRESSION;
+	m_pJobPool = 0;
 	m_pItemTypes = static_cast<CItemTypeInfo *>(mem_alloc(sizeof(CItemTypeInfo) * MAX_ITEM_TYPES));
 	m_pItems = static_cast<CItemInfo *>(mem_alloc(sizeof(CItemInfo) * MAX_ITEMS));
 	m_pDatas = static_cast<CDataInfo *>(mem_alloc(sizeof(CDataInfo) * MAX_DATAS));
@@ -540,6 +744,12 @@ bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename)
 	return true;
 }
 
+void CDataFileWriter::SetCompression(int Level, CJobPool *pPool)
+{
+	m_CompressionLevel = clamp(Level, int(Z_NO_COMPRESSION), int(Z_BEST_COMPRESSION));
+	m_pJobPool = pPool;
+}
+
 int CDataFileWriter::AddItem(int Type, int ID, int Size, const void *pData)
 {
 	if(!m_File) return 0;
@@ -582,22 +792,13 @@ int CDataFileWriter::AddData(int Size, const void *pData)
 
 	dbg_assert(m_NumDatas < 1024, "too much data");
 
+	// keep a copy, all data gets compressed at once when finishing
 	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
-	unsigned long s = compressBound(Size);
-	void *pCompData = mem_alloc(s); // temporary buffer that we use during compression
-
-	int Result = compress((Bytef*)pCompData, &s, (Bytef*)pData, Size);
-	if(Result != Z_OK)
-	{
-		dbg_msg("datafile", "compression error %d", Result);
-		dbg_assert(0, "zlib error");
-	}
-
 	pInfo->m_UncompressedSize = Size;
-	pInfo->m_CompressedSize = (int)s;
-	pInfo->m_pCompressedData = mem_alloc(pInfo->m_CompressedSize);
-	mem_copy(pInfo->m_pCompressedData, pCompData, pInfo->m_CompressedSize);
-	mem_free(pCompData);
+	pInfo->m_CompressedSize = 0;
+	pInfo->m_pUncompressedData = mem_alloc(Size);
+	mem_copy(pInfo->m_pUncompressedData, pData, Size);
+	pInfo->m_pCompressedData = 0;
 
 	m_NumDatas++;
 	return m_NumDatas-1;
@@ -619,6 +820,40 @@ int CDataFileWriter::AddDataSwapped(int Size, const void *pData)
 #endif
 }
 
+void CDataFileWriter::CompressData()
+{
+	if(!m_NumDatas)
+		return;
+
+	CDataBlockJob *pJobs = (CDataBlockJob *)mem_alloc(m_NumDatas*sizeof(CDataBlockJob));
+	for(int i = 0; i < m_NumDatas; i++)
+	{
+		pJobs[i].m_Index = i;
+		pJobs[i].m_pSrc = (const char *)m_pDatas[i].m_pUncompressedData;
+		pJobs[i].m_SrcSize = m_pDatas[i].m_UncompressedSize;
+		pJobs[i].m_DstSize = compressBound(m_pDatas[i].m_UncompressedSize);
+		pJobs[i].m_pDst = (char *)mem_alloc(pJobs[i].m_DstSize);
+	}
+
+	RunDataBlockJobs(pJobs, m_NumDatas, m_CompressionLevel, m_pJobPool);
+
+	for(int i = 0; i < m_NumDatas; i++)
+	{
+		if(pJobs[i].m_Result != Z_OK)
+		{
+			dbg_msg("datafile", "compression error %d", pJobs[i].m_Result);
+			dbg_assert(0, "zlib error");
+		}
+
+		CDataInfo *pInfo = &m_pDatas[pJobs[i].m_Index];
+		pInfo->m_CompressedSize = (int)pJobs[i].m_DstSize;
+		pInfo->m_pCompressedData = pJobs[i].m_pDst;
+		mem_free(pInfo->m_pUncompressedData);
+		pInfo->m_pUncompressedData = 0;
+	}
+	mem_free(pJobs);
+}
+
 
 int CDataFileWriter::Finish()
 {
@@ -629,6 +864,8 @@ int CDataFileWriter::Finish()
 	int DataSize = 0;
 	CDatafileHeader Header;
 
+	CompressData();
+
 	// we should now write this file!
 	if(DEBUG)
 		dbg_msg("datafile", "writing");
@@ -21,9 +21,11 @@ public:
 
 	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
 	bool Close();
+	void Swap(CDataFileReader *pOther) { struct CDatafile *pDataFile = m_pDataFile; m_pDataFile = pOther->m_pDataFile; pOther->m_pDataFile = pDataFile; }
 
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
+	void PrefetchData(const int *pIndices, int Num, class CJobPool *pPool = 0); // decompresses the data on the pool, all of it without indices
 	int GetDataSize(int Index) const;
 	void ReplaceData(int Index, char *pData, int Size);
 	void UnloadData(int Index);
@@ -37,6 +39,8 @@ public:
 
 	SHA256_DIGEST Sha256() const;
 	unsigned Crc() const;
+	const void *FileData(unsigned *pSize) const; // the whole file, valid until closed. it may be mapped, replace open files by renaming
+	bool FileChanged() const; // whether the size or modification time of the file changed since it was opened
 
 	static bool CheckSha256(IOHANDLE Handle, const void *pSha256);
 };
@@ -48,6 +52,7 @@ class CDataFileWriter
 	{
 		int m_UncompressedSize;
 		int m_CompressedSize;
+		void *m_pUncompressedData; // compressed in Finish
 		void *m_pCompressedData;
 	};
 
@@ -82,11 +87,16 @@ class CDataFileWriter
 	CItemTypeInfo *m_pItemTypes;
 	CItemInfo *m_pItems;
 	CDataInfo *m_pDatas;
+	int m_CompressionLevel;
+	class CJobPool *m_pJobPool;
+
+	void CompressData();
 
 public:
 	CDataFileWriter();
 	~CDataFileWriter();
 	bool Open(class IStorage *pStorage, const char *Filename);
+	void SetCompression(int Level, class CJobPool *pPool = 0); // zlib level 0-9, the data is compressed on the pool in Finish
 	int AddData(int Size, const void *pData);
 	int AddDataSwapped(int Size, const void *pData);
 	int AddItem(int Type, int ID, int Size, const void *pData);
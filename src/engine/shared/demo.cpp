@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 #include <engine/console.h>
 #include <engine/storage.h>
@@ -19,6 +20,8 @@ static const unsigned char gs_OldVersion = 4;
 static const unsigned char gs_VersionTickCompression = 5; // demo files with this version or higher will use `CHUNKTICKFLAG_TICK_COMPRESSED`
 static const int gs_LengthOffset = 152;
 static const int gs_NumMarkersOffset = 176;
+static const int gs_IndexMagic = 0x54574958; // "TWIX"
+static const int gs_IndexVersion = 1;
 
 CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta)
 {
@@ -26,6 +29,11 @@ CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta)
 	m_LastTickMarker = -1;
 	m_pSnapshotDelta = pSnapshotDelta;
 	m_Huffman.Init();
+	m_QueueStart = 0;
+	m_QueueNum = 0;
+	m_WaitingForSpace = false;
+	m_pWriterThread = 0;
+	mem_zero(&m_Stats, sizeof(m_Stats));
 }
 
 void CDemoRecorder::Init(class IConsole *pConsole, class IStorage *pStorage)
@@ -119,13 +127,18 @@ int CDemoRecorder::Start(const char *pFilename, const char *pNetVersion, const c
 
 	m_LastKeyFrame = -1;
 	m_LastTickMarker = -1;
+	m_LastWrittenTick = -1;
 	m_FirstTick = -1;
 	m_NumTimelineMarkers = 0;
+	m_lKeyFrames.clear();
+	m_WriterSnapshotDelta = *m_pSnapshotDelta;
+	mem_zero(&m_Stats, sizeof(m_Stats));
 
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "Recording to '%s'", pFilename);
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
 	m_File = DemoFile;
+	m_pWriterThread = thread_init(WriterThread, this);
 
 	return 0;
 }
@@ -153,16 +166,36 @@ enum
 	CHUNKMASK_TYPE = 0x60,
 	CHUNKMASK_SIZE = 0x1f,
 
+	CHUNKTYPE_INDEX = 0,
 	CHUNKTYPE_SNAPSHOT = 1,
 	CHUNKTYPE_MESSAGE = 2,
 	CHUNKTYPE_DELTA = 3,
 
-	CHUNKFLAG_BIGSIZE = 0x10
+	CHUNKFLAG_BIGSIZE = 0x10,
+
+	QUEUEITEM_STOP = -1
+};
+
+/*
+	Keyframe index, appended when the recording is stopped
+		Index chunks
+			tick and file position of each keyframe as the difference to the previous one
+		Trailer, padded with empty chunks to INDEX_TRAILER_SIZE bytes
+			magic, version, position of the first index chunk, number of keyframes, first tick, last tick
+
+	Both are index type chunks, players that don't know about the index skip them.
+*/
+
+enum
+{
+	INDEX_CHUNK_KEYFRAMES = 1024,
+	INDEX_TRAILER_SIZE = 64,
+	INDEX_TRAILER_INTS = 6,
 };
 
 void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 {
-	if(m_LastTickMarker == -1 || Tick-m_LastTickMarker > CHUNKMASK_TICK || Keyframe)
+	if(m_LastWrittenTick == -1 || Tick-m_LastWrittenTick > CHUNKMASK_TICK || Keyframe)
 	{
 		unsigned char aChunk[5];
 		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER;
@@ -176,13 +209,11 @@ void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 	else
 	{
 		unsigned char aChunk[1];
-		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | CHUNKTICKFLAG_TICK_COMPRESSED | (Tick-m_LastTickMarker);
+		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | CHUNKTICKFLAG_TICK_COMPRESSED | (Tick-m_LastWrittenTick);
 		io_write(m_File, aChunk, sizeof(aChunk));
 	}
 
-	m_LastTickMarker = Tick;
-	if(m_FirstTick < 0)
-		m_FirstTick = Tick;
+	m_LastWrittenTick = Tick;
 }
 
 void CDemoRecorder::Write(int Type, const void *pData, int Size)
@@ -201,13 +232,15 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 	Size = CVariableInt::Compress(aBuffer2, Size, aBuffer, sizeof(aBuffer)); // buffer2 -> buffer
 	if(Size < 0)
 	{
-		m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_recorder", "error during intpack compression");
+		// error during intpack compression, reported on stop
+		m_Stats.m_NumErrors++;
 		return;
 	}
 	Size = m_Huffman.Compress(aBuffer, Size, aBuffer2, sizeof(aBuffer2)); // buffer -> buffer2
 	if(Size < 0)
 	{
-		m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_recorder", "error during network compression");
+		// error during network compression, reported on stop
+		m_Stats.m_NumErrors++;
 		return;
 	}
 
@@ -238,12 +271,117 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 	io_write(m_File, aBuffer2, Size);
 }
 
+void CDemoRecorder::WriterThread(void *pUser)
+{
+	CDemoRecorder *pSelf = (CDemoRecorder *)pUser;
+
+	while(1)
+	{
+		pSelf->m_QueueItems.wait();
+
+		CQueueItem Item;
+		{
+			scope_lock Lock(&pSelf->m_QueueLock);
+			Item = pSelf->m_aQueue[pSelf->m_QueueStart];
+		}
+
+		if(Item.m_Type == CHUNKTYPE_SNAPSHOT)
+			pSelf->WriteSnapshot(Item.m_Tick, Item.m_pData, Item.m_Size);
+		else if(Item.m_Type == CHUNKTYPE_MESSAGE)
+			pSelf->Write(CHUNKTYPE_MESSAGE, Item.m_pData, Item.m_Size);
+		mem_free(Item.m_pData);
+
+		{
+			scope_lock Lock(&pSelf->m_QueueLock);
+			pSelf->m_QueueStart = (pSelf->m_QueueStart+1)%MAX_QUEUED;
+			pSelf->m_QueueNum--;
+			if(pSelf->m_WaitingForSpace)
+			{
+				pSelf->m_WaitingForSpace = false;
+				pSelf->m_QueueSpace.signal();
+			}
+		}
+
+		if(Item.m_Type == QUEUEITEM_STOP)
+			break;
+	}
+}
+
+void CDemoRecorder::Enqueue(int Type, int Tick, const void *pData, int Size)
+{
+	CQueueItem Item;
+	Item.m_Type = Type;
+	Item.m_Tick = Tick;
+	Item.m_Size = Size;
+	Item.m_pData = 0;
+	if(Size > 0)
+	{
+		Item.m_pData = (char *)mem_alloc(Size);
+		mem_copy(Item.m_pData, pData, Size);
+	}
+
+	bool Stalled = false;
+	int64 StallStart = 0;
+	while(1)
+	{
+		{
+			scope_lock Lock(&m_QueueLock);
+			if(m_QueueNum < MAX_QUEUED)
+			{
+				m_aQueue[(m_QueueStart+m_QueueNum)%MAX_QUEUED] = Item;
+				m_QueueNum++;
+				m_Stats.m_QueuePeak = maximum(m_Stats.m_QueuePeak, m_QueueNum);
+				break;
+			}
+			m_WaitingForSpace = true;
+		}
+
+		// the writer can't keep up, wait for it
+		if(!Stalled)
+		{
+			Stalled = true;
+			StallStart = time_get();
+			m_Stats.m_NumStalls++;
+		}
+		m_QueueSpace.wait();
+	}
+	if(Stalled)
+		m_Stats.m_StallTime += time_get()-StallStart;
+
+	m_QueueItems.signal();
+}
+
 void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
+{
+	if(!m_File)
+		return;
+
+	m_LastTickMarker = Tick;
+	if(m_FirstTick < 0)
+		m_FirstTick = Tick;
+	Enqueue(CHUNKTYPE_SNAPSHOT, Tick, pData, Size);
+}
+
+void CDemoRecorder::RecordMessage(const void *pData, int Size)
+{
+	if(!m_File)
+		return;
+
+	Enqueue(CHUNKTYPE_MESSAGE, 0, pData, Size);
+}
+
+void CDemoRecorder::WriteSnapshot(int Tick, const void *pData, int Size)
 {
 	char aTmpData[CSnapshot::MAX_SIZE];
 
 	if(m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5)
 	{
+		// remember the keyframe for the index
+		CKeyFrame KeyFrame;
+		KeyFrame.m_Filepos = io_tell(m_File);
+		KeyFrame.m_Tick = Tick;
+		m_lKeyFrames.add(KeyFrame);
+
 		// write full tickmarker
 		WriteTickMarker(Tick, 1);
 
@@ -260,7 +398,7 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 		WriteTickMarker(Tick, 0);
 
 		// create delta
-		int DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)pData, &aTmpData);
+		int DeltaSize = m_WriterSnapshotDelta.CreateDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)pData, &aTmpData);
 		if(DeltaSize)
 		{
 			// record delta
@@ -270,9 +408,40 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 	}
 }
 
-void CDemoRecorder::RecordMessage(const void *pData, int Size)
+void CDemoRecorder::WriteKeyFrameIndex()
 {
-	Write(CHUNKTYPE_MESSAGE, pData, Size);
+	const long IndexPos = io_tell(m_File);
+	if(m_lKeyFrames.size() == 0 || IndexPos < 0 || IndexPos > 0x7fffffff)
+		return;
+
+	int aData[INDEX_CHUNK_KEYFRAMES*2];
+	long LastFilepos = 0;
+	int LastTick = 0;
+	for(int Start = 0; Start < m_lKeyFrames.size(); Start += INDEX_CHUNK_KEYFRAMES)
+	{
+		int Num = minimum(m_lKeyFrames.size()-Start, (int)INDEX_CHUNK_KEYFRAMES);
+		for(int i = 0; i < Num; i++)
+		{
+			const CKeyFrame *pKeyFrame = &m_lKeyFrames[Start+i];
+			aData[i*2] = pKeyFrame->m_Tick-LastTick;
+			aData[i*2+1] = (int)(pKeyFrame->m_Filepos-LastFilepos);
+			LastTick = pKeyFrame->m_Tick;
+			LastFilepos = pKeyFrame->m_Filepos;
+		}
+		Write(CHUNKTYPE_INDEX, aData, Num*2*sizeof(int));
+	}
+
+	// the trailer is found by its fixed size from the end of the file. if it
+	// doesn't fit, the player won't find it and falls back to scanning the file
+	int aTrailer[INDEX_TRAILER_INTS] = {gs_IndexMagic, gs_IndexVersion, (int)IndexPos, m_lKeyFrames.size(), m_FirstTick, m_LastTickMarker};
+	const long TrailerPos = io_tell(m_File);
+	Write(CHUNKTYPE_INDEX, aTrailer, sizeof(aTrailer));
+	const long TrailerSize = io_tell(m_File)-TrailerPos;
+	if(TrailerSize < INDEX_TRAILER_SIZE)
+	{
+		static const unsigned char s_aPadding[INDEX_TRAILER_SIZE] = {0};
+		io_write(m_File, s_aPadding, INDEX_TRAILER_SIZE-TrailerSize);
+	}
 }
 
 int CDemoRecorder::Stop()
@@ -283,6 +452,15 @@ int CDemoRecorder::Stop()
 		return -1;
 	}
 
+	// let the writer finish the queue
+	Enqueue(QUEUEITEM_STOP, 0, 0, 0);
+	thread_wait(m_pWriterThread);
+	thread_destroy(m_pWriterThread);
+	m_pWriterThread = 0;
+
+	// add the keyframe index to the end
+	WriteKeyFrameIndex();
+
 	// add the demo length to the header
 	io_seek(m_File, gs_LengthOffset, IOSEEK_START);
 	unsigned char aLength[4];
@@ -307,8 +485,14 @@ int CDemoRecorder::Stop()
 	m_LastTickMarker = -1;
 	m_FirstTick = -1;
 	m_NumTimelineMarkers = 0;
+	m_lKeyFrames.clear();
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "Stopped recording");
 
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "writer queue peak %d/%d, waited %d times for %.2f ms, %d encoding errors",
+		m_Stats.m_QueuePeak, (int)MAX_QUEUED, m_Stats.m_NumStalls, m_Stats.m_StallTime*1000.0f/time_freq(), m_Stats.m_NumErrors);
+	m_pConsole->Print(m_Stats.m_NumStalls || m_Stats.m_NumErrors ? IConsole::OUTPUT_LEVEL_STANDARD : IConsole::OUTPUT_LEVEL_ADDINFO, "demo_recorder", aBuf);
+
 	return 0;
 }
 
@@ -342,6 +526,93 @@ void CDemoRecorder::AddDemoMarker()
 }
 
 
+CDemoSnapshotCache::CDemoSnapshotCache()
+{
+	m_NumEntries = 0;
+	m_UseCounter = 0;
+}
+
+CDemoSnapshotCache::~CDemoSnapshotCache()
+{
+	Clear();
+}
+
+int CDemoSnapshotCache::FindEntry(int Tick) const
+{
+	for(int i = 0; i < m_NumEntries; i++)
+	{
+		if(m_aEntries[i].m_Tick == Tick)
+			return i;
+	}
+	return -1;
+}
+
+void CDemoSnapshotCache::Clear()
+{
+	scope_lock Lock(&m_Lock);
+	for(int i = 0; i < m_NumEntries; i++)
+		mem_free(m_aEntries[i].m_pData);
+	m_NumEntries = 0;
+	m_UseCounter = 0;
+}
+
+bool CDemoSnapshotCache::Contains(int Tick)
+{
+	scope_lock Lock(&m_Lock);
+	return FindEntry(Tick) != -1;
+}
+
+void CDemoSnapshotCache::Add(int Tick, int PreviousTick, int NextTick, long Filepos, const void *pData, int DataSize)
+{
+	scope_lock Lock(&m_Lock);
+	if(FindEntry(Tick) != -1)
+		return;
+
+	// replace the least recently used entry when full
+	CEntry *pEntry;
+	if(m_NumEntries < MAX_ENTRIES)
+		pEntry = &m_aEntries[m_NumEntries++];
+	else
+	{
+		pEntry = &m_aEntries[0];
+		for(int i = 1; i < m_NumEntries; i++)
+		{
+			if(m_aEntries[i].m_LastUse < pEntry->m_LastUse)
+				pEntry = &m_aEntries[i];
+		}
+		mem_free(pEntry->m_pData);
+	}
+
+	pEntry->m_Tick = Tick;
+	pEntry->m_PreviousTick = PreviousTick;
+	pEntry->m_NextTick = NextTick;
+	pEntry->m_Filepos = Filepos;
+	pEntry->m_DataSize = DataSize;
+	pEntry->m_pData = (char *)mem_alloc(DataSize);
+	mem_copy(pEntry->m_pData, pData, DataSize);
+	pEntry->m_LastUse = ++m_UseCounter;
+}
+
+bool CDemoSnapshotCache::Find(int MinTick, int MaxTick, CEntry *pEntry, void *pData)
+{
+	scope_lock Lock(&m_Lock);
+	CEntry *pBest = 0;
+	for(int i = 0; i < m_NumEntries; i++)
+	{
+		if(m_aEntries[i].m_Tick >= MinTick && m_aEntries[i].m_Tick <= MaxTick && (!pBest || m_aEntries[i].m_Tick > pBest->m_Tick))
+			pBest = &m_aEntries[i];
+	}
+	if(!pBest)
+		return false;
+
+	pBest->m_LastUse = ++m_UseCounter;
+	*pEntry = *pBest;
+	pEntry->m_pData = 0;
+	mem_copy(pData, pBest->m_pData, pBest->m_DataSize);
+	return true;
+}
+
+
 const float CDemoPlayer::ms_aSpeeds[] = {0.05f, 0.1f, 0.25f, 0.5f, 0.75f, 1.0f, 2.0f, 4.0f, 8.0f};
 
 CDemoPlayer::CDemoPlayer(class CSnapshotDelta *pSnapshotDelta)
@@ -353,6 +624,13 @@ CDemoPlayer::CDemoPlayer(class CSnapshotDelta *pSnapshotDelta)
 
 	m_pSnapshotDelta = pSnapshotDelta;
 	m_LastSnapshotDataSize = -1;
+	m_UseSnapshotCache = true;
+
+	m_Prefetch.m_File = 0;
+	m_Prefetch.m_Huffman.Init();
+	m_Prefetch.m_pThread = 0;
+	m_Prefetch.m_Request = -1;
+	m_Prefetch.m_Shutdown = false;
 }
 
 void CDemoPlayer::Init(class IConsole *pConsole, class IStorage *pStorage)
@@ -367,14 +645,14 @@ void CDemoPlayer::SetListener(IListener *pListener)
 }
 
 
-int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
+static int ReadChunkHeader(IOHANDLE File, int Version, int *pType, int *pSize, int *pTick)
 {
 	unsigned char Chunk = 0;
 
 	*pSize = 0;
 	*pType = 0;
 
-	if(io_read(m_File, &Chunk, sizeof(Chunk)) != sizeof(Chunk))
+	if(io_read(File, &Chunk, sizeof(Chunk)) != sizeof(Chunk))
 		return -1;
 
 	if(Chunk&CHUNKTYPEFLAG_TICKMARKER)
@@ -383,7 +661,7 @@ int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
 		int Tickdelta_legacy = Chunk&(CHUNKMASK_TICK_LEGACY); // compatibility
 		*pType = Chunk&(CHUNKTYPEFLAG_TICKMARKER|CHUNKTICKFLAG_KEYFRAME);
 
-		if(m_Info.m_Header.m_Version < gs_VersionTickCompression && Tickdelta_legacy != 0)
+		if(Version < gs_VersionTickCompression && Tickdelta_legacy != 0)
 		{
 			*pTick += Tickdelta_legacy;
 		}
@@ -395,7 +673,7 @@ int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
 		else
 		{
 			unsigned char aTickData[4];
-			if(io_read(m_File, aTickData, sizeof(aTickData)) != sizeof(aTickData))
+			if(io_read(File, aTickData, sizeof(aTickData)) != sizeof(aTickData))
 				return -1;
 			*pTick = bytes_be_to_int(aTickData);
 		}
@@ -409,14 +687,14 @@ int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
 		if(*pSize == 30)
 		{
 			unsigned char aSizeData[1];
-			if(io_read(m_File, aSizeData, sizeof(aSizeData)) != sizeof(aSizeData))
+			if(io_read(File, aSizeData, sizeof(aSizeData)) != sizeof(aSizeData))
 				return -1;
 			*pSize = aSizeData[0];
 		}
 		else if(*pSize == 31)
 		{
 			unsigned char aSizeData[2];
-			if(io_read(m_File, aSizeData, sizeof(aSizeData)) != sizeof(aSizeData))
+			if(io_read(File, aSizeData, sizeof(aSizeData)) != sizeof(aSizeData))
 				return -1;
 			*pSize = (aSizeData[1]<<8) | aSizeData[0];
 		}
@@ -425,6 +703,102 @@ int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
 	return 0;
 }
 
+int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
+{
+	return ::ReadChunkHeader(m_File, m_Info.m_Header.m_Version, pType, pSize, pTick);
+}
+
+int CDemoPlayer::ReadIndexChunk(int *pData, int MaxSize)
+{
+	int ChunkType, ChunkSize;
+	int ChunkTick = 0;
+	if(ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick) || ChunkType != CHUNKTYPE_INDEX || ChunkSize <= 0)
+		return -1;
+
+	char aCompressedData[CSnapshot::MAX_SIZE];
+	char aDecompressed[CSnapshot::MAX_SIZE];
+	if(io_read(m_File, aCompressedData, ChunkSize) != (unsigned)ChunkSize)
+		return -1;
+
+	int DataSize = m_Huffman.Decompress(aCompressedData, ChunkSize, aDecompressed, sizeof(aDecompressed));
+	if(DataSize < 0)
+		return -1;
+
+	DataSize = CVariableInt::Decompress(aDecompressed, DataSize, pData, MaxSize);
+	if(DataSize < 0)
+		return -1;
+	return DataSize/sizeof(int);
+}
+
+bool CDemoPlayer::ReadKeyFrameIndex()
+{
+	const long StartPos = io_tell(m_File);
+	io_seek(m_File, 0, IOSEEK_END);
+	const long FileSize = io_tell(m_File);
+
+	// read the trailer
+	int aTrailer[INDEX_TRAILER_SIZE] = {0};
+	int TrailerSize = -1;
+	if(FileSize-StartPos >= INDEX_TRAILER_SIZE)
+	{
+		io_seek(m_File, FileSize-INDEX_TRAILER_SIZE, IOSEEK_START);
+		TrailerSize = ReadIndexChunk(aTrailer, sizeof(aTrailer));
+	}
+	const long IndexPos = aTrailer[2];
+	const int NumKeyFrames = aTrailer[3];
+	if(TrailerSize != INDEX_TRAILER_INTS || aTrailer[0] != gs_IndexMagic || aTrailer[1] != gs_IndexVersion ||
+		IndexPos <= StartPos || IndexPos >= FileSize-INDEX_TRAILER_SIZE || NumKeyFrames <= 0 || aTrailer[4] > aTrailer[5])
+	{
+		io_seek(m_File, StartPos, IOSEEK_START);
+		return false;
+	}
+
+	// read the keyframes
+	CKeyFrame *pKeyFrames = (CKeyFrame*)mem_alloc(NumKeyFrames*sizeof(CKeyFrame));
+	int aData[INDEX_CHUNK_KEYFRAMES*2];
+	int Num = 0;
+	long Filepos = 0;
+	int Tick = 0;
+	bool Valid = true;
+	io_seek(m_File, IndexPos, IOSEEK_START);
+	while(Valid && Num < NumKeyFrames)
+	{
+		int Size = ReadIndexChunk(aData, sizeof(aData));
+		if(Size <= 0 || Size%2 || Num+Size/2 > NumKeyFrames)
+		{
+			Valid = false;
+			break;
+		}
+
+		for(int i = 0; i < Size; i += 2)
+		{
+			Tick += aData[i];
+			Filepos += aData[i+1];
+			if(Filepos < StartPos || Filepos >= IndexPos || (Num > 0 && Tick <= pKeyFrames[Num-1].m_Tick))
+			{
+				Valid = false;
+				break;
+			}
+			pKeyFrames[Num].m_Filepos = Filepos;
+			pKeyFrames[Num].m_Tick = Tick;
+			Num++;
+		}
+	}
+
+	io_seek(m_File, StartPos, IOSEEK_START);
+	if(!Valid)
+	{
+		mem_free(pKeyFrames);
+		return false;
+	}
+
+	m_pKeyFrames = pKeyFrames;
+	m_Info.m_SeekablePoints = NumKeyFrames;
+	m_Info.m_Info.m_FirstTick = aTrailer[4];
+	m_Info.m_Info.m_LastTick = aTrailer[5];
+	return true;
+}
+
 void CDemoPlayer::ScanFile()
 {
 	CHeap Heap;
@@ -481,10 +855,6 @@ void CDemoPlayer::ScanFile()
 
 void CDemoPlayer::DoTick()
 {
-	static char aCompressedData[CSnapshot::MAX_SIZE];
-	static char aDecompressed[CSnapshot::MAX_SIZE];
-	static char aData[CSnapshot::MAX_SIZE];
-	static char aNewSnap[CSnapshot::MAX_SIZE];
 	bool GotSnapshot = false;
 
 	// update ticks
@@ -513,7 +883,7 @@ void CDemoPlayer::DoTick()
 		// read the chunk
 		if(ChunkSize)
 		{
-			if(io_read(m_File, aCompressedData, ChunkSize) != (unsigned)ChunkSize)
+			if(io_read(m_File, m_aCompressedData, ChunkSize) != (unsigned)ChunkSize)
 			{
 				// stop on error or eof
 				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error reading chunk");
@@ -521,7 +891,7 @@ void CDemoPlayer::DoTick()
 				break;
 			}
 
-			DataSize = m_Huffman.Decompress(aCompressedData, ChunkSize, aDecompressed, sizeof(aDecompressed));
+			DataSize = m_Huffman.Decompress(m_aCompressedData, ChunkSize, m_aDecompressed, sizeof(m_aDecompressed));
 			if(DataSize < 0)
 			{
 				// stop on error or eof
@@ -530,7 +900,7 @@ void CDemoPlayer::DoTick()
 				break;
 			}
 
-			DataSize = CVariableInt::Decompress(aDecompressed, DataSize, aData, sizeof(aData));
+			DataSize = CVariableInt::Decompress(m_aDecompressed, DataSize, m_aData, sizeof(m_aData));
 			if(DataSize < 0)
 			{
 				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error during intpack decompression");
@@ -548,14 +918,14 @@ void CDemoPlayer::DoTick()
 			if(m_LastSnapshotDataSize == -1)
 				continue;
 
-			DataSize = m_pSnapshotDelta->UnpackDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)aNewSnap, aData, DataSize);
+			DataSize = m_pSnapshotDelta->UnpackDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)m_aNewSnap, m_aData, DataSize);
 			if(DataSize >= 0)
 			{
 				if(m_pListener)
-					m_pListener->OnDemoPlayerSnapshot(aNewSnap, DataSize);
+					m_pListener->OnDemoPlayerSnapshot(m_aNewSnap, DataSize);
 
 				m_LastSnapshotDataSize = DataSize;
-				mem_copy(m_aLastSnapshotData, aNewSnap, DataSize);
+				mem_copy(m_aLastSnapshotData, m_aNewSnap, DataSize);
 			}
 			else
 			{
@@ -570,17 +940,17 @@ void CDemoPlayer::DoTick()
 			CSnapshotBuilder Builder;
 			GotSnapshot = true;
 
-			if(Builder.UnserializeSnap(aData, DataSize))
-				DataSize = Builder.Finish(aNewSnap);
+			if(Builder.UnserializeSnap(m_aData, DataSize))
+				DataSize = Builder.Finish(m_aNewSnap);
 			else
 				DataSize = -1;
 
 			if(DataSize >= 0)
 			{
 				m_LastSnapshotDataSize = DataSize;
-				mem_copy(m_aLastSnapshotData, aNewSnap, DataSize);
+				mem_copy(m_aLastSnapshotData, m_aNewSnap, DataSize);
 				if(m_pListener)
-					m_pListener->OnDemoPlayerSnapshot(aNewSnap, DataSize);
+					m_pListener->OnDemoPlayerSnapshot(m_aNewSnap, DataSize);
 			}
 			else
 			{
@@ -602,13 +972,137 @@ void CDemoPlayer::DoTick()
 			if(ChunkType&CHUNKTYPEFLAG_TICKMARKER)
 			{
 				m_Info.m_NextTick = ChunkTick;
+
+				// keep the snapshot to continue from when seeking here later
+				const int CurrentTick = m_Info.m_Info.m_CurrentTick;
+				if(m_UseSnapshotCache && CurrentTick >= 0 && CurrentTick%CDemoSnapshotCache::INTERVAL == 0 && m_LastSnapshotDataSize != -1)
+					m_SnapshotCache.Add(CurrentTick, m_Info.m_PreviousTick, ChunkTick, io_tell(m_File), m_aLastSnapshotData, m_LastSnapshotDataSize);
 				break;
 			}
 			else if(ChunkType == CHUNKTYPE_MESSAGE && m_pListener && m_LastSnapshotDataSize != -1)
 			{
-				m_pListener->OnDemoPlayerMessage(aData, DataSize);
+				m_pListener->OnDemoPlayerMessage(m_aData, DataSize);
+			}
+		}
+	}
+}
+
+void CDemoPlayer::PrefetchThread(void *pUser)
+{
+	CDemoPlayer *pThis = (CDemoPlayer *)pUser;
+	CPrefetch *pPrefetch = &pThis->m_Prefetch;
+
+	while(1)
+	{
+		pPrefetch->m_Activity.wait();
+		if(pPrefetch->m_Shutdown)
+			break;
+
+		int Keyframe;
+		{
+			scope_lock Lock(&pPrefetch->m_Lock);
+			Keyframe = pPrefetch->m_Request;
+			pPrefetch->m_Request = -1;
+		}
+		if(Keyframe >= 0)
+			pThis->DoPrefetch(Keyframe);
+	}
+}
+
+void CDemoPlayer::DoPrefetch(int Keyframe)
+{
+	// decode this keyframe window and the next one, like DoTick does
+	CPrefetch *pPrefetch = &m_Prefetch;
+	const int EndKeyframe = Keyframe+2;
+	const int EndTick = EndKeyframe < m_Info.m_SeekablePoints ? m_pKeyFrames[EndKeyframe].m_Tick : m_Info.m_Info.m_LastTick+1;
+	io_seek(pPrefetch->m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
+
+	int ChunkTick = 0;
+	int PreviousTick = -1;
+	int CurrentTick = -1;
+	int LastSnapshotDataSize = -1;
+
+	// stop early when there is a newer request
+	while(!pPrefetch->m_Shutdown && pPrefetch->m_Request == -1)
+	{
+		int ChunkType, ChunkSize;
+		if(::ReadChunkHeader(pPrefetch->m_File, m_Info.m_Header.m_Version, &ChunkType, &ChunkSize, &ChunkTick))
+			break;
+
+		if(ChunkType&CHUNKTYPEFLAG_TICKMARKER)
+		{
+			if(CurrentTick >= 0 && CurrentTick%CDemoSnapshotCache::INTERVAL == 0 && LastSnapshotDataSize != -1)
+				m_SnapshotCache.Add(CurrentTick, PreviousTick, ChunkTick, io_tell(pPrefetch->m_File), pPrefetch->m_aLastSnapshot, LastSnapshotDataSize);
+
+			PreviousTick = CurrentTick;
+			CurrentTick = ChunkTick;
+			if(CurrentTick >= EndTick)
+				break;
+			continue;
+		}
+
+		int DataSize = 0;
+		if(ChunkSize)
+		{
+			if(io_read(pPrefetch->m_File, pPrefetch->m_aCompressedData, ChunkSize) != (unsigned)ChunkSize)
+				break;
+			DataSize = pPrefetch->m_Huffman.Decompress(pPrefetch->m_aCompressedData, ChunkSize, pPrefetch->m_aDecompressed, sizeof(pPrefetch->m_aDecompressed));
+			if(DataSize < 0)
+				break;
+			DataSize = CVariableInt::Decompress(pPrefetch->m_aDecompressed, DataSize, pPrefetch->m_aData, sizeof(pPrefetch->m_aData));
+			if(DataSize < 0)
+				break;
+		}
+
+		if(ChunkType == CHUNKTYPE_DELTA)
+		{
+			if(LastSnapshotDataSize == -1)
+				continue;
+
+			DataSize = pPrefetch->m_SnapshotDelta.UnpackDelta((CSnapshot*)pPrefetch->m_aLastSnapshot, (CSnapshot*)pPrefetch->m_aNewSnapshot, pPrefetch->m_aData, DataSize);
+			if(DataSize >= 0)
+			{
+				LastSnapshotDataSize = DataSize;
+				mem_copy(pPrefetch->m_aLastSnapshot, pPrefetch->m_aNewSnapshot, DataSize);
 			}
 		}
+		else if(ChunkType == CHUNKTYPE_SNAPSHOT)
+		{
+			CSnapshotBuilder Builder;
+			if(Builder.UnserializeSnap(pPrefetch->m_aData, DataSize))
+				LastSnapshotDataSize = Builder.Finish(pPrefetch->m_aLastSnapshot);
+		}
+	}
+}
+
+void CDemoPlayer::StartPrefetch(int Keyframe)
+{
+	if(!m_Prefetch.m_pThread)
+		return;
+
+	{
+		scope_lock Lock(&m_Prefetch.m_Lock);
+		m_Prefetch.m_Request = Keyframe;
+	}
+	m_Prefetch.m_Activity.signal();
+}
+
+void CDemoPlayer::StopPrefetchThread()
+{
+	if(m_Prefetch.m_pThread)
+	{
+		m_Prefetch.m_Shutdown = true;
+		m_Prefetch.m_Activity.signal();
+		thread_wait(m_Prefetch.m_pThread);
+		thread_destroy(m_Prefetch.m_pThread);
+		m_Prefetch.m_pThread = 0;
+		m_Prefetch.m_Shutdown = false;
+		m_Prefetch.m_Request = -1;
+	}
+	if(m_Prefetch.m_File)
+	{
+		io_close(m_Prefetch.m_File);
+		m_Prefetch.m_File = 0;
 	}
 }
 
@@ -706,10 +1200,19 @@ const char *CDemoPlayer::Load(const char *pFilename, int StorageType, const char
 		unsigned char *pMapData = (unsigned char *)mem_alloc(MapSize);
 		io_read(m_File, pMapData, MapSize);
 
-		// save map
-		MapFile = m_pStorage->OpenFile(aMapFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
-		io_write(MapFile, pMapData, MapSize);
-		io_close(MapFile);
+		// save map under a name of its own and move it in place when
+		// complete, other players may extract the same map at the same time
+		static volatile unsigned s_NumExtracted = 0;
+		char aTempFilename[160];
+		str_format(aTempFilename, sizeof(aTempFilename), "%s.%d.%u.tmp", aMapFilename, pid(), atomic_inc(&s_NumExtracted));
+		MapFile = m_pStorage->OpenFile(aTempFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		if(MapFile)
+		{
+			bool Written = io_write(MapFile, pMapData, MapSize) == MapSize;
+			io_close(MapFile);
+			if(!Written || !m_pStorage->RenameFile(aTempFilename, aMapFilename, IStorage::TYPE_SAVE))
+				m_pStorage->RemoveFile(aTempFilename, IStorage::TYPE_SAVE);
+		}
 
 		// free data
 		mem_free(pMapData);
@@ -720,8 +1223,18 @@ const char *CDemoPlayer::Load(const char *pFilename, int StorageType, const char
 	for(int i = 0; i < m_Info.m_Info.m_NumTimelineMarkers; i++)
 		m_Info.m_Info.m_aTimelineMarkers[i] = bytes_be_to_int(m_Info.m_Header.m_aTimelineMarkers[i]);
 
-	// scan the file for interesting points
-	ScanFile();
+	// use the keyframe index if the demo has one, otherwise scan the file for interesting points
+	if(!ReadKeyFrameIndex())
+		ScanFile();
+
+	// start the prefetching with its own file handle
+	m_SnapshotCache.Clear();
+	m_Prefetch.m_File = m_pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType);
+	if(m_UseSnapshotCache && m_Prefetch.m_File && m_Info.m_SeekablePoints > 0)
+	{
+		m_Prefetch.m_SnapshotDelta = *m_pSnapshotDelta;
+		m_Prefetch.m_pThread = thread_init(PrefetchThread, this);
+	}
 
 	// ready for playback
 	return 0;
@@ -762,12 +1275,28 @@ int CDemoPlayer::SetPos(int WantedTick)
 	while(Keyframe > 0 && m_pKeyFrames[Keyframe].m_Tick > KeyframeWantedTick)
 		Keyframe--;
 
-	// seek to the correct keyframe
-	io_seek(m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
+	CDemoSnapshotCache::CEntry Entry;
+	if(m_SnapshotCache.Find(m_pKeyFrames[Keyframe].m_Tick, KeyframeWantedTick, &Entry, m_aLastSnapshotData))
+	{
+		// continue from a cached snapshot closer to the wanted tick
+		io_seek(m_File, Entry.m_Filepos, IOSEEK_START);
+		m_LastSnapshotDataSize = Entry.m_DataSize;
+		m_Info.m_NextTick = Entry.m_NextTick;
+		m_Info.m_Info.m_CurrentTick = Entry.m_Tick;
+		m_Info.m_PreviousTick = Entry.m_PreviousTick;
+	}
+	else
+	{
+		// seek to the correct keyframe
+		io_seek(m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
 
-	m_Info.m_NextTick = -1;
-	m_Info.m_Info.m_CurrentTick = -1;
-	m_Info.m_PreviousTick = -1;
+		m_Info.m_NextTick = -1;
+		m_Info.m_Info.m_CurrentTick = -1;
+		m_Info.m_PreviousTick = -1;
+	}
+
+	// get the surroundings ready for scrubbing
+	StartPrefetch(Keyframe);
 
 	// playback everything until we hit our tick
 	while(m_Info.m_NextTick < WantedTick)
@@ -836,12 +1365,25 @@ int CDemoPlayer::Update()
 	return 0;
 }
 
+// plays the next tick right away instead of following the clock like
+// Update, returns -1 once the end of the demo is reached
+int CDemoPlayer::NextTick()
+{
+	if(!IsPlaying() || m_Info.m_Info.m_Paused)
+		return -1;
+
+	DoTick();
+	return IsPlaying() && !m_Info.m_Info.m_Paused ? 0 : -1;
+}
+
 int CDemoPlayer::Stop()
 {
 	if(!m_File)
 		return -1;
 
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_player", "Stopped playback");
+	StopPrefetchThread();
+	m_SnapshotCache.Clear();
 	io_close(m_File);
 	m_File = 0;
 	mem_free(m_pKeyFrames);
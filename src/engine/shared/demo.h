@@ -3,6 +3,9 @@
 #ifndef ENGINE_SHARED_DEMO_H
 #define ENGINE_SHARED_DEMO_H
 
+#include <base/tl/array.h>
+#include <base/tl/threading.h>
+
 #include <engine/demo.h>
 #include <engine/shared/protocol.h>
 
@@ -11,20 +14,71 @@
 
 class CDemoRecorder : public IDemoRecorder
 {
+public:
+	// how well the writer thread keeps up with the recording
+	struct CStats
+	{
+		int m_QueuePeak;
+		int m_NumStalls;
+		int64 m_StallTime;
+		int m_NumErrors;
+	};
+
+private:
+	enum
+	{
+		MAX_QUEUED=256,
+	};
+
+	struct CKeyFrame
+	{
+		long m_Filepos;
+		int m_Tick;
+	};
+
+	struct CQueueItem
+	{
+		int m_Type;
+		int m_Tick;
+		int m_Size;
+		char *m_pData;
+	};
+
 	class IConsole *m_pConsole;
 	class IStorage *m_pStorage;
-	CHuffman m_Huffman;
 	IOHANDLE m_File;
 	int m_LastTickMarker;
-	int m_LastKeyFrame;
 	int m_FirstTick;
-	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
 	class CSnapshotDelta *m_pSnapshotDelta;
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
 
+	// snapshots and messages are encoded and written by the writer thread,
+	// the queue is bounded and recording waits when it is full
+	CQueueItem m_aQueue[MAX_QUEUED];
+	int m_QueueStart;
+	int m_QueueNum;
+	bool m_WaitingForSpace;
+	lock m_QueueLock;
+	semaphore m_QueueItems;
+	semaphore m_QueueSpace;
+	void *m_pWriterThread;
+	CStats m_Stats;
+
+	// owned by the writer thread while recording
+	CHuffman m_Huffman;
+	CSnapshotDelta m_WriterSnapshotDelta;
+	int m_LastWrittenTick;
+	int m_LastKeyFrame;
+	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
+	array<CKeyFrame> m_lKeyFrames;
+
+	static void WriterThread(void *pUser);
+	void Enqueue(int Type, int Tick, const void *pData, int Size);
+	void WriteSnapshot(int Tick, const void *pData, int Size);
 	void WriteTickMarker(int Tick, int Keyframe);
 	void Write(int Type, const void *pData, int Size);
+	void WriteKeyFrameIndex();
 public:
 	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta);
 	void Init(class IConsole *pConsole, class IStorage *pStorage);
@@ -39,6 +93,50 @@ public:
 	bool IsRecording() const { return m_File != 0; }
 
 	int Length() const { return (m_LastTickMarker - m_FirstTick)/SERVER_TICK_SPEED; }
+	const CStats *Stats() const { return &m_Stats; }
+};
+
+// snapshots reconstructed during playback at regular ticks, together with
+// the state needed to continue the playback from there
+class CDemoSnapshotCache
+{
+public:
+	enum
+	{
+		INTERVAL=25,
+		MAX_ENTRIES=512,
+	};
+
+	struct CEntry
+	{
+		int m_Tick;
+		int m_PreviousTick;
+		int m_NextTick;
+		long m_Filepos;
+		int m_DataSize;
+		char *m_pData;
+		unsigned m_LastUse;
+	};
+
+private:
+	lock m_Lock;
+	CEntry m_aEntries[MAX_ENTRIES];
+	int m_NumEntries;
+	unsigned m_UseCounter;
+
+	int FindEntry(int Tick) const;
+
+public:
+	CDemoSnapshotCache();
+	~CDemoSnapshotCache();
+
+	void Clear();
+	bool Contains(int Tick);
+	void Add(int Tick, int PreviousTick, int NextTick, long Filepos, const void *pData, int DataSize);
+
+	// newest snapshot between the ticks, the data is copied to pData
+	bool Find(int MinTick, int MaxTick, CEntry *pEntry, void *pData);
+	int NumEntries() const { return m_NumEntries; }
 };
 
 class CDemoPlayer : public IDemoPlayer
@@ -102,9 +200,43 @@ private:
 	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
 	int m_LastSnapshotDataSize;
 	class CSnapshotDelta *m_pSnapshotDelta;
+	CDemoSnapshotCache m_SnapshotCache;
+	bool m_UseSnapshotCache;
+
+	// chunk buffers, several players can run at the same time
+	char m_aCompressedData[CSnapshot::MAX_SIZE];
+	char m_aDecompressed[CSnapshot::MAX_SIZE];
+	char m_aData[CSnapshot::MAX_SIZE];
+	char m_aNewSnap[CSnapshot::MAX_SIZE];
+
+	// decodes the keyframe windows around the last seek in the background
+	struct CPrefetch
+	{
+		IOHANDLE m_File;
+		CHuffman m_Huffman;
+		CSnapshotDelta m_SnapshotDelta;
+		void *m_pThread;
+		semaphore m_Activity;
+		lock m_Lock;
+		volatile int m_Request;
+		volatile bool m_Shutdown;
+		char m_aCompressedData[CSnapshot::MAX_SIZE];
+		char m_aDecompressed[CSnapshot::MAX_SIZE];
+		char m_aData[CSnapshot::MAX_SIZE];
+		char m_aLastSnapshot[CSnapshot::MAX_SIZE];
+		char m_aNewSnapshot[CSnapshot::MAX_SIZE];
+	};
+	CPrefetch m_Prefetch;
+
+	static void PrefetchThread(void *pUser);
+	void DoPrefetch(int Keyframe);
+	void StartPrefetch(int Keyframe);
+	void StopPrefetchThread();
 
 	int ReadChunkHeader(int *pType, int *pSize, int *pTick);
+	int ReadIndexChunk(int *pData, int MaxSize);
 	void DoTick();
+	bool ReadKeyFrameIndex();
 	void ScanFile();
 
 public:
@@ -112,6 +244,7 @@ public:
 	CDemoPlayer(class CSnapshotDelta *pSnapshotDelta);
 	void Init(class IConsole *pConsole, class IStorage *pStorage);
 	void SetListener(IListener *pListener);
+	void EnableSnapshotCache(bool Enable) { m_UseSnapshotCache = Enable; }
 
 	const char *Load(const char *pFilename, int StorageType, const char *pNetversion);
 	int Play();
@@ -128,8 +261,10 @@ public:
 	int GetDemoType() const;
 
 	int Update();
+	int NextTick();
 
 	const CPlaybackInfo *Info() const { return &m_Info; }
+	const CDemoSnapshotCache *SnapshotCache() const { return &m_SnapshotCache; }
 	int IsPlaying() const { return m_File != 0; }
 };
 
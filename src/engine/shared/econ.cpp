@@ -1,5 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+
 #include <engine/console.h>
 #include <engine/shared/config.h>
 
@@ -20,6 +22,8 @@ int CEcon::NewClientCallback(int ClientID, void *pUser)
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_CONNECTED;
 	pThis->m_aClients[ClientID].m_TimeConnected = time_get();
 	pThis->m_aClients[ClientID].m_AuthTries = 0;
+	pThis->m_aClients[ClientID].m_OutputLevel = pThis->m_pConfig->m_EcOutputLevel;
+	pThis->m_aClients[ClientID].m_aSystems[0] = 0;
 
 	pThis->m_NetConsole.Send(ClientID, "Enter password:");
 	return 0;
@@ -36,12 +40,49 @@ int CEcon::DelClientCallback(int ClientID, const char *pReason, void *pUser)
 	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "econ", aBuf);
 
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_EMPTY;
+	pThis->UpdatePrintOutputLevel();
 	return 0;
 }
 
-void CEcon::SendLineCB(const char *pLine, void *pUserData, bool Highlighted)
+bool CEcon::IsSubscribed(int ClientID, int Level, const char *pFrom) const
+{
+	const CClient *pClient = &m_aClients[ClientID];
+	if(pClient->m_State != CClient::STATE_AUTHED || Level > pClient->m_OutputLevel)
+		return false;
+	if(!pClient->m_aSystems[0])
+		return true;
+
+	// whole words of the system list only
+	const int FromLength = str_length(pFrom);
+	for(const char *pSystem = pClient->m_aSystems; (pSystem = str_find(pSystem, pFrom)); pSystem += FromLength)
+	{
+		if((pSystem == pClient->m_aSystems || pSystem[-1] == ' ') && (pSystem[FromLength] == 0 || pSystem[FromLength] == ' '))
+			return true;
+	}
+	return false;
+}
+
+void CEcon::UpdatePrintOutputLevel()
+{
+	// the console only has to format lines that somebody wants
+	int OutputLevel = IConsole::OUTPUT_LEVEL_STANDARD;
+	for(int i = 0; i < m_NetConsole.MaxClients(); i++)
+	{
+		if(m_aClients[i].m_State == CClient::STATE_AUTHED)
+			OutputLevel = maximum(OutputLevel, m_aClients[i].m_OutputLevel);
+	}
+	Console()->SetPrintOutputLevel(m_PrintCBIndex, OutputLevel);
+}
+
+void CEcon::SendLineCB(const char *pLine, void *pUserData, int Level, const char *pFrom, bool Highlighted)
 {
-	static_cast<CEcon *>(pUserData)->Send(-1, pLine);
+	CEcon *pThis = static_cast<CEcon *>(pUserData);
+	for(int i = 0; i < pThis->m_NetConsole.MaxClients(); i++)
+	{
+		// the issuer of a command always gets its output
+		if(i == pThis->m_UserClientID ? pThis->m_aClients[i].m_State == CClient::STATE_AUTHED : pThis->IsSubscribed(i, Level, pFrom))
+			pThis->m_NetConsole.Send(i, pLine);
+	}
 }
 
 void CEcon::ConchainEconOutputLevelUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
@@ -50,7 +91,9 @@ void CEcon::ConchainEconOutputLevelUpdate(IConsole::IResult *pResult, void *pUse
 	if(pResult->NumArguments() == 1)
 	{
 		CEcon *pThis = static_cast<CEcon *>(pUserData);
-		pThis->Console()->SetPrintOutputLevel(pThis->m_PrintCBIndex, pResult->GetInteger(0));
+		for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
+			pThis->m_aClients[i].m_OutputLevel = pThis->m_pConfig->m_EcOutputLevel;
+		pThis->UpdatePrintOutputLevel();
 	}
 }
 
@@ -64,6 +107,16 @@ void CEcon::ConchainEconLingerUpdate(IConsole::IResult *pResult, void *pUserData
 	}
 }
 
+void CEcon::ConchainEconMaxClientsPerIPUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments() == 1)
+	{
+		CEcon *pThis = static_cast<CEcon *>(pUserData);
+		pThis->m_NetConsole.SetMaxClientsPerIP(pThis->m_pConfig->m_EcMaxClientsPerIP);
+	}
+}
+
 void CEcon::ConLogout(IConsole::IResult *pResult, void *pUserData)
 {
 	CEcon *pThis = static_cast<CEcon *>(pUserData);
@@ -72,11 +125,53 @@ void CEcon::ConLogout(IConsole::IResult *pResult, void *pUserData)
 		pThis->m_NetConsole.Drop(pThis->m_UserClientID, "Logout");
 }
 
-void CEcon::Init(CConfig *pConfig, IConsole *pConsole, CNetBan *pNetBan)
+void CEcon::ConSubscribe(IConsole::IResult *pResult, void *pUserData)
+{
+	CEcon *pThis = static_cast<CEcon *>(pUserData);
+	if(pThis->m_UserClientID < 0 || pThis->m_UserClientID >= NET_MAX_CONSOLE_CLIENTS)
+		return;
+
+	CClient *pClient = &pThis->m_aClients[pThis->m_UserClientID];
+	pClient->m_OutputLevel = clamp(pResult->GetInteger(0), (int)IConsole::OUTPUT_LEVEL_STANDARD, (int)IConsole::OUTPUT_LEVEL_DEBUG);
+	str_copy(pClient->m_aSystems, pResult->NumArguments() > 1 ? pResult->GetString(1) : "", sizeof(pClient->m_aSystems));
+	pThis->UpdatePrintOutputLevel();
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "subscribed to level %d of %s", pClient->m_OutputLevel, pClient->m_aSystems[0] ? pClient->m_aSystems : "all systems");
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "econ", aBuf);
+}
+
+void CEcon::ConUnsubscribe(IConsole::IResult *pResult, void *pUserData)
+{
+	CEcon *pThis = static_cast<CEcon *>(pUserData);
+	if(pThis->m_UserClientID < 0 || pThis->m_UserClientID >= NET_MAX_CONSOLE_CLIENTS)
+		return;
+
+	// command output still gets through
+	pThis->m_aClients[pThis->m_UserClientID].m_OutputLevel = -1;
+	pThis->UpdatePrintOutputLevel();
+}
+
+void CEcon::ConMetrics(IConsole::IResult *pResult, void *pUserData)
+{
+	CEcon *pThis = static_cast<CEcon *>(pUserData);
+	if(pThis->m_UserClientID >= 0 && pThis->m_UserClientID < NET_MAX_CONSOLE_CLIENTS)
+		pThis->m_pMetrics->Export(SendMetricsLine, pThis);
+}
+
+void CEcon::SendMetricsLine(const char *pLine, void *pUserData)
+{
+	// only to the client that asked, without log line formatting
+	CEcon *pThis = static_cast<CEcon *>(pUserData);
+	pThis->m_NetConsole.Send(pThis->m_UserClientID, pLine);
+}
+
+void CEcon::Init(CConfig *pConfig, IConsole *pConsole, CNetBan *pNetBan, IMetrics *pMetrics)
 {
 	m_pConfig = pConfig;
 	m_pConsole = pConsole;
 	m_pNetBan = pNetBan;
+	m_pMetrics = pMetrics;
 
 	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
 		m_aClients[i].m_State = CClient::STATE_EMPTY;
@@ -89,6 +184,7 @@ void CEcon::SetDefaultValues()
 	m_Ready = false;
 	m_LastOpenTry = 0;
 	m_UserClientID = -1;
+	m_LastAuthTimeoutCheck = 0;
 }
 
 bool CEcon::Open()
@@ -114,19 +210,25 @@ bool CEcon::Open()
 		BindAddr.port = m_pConfig->m_EcPort;
 	}
 
-	if(m_NetConsole.Open(BindAddr, m_pNetBan, NewClientCallback, DelClientCallback, this))
+	if(m_NetConsole.Open(BindAddr, m_pNetBan, m_pConfig->m_EcMaxClients, NewClientCallback, DelClientCallback, this))
 	{
 		m_Ready = true;
 		char aBuf[128];
 		str_format(aBuf, sizeof(aBuf), "bound to %s:%d", m_pConfig->m_EcBindaddr, m_pConfig->m_EcPort);
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD,"econ", aBuf);
 		m_NetConsole.SetLingerState(m_pConfig->m_NetTcpAbortOnClose);
+		m_NetConsole.SetMaxClientsPerIP(m_pConfig->m_EcMaxClientsPerIP);
 
 		Console()->Chain("ec_output_level", ConchainEconOutputLevelUpdate, this);
 		Console()->Chain("net_tcp_abort_on_close", ConchainEconLingerUpdate, this);
+		Console()->Chain("ec_max_clients_per_ip", ConchainEconMaxClientsPerIPUpdate, this);
 		m_PrintCBIndex = Console()->RegisterPrintCallback(m_pConfig->m_EcOutputLevel, SendLineCB, this);
 
 		Console()->Register("logout", "", CFGFLAG_ECON, ConLogout, this, "Logout of econ");
+		Console()->Register("subscribe", "i[level] ?r[systems]", CFGFLAG_ECON, ConSubscribe, this, "Receive the log lines up to a level, of the given systems only if any");
+		Console()->Register("unsubscribe", "", CFGFLAG_ECON, ConUnsubscribe, this, "Stop receiving log lines");
+		if(m_pMetrics)
+			Console()->Register("metrics", "", CFGFLAG_ECON, ConMetrics, this, "Export the metrics in the Prometheus text format, ending with '# EOF'");
 		return true;
 	}
 	else
@@ -155,6 +257,7 @@ void CEcon::Update()
 			{
 				m_aClients[ClientID].m_State = CClient::STATE_AUTHED;
 				m_NetConsole.Send(ClientID, "Authentication successful. External console access granted.");
+				UpdatePrintOutputLevel();
 
 				char aAddrStr[NETADDR_MAXSTRSIZE];
 				net_addr_str(m_NetConsole.ClientAddr(ClientID), aAddrStr, sizeof(aAddrStr), true);
@@ -186,10 +289,14 @@ void CEcon::Update()
 		}
 	}
 
-	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; ++i)
+	int64 Now = time_get();
+	if(Now < m_LastAuthTimeoutCheck + time_freq())
+		return;
+	m_LastAuthTimeoutCheck = Now;
+	for(int i = 0; i < m_NetConsole.MaxClients(); ++i)
 	{
 		if(m_aClients[i].m_State == CClient::STATE_CONNECTED &&
-			time_get() > m_aClients[i].m_TimeConnected + m_pConfig->m_EcAuthTimeout * time_freq())
+			Now > m_aClients[i].m_TimeConnected + m_pConfig->m_EcAuthTimeout * time_freq())
 			m_NetConsole.Drop(i, "authentication timeout");
 	}
 }
@@ -201,7 +308,7 @@ void CEcon::Send(int ClientID, const char *pLine)
 
 	if(ClientID == -1)
 	{
-		for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
+		for(int i = 0; i < m_NetConsole.MaxClients(); i++)
 		{
 			if(m_aClients[i].m_State == CClient::STATE_AUTHED)
 				m_NetConsole.Send(i, pLine);
@@ -3,6 +3,8 @@
 #ifndef ENGINE_SHARED_ECON_H
 #define ENGINE_SHARED_ECON_H
 
+#include <engine/metrics.h>
+
 #include "network.h"
 
 
@@ -26,25 +28,38 @@ class CEcon
 		int m_State;
 		int64 m_TimeConnected;
 		int m_AuthTries;
+
+		// subscription, an empty system list means all of them
+		int m_OutputLevel;
+		char m_aSystems[128];
 	};
 	CClient m_aClients[NET_MAX_CONSOLE_CLIENTS];
 
 	CConfig *m_pConfig;
 	IConsole *m_pConsole;
 	CNetBan *m_pNetBan;
+	IMetrics *m_pMetrics;
 	CNetConsole m_NetConsole;
 
 	bool m_Ready;
 	int64 m_LastOpenTry;
 	int m_PrintCBIndex;
 	int m_UserClientID;
+	int64 m_LastAuthTimeoutCheck;
 
 	void SetDefaultValues();
+	void UpdatePrintOutputLevel();
+	bool IsSubscribed(int ClientID, int Level, const char *pFrom) const;
 
-	static void SendLineCB(const char *pLine, void *pUserData, bool Highlighted);
+	static void SendLineCB(const char *pLine, void *pUserData, int Level, const char *pFrom, bool Highlighted);
 	static void ConchainEconOutputLevelUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainEconLingerUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainEconMaxClientsPerIPUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConLogout(IConsole::IResult *pResult, void *pUserData);
+	static void ConSubscribe(IConsole::IResult *pResult, void *pUserData);
+	static void ConUnsubscribe(IConsole::IResult *pResult, void *pUserData);
+	static void ConMetrics(IConsole::IResult *pResult, void *pUserData);
+	static void SendMetricsLine(const char *pLine, void *pUserData);
 
 	static int NewClientCallback(int ClientID, void *pUser);
 	static int DelClientCallback(int ClientID, const char *pReason, void *pUser);
@@ -52,7 +67,7 @@ class CEcon
 public:
 	IConsole *Console() { return m_pConsole; }
 
-	void Init(CConfig *pConfig, IConsole *pConsole, class CNetBan *pNetBan);
+	void Init(CConfig *pConfig, IConsole *pConsole, class CNetBan *pNetBan, IMetrics *pMetrics = 0);
 	bool Open();
 	void Update();
 	void Send(int ClientID, const char *pLine);
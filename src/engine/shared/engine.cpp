@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <stdlib.h> // srand
 
+#include <base/math.h>
 #include <base/system.h>
 
 #include <engine/console.h>
@@ -53,6 +54,7 @@ public:
 		srand(time_get());
 		dbg_logger_stdout();
 		dbg_logger_debugger();
+		dbg_logger_async_start();
 
 		//
 		dbg_msg("engine", "running on %s-%s-%s", CONF_FAMILY_STRING, CONF_PLATFORM_STRING, CONF_ARCH_STRING);
@@ -64,7 +66,8 @@ public:
 		dbg_msg("engine", "unknown endian");
 	#endif
 
-		m_JobPool.Init(1);
+		// the main thread helps out while waiting on its jobs
+		m_JobPool.Init(maximum(cpu_count()-1, 1));
 
 		m_DataLogSent = 0;
 		m_DataLogRecv = 0;
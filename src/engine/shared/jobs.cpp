@@ -1,21 +1,101 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 #include "jobs.h"
 
+#if defined(CONF_FAMILY_WINDOWS) && !defined(__GNUC__)
+	#define JOBS_THREAD_LOCAL __declspec(thread)
+#else
+	#define JOBS_THREAD_LOCAL __thread
+#endif
+
+// the worker running on this thread, if any
+static JOBS_THREAD_LOCAL void *s_pCurrentWorker = 0;
+
+int CJob::Status() const
+{
+	return atomic_load(&m_Status);
+}
+
+bool CJobGroup::Done() const
+{
+	return atomic_load(&m_Pending) == 0;
+}
+
+// the deque is the one by Chase and Lev with a fixed size. only the
+// owner pushes and pops at the bottom, so it only has to race with
+// thieves for the last job
+bool CJobPool::CWorker::Push(CJob *pJob)
+{
+	unsigned Bottom = m_Bottom;
+	unsigned Top = m_Top;
+	if(Bottom-Top >= (unsigned)DEQUE_SIZE)
+		return false;
+	m_apJobs[Bottom&(DEQUE_SIZE-1)] = pJob;
+	sync_barrier();
+	m_Bottom = Bottom+1;
+	return true;
+}
+
+CJob *CJobPool::CWorker::Pop()
+{
+	unsigned Bottom = m_Bottom-1;
+	m_Bottom = Bottom;
+	sync_barrier();
+	unsigned Top = m_Top;
+	if((int)(Bottom-Top) < 0)
+	{
+		m_Bottom = Top;
+		return 0;
+	}
+
+	CJob *pJob = m_apJobs[Bottom&(DEQUE_SIZE-1)];
+	if(Bottom != Top)
+		return pJob;
+
+	// last one, whoever moves the top gets it
+	if(atomic_compswap(&m_Top, Top, Top+1) != Top)
+		pJob = 0;
+	m_Bottom = Top+1;
+	return pJob;
+}
+
+CJob *CJobPool::CWorker::Steal()
+{
+	while(1)
+	{
+		unsigned Top = m_Top;
+		sync_barrier();
+		unsigned Bottom = m_Bottom;
+		if((int)(Bottom-Top) <= 0)
+			return 0;
+
+		CJob *pJob = m_apJobs[Top&(DEQUE_SIZE-1)];
+		if(atomic_compswap(&m_Top, Top, Top+1) == Top)
+			return pJob;
+	}
+}
+
 CJobPool::CJobPool()
 {
 	// empty the pool
 	m_NumThreads = 0;
+	m_pWorkers = 0;
 	m_Shutdown = false;
 	m_Lock = lock_create();
 	m_pFirstJob = 0;
 	m_pLastJob = 0;
+	sphore_init(&m_Semaphore);
+	m_NumSleeping = 0;
 }
 
 CJobPool::~CJobPool()
 {
 	Shutdown();
+	sphore_destroy(&m_Semaphore);
+	lock_destroy(m_Lock);
 }
 
 void CJobPool::Shutdown()
@@ -23,75 +103,286 @@ void CJobPool::Shutdown()
 	if(m_Shutdown)
 		return;
 
+	// stop the workers, new jobs are refused from here on
 	m_Shutdown = true;
+	sync_barrier();
+	for(int i = 0; i < m_NumThreads; i++)
+		sphore_signal(&m_Semaphore);
 	for(int i = 0; i < m_NumThreads; i++)
 	{
-		thread_wait(m_apThreads[i]);
-		thread_destroy(m_apThreads[i]);
+		thread_wait(m_pWorkers[i].m_pThread);
+		thread_destroy(m_pWorkers[i].m_pThread);
 	}
-	lock_destroy(m_Lock);
+
+	// run what is still queued here, so every group finishes
+	const int NumThreads = m_NumThreads;
+	m_NumThreads = 0;
+	int NumRun = 0;
+	CJob *pJob;
+	while((pJob = FindJob(0)))
+	{
+		RunJob(pJob);
+		NumRun++;
+	}
+	for(int i = 0; i < NumThreads; i++)
+	{
+		while((pJob = m_pWorkers[i].Steal()))
+		{
+			RunJob(pJob);
+			NumRun++;
+		}
+	}
+	if(NumRun)
+		dbg_msg("jobs", "ran %d queued jobs on shutdown", NumRun);
+
+	delete[] m_pWorkers;
+	m_pWorkers = 0;
 }
 
-void CJobPool::WorkerThread(void *pUser)
+CJobPool::CWorker *CJobPool::CurrentWorker() const
 {
-	CJobPool *pPool = (CJobPool *)pUser;
+	CWorker *pWorker = (CWorker *)s_pCurrentWorker;
+	return pWorker && pWorker->m_pPool == this ? pWorker : 0;
+}
 
-	while(!pPool->m_Shutdown)
-	{
-		CJob *pJob = 0;
+CJob *CJobPool::FindJob(CWorker *pWorker)
+{
+	CJob *pJob = 0;
 
-		// fetch job from queue
-		lock_wait(pPool->m_Lock);
-		if(pPool->m_pFirstJob)
+	// own jobs first, they are the most likely to be in the cache
+	if(pWorker && (pJob = pWorker->Pop()))
+		return pJob;
+
+	// fetch job from queue
+	if(m_pFirstJob)
+	{
+		lock_wait(m_Lock);
+		if(m_pFirstJob)
 		{
-			pJob = pPool->m_pFirstJob;
-			pPool->m_pFirstJob = pPool->m_pFirstJob->m_pNext;
-			if(pPool->m_pFirstJob)
-				pPool->m_pFirstJob->m_pPrev = 0;
+			pJob = m_pFirstJob;
+			m_pFirstJob = pJob->m_pNext;
+			if(m_pFirstJob)
+				m_pFirstJob->m_pPrev = 0;
 			else
-				pPool->m_pLastJob = 0;
+				m_pLastJob = 0;
 		}
-		lock_unlock(pPool->m_Lock);
+		lock_unlock(m_Lock);
+		if(pJob)
+			return pJob;
+	}
+
+	// steal from the others, starting at a random one to spread the thieves
+	unsigned Start = 0;
+	if(pWorker)
+	{
+		pWorker->m_Seed ^= pWorker->m_Seed<<13;
+		pWorker->m_Seed ^= pWorker->m_Seed>>17;
+		pWorker->m_Seed ^= pWorker->m_Seed<<5;
+		Start = pWorker->m_Seed;
+	}
+	for(int i = 0; i < m_NumThreads; i++)
+	{
+		CWorker *pVictim = &m_pWorkers[(Start+i)%m_NumThreads];
+		if(pVictim != pWorker && (pJob = pVictim->Steal()))
+			return pJob;
+	}
+	return 0;
+}
+
+CJob *CJobPool::FindGroupJob(CJobGroup *pGroup)
+{
+	// only the shared queue can give up jobs from the middle
+	CJob *pJob = 0;
+	if(!m_pFirstJob)
+		return 0;
+
+	lock_wait(m_Lock);
+	for(pJob = m_pFirstJob; pJob && pJob->m_pGroup != pGroup; pJob = pJob->m_pNext);
+	if(pJob)
+	{
+		if(pJob->m_pPrev)
+			pJob->m_pPrev->m_pNext = pJob->m_pNext;
+		else
+			m_pFirstJob = pJob->m_pNext;
+		if(pJob->m_pNext)
+			pJob->m_pNext->m_pPrev = pJob->m_pPrev;
+		else
+			m_pLastJob = pJob->m_pPrev;
+	}
+	lock_unlock(m_Lock);
+	return pJob;
+}
+
+void CJobPool::RunJob(CJob *pJob)
+{
+	// the job may be gone as soon as it is done
+	CJobGroup *pGroup = pJob->m_pGroup;
+
+	pJob->m_Status = CJob::STATE_RUNNING;
+	pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
+	atomic_store(&pJob->m_Status, (int)CJob::STATE_DONE);
 
-		// do the job if we have one
+	// the group may be gone too once the count is 0, waking only
+	// uses the address
+	if(pGroup && atomic_dec(&pGroup->m_Pending) == 0)
+		atomic_notify_all(&pGroup->m_Pending);
+}
+
+void CJobPool::WorkerThread(void *pUser)
+{
+	CWorker *pWorker = (CWorker *)pUser;
+	CJobPool *pPool = pWorker->m_pPool;
+	s_pCurrentWorker = pWorker;
+
+	while(!pPool->m_Shutdown)
+	{
+		CJob *pJob = pPool->FindJob(pWorker);
 		if(pJob)
 		{
-			pJob->m_Status = CJob::STATE_RUNNING;
-			pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
-			pJob->m_Status = CJob::STATE_DONE;
+			pPool->RunJob(pJob);
+			continue;
 		}
-		else
-			thread_sleep(10);
-	}
 
+		// announce the sleep before looking again, so a job added
+		// meanwhile either is found or sees us sleeping and wakes us
+		atomic_inc(&pPool->m_NumSleeping);
+		pJob = pPool->FindJob(pWorker);
+		if(!pJob && !pPool->m_Shutdown)
+			sphore_wait(&pPool->m_Semaphore);
+		atomic_dec(&pPool->m_NumSleeping);
+
+		if(pJob)
+			pPool->RunJob(pJob);
+	}
 }
 
 int CJobPool::Init(int NumThreads)
 {
+	if(m_pWorkers || NumThreads <= 0)
+		return 0;
+
+	// all deques have to exist before anyone steals
+	m_NumThreads = NumThreads;
+	m_pWorkers = new CWorker[m_NumThreads];
+	for(int i = 0; i < m_NumThreads; i++)
+	{
+		m_pWorkers[i].m_pPool = this;
+		m_pWorkers[i].m_pThread = 0;
+		m_pWorkers[i].m_Seed = 2463534242u+i*7919;
+		m_pWorkers[i].m_Top = 0;
+		m_pWorkers[i].m_Bottom = 0;
+	}
+
 	// start threads
-	m_NumThreads = NumThreads > MAX_THREADS ? MAX_THREADS : NumThreads;
 	for(int i = 0; i < m_NumThreads; i++)
-		m_apThreads[i] = thread_init(WorkerThread, this);
+		m_pWorkers[i].m_pThread = thread_init(WorkerThread, &m_pWorkers[i]);
 	return 0;
 }
 
-int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData)
+int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup)
 {
 	mem_zero(pJob, sizeof(CJob));
+	if(m_Shutdown)
+	{
+		// the job never runs, it is done without touching the group
+		pJob->m_Status = CJob::STATE_DONE;
+		pJob->m_Result = -1;
+		return -1;
+	}
+
 	pJob->m_pfnFunc = pfnFunc;
 	pJob->m_pFuncData = pData;
+	pJob->m_pGroup = pGroup;
+	if(pGroup)
+		atomic_inc(&pGroup->m_Pending);
 
-	lock_wait(m_Lock);
+	CWorker *pWorker = CurrentWorker();
+	if(!pWorker || !pWorker->Push(pJob))
+	{
+		lock_wait(m_Lock);
 
-	// add job to queue
-	pJob->m_pPrev = m_pLastJob;
-	if(m_pLastJob)
-		m_pLastJob->m_pNext = pJob;
-	m_pLastJob = pJob;
-	if(!m_pFirstJob)
-		m_pFirstJob = pJob;
+		// add job to queue
+		pJob->m_pPrev = m_pLastJob;
+		if(m_pLastJob)
+			m_pLastJob->m_pNext = pJob;
+		m_pLastJob = pJob;
+		if(!m_pFirstJob)
+			m_pFirstJob = pJob;
 
-	lock_unlock(m_Lock);
+		lock_unlock(m_Lock);
+	}
+
+	// pairs with the sleeping worker looking again after announcing itself
+	sync_barrier();
+	if(m_NumSleeping)
+		sphore_signal(&m_Semaphore);
+	return 0;
+}
+
+void CJobPool::Wait(CJobGroup *pGroup)
+{
+	CWorker *pWorker = CurrentWorker();
+	while(1)
+	{
+		unsigned Pending = atomic_load(&pGroup->m_Pending);
+		if(!Pending)
+			return;
+
+		// workers run any job, so jobs waiting on each other always make
+		// progress. other threads only help with the group, they may be
+		// in the middle of something that shouldn't wait for unrelated
+		// jobs. without a job the rest is running, sleep until it is done
+		CJob *pJob = 0;
+		if(!m_Shutdown)
+			pJob = pWorker ? FindJob(pWorker) : FindGroupJob(pGroup);
+		if(pJob)
+			RunJob(pJob);
+		else
+			atomic_wait(&pGroup->m_Pending, Pending);
+	}
+}
+
+struct CRangeJob
+{
+	CJob m_Job;
+	int m_Begin;
+	int m_End;
+	CJobPool::FRangeFunc m_pfnFunc;
+	void *m_pUser;
+};
+
+static int RangeJob(void *pData)
+{
+	CRangeJob *pRange = (CRangeJob *)pData;
+	pRange->m_pfnFunc(pRange->m_Begin, pRange->m_End, pRange->m_pUser);
 	return 0;
 }
 
+void CJobPool::ParallelFor(int Begin, int End, int Grain, FRangeFunc pfnFunc, void *pUser)
+{
+	if(End <= Begin)
+		return;
+
+	// a few parts per thread, so the ones that finish early can steal
+	const int64 Count = (int64)End-Begin;
+	const int64 MaxParts = m_NumThreads ? minimum((m_NumThreads+1)*4, (int)MAX_RANGE_JOBS) : 1;
+	const int NumParts = (int)minimum((Count+maximum(Grain, 1)-1)/maximum(Grain, 1), MaxParts);
+	if(NumParts <= 1)
+	{
+		pfnFunc(Begin, End, pUser);
+		return;
+	}
+
+	CRangeJob aJobs[MAX_RANGE_JOBS];
+	CJobGroup Group;
+	for(int i = 1; i < NumParts; i++)
+	{
+		aJobs[i].m_Begin = (int)(Begin+Count*i/NumParts);
+		aJobs[i].m_End = (int)(Begin+Count*(i+1)/NumParts);
+		aJobs[i].m_pfnFunc = pfnFunc;
+		aJobs[i].m_pUser = pUser;
+		Add(&aJobs[i].m_Job, RangeJob, &aJobs[i], &Group);
+	}
+	pfnFunc(Begin, (int)(Begin+Count/NumParts), pUser);
+	Wait(&Group);
+}
@@ -2,10 +2,28 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #ifndef ENGINE_SHARED_JOBS_H
 #define ENGINE_SHARED_JOBS_H
+#include <base/system.h>
+
 typedef int (*JOBFUNC)(void *pData);
 
 class CJobPool;
 
+/*
+	Counts the jobs added to it that have not finished yet.
+	Wait on it with CJobPool::Wait, which runs jobs while waiting.
+*/
+class CJobGroup
+{
+	friend class CJobPool;
+
+	volatile unsigned m_Pending;
+public:
+	CJobGroup() { m_Pending = 0; }
+
+	// once done, everything the jobs wrote is visible
+	bool Done() const;
+};
+
 class CJob
 {
 	friend class CJobPool;
@@ -18,11 +36,13 @@ class CJob
 
 	JOBFUNC m_pfnFunc;
 	void *m_pFuncData;
+	CJobGroup *m_pGroup;
 public:
 	CJob()
 	{
 		m_Status = STATE_DONE;
 		m_pFuncData = 0;
+		m_pGroup = 0;
 	}
 
 	enum
@@ -32,32 +52,82 @@ public:
 		STATE_DONE
 	};
 
-	int Status() const { return m_Status; }
-	int Result() const {return m_Result; }
+	// once the status is done, everything the job wrote is visible
+	int Status() const;
+	int Result() const { return m_Result; }
 };
 
+/*
+	Runs jobs on a set of worker threads.
+
+	Every worker owns a deque, jobs added from a worker go to the bottom
+	of its own deque and it takes them from there again, newest first.
+	Idle workers steal the oldest job from the top of another deque.
+	Jobs added from other threads go to a shared queue in order. Workers
+	with nothing to do sleep until a job is added.
+*/
 class CJobPool
 {
 	enum
 	{
-		MAX_THREADS=32
+		DEQUE_SIZE=1024, // power of two, the shared queue takes the overflow
+		MAX_RANGE_JOBS=64,
+	};
+
+	struct CWorker
+	{
+		CJobPool *m_pPool;
+		void *m_pThread;
+		unsigned m_Seed;
+
+		// written by the owner at the bottom, by thieves at the top
+		volatile unsigned m_Top;
+		volatile unsigned m_Bottom;
+		CJob *volatile m_apJobs[DEQUE_SIZE];
+
+		bool Push(CJob *pJob);
+		CJob *Pop();
+		CJob *Steal();
 	};
+
 	int m_NumThreads;
-	void *m_apThreads[MAX_THREADS];
+	CWorker *m_pWorkers;
 	volatile bool m_Shutdown;
 
 	LOCK m_Lock;
-	CJob *m_pFirstJob;
+	CJob *volatile m_pFirstJob;
 	CJob *m_pLastJob;
 
+	SEMAPHORE m_Semaphore;
+	volatile unsigned m_NumSleeping;
+
 	static void WorkerThread(void *pUser);
+	CWorker *CurrentWorker() const;
+	CJob *FindJob(CWorker *pWorker);
+	CJob *FindGroupJob(CJobGroup *pGroup);
+	void RunJob(CJob *pJob);
 
 public:
+	typedef void (*FRangeFunc)(int Begin, int End, void *pUser);
+
 	CJobPool();
 	~CJobPool();
 
 	int Init(int NumThreads);
-	void Shutdown();
-	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData);
+	void Shutdown(); // runs the jobs still queued
+	int NumThreads() const { return m_NumThreads; }
+
+	// returns -1 and marks the job done without running it after Shutdown
+	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup = 0);
+
+	// helps until all jobs of the group are done, sleeps while the last
+	// ones run elsewhere. workers run any queued job, other threads only
+	// the group's own
+	void Wait(CJobGroup *pGroup);
+
+	// calls pfnFunc for consecutive parts of [Begin, End) of at least Grain
+	// indices in parallel, including on the calling thread, and returns
+	// when all are done. can be used from within jobs
+	void ParallelFor(int Begin, int End, int Grain, FRangeFunc pfnFunc, void *pUser);
 };
 #endif
@@ -1,6 +1,8 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/system.h>
+#include <base/tl/array.h>
+#include <engine/engine.h>
 #include <engine/map.h>
 #include <engine/storage.h>
 #include <game/mapitems.h>
@@ -9,12 +11,14 @@
 class CMap : public IEngineMap
 {
 	CDataFileReader m_DataFile;
+	CJobPool *m_pJobPool;
 public:
-	CMap() {}
+	CMap() : m_pJobPool(0) {}
 
 	virtual void *GetData(int Index) { return m_DataFile.GetData(Index); }
 	virtual void *GetDataSwapped(int Index) { return m_DataFile.GetDataSwapped(Index); }
 	virtual void UnloadData(int Index) { m_DataFile.UnloadData(Index); }
+	virtual void PrefetchData(const int *pIndices, int Num) { m_DataFile.PrefetchData(pIndices, Num, m_pJobPool); }
 	virtual void *GetItem(int Index, int *pType, int *pID) { return m_DataFile.GetItem(Index, pType, pID); }
 	virtual void GetType(int Type, int *pStart, int *pNum) { m_DataFile.GetType(Type, pStart, pNum); }
 	virtual void *FindItem(int Type, int ID) { return m_DataFile.FindItem(Type, ID); }
@@ -25,29 +29,49 @@ public:
 		m_DataFile.Close();
 	}
 
-	virtual bool Load(const char *pMapName, IStorage *pStorage)
+	virtual bool Load(const char *pMapName, IStorage *pStorage, CJobPool *pJobPool)
 	{
 		if(!pStorage)
 			pStorage = Kernel()->RequestInterface<IStorage>();
 		if(!pStorage)
 			return false;
-		if(!m_DataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL))
+		if(!pJobPool && Kernel())
+		{
+			IEngine *pEngine = Kernel()->RequestInterface<IEngine>();
+			if(pEngine)
+				pJobPool = pEngine->JobPool();
+		}
+		// load into a new reader, the current map stays if this fails
+		CDataFileReader DataFile;
+		if(!DataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL))
 			return false;
 		// check version
-		CMapItemVersion *pItem = (CMapItemVersion *)m_DataFile.FindItem(MAPITEMTYPE_VERSION, 0);
+		CMapItemVersion *pItem = (CMapItemVersion *)DataFile.FindItem(MAPITEMTYPE_VERSION, 0);
 		if(!pItem || pItem->m_Version != CMapItemVersion::CURRENT_VERSION)
 			return false;
 
 		// replace compressed tile layers with uncompressed ones
 		int GroupsStart, GroupsNum, LayersStart, LayersNum;
-		m_DataFile.GetType(MAPITEMTYPE_GROUP, &GroupsStart, &GroupsNum);
-		m_DataFile.GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
+		DataFile.GetType(MAPITEMTYPE_GROUP, &GroupsStart, &GroupsNum);
+		DataFile.GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
+
+		// decompress all tile layers at once
+		array<int> lTileData;
+		for(int l = 0; l < LayersNum; l++)
+		{
+			CMapItemLayer *pLayer = static_cast<CMapItemLayer *>(DataFile.GetItem(LayersStart + l, 0, 0));
+			if(pLayer->m_Type == LAYERTYPE_TILES)
+				lTileData.add(reinterpret_cast<CMapItemLayerTilemap *>(pLayer)->m_Data);
+		}
+		if(lTileData.size())
+			DataFile.PrefetchData(lTileData.base_ptr(), lTileData.size(), pJobPool);
+
 		for(int g = 0; g < GroupsNum; g++)
 		{
-			CMapItemGroup *pGroup = static_cast<CMapItemGroup *>(m_DataFile.GetItem(GroupsStart + g, 0, 0));
+			CMapItemGroup *pGroup = static_cast<CMapItemGroup *>(DataFile.GetItem(GroupsStart + g, 0, 0));
 			for(int l = 0; l < pGroup->m_NumLayers; l++)
 			{
-				CMapItemLayer *pLayer = static_cast<CMapItemLayer *>(m_DataFile.GetItem(LayersStart + pGroup->m_StartLayer + l, 0, 0));
+				CMapItemLayer *pLayer = static_cast<CMapItemLayer *>(DataFile.GetItem(LayersStart + pGroup->m_StartLayer + l, 0, 0));
 
 				if(pLayer->m_Type == LAYERTYPE_TILES)
 				{
@@ -69,7 +93,12 @@ public:
 
 						// extract original tile data
 						int i = 0;
-						CTile *pSavedTiles = static_cast<CTile *>(m_DataFile.GetData(pTilemap->m_Data));
+						CTile *pSavedTiles = static_cast<CTile *>(DataFile.GetData(pTilemap->m_Data));
+						if(!pSavedTiles)
+						{
+							mem_free(pTiles);
+							return false;
+						}
 						while(i < TilemapCount)
 						{
 							for(unsigned Counter = 0; Counter <= pSavedTiles->m_Skip && i < TilemapCount; Counter++)
@@ -81,13 +110,17 @@ public:
 							pSavedTiles++;
 						}
 
-						m_DataFile.ReplaceData(pTilemap->m_Data, reinterpret_cast<char *>(pTiles), TilemapSize);
+						DataFile.ReplaceData(pTilemap->m_Data, reinterpret_cast<char *>(pTiles), TilemapSize);
 					}
+					else if(!DataFile.GetData(pTilemap->m_Data))
+						return false;
 				}
 			}
 			
 		}
-		
+
+		m_DataFile.Swap(&DataFile);
+		m_pJobPool = pJobPool;
 		return true;
 	}
 
@@ -105,6 +138,24 @@ public:
 	{
 		return m_DataFile.Crc();
 	}
+
+	virtual const void *FileData(unsigned *pSize)
+	{
+		return m_DataFile.FileData(pSize);
+	}
+
+	virtual bool FileChanged()
+	{
+		return m_DataFile.FileChanged();
+	}
+
+	virtual void Swap(IEngineMap *pOther)
+	{
+		m_DataFile.Swap(&static_cast<CMap *>(pOther)->m_DataFile);
+		CJobPool *pJobPool = m_pJobPool;
+		m_pJobPool = static_cast<CMap *>(pOther)->m_pJobPool;
+		static_cast<CMap *>(pOther)->m_pJobPool = pJobPool;
+	}
 };
 
 extern IEngineMap *CreateEngineMap() { return new CMap; }
@@ -0,0 +1,79 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <engine/storage.h>
+
+#include "mapcache.h"
+
+struct CMapCacheList
+{
+	CMapCache *m_pCache;
+	const char *m_pPath;
+};
+
+int CMapCache::ListCallback(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	CMapCacheList *pList = (CMapCacheList *)pUser;
+
+	// <name>_<sha256>.map
+	int Length = str_length(pName);
+	const int SuffixLength = SHA256_MAXSTRSIZE-1+4;
+	if(IsDir || Length <= SuffixLength || pName[Length-SuffixLength-1] != '_' || str_comp(pName+Length-4, ".map") != 0)
+		return 0;
+
+	char aSha256[SHA256_MAXSTRSIZE];
+	str_truncate(aSha256, sizeof(aSha256), pName+Length-SuffixLength, SHA256_MAXSTRSIZE-1);
+	SHA256_DIGEST Sha256;
+	if(sha256_from_str(&Sha256, aSha256) != 0)
+		return 0;
+
+	char aPath[IO_MAX_PATH_LENGTH];
+	str_format(aPath, sizeof(aPath), "%s/%s", pList->m_pPath, pName);
+	pList->m_pCache->Add(Sha256, aPath);
+	return 0;
+}
+
+void CMapCache::Init(IStorage *pStorage, const char *pPath)
+{
+	m_lEntries.clear();
+
+	CMapCacheList List;
+	List.m_pCache = this;
+	List.m_pPath = pPath;
+	pStorage->ListDirectory(IStorage::TYPE_SAVE, pPath, ListCallback, &List);
+}
+
+void CMapCache::Add(const SHA256_DIGEST &Sha256, const char *pPath)
+{
+	// the file might have had different content before
+	Remove(pPath);
+
+	CEntry Entry;
+	Entry.m_Sha256 = Sha256;
+	str_copy(Entry.m_aPath, pPath, sizeof(Entry.m_aPath));
+
+	sorted_array<CEntry>::range r = find_binary(m_lEntries.all(), Entry);
+	if(r.empty())
+		m_lEntries.add(Entry);
+	else
+		r.front() = Entry;
+}
+
+void CMapCache::Remove(const char *pPath)
+{
+	for(int i = 0; i < m_lEntries.size(); i++)
+	{
+		if(str_comp(m_lEntries[i].m_aPath, pPath) == 0)
+		{
+			m_lEntries.remove_index(i);
+			return;
+		}
+	}
+}
+
+const char *CMapCache::Find(const SHA256_DIGEST &Sha256) const
+{
+	CEntry Entry;
+	Entry.m_Sha256 = Sha256;
+	sorted_array<CEntry>::range r = find_binary(m_lEntries.all(), Entry);
+	return r.empty() ? 0 : r.front().m_aPath;
+}
@@ -0,0 +1,38 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_MAPCACHE_H
+#define ENGINE_SHARED_MAPCACHE_H
+
+#include <base/hash.h>
+#include <base/system.h>
+#include <base/tl/sorted_array.h>
+
+/*
+	Maps on disk by their content. Downloaded maps carry their SHA256 in
+	the file name, so they are indexed without reading them, other maps
+	are added once they were loaded and hashed.
+*/
+class CMapCache
+{
+	struct CEntry
+	{
+		SHA256_DIGEST m_Sha256;
+		char m_aPath[IO_MAX_PATH_LENGTH];
+
+		bool operator<(const CEntry &Other) const { return sha256_comp(m_Sha256, Other.m_Sha256) < 0; }
+		bool operator==(const CEntry &Other) const { return m_Sha256 == Other.m_Sha256; }
+	};
+
+	sorted_array<CEntry> m_lEntries;
+
+	static int ListCallback(const char *pName, int IsDir, int StorageType, void *pUser);
+
+public:
+	void Init(class IStorage *pStorage, const char *pPath);
+	void Add(const SHA256_DIGEST &Sha256, const char *pPath);
+	void Remove(const char *pPath);
+	const char *Find(const SHA256_DIGEST &Sha256) const;
+	int Num() const { return m_lEntries.size(); }
+};
+
+#endif
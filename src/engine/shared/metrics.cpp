@@ -0,0 +1,151 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include "metrics.h"
+
+static const char *s_apTypeNames[] = { "counter", "gauge", "histogram" };
+
+CMetrics::CMetrics()
+{
+	m_NumMetrics = 0;
+	m_pCollecting = 0;
+	m_pfnExport = 0;
+	m_pExportUser = 0;
+}
+
+CMetrics::~CMetrics()
+{
+	for(int i = 0; i < m_NumMetrics; i++)
+		delete m_apMetrics[i];
+}
+
+CMetrics::CMetric *CMetrics::Find(const char *pName) const
+{
+	for(int i = 0; i < m_NumMetrics; i++)
+	{
+		if(str_comp(m_apMetrics[i]->m_aName, pName) == 0)
+			return m_apMetrics[i];
+	}
+	return 0;
+}
+
+CMetrics::CMetric *CMetrics::Add(const char *pName, int Type, const char *pHelp)
+{
+	CMetric *pMetric = Find(pName);
+	if(pMetric)
+	{
+		dbg_assert(pMetric->m_Type == Type, "metric registered again with another type");
+		return pMetric;
+	}
+
+	dbg_assert(m_NumMetrics < MAX_METRICS, "too many metrics");
+	pMetric = new CMetric;
+	mem_zero(pMetric, sizeof(*pMetric));
+	str_copy(pMetric->m_aName, pName, sizeof(pMetric->m_aName));
+	str_copy(pMetric->m_aHelp, pHelp, sizeof(pMetric->m_aHelp));
+	pMetric->m_Type = Type;
+	m_apMetrics[m_NumMetrics++] = pMetric;
+	return pMetric;
+}
+
+IMetrics::CCounter *CMetrics::RegisterCounter(const char *pName, const char *pHelp)
+{
+	return &Add(pName, TYPE_COUNTER, pHelp)->m_Counter;
+}
+
+IMetrics::CGauge *CMetrics::RegisterGauge(const char *pName, const char *pHelp)
+{
+	return &Add(pName, TYPE_GAUGE, pHelp)->m_Gauge;
+}
+
+IMetrics::CHistogram *CMetrics::RegisterHistogram(const char *pName, const char *pHelp, const int64 *pBounds, int NumBounds)
+{
+	CMetric *pMetric = Add(pName, TYPE_HISTOGRAM, pHelp);
+	CHistogram *pHistogram = &pMetric->m_Histogram;
+	if(!pHistogram->m_NumBounds)
+	{
+		pHistogram->m_NumBounds = clamp(NumBounds, 0, (int)MAX_BUCKETS);
+		mem_copy(pHistogram->m_aBounds, pBounds, sizeof(int64)*pHistogram->m_NumBounds);
+	}
+	return pHistogram;
+}
+
+void CMetrics::RegisterCollector(const char *pName, int Type, const char *pHelp, FCollectCallback pfnCallback, void *pUser)
+{
+	dbg_assert(Type != TYPE_HISTOGRAM, "collectors can't export histograms");
+	CMetric *pMetric = Add(pName, Type, pHelp);
+	pMetric->m_pfnCollect = pfnCallback;
+	pMetric->m_pCollectUser = pUser;
+}
+
+void CMetrics::AddSample(const char *pLabels, int64 Value)
+{
+	if(!m_pCollecting)
+		return;
+
+	char aBuf[256];
+	if(pLabels && pLabels[0])
+		str_format(aBuf, sizeof(aBuf), "%s{%s} %lld", m_pCollecting->m_aName, pLabels, Value);
+	else
+		str_format(aBuf, sizeof(aBuf), "%s %lld", m_pCollecting->m_aName, Value);
+	m_pfnExport(aBuf, m_pExportUser);
+}
+
+void CMetrics::Export(FExportCallback pfnCallback, void *pUser)
+{
+	m_pfnExport = pfnCallback;
+	m_pExportUser = pUser;
+
+	char aBuf[256];
+	for(int i = 0; i < m_NumMetrics; i++)
+	{
+		const CMetric *pMetric = m_apMetrics[i];
+		str_format(aBuf, sizeof(aBuf), "# HELP %s %s", pMetric->m_aName, pMetric->m_aHelp);
+		pfnCallback(aBuf, pUser);
+		str_format(aBuf, sizeof(aBuf), "# TYPE %s %s", pMetric->m_aName, s_apTypeNames[pMetric->m_Type]);
+		pfnCallback(aBuf, pUser);
+
+		if(pMetric->m_pfnCollect)
+		{
+			m_pCollecting = pMetric;
+			pMetric->m_pfnCollect(this, pMetric->m_pCollectUser);
+			m_pCollecting = 0;
+		}
+		else if(pMetric->m_Type == TYPE_COUNTER)
+		{
+			str_format(aBuf, sizeof(aBuf), "%s %lld", pMetric->m_aName, pMetric->m_Counter.m_Value);
+			pfnCallback(aBuf, pUser);
+		}
+		else if(pMetric->m_Type == TYPE_GAUGE)
+		{
+			str_format(aBuf, sizeof(aBuf), "%s %lld", pMetric->m_aName, pMetric->m_Gauge.m_Value);
+			pfnCallback(aBuf, pUser);
+		}
+		else
+		{
+			// buckets are cumulative in the output
+			const CHistogram *pHistogram = &pMetric->m_Histogram;
+			int64 Count = 0;
+			for(int b = 0; b < pHistogram->m_NumBounds; b++)
+			{
+				Count += pHistogram->m_aCounts[b];
+				str_format(aBuf, sizeof(aBuf), "%s_bucket{le=\"%lld\"} %lld", pMetric->m_aName, pHistogram->m_aBounds[b], Count);
+				pfnCallback(aBuf, pUser);
+			}
+			str_format(aBuf, sizeof(aBuf), "%s_bucket{le=\"+Inf\"} %lld", pMetric->m_aName, pHistogram->m_Count);
+			pfnCallback(aBuf, pUser);
+			str_format(aBuf, sizeof(aBuf), "%s_sum %lld", pMetric->m_aName, pHistogram->m_Sum);
+			pfnCallback(aBuf, pUser);
+			str_format(aBuf, sizeof(aBuf), "%s_count %lld", pMetric->m_aName, pHistogram->m_Count);
+			pfnCallback(aBuf, pUser);
+		}
+	}
+	pfnCallback("# EOF", pUser);
+
+	m_pfnExport = 0;
+	m_pExportUser = 0;
+}
+
+IMetrics *CreateMetrics() { return new CMetrics; }
@@ -0,0 +1,57 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_METRICS_H
+#define ENGINE_SHARED_METRICS_H
+
+#include <engine/metrics.h>
+
+class CMetrics : public IMetrics
+{
+	enum
+	{
+		MAX_METRICS=128,
+		MAX_NAME_LENGTH=64,
+		MAX_HELP_LENGTH=128,
+	};
+
+	struct CMetric
+	{
+		char m_aName[MAX_NAME_LENGTH];
+		char m_aHelp[MAX_HELP_LENGTH];
+		int m_Type;
+		union
+		{
+			CCounter m_Counter;
+			CGauge m_Gauge;
+			CHistogram m_Histogram;
+		};
+		FCollectCallback m_pfnCollect;
+		void *m_pCollectUser;
+	};
+
+	CMetric *m_apMetrics[MAX_METRICS];
+	int m_NumMetrics;
+
+	// set while exporting a collector
+	const CMetric *m_pCollecting;
+	FExportCallback m_pfnExport;
+	void *m_pExportUser;
+
+	CMetric *Find(const char *pName) const;
+	CMetric *Add(const char *pName, int Type, const char *pHelp);
+
+public:
+	CMetrics();
+	~CMetrics();
+
+	CCounter *RegisterCounter(const char *pName, const char *pHelp);
+	CGauge *RegisterGauge(const char *pName, const char *pHelp);
+	CHistogram *RegisterHistogram(const char *pName, const char *pHelp, const int64 *pBounds, int NumBounds);
+	void RegisterCollector(const char *pName, int Type, const char *pHelp, FCollectCallback pfnCallback, void *pUser);
+
+	void AddSample(const char *pLabels, int64 Value);
+
+	void Export(FExportCallback pfnCallback, void *pUser);
+};
+
+#endif
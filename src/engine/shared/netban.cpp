@@ -5,105 +5,286 @@
 #include <engine/console.h>
 #include <engine/storage.h>
 #include <engine/shared/config.h>
+#include <engine/shared/linereader.h>
 
 #include "netban.h"
 
 
-CNetBan::CNetHash::CNetHash(const NETADDR *pAddr)
+static int AddrBytes(const NETADDR *pAddr)
 {
-	if(pAddr->type==NETTYPE_IPV4)
-		m_Hash = (pAddr->ip[0]+pAddr->ip[1]+pAddr->ip[2]+pAddr->ip[3])&0xFF;
-	else
-		m_Hash = (pAddr->ip[0]+pAddr->ip[1]+pAddr->ip[2]+pAddr->ip[3]+pAddr->ip[4]+pAddr->ip[5]+pAddr->ip[6]+pAddr->ip[7]+
-			pAddr->ip[8]+pAddr->ip[9]+pAddr->ip[10]+pAddr->ip[11]+pAddr->ip[12]+pAddr->ip[13]+pAddr->ip[14]+pAddr->ip[15])&0xFF;
-	m_HashIndex = 0;
+	return pAddr->type==NETTYPE_IPV4 ? NETADDR_SIZE_IPV4 : NETADDR_SIZE_IPV6;
+}
+
+static int AddrBit(const unsigned char *pAddr, int Index)
+{
+	return (pAddr[Index>>3]>>(7-(Index&7)))&1;
 }
 
-CNetBan::CNetHash::CNetHash(const CNetRange *pRange)
+// number of leading bits that are equal, at most MaxBits
+static int CommonBits(const unsigned char *pAddr1, const unsigned char *pAddr2, int MaxBits)
 {
-	m_Hash = 0;
-	m_HashIndex = 0;
-	for(int i = 0; pRange->m_LB.ip[i] == pRange->m_UB.ip[i]; ++i)
+	int Bits = 0;
+	for(int i = 0; Bits < MaxBits; i++, Bits += 8)
 	{
-		m_Hash += pRange->m_LB.ip[i];
-		++m_HashIndex;
+		unsigned char Diff = pAddr1[i]^pAddr2[i];
+		if(Diff)
+		{
+			while(!(Diff&0x80))
+			{
+				Diff <<= 1;
+				Bits++;
+			}
+			break;
+		}
+	}
+	return minimum(Bits, MaxBits);
+}
+
+int CNetBan::MakePrefixes(const NETADDR *pAddr, CNetPrefix *pPrefixes)
+{
+	pPrefixes[0].m_Addr = *pAddr;
+	pPrefixes[0].m_Length = AddrBytes(pAddr)*8;
+	return 1;
+}
+
+int CNetBan::MakePrefixes(const CNetRange *pRange, CNetPrefix *pPrefixes)
+{
+	const int Bytes = AddrBytes(&pRange->m_LB);
+	const int Bits = Bytes*8;
+	NETADDR Start = pRange->m_LB;
+	int Num = 0;
+	while(1)
+	{
+		// the largest block aligned at the start that ends within the range
+		int Size = 0;
+		while(Size < Bits && !AddrBit(Start.ip, Bits-1-Size))
+			Size++;
+		for(; Size > 0; Size--)
+		{
+			NETADDR End = Start;
+			for(int i = Bytes-1, Left = Size; Left > 0; i--, Left -= 8)
+				End.ip[i] |= Left >= 8 ? 0xff : (1<<Left)-1;
+			if(mem_comp(End.ip, pRange->m_UB.ip, Bytes) <= 0)
+				break;
+		}
+		pPrefixes[Num].m_Addr = Start;
+		pPrefixes[Num].m_Length = Bits-Size;
+		Num++;
+
+		// continue after the block, unless it was the last one
+		int Carry = 1<<(Size&7);
+		for(int i = Bytes-1-Size/8; i >= 0 && Carry; i--)
+		{
+			Carry += Start.ip[i];
+			Start.ip[i] = Carry&0xff;
+			Carry >>= 8;
+		}
+		if(Carry || Size == Bits || mem_comp(Start.ip, pRange->m_UB.ip, Bytes) > 0)
+			break;
 	}
-	m_Hash &= 0xFF;
+	return Num;
+}
+
+
+CNetBan::CNetTrie::CNode *CNetBan::CNetTrie::NewNode(const unsigned char *pPrefix, int Length)
+{
+	CNode *pNode = new CNode;
+	mem_zero(pNode, sizeof(*pNode));
+	mem_copy(pNode->m_aPrefix, pPrefix, (Length+7)/8);
+	if(Length&7)
+		pNode->m_aPrefix[Length/8] &= 0xff<<(8-(Length&7));
+	pNode->m_Length = Length;
+	return pNode;
 }
 
-int CNetBan::CNetHash::MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17])
+void CNetBan::CNetTrie::DeleteNode(CNode *pNode)
 {
-	int Length = pAddr->type==NETTYPE_IPV4 ? 4 : 16;
-	aHash[0].m_Hash = 0;
-	aHash[0].m_HashIndex = 0;
-	for(int i = 1, Sum = 0; i <= Length; ++i)
+	if(!pNode)
+		return;
+	DeleteNode(pNode->m_apChildren[0]);
+	DeleteNode(pNode->m_apChildren[1]);
+	while(pNode->m_pEntries)
 	{
-		Sum += pAddr->ip[i-1];
-		aHash[i].m_Hash = Sum&0xFF;
-		aHash[i].m_HashIndex = i%Length;
+		CEntry *pNext = pNode->m_pEntries->m_pNext;
+		delete pNode->m_pEntries;
+		pNode->m_pEntries = pNext;
 	}
-	return Length;
+	delete pNode;
 }
 
+int CNetBan::CNetTrie::RootIndex(const NETADDR *pAddr, int Length)
+{
+	const int Family = pAddr->type==NETTYPE_IPV4 ? 0 : NUM_ROOTS;
+	return Length < ROOT_BITS ? Family : Family+1+pAddr->ip[0];
+}
 
-template<class T, int HashCount>
-typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Add(const T *pData, const CBanInfo *pInfo,  const CNetHash *pNetHash)
+void CNetBan::CNetTrie::Add(const CNetPrefix *pPrefix, void *pData)
 {
-	if(!m_pFirstFree)
-		return 0;
+	const unsigned char *pAddr = pPrefix->m_Addr.ip;
+	const int Length = pPrefix->m_Length;
+	CNode **ppRoot = &m_apRoots[RootIndex(&pPrefix->m_Addr, Length)];
+	if(!*ppRoot)
+		*ppRoot = NewNode(pAddr, Length < ROOT_BITS ? 0 : ROOT_BITS);
+
+	CNode *pNode = *ppRoot;
+	while(pNode->m_Length < Length)
+	{
+		const int Bit = AddrBit(pAddr, pNode->m_Length);
+		CNode *pChild = pNode->m_apChildren[Bit];
+		if(!pChild)
+		{
+			pNode = pNode->m_apChildren[Bit] = NewNode(pAddr, Length);
+			break;
+		}
 
-	// create new ban
-	CBan<T> *pBan = m_pFirstFree;
-	pBan->m_Data = *pData;
-	pBan->m_Info = *pInfo;
-	pBan->m_NetHash = *pNetHash;
-	if(pBan->m_pNext)
-		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
-	if(pBan->m_pPrev)
-		pBan->m_pPrev->m_pNext = pBan->m_pNext;
-	else
-		m_pFirstFree = pBan->m_pNext;
+		const int Common = CommonBits(pChild->m_aPrefix, pAddr, minimum(pChild->m_Length, Length));
+		if(Common == pChild->m_Length)
+		{
+			pNode = pChild;
+			continue;
+		}
 
-	// add it to the hash list
-	if(m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash])
-		m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]->m_pHashPrev = pBan;
-	pBan->m_pHashPrev = 0;
-	pBan->m_pHashNext = m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash];
-	m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash] = pBan;
+		// split the path where the prefixes differ
+		CNode *pSplit = NewNode(pAddr, Common);
+		pSplit->m_apChildren[AddrBit(pChild->m_aPrefix, Common)] = pChild;
+		pNode->m_apChildren[Bit] = pSplit;
+		pNode = pSplit;
+		if(Common < Length)
+			pNode = pSplit->m_apChildren[AddrBit(pAddr, Common)] = NewNode(pAddr, Length);
+		break;
+	}
 
-	// insert it into the used list
-	if(m_pFirstUsed)
+	CEntry *pEntry = new CEntry;
+	pEntry->m_pData = pData;
+	pEntry->m_pNext = pNode->m_pEntries;
+	pNode->m_pEntries = pEntry;
+}
+
+void CNetBan::CNetTrie::Remove(const CNetPrefix *pPrefix, void *pData)
+{
+	const unsigned char *pAddr = pPrefix->m_Addr.ip;
+	const int Length = pPrefix->m_Length;
+
+	// remember the path to prune nodes that are no longer needed
+	CNode **apPath[NETADDR_SIZE_IPV6*8+2];
+	int Depth = 0;
+	apPath[0] = &m_apRoots[RootIndex(&pPrefix->m_Addr, Length)];
+	CNode *pNode = *apPath[0];
+	while(pNode && pNode->m_Length < Length)
+	{
+		apPath[++Depth] = &pNode->m_apChildren[AddrBit(pAddr, pNode->m_Length)];
+		pNode = *apPath[Depth];
+		if(pNode && (pNode->m_Length > Length || CommonBits(pNode->m_aPrefix, pAddr, pNode->m_Length) < pNode->m_Length))
+			pNode = 0;
+	}
+	if(!pNode)
+		return;
+
+	for(CEntry **ppEntry = &pNode->m_pEntries; *ppEntry; ppEntry = &(*ppEntry)->m_pNext)
 	{
-		for(CBan<T> *p = m_pFirstUsed; ; p = p->m_pNext)
+		if((*ppEntry)->m_pData == pData)
 		{
-			if(p->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER || (pInfo->m_Expires != CBanInfo::EXPIRES_NEVER && pInfo->m_Expires <= p->m_Info.m_Expires))
-			{
-				// insert before
-				pBan->m_pNext = p;
-				pBan->m_pPrev = p->m_pPrev;
-				if(p->m_pPrev)
-					p->m_pPrev->m_pNext = pBan;
-				else
-					m_pFirstUsed = pBan;
-				p->m_pPrev = pBan;
-				break;
-			}
-
-			if(!p->m_pNext)
-			{
-				// last entry
-				p->m_pNext = pBan;
-				pBan->m_pPrev = p;
-				pBan->m_pNext = 0;
-				break;
-			}
+			CEntry *pEntry = *ppEntry;
+			*ppEntry = pEntry->m_pNext;
+			delete pEntry;
+			break;
 		}
 	}
-	else
+
+	// the root stays
+	for(; Depth > 0; Depth--)
 	{
-		m_pFirstUsed = pBan;
-		pBan->m_pNext = pBan->m_pPrev = 0;
+		pNode = *apPath[Depth];
+		if(pNode->m_pEntries || (pNode->m_apChildren[0] && pNode->m_apChildren[1]))
+			break;
+		*apPath[Depth] = pNode->m_apChildren[0] ? pNode->m_apChildren[0] : pNode->m_apChildren[1];
+		delete pNode;
+		if(*apPath[Depth])
+			break;
+	}
+}
+
+void CNetBan::CNetTrie::Reset()
+{
+	for(int i = 0; i < 2*NUM_ROOTS; i++)
+	{
+		DeleteNode(m_apRoots[i]);
+		m_apRoots[i] = 0;
 	}
+}
+
+const CNetBan::CNetTrie::CEntry *CNetBan::CNetTrie::Find(const CNetPrefix *pPrefix) const
+{
+	const unsigned char *pAddr = pPrefix->m_Addr.ip;
+	const CNode *pNode = m_apRoots[RootIndex(&pPrefix->m_Addr, pPrefix->m_Length)];
+	while(pNode && pNode->m_Length < pPrefix->m_Length)
+	{
+		pNode = pNode->m_apChildren[AddrBit(pAddr, pNode->m_Length)];
+		if(pNode && (pNode->m_Length > pPrefix->m_Length || CommonBits(pNode->m_aPrefix, pAddr, pNode->m_Length) < pNode->m_Length))
+			return 0;
+	}
+	return pNode ? pNode->m_pEntries : 0;
+}
+
+const CNetBan::CNetTrie::CEntry *CNetBan::CNetTrie::Longest(const NETADDR *pAddr) const
+{
+	// prefixes below the first byte are less specific than all others
+	const CEntry *pEntry = Longest(m_apRoots[RootIndex(pAddr, ROOT_BITS)], pAddr);
+	return pEntry ? pEntry : Longest(m_apRoots[RootIndex(pAddr, 0)], pAddr);
+}
+
+const CNetBan::CNetTrie::CEntry *CNetBan::CNetTrie::Longest(const CNode *pNode, const NETADDR *pAddr)
+{
+	// descend by the branch bits only, every node on the way is a prefix
+	// of the last one, so a single comparison tells which of them match
+	const int Bits = AddrBytes(pAddr)*8;
+	const CNode *apPath[NETADDR_SIZE_IPV6*8+1];
+	int Depth = 0;
+	const CNode *pLast = 0;
+	for(; pNode; pNode = pNode->m_Length < Bits ? pNode->m_apChildren[AddrBit(pAddr->ip, pNode->m_Length)] : 0)
+	{
+		if(pNode->m_pEntries)
+			apPath[Depth++] = pNode;
+		pLast = pNode;
+	}
+	if(!Depth)
+		return 0;
+
+	const int Common = CommonBits(pLast->m_aPrefix, pAddr->ip, pLast->m_Length);
+	while(Depth > 0 && apPath[Depth-1]->m_Length > Common)
+		Depth--;
+	return Depth ? apPath[Depth-1]->m_pEntries : 0;
+}
+
+
+template<class T>
+typename CNetBan::CBan<T> *CNetBan::CBanPool<T>::Add(const T *pData, const CBanInfo *pInfo)
+{
+	if(!m_pFirstFree)
+	{
+		// grow by another chunk
+		CChunk *pChunk = new CChunk;
+		pChunk->m_pNext = m_pFirstChunk;
+		m_pFirstChunk = pChunk;
+		for(int i = 0; i < BANS_PER_CHUNK; ++i)
+			pChunk->m_aBans[i].m_pNext = i+1 < BANS_PER_CHUNK ? &pChunk->m_aBans[i+1] : 0;
+		m_pFirstFree = &pChunk->m_aBans[0];
+	}
+
+	// create new ban
+	CBan<T> *pBan = m_pFirstFree;
+	m_pFirstFree = pBan->m_pNext;
+	pBan->m_Data = *pData;
+	pBan->m_Info = *pInfo;
+
+	// add it to the trie
+	CNetPrefix aPrefixes[MAX_PREFIXES];
+	int NumPrefixes = MakePrefixes(pData, aPrefixes);
+	for(int i = 0; i < NumPrefixes; i++)
+		m_Trie.Add(&aPrefixes[i], pBan);
+
+	// insert it into the used list
+	Insert(pBan);
 
 	// update ban count
 	++m_CountUsed;
@@ -111,32 +292,22 @@ typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Add(const T *pData,
 	return pBan;
 }
 
-template<class T, int HashCount>
-int CNetBan::CBanPool<T, HashCount>::Remove(CBan<T> *pBan)
+template<class T>
+int CNetBan::CBanPool<T>::Remove(CBan<T> *pBan)
 {
 	if(pBan == 0)
 		return -1;
 
-	// remove from hash list
-	if(pBan->m_pHashNext)
-		pBan->m_pHashNext->m_pHashPrev = pBan->m_pHashPrev;
-	if(pBan->m_pHashPrev)
-		pBan->m_pHashPrev->m_pHashNext = pBan->m_pHashNext;
-	else
-		m_aapHashList[pBan->m_NetHash.m_HashIndex][pBan->m_NetHash.m_Hash] = pBan->m_pHashNext;
-	pBan->m_pHashNext = pBan->m_pHashPrev = 0;
+	// remove from the trie
+	CNetPrefix aPrefixes[MAX_PREFIXES];
+	int NumPrefixes = MakePrefixes(&pBan->m_Data, aPrefixes);
+	for(int i = 0; i < NumPrefixes; i++)
+		m_Trie.Remove(&aPrefixes[i], pBan);
 
 	// remove from used list
-	if(pBan->m_pNext)
-		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
-	if(pBan->m_pPrev)
-		pBan->m_pPrev->m_pNext = pBan->m_pNext;
-	else
-		m_pFirstUsed = pBan->m_pNext;
+	Unlink(pBan);
 
 	// add to recycle list
-	if(m_pFirstFree)
-		m_pFirstFree->m_pPrev = pBan;
 	pBan->m_pPrev = 0;
 	pBan->m_pNext = m_pFirstFree;
 	m_pFirstFree = pBan;
@@ -147,75 +318,101 @@ int CNetBan::CBanPool<T, HashCount>::Remove(CBan<T> *pBan)
 	return 0;
 }
 
-template<class T, int HashCount>
-void CNetBan::CBanPool<T, HashCount>::Update(CBan<CDataType> *pBan, const CBanInfo *pInfo)
+template<class T>
+void CNetBan::CBanPool<T>::Update(CBan<CDataType> *pBan, const CBanInfo *pInfo)
 {
+	Unlink(pBan);
 	pBan->m_Info = *pInfo;
+	Insert(pBan);
+}
 
-	// remove from used list
+template<class T>
+void CNetBan::CBanPool<T>::Insert(CBan<T> *pBan)
+{
+	// sorted by expiry, searched from the end since new bans tend to expire last
+	CBan<T> *pPrev;
+	if(pBan->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER)
+	{
+		pPrev = m_pLastUsed;
+		if(!m_pFirstNever)
+			m_pFirstNever = pBan;
+	}
+	else
+	{
+		pPrev = m_pFirstNever ? m_pFirstNever->m_pPrev : m_pLastUsed;
+		while(pPrev && pPrev->m_Info.m_Expires > pBan->m_Info.m_Expires)
+			pPrev = pPrev->m_pPrev;
+	}
+
+	pBan->m_pPrev = pPrev;
+	pBan->m_pNext = pPrev ? pPrev->m_pNext : m_pFirstUsed;
+	if(pBan->m_pNext)
+		pBan->m_pNext->m_pPrev = pBan;
+	else
+		m_pLastUsed = pBan;
+	if(pPrev)
+		pPrev->m_pNext = pBan;
+	else
+		m_pFirstUsed = pBan;
+}
+
+template<class T>
+void CNetBan::CBanPool<T>::Unlink(CBan<T> *pBan)
+{
+	if(m_pFirstNever == pBan)
+		m_pFirstNever = pBan->m_pNext;
 	if(pBan->m_pNext)
 		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
+	else
+		m_pLastUsed = pBan->m_pPrev;
 	if(pBan->m_pPrev)
 		pBan->m_pPrev->m_pNext = pBan->m_pNext;
 	else
 		m_pFirstUsed = pBan->m_pNext;
+}
 
-	// insert it into the used list
-	if(m_pFirstUsed)
-	{
-		for(CBan<T> *p = m_pFirstUsed; ; p = p->m_pNext)
-		{
-			if(p->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER || (pInfo->m_Expires != CBanInfo::EXPIRES_NEVER && pInfo->m_Expires <= p->m_Info.m_Expires))
-			{
-				// insert before
-				pBan->m_pNext = p;
-				pBan->m_pPrev = p->m_pPrev;
-				if(p->m_pPrev)
-					p->m_pPrev->m_pNext = pBan;
-				else
-					m_pFirstUsed = pBan;
-				p->m_pPrev = pBan;
-				break;
-			}
-
-			if(!p->m_pNext)
-			{
-				// last entry
-				p->m_pNext = pBan;
-				pBan->m_pPrev = p;
-				pBan->m_pNext = 0;
-				break;
-			}
-		}
-	}
-	else
+template<class T>
+void CNetBan::CBanPool<T>::Reset()
+{
+	m_Trie.Reset();
+	while(m_pFirstChunk)
 	{
-		m_pFirstUsed = pBan;
-		pBan->m_pNext = pBan->m_pPrev = 0;
+		CChunk *pNext = m_pFirstChunk->m_pNext;
+		delete m_pFirstChunk;
+		m_pFirstChunk = pNext;
 	}
-}
 
-template<class T, int HashCount>
-void CNetBan::CBanPool<T, HashCount>::Reset()
-{
-	mem_zero(m_aapHashList, sizeof(m_aapHashList));
-	mem_zero(m_aBans, sizeof(m_aBans));
+	m_pFirstFree = 0;
 	m_pFirstUsed = 0;
+	m_pLastUsed = 0;
+	m_pFirstNever = 0;
 	m_CountUsed = 0;
+}
 
-	for(int i = 1; i < MAX_BANS-1; ++i)
+template<class T>
+typename CNetBan::CBan<T> *CNetBan::CBanPool<T>::Find(const T *pData) const
+{
+	CNetPrefix aPrefixes[MAX_PREFIXES];
+	MakePrefixes(pData, aPrefixes);
+	for(const CNetTrie::CEntry *pEntry = m_Trie.Find(&aPrefixes[0]); pEntry; pEntry = pEntry->m_pNext)
 	{
-		m_aBans[i].m_pNext = &m_aBans[i+1];
-		m_aBans[i].m_pPrev = &m_aBans[i-1];
+		CBan<T> *pBan = static_cast<CBan<T> *>(pEntry->m_pData);
+		if(NetComp(&pBan->m_Data, pData) == 0)
+			return pBan;
 	}
 
-	m_aBans[0].m_pNext = &m_aBans[1];
-	m_aBans[MAX_BANS-1].m_pPrev = &m_aBans[MAX_BANS-2];
-	m_pFirstFree = &m_aBans[0];
+	return 0;
+}
+
+template<class T>
+typename CNetBan::CBan<T> *CNetBan::CBanPool<T>::Match(const NETADDR *pAddr) const
+{
+	const CNetTrie::CEntry *pEntry = m_Trie.Longest(pAddr);
+	return pEntry ? static_cast<CBan<T> *>(pEntry->m_pData) : 0;
 }
 
-template<class T, int HashCount>
-typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Get(int Index) const
+template<class T>
+typename CNetBan::CBan<T> *CNetBan::CBanPool<T>::Get(int Index) const
 {
 	if(Index < 0 || Index >= Num())
 		return 0;
@@ -286,7 +483,8 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	// do not ban localhost
 	if(!IsBannable(pData))
 	{
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban failed (localhost)");
+		if(!m_Quiet)
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban failed (localhost)");
 		return -1;
 	}
 
@@ -300,37 +498,43 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	str_copy(Info.m_aReason, pReason, sizeof(Info.m_aReason));
 
 	// check if it already exists
-	CNetHash NetHash(pData);
-	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData);
 	if(pBan)
 	{
 		// adjust the ban
 		pBanPool->Update(pBan, &Info);
-		char aBuf[128];
-		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_LIST);
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+		if(!m_Quiet)
+		{
+			char aBuf[128];
+			MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_LIST);
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+		}
 		return 1;
 	}
 
+	// the pools grow as needed, keep them from taking all memory
+	if(m_MaxBans && m_BanAddrPool.Num()+m_BanRangePool.Num() >= m_MaxBans)
+	{
+		if(!m_Quiet)
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban failed (full banlist)");
+		return -1;
+	}
+
 	// add ban and print result
-	pBan = pBanPool->Add(pData, &Info, &NetHash);
-	if(pBan)
+	pBan = pBanPool->Add(pData, &Info);
+	if(!m_Quiet)
 	{
 		char aBuf[128];
 		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		return 0;
 	}
-	else
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban failed (full banlist)");
-	return -1;
+	return 0;
 }
 
 template<class T>
 int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 {
-	CNetHash NetHash(pData);
-	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData);
 	if(pBan)
 	{
 		char aBuf[256];
@@ -350,6 +554,8 @@ void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 	m_pStorage = pStorage;
 	m_BanAddrPool.Reset();
 	m_BanRangePool.Reset();
+	m_Quiet = false;
+	m_MaxBans = 0;
 
 	net_host_lookup("localhost", &m_LocalhostIPV4, NETTYPE_IPV4);
 	net_host_lookup("localhost", &m_LocalhostIPV6, NETTYPE_IPV6);
@@ -359,6 +565,7 @@ void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 	Console()->Register("unban_all", "", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConUnbanAll, this, "Unban all entries");
 	Console()->Register("bans", "", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBans, this, "Show banlist");
 	Console()->Register("bans_save", "s[file]", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBansSave, this, "Save banlist in a file");
+	Console()->Register("bans_import", "s[file] ?i[minutes] ?r[reason]", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBansImport, this, "Ban every IP, IP range or CIDR block listed in a file, for life by default");
 }
 
 void CNetBan::Update()
@@ -446,6 +653,72 @@ void CNetBan::UnbanAll()
 	m_BanRangePool.Reset();
 }
 
+int CNetBan::ImportBans(const char *pFilename, int Seconds, const char *pReason)
+{
+	IOHANDLE File = Storage()->OpenFile(pFilename, IOFLAG_READ|IOFLAG_SKIP_BOM, IStorage::TYPE_ALL);
+	if(!File)
+		return -1;
+
+	// one address, range or CIDR block per line, anything after it is ignored
+	int NumAdded = 0, NumUpdated = 0, NumFailed = 0;
+	CLineReader LineReader;
+	LineReader.Init(File);
+	m_Quiet = true;
+	for(const char *pLine; (pLine = LineReader.Get());)
+	{
+		pLine = str_skip_whitespaces_const(pLine);
+		if(!pLine[0] || pLine[0] == '#')
+			continue;
+
+		char aBuf[128];
+		str_copy(aBuf, pLine, minimum((int)sizeof(aBuf), (int)(str_skip_to_whitespace_const(pLine)-pLine)+1));
+		char *pSeparator = (char *)str_find(aBuf, "-");
+		char *pPrefixLength = (char *)str_find(aBuf, "/");
+
+		int Result = -1;
+		CNetRange Range;
+		if(pSeparator)
+		{
+			*pSeparator = 0;
+			if(net_addr_from_str(&Range.m_LB, aBuf) == 0 && net_addr_from_str(&Range.m_UB, pSeparator+1) == 0 && Range.IsValid())
+				Result = BanRange(&Range, Seconds, pReason);
+		}
+		else if(pPrefixLength)
+		{
+			*pPrefixLength = 0;
+			int Length = str_toint(pPrefixLength+1);
+			if(net_addr_from_str(&Range.m_LB, aBuf) == 0 && pPrefixLength[1] && str_is_number(pPrefixLength+1) == 0 && Length >= 0 && Length <= AddrBytes(&Range.m_LB)*8)
+			{
+				// the first and the last address of the block
+				const int Bits = AddrBytes(&Range.m_LB)*8;
+				Range.m_UB = Range.m_LB;
+				for(int i = Length; i < Bits; i++)
+				{
+					Range.m_LB.ip[i/8] &= ~(0x80>>(i%8));
+					Range.m_UB.ip[i/8] |= 0x80>>(i%8);
+				}
+				Result = Length == Bits ? BanAddr(&Range.m_LB, Seconds, pReason) : BanRange(&Range, Seconds, pReason);
+			}
+		}
+		else if(net_addr_from_str(&Range.m_LB, aBuf) == 0)
+			Result = BanAddr(&Range.m_LB, Seconds, pReason);
+
+		if(Result == 0)
+			NumAdded++;
+		else if(Result == 1)
+			NumUpdated++;
+		else
+			NumFailed++;
+	}
+	m_Quiet = false;
+	io_close(File);
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "imported '%s': %d added, %d updated, %d failed", pFilename, NumAdded, NumUpdated, NumFailed);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+	return NumAdded+NumUpdated;
+}
+
 template<class T>
 bool CNetBan::IsBannable(const T *pData)
 {
@@ -459,28 +732,20 @@ bool CNetBan::IsBannable(const T *pData)
 
 bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize, int *pLastInfoQuery)
 {
-	CNetHash aHash[17];
-	int Length = CNetHash::MakeHashArray(pAddr, aHash);
-
 	// check ban addresses
-	CBanAddr *pBan = m_BanAddrPool.Find(pAddr, &aHash[Length]);
+	CBanAddr *pBan = m_BanAddrPool.Match(pAddr);
 	if(pBan)
 	{
 		MakeBanInfo(pBan, pBuf, BufferSize, MSGTYPE_PLAYER, pLastInfoQuery);
 		return true;
 	}
 
-	// check ban ranges
-	for(int i = Length-1; i >= 0; --i)
+	// check ban ranges, the most specific one first
+	CBanRange *pBanRange = m_BanRangePool.Match(pAddr);
+	if(pBanRange)
 	{
-		for(CBanRange *pBan = m_BanRangePool.First(&aHash[i]); pBan; pBan = pBan->m_pHashNext)
-		{
-			if(NetMatch(&pBan->m_Data, pAddr, i, Length))
-			{
-				MakeBanInfo(pBan, pBuf, BufferSize, MSGTYPE_PLAYER, pLastInfoQuery);
-				return true;
-			}
-		}
+		MakeBanInfo(pBanRange, pBuf, BufferSize, MSGTYPE_PLAYER, pLastInfoQuery);
+		return true;
 	}
 
 	return false;
@@ -618,10 +883,27 @@ void CNetBan::ConBansSave(IConsole::IResult *pResult, void *pUser)
 	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
 }
 
+void CNetBan::ConBansImport(IConsole::IResult *pResult, void *pUser)
+{
+	CNetBan *pThis = static_cast<CNetBan *>(pUser);
+	const char *pFilename = pResult->GetString(0);
+	const int Minutes = pResult->NumArguments() > 1 ? clamp(pResult->GetInteger(1), 0, 31*24*60) : 0;
+	const char *pReason = pResult->NumArguments() > 2 ? pResult->GetString(2) : "Blocklist";
+
+	if(pThis->ImportBans(pFilename, Minutes*60, pReason) < 0)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "failed to import bans from '%s'", pFilename);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+	}
+}
+
 // explicitly instantiate template for src/engine/server/server.cpp
+template class CNetBan::CBanPool<NETADDR>;
+template class CNetBan::CBanPool<CNetRange>;
 template void CNetBan::MakeBanInfo<CNetRange>(CBan<CNetRange> *pBan, char *pBuf, unsigned BufferSize, int Type, int *pLastInfoQuery);
 template void CNetBan::MakeBanInfo<NETADDR>(CBan<NETADDR> *pBan, char *pBuf, unsigned BufferSize, int Type, int *pLastInfoQuery);
-template int CNetBan::Ban<CNetBan::CBanPool<NETADDR, 1> >(CNetBan::CBanPool<NETADDR, 1> *pBanPool, const NETADDR *pData, int Seconds, const char *pReason);
-template int CNetBan::Ban<CNetBan::CBanPool<CNetRange, 16> >(CNetBan::CBanPool<CNetRange, 16> *pBanPool, const CNetRange *pData, int Seconds, const char *pReason);
+template int CNetBan::Ban<CNetBan::CBanPool<NETADDR> >(CNetBan::CBanPool<NETADDR> *pBanPool, const NETADDR *pData, int Seconds, const char *pReason);
+template int CNetBan::Ban<CNetBan::CBanPool<CNetRange> >(CNetBan::CBanPool<CNetRange> *pBanPool, const CNetRange *pData, int Seconds, const char *pReason);
 template bool CNetBan::IsBannable<NETADDR>(const NETADDR *pData);
 template bool CNetBan::IsBannable<CNetRange>(const CNetRange *pData);
@@ -62,17 +62,64 @@ protected:
 		return pBuffer;
 	}
 
-	class CNetHash
+	// a CIDR block, ranges are split into as few of them as possible
+	struct CNetPrefix
+	{
+		NETADDR m_Addr;
+		int m_Length; // in bits
+	};
+
+	enum
+	{
+		MAX_PREFIXES=2*128,
+	};
+
+	static int MakePrefixes(const NETADDR *pAddr, CNetPrefix *pPrefixes);
+	static int MakePrefixes(const CNetRange *pRange, CNetPrefix *pPrefixes);
+
+	// binary trie over the address bits with single child paths
+	// compressed, a lookup visits at most one node per address bit. the
+	// first byte selects the root, only prefixes shorter than that share one
+	class CNetTrie
 	{
 	public:
-		int m_Hash;
-		int m_HashIndex;	// matching parts for ranges, 0 for addr
+		struct CEntry
+		{
+			void *m_pData;
+			CEntry *m_pNext;
+		};
+
+		CNetTrie() { mem_zero(m_apRoots, sizeof(m_apRoots)); }
+		~CNetTrie() { Reset(); }
+
+		void Add(const CNetPrefix *pPrefix, void *pData);
+		void Remove(const CNetPrefix *pPrefix, void *pData);
+		void Reset();
 
-		CNetHash() {}	
-		CNetHash(const NETADDR *pAddr);
-		CNetHash(const CNetRange *pRange);
+		const CEntry *Find(const CNetPrefix *pPrefix) const;
+		const CEntry *Longest(const NETADDR *pAddr) const; // entries of the longest prefix containing the address
 
-		static int MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17]);
+	private:
+		struct CNode
+		{
+			unsigned char m_aPrefix[NETADDR_SIZE_IPV6];
+			int m_Length;
+			CNode *m_apChildren[2];
+			CEntry *m_pEntries;
+		};
+
+		enum
+		{
+			ROOT_BITS=8,
+			NUM_ROOTS=1+(1<<ROOT_BITS),
+		};
+
+		CNode *m_apRoots[2*NUM_ROOTS]; // ipv4, ipv6: short prefixes, then by first byte
+
+		static int RootIndex(const NETADDR *pAddr, int Length);
+		static CNode *NewNode(const unsigned char *pPrefix, int Length);
+		static void DeleteNode(CNode *pNode);
+		static const CEntry *Longest(const CNode *pNode, const NETADDR *pAddr);
 	};
 
 	struct CBanInfo
@@ -84,69 +131,68 @@ protected:
 		};
 		int m_Expires;
 		int m_LastInfoQuery;
-		char m_aReason[REASON_LENGTH];		
+		char m_aReason[REASON_LENGTH];
 	};
 
 	template<class T> struct CBan
 	{
 		T m_Data;
 		CBanInfo m_Info;
-		CNetHash m_NetHash;
-
-		// hash list
-		CBan *m_pHashNext;
-		CBan *m_pHashPrev;
 
 		// used or free list
 		CBan *m_pNext;
 		CBan *m_pPrev;
 	};
 
-	template<class T, int HashCount> class CBanPool
+	template<class T> class CBanPool
 	{
 	public:
 		typedef T CDataType;
 
-		CBan<CDataType> *Add(const CDataType *pData, const CBanInfo *pInfo, const CNetHash *pNetHash);
+		CBanPool() : m_pFirstChunk(0) { Reset(); }
+		~CBanPool() { Reset(); }
+
+		CBan<CDataType> *Add(const CDataType *pData, const CBanInfo *pInfo);
 		int Remove(CBan<CDataType> *pBan);
 		void Update(CBan<CDataType> *pBan, const CBanInfo *pInfo);
 		void Reset();
-	
+
 		int Num() const { return m_CountUsed; }
-		bool IsFull() const { return m_CountUsed == MAX_BANS; }
 
 		CBan<CDataType> *First() const { return m_pFirstUsed; }
-		CBan<CDataType> *First(const CNetHash *pNetHash) const { return m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]; }
-		CBan<CDataType> *Find(const CDataType *pData, const CNetHash *pNetHash) const
-		{
-			for(CBan<CDataType> *pBan = m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]; pBan; pBan = pBan->m_pHashNext)
-			{
-				if(NetComp(&pBan->m_Data, pData) == 0)
-					return pBan;
-			}
-
-			return 0;
-		}
+		CBan<CDataType> *Find(const CDataType *pData) const;
+		CBan<CDataType> *Match(const NETADDR *pAddr) const;
 		CBan<CDataType> *Get(int Index) const;
 
 	private:
 		enum
 		{
-			MAX_BANS=1024,
+			BANS_PER_CHUNK=1024,
 		};
 
-		CBan<CDataType> *m_aapHashList[HashCount][256];
-		CBan<CDataType> m_aBans[MAX_BANS];
+		struct CChunk
+		{
+			CBan<CDataType> m_aBans[BANS_PER_CHUNK];
+			CChunk *m_pNext;
+		};
+
+		void Insert(CBan<CDataType> *pBan);
+		void Unlink(CBan<CDataType> *pBan);
+
+		CNetTrie m_Trie;
+		CChunk *m_pFirstChunk;
 		CBan<CDataType> *m_pFirstFree;
 		CBan<CDataType> *m_pFirstUsed;
+		CBan<CDataType> *m_pLastUsed;
+		CBan<CDataType> *m_pFirstNever; // bans without expiry are at the end of the used list
 		int m_CountUsed;
 	};
 
-	typedef CBanPool<NETADDR, 1> CBanAddrPool;
-	typedef CBanPool<CNetRange, 16> CBanRangePool;
+	typedef CBanPool<NETADDR> CBanAddrPool;
+	typedef CBanPool<CNetRange> CBanRangePool;
 	typedef CBan<NETADDR> CBanAddr;
 	typedef CBan<CNetRange> CBanRange;
-	
+
 	template<class T> void MakeBanInfo(CBan<T> *pBan, char *pBuf, unsigned BuffSize, int Type, int *pLastInfoQuery=0);
 	template<class T> int Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, const char *pReason);
 	template<class T> int Unban(T *pBanPool, const typename T::CDataType *pData);
@@ -156,6 +202,8 @@ protected:
 	CBanAddrPool m_BanAddrPool;
 	CBanRangePool m_BanRangePool;
 	NETADDR m_LocalhostIPV4, m_LocalhostIPV6;
+	bool m_Quiet;
+	int m_MaxBans;
 
 public:
 	enum
@@ -172,6 +220,7 @@ public:
 	virtual ~CNetBan() {}
 	void Init(class IConsole *pConsole, class IStorage *pStorage);
 	void Update();
+	void SetMaxBans(int MaxBans) { m_MaxBans = MaxBans; } // addresses and ranges together, 0 for no limit
 
 	virtual int BanAddr(const NETADDR *pAddr, int Seconds, const char *pReason);
 	virtual int BanRange(const CNetRange *pRange, int Seconds, const char *pReason);
@@ -179,6 +228,7 @@ public:
 	int UnbanByRange(const CNetRange *pRange);
 	int UnbanByIndex(int Index);
 	void UnbanAll();
+	int ImportBans(const char *pFilename, int Seconds, const char *pReason);
 	template<class T> bool IsBannable(const T *pData);
 	bool IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize, int *pLastInfoQuery);
 
@@ -187,6 +237,7 @@ public:
 	static void ConUnbanAll(class IConsole::IResult *pResult, void *pUser);
 	static void ConBans(class IConsole::IResult *pResult, void *pUser);
 	static void ConBansSave(class IConsole::IResult *pResult, void *pUser);
+	static void ConBansImport(class IConsole::IResult *pResult, void *pUser);
 };
 
 #endif
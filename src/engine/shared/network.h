@@ -107,7 +107,8 @@ enum
 
 	//
 	NET_MAX_CLIENTS = 64,
-	NET_MAX_CONSOLE_CLIENTS = 4,
+	NET_MAX_CONSOLE_CLIENTS = 128,
+	NET_CONSOLE_OUTPUT_SIZE = 64*1024,
 	
 	NET_MAX_SEQUENCE = 1<<10,
 	NET_SEQUENCE_MASK = NET_MAX_SEQUENCE-1,
@@ -312,6 +313,54 @@ private:
 };
 
 
+// token bucket per source address, ipv6 addresses share one per /64.
+// kept in a fixed open addressing table that forgets the least loaded
+// source when its probe window is full, so spoofed floods can't grow it
+class CNetRateLimiter
+{
+public:
+	struct CStats
+	{
+		int64 m_NumChecked;
+		int64 m_NumLimited;
+		int64 m_NumEvicted; // sources forgotten before their bucket was full again
+	};
+
+	void Init();
+	void SetRate(int PacketsPerSecond, int Burst); // 0 packets per second disables the limit
+	bool Enabled() const { return m_Interval != 0; }
+
+	bool Allow(const NETADDR *pAddr, int64 Now);
+
+	const CStats *Stats() const { return &m_Stats; }
+	int NumTracked(int64 Now) const;
+	int GetLimited(NETADDR *pAddrs, int MaxAddrs, int64 Now) const;
+
+private:
+	enum
+	{
+		NUM_ENTRIES=4096,
+		NUM_PROBES=8,
+	};
+
+	struct CEntry
+	{
+		int64 m_Tat; // when the bucket is full again
+		unsigned m_aKey[NETADDR_SIZE_IPV6/4];
+		unsigned m_Type;
+	};
+
+	CEntry m_aEntries[NUM_ENTRIES];
+	unsigned m_Seed;
+	int64 m_Interval;
+	int64 m_Tolerance;
+	CStats m_Stats;
+
+	static void MakeKey(const NETADDR *pAddr, unsigned *pKey);
+	unsigned Hash(const unsigned *pKey) const;
+};
+
+
 class CNetConnection
 {
 	// TODO: is this needed because this needs to be aware of
@@ -342,6 +391,7 @@ private:
 	NETADDR m_PeerAddr;
 
 	NETSTATS m_Stats;
+	int64 m_ResentChunks;
 	CNetBase *m_pNetBase;
 
 	//
@@ -389,10 +439,14 @@ public:
 	int64 ConnectTime() const { return m_LastUpdateTime; }
 
 	int AckSequence() const { return m_Ack; }
+	int64 ResentChunks() const { return m_ResentChunks; }
 	// The backroom is ack-NET_MAX_SEQUENCE/2. Used for knowing if we acked a packet or not
 	static int IsSeqInBackroom(int Seq, int Ack);
 };
 
+// lines to the client are buffered and written by the network thread of
+// CNetConsole. a client that doesn't keep up loses lines instead of
+// stalling the server, it is told how many once it caught up
 class CConsoleNetConnection
 {
 private:
@@ -404,21 +458,38 @@ private:
 	char m_aBuffer[NET_MAX_PACKETSIZE];
 	int m_BufferOffset;
 
+	char *m_pOutput;
+	int m_OutputStart;
+	int m_OutputEnd;
+	int m_NumDropped;
+
 	char m_aErrorString[256];
 
 	bool m_LineEndingDetected;
 	char m_aLineEnding[3];
 
+	bool Queue(const char *pLine);
+
 public:
+	CConsoleNetConnection() : m_pOutput(0) {}
+	~CConsoleNetConnection() { mem_free(m_pOutput); }
+
 	void Init(NETSOCKET Socket, const NETADDR *pAddr);
 	void Disconnect(const char *pReason);
+	void SetError(const char *pError);
 
 	int State() const { return m_State; }
 	const NETADDR *PeerAddress() const { return &m_PeerAddr; }
+	NETSOCKET Socket() const { return m_Socket; }
 	const char *ErrorString() const { return m_aErrorString; }
+	bool InputFull() const { return m_BufferOffset >= (int)sizeof(m_aBuffer); }
+	bool HasInput() const { return m_BufferOffset > 0; }
+	bool HasOutput() const { return m_OutputEnd > m_OutputStart; }
+	int NumDropped() const { return m_NumDropped; }
 
 	void Reset();
 	int Update();
+	int Flush();
 	int Send(const char *pLine);
 	int Recv(char *pLine, int MaxLength);
 };
@@ -465,6 +536,9 @@ class CNetServer : public CNetBase
 
 	CNetTokenManager m_TokenManager;
 	CNetTokenCache m_TokenCache;
+	CNetRateLimiter m_RateLimiter;
+
+	bool HasSlot(const NETADDR *pAddr) const;
 
 public:
 	//
@@ -483,33 +557,64 @@ public:
 
 	// status requests
 	const NETADDR *ClientAddr(int ClientID) const { return m_aSlots[ClientID].m_Connection.PeerAddress(); }
+	int64 ClientResentChunks(int ClientID) const { return m_aSlots[ClientID].m_Connection.ResentChunks(); }
 	class CNetBan *NetBan() const { return m_pNetBan; }
+	const CNetRateLimiter *RateLimiter() const { return &m_RateLimiter; }
 
 	//
 	void SetMaxClients(int MaxClients);
 	void SetMaxClientsPerIP(int MaxClientsPerIP);
+	void SetRateLimit(int PacketsPerSecond, int Burst) { m_RateLimiter.SetRate(PacketsPerSecond, Burst); }
 };
 
+// accepts, reads and writes the connections on its own thread, waiting
+// for them with net_poll. the owner picks up new clients, lines and
+// errors in Update and Recv, which don't touch the sockets
 class CNetConsole
 {
 	struct CSlot
 	{
 		CConsoleNetConnection m_Connection;
+		int m_PollEvents;
+		unsigned m_Accepted; // m_NumAccepted when the connection got the slot
+	};
+
+	enum
+	{
+		MAX_PENDING=16,
 	};
 
 	NETSOCKET m_Socket;
 	class CNetBan *m_pNetBan;
 	CSlot m_aSlots[NET_MAX_CONSOLE_CLIENTS];
+	int m_MaxClients;
+	int m_MaxClientsPerIP;
 
 	NETFUNC_NEWCLIENT m_pfnNewClient;
 	NETFUNC_DELCLIENT m_pfnDelClient;
 	void *m_UserPtr;
 
-	CNetRecvUnpacker m_RecvUnpacker;
+	// shared with the network thread
+	LOCK m_Lock;
+	NETPOLL m_Poll;
+	void *m_pThread;
+	volatile bool m_Shutdown;
+	volatile bool m_NewEvents; // accepted sockets or connection errors
+	volatile bool m_NewInput;
+	NETSOCKET m_aPendingSockets[MAX_PENDING];
+	NETADDR m_aPendingAddrs[MAX_PENDING];
+	int m_NumPending;
+	volatile unsigned m_NumAccepted;
+
+	static void ThreadFunc(void *pUser);
+	void Run();
+	void UpdatePollEvents(int ClientID);
 
 public:
+	CNetConsole() : m_Lock(0), m_Poll(0), m_pThread(0) {}
+
 	//
-	bool Open(NETADDR BindAddr, class CNetBan *pNetBan, NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
+	bool Open(NETADDR BindAddr, class CNetBan *pNetBan, int MaxClients, NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 	void Close();
 
 	//
@@ -517,6 +622,7 @@ public:
 	int Send(int ClientID, const char *pLine);
 	int Update();
 	void SetLingerState(int State);
+	void SetMaxClientsPerIP(int MaxClientsPerIP);
 
 	//
 	int AcceptClient(NETSOCKET Socket, const NETADDR *pAddr);
@@ -524,6 +630,7 @@ public:
 
 	// status requests
 	const NETADDR *ClientAddr(int ClientID) const { return m_aSlots[ClientID].m_Connection.PeerAddress(); }
+	int MaxClients() const { return m_MaxClients; }
 	class CNetBan *NetBan() const { return m_pNetBan; }
 };
 
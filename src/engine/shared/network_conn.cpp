@@ -25,6 +25,7 @@ void CNetConnection::Reset()
 	m_Token = NET_TOKEN_NONE;
 	m_PeerToken = NET_TOKEN_NONE;
 	mem_zero(&m_PeerAddr, sizeof(m_PeerAddr));
+	m_ResentChunks = 0;
 
 	m_Buffer.Init();
 
@@ -181,6 +182,7 @@ void CNetConnection::ResendChunk(CNetChunkResend *pResend)
 {
 	QueueChunkEx(pResend->m_Flags|NET_CHUNKFLAG_RESEND, pResend->m_DataSize, pResend->m_pData, pResend->m_Sequence);
 	pResend->m_LastSendTime = time_get();
+	m_ResentChunks++;
 }
 
 void CNetConnection::Resend()
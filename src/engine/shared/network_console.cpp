@@ -1,5 +1,6 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 
 #include <engine/console.h>
@@ -8,39 +9,163 @@
 #include "network.h"
 
 
-bool CNetConsole::Open(NETADDR BindAddr, CNetBan *pNetBan, NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser)
+bool CNetConsole::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser)
 {
-	// zero out the whole structure
-	mem_zero(this, sizeof(*this));
-	m_Socket.type = NETTYPE_INVALID;
-	m_Socket.ipv4sock = -1;
-	m_Socket.ipv6sock = -1;
 	m_pNetBan = pNetBan;
+	m_MaxClients = clamp(MaxClients, 1, int(NET_MAX_CONSOLE_CLIENTS));
+	m_MaxClientsPerIP = 1;
+	m_Shutdown = false;
+	m_NewEvents = false;
+	m_NewInput = false;
+	m_NumPending = 0;
+	m_NumAccepted = 0;
 
 	// open socket
 	m_Socket = net_tcp_create(BindAddr);
 	if(!m_Socket.type)
 		return false;
-	if(net_tcp_listen(m_Socket, NET_MAX_CONSOLE_CLIENTS))
+	if(net_tcp_listen(m_Socket, m_MaxClients) || !(m_Poll = net_poll_create()))
+	{
+		net_tcp_close(m_Socket);
 		return false;
+	}
 	net_set_non_blocking(m_Socket);
 
 	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
+	{
 		m_aSlots[i].m_Connection.Reset();
+		m_aSlots[i].m_PollEvents = -1;
+	}
 
 	m_pfnNewClient = pfnNewClient;
 	m_pfnDelClient = pfnDelClient;
 	m_UserPtr = pUser;
 
+	m_Lock = lock_create();
+	net_poll_add(m_Poll, m_Socket, NETPOLL_READ, &m_Socket);
+	m_pThread = thread_init(ThreadFunc, this);
 	return true;
 }
 
 void CNetConsole::Close()
 {
+	if(m_pThread)
+	{
+		m_Shutdown = true;
+		net_poll_wake(m_Poll);
+		thread_wait(m_pThread);
+		thread_destroy(m_pThread);
+		m_pThread = 0;
+	}
+
 	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
 		Drop(i, "Closing console");
+	for(int i = 0; i < m_NumPending; i++)
+		net_tcp_close(m_aPendingSockets[i]);
+	m_NumPending = 0;
 
 	net_tcp_close(m_Socket);
+	net_poll_destroy(m_Poll);
+	m_Poll = 0;
+	lock_destroy(m_Lock);
+	m_Lock = 0;
+}
+
+void CNetConsole::ThreadFunc(void *pUser)
+{
+	static_cast<CNetConsole *>(pUser)->Run();
+}
+
+void CNetConsole::Run()
+{
+	NETPOLL_EVENT aEvents[64];
+	while(!m_Shutdown)
+	{
+		const unsigned NumAccepted = m_NumAccepted;
+		int NumEvents = net_poll_wait(m_Poll, aEvents, sizeof(aEvents)/sizeof(aEvents[0]), -1);
+
+		lock_wait(m_Lock);
+		for(int e = 0; e < NumEvents; e++)
+		{
+			if(aEvents[e].user == &m_Socket)
+			{
+				// hand new sockets to the owner, it checks bans and slots
+				NETSOCKET Socket;
+				NETADDR Addr;
+				while(net_tcp_accept(m_Socket, &Socket, &Addr) > 0)
+				{
+					if(m_NumPending == MAX_PENDING)
+					{
+						net_tcp_close(Socket);
+						continue;
+					}
+					m_aPendingSockets[m_NumPending] = Socket;
+					m_aPendingAddrs[m_NumPending] = Addr;
+					m_NumPending++;
+					m_NewEvents = true;
+				}
+				continue;
+			}
+
+			// the events can belong to a connection the slot had before
+			const int ClientID = static_cast<CSlot *>(aEvents[e].user) - m_aSlots;
+			CConsoleNetConnection *pConnection = &m_aSlots[ClientID].m_Connection;
+			if(pConnection->State() != NET_CONNSTATE_ONLINE || (int)(m_aSlots[ClientID].m_Accepted-NumAccepted) > 0)
+				continue;
+
+			if(aEvents[e].events&NETPOLL_ERROR)
+			{
+				// hung up or failed, it would be reported again and again
+				pConnection->Update();
+				if(pConnection->HasInput())
+					m_NewInput = true;
+				pConnection->SetError("connection failure");
+			}
+			else
+			{
+				if(aEvents[e].events&NETPOLL_READ)
+				{
+					pConnection->Update();
+					if(pConnection->HasInput())
+						m_NewInput = true;
+				}
+				if(aEvents[e].events&NETPOLL_WRITE)
+					pConnection->Flush();
+			}
+
+			if(pConnection->State() == NET_CONNSTATE_ERROR)
+				m_NewEvents = true;
+			UpdatePollEvents(ClientID);
+		}
+		lock_unlock(m_Lock);
+	}
+}
+
+// called with the lock held
+void CNetConsole::UpdatePollEvents(int ClientID)
+{
+	CSlot *pSlot = &m_aSlots[ClientID];
+	if(pSlot->m_PollEvents < 0)
+		return;
+
+	// errors are reported regardless of the interest, so broken connections leave the set until they get dropped
+	if(pSlot->m_Connection.State() != NET_CONNSTATE_ONLINE)
+	{
+		net_poll_remove(m_Poll, pSlot->m_Connection.Socket());
+		pSlot->m_PollEvents = -1;
+		return;
+	}
+
+	int Events = 0;
+	if(!pSlot->m_Connection.InputFull())
+		Events |= NETPOLL_READ;
+	if(pSlot->m_Connection.HasOutput())
+		Events |= NETPOLL_WRITE;
+	if(Events != pSlot->m_PollEvents)
+	{
+		net_poll_modify(m_Poll, pSlot->m_Connection.Socket(), Events, pSlot);
+		pSlot->m_PollEvents = Events;
+	}
 }
 
 void CNetConsole::Drop(int ClientID, const char *pReason)
@@ -51,24 +176,33 @@ void CNetConsole::Drop(int ClientID, const char *pReason)
 	if(m_pfnDelClient)
 		m_pfnDelClient(ClientID, pReason, m_UserPtr);
 
+	lock_wait(m_Lock);
+	if(m_aSlots[ClientID].m_PollEvents >= 0)
+		net_poll_remove(m_Poll, m_aSlots[ClientID].m_Connection.Socket());
 	m_aSlots[ClientID].m_Connection.Disconnect(pReason);
+	m_aSlots[ClientID].m_PollEvents = -1;
+	lock_unlock(m_Lock);
 }
 
 int CNetConsole::AcceptClient(NETSOCKET Socket, const NETADDR *pAddr)
 {
 	char aError[256] = { 0 };
 	int FreeSlot = -1;
+	int FoundAddr = 0;
 
 	// look for free slot or multiple client
-	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
+	for(int i = 0; i < m_MaxClients; i++)
 	{
 		if(FreeSlot == -1 && m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
 			FreeSlot = i;
 		if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE)
 		{
-			if(net_addr_comp(pAddr, m_aSlots[i].m_Connection.PeerAddress(), true) == 0)
+			if(net_addr_comp(pAddr, m_aSlots[i].m_Connection.PeerAddress(), false) == 0 && ++FoundAddr >= m_MaxClientsPerIP)
 			{
-				str_copy(aError, "only one client per IP allowed", sizeof(aError));
+				if(m_MaxClientsPerIP == 1)
+					str_copy(aError, "only one client per IP allowed", sizeof(aError));
+				else
+					str_format(aError, sizeof(aError), "only %d clients per IP allowed", m_MaxClientsPerIP);
 				break;
 			}
 		}
@@ -77,7 +211,12 @@ int CNetConsole::AcceptClient(NETSOCKET Socket, const NETADDR *pAddr)
 	// accept client
 	if(!aError[0] && FreeSlot != -1)
 	{
+		lock_wait(m_Lock);
 		m_aSlots[FreeSlot].m_Connection.Init(Socket, pAddr);
+		m_aSlots[FreeSlot].m_PollEvents = NETPOLL_READ;
+		m_aSlots[FreeSlot].m_Accepted = ++m_NumAccepted;
+		net_poll_add(m_Poll, Socket, NETPOLL_READ, &m_aSlots[FreeSlot]);
+		lock_unlock(m_Lock);
 		if(m_pfnNewClient)
 			m_pfnNewClient(FreeSlot, m_UserPtr);
 		return 0;
@@ -95,62 +234,95 @@ int CNetConsole::AcceptClient(NETSOCKET Socket, const NETADDR *pAddr)
 
 int CNetConsole::Update()
 {
-	NETSOCKET Socket;
-	NETADDR Addr;
+	if(!m_NewEvents)
+		return 0;
+
+	NETSOCKET aSockets[MAX_PENDING];
+	NETADDR aAddrs[MAX_PENDING];
+	int aErrors[NET_MAX_CONSOLE_CLIENTS];
+	int NumErrors = 0;
+
+	lock_wait(m_Lock);
+	m_NewEvents = false;
+	const int NumPending = m_NumPending;
+	mem_copy(aSockets, m_aPendingSockets, sizeof(NETSOCKET)*NumPending);
+	mem_copy(aAddrs, m_aPendingAddrs, sizeof(NETADDR)*NumPending);
+	m_NumPending = 0;
+	for(int i = 0; i < m_MaxClients; i++)
+	{
+		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR)
+			aErrors[NumErrors++] = i;
+	}
+	lock_unlock(m_Lock);
 
-	if(net_tcp_accept(m_Socket, &Socket, &Addr) > 0)
+	// the callbacks send lines, so the lock is not held for them
+	for(int i = 0; i < NumPending; i++)
 	{
 		// check if we just should drop the packet
 		char aBuf[128];
 		int LastInfoQuery;
-		if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf), &LastInfoQuery))
+		if(NetBan() && NetBan()->IsBanned(&aAddrs[i], aBuf, sizeof(aBuf), &LastInfoQuery))
 		{
 			// banned, reply with a message (5 second cooldown) and drop
 			int Time = time_timestamp();
 			if(LastInfoQuery + 5 < Time)
 			{
-				net_tcp_send(Socket, aBuf, str_length(aBuf));
+				net_tcp_send(aSockets[i], aBuf, str_length(aBuf));
 			}
-			net_tcp_close(Socket);
+			net_tcp_close(aSockets[i]);
 		}
 		else
-			AcceptClient(Socket, &Addr);
+			AcceptClient(aSockets[i], &aAddrs[i]);
 	}
 
-	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
-	{
-		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ONLINE)
-			m_aSlots[i].m_Connection.Update();
-		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR)
-			Drop(i, m_aSlots[i].m_Connection.ErrorString());
-	}
+	for(int i = 0; i < NumErrors; i++)
+		Drop(aErrors[i], m_aSlots[aErrors[i]].m_Connection.ErrorString());
 
 	return 0;
 }
 
 int CNetConsole::Recv(char *pLine, int MaxLength, int *pClientID)
 {
-	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
+	if(!m_NewInput)
+		return 0;
+
+	lock_wait(m_Lock);
+	for(int i = 0; i < m_MaxClients; i++)
 	{
-		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ONLINE && m_aSlots[i].m_Connection.Recv(pLine, MaxLength))
+		CConsoleNetConnection *pConnection = &m_aSlots[i].m_Connection;
+		if(pConnection->State() == NET_CONNSTATE_ONLINE && pConnection->HasInput() && pConnection->Recv(pLine, MaxLength))
 		{
+			UpdatePollEvents(i);
+			lock_unlock(m_Lock);
 			if(pClientID)
 				*pClientID = i;
 			return 1;
 		}
 	}
+	m_NewInput = false;
+	lock_unlock(m_Lock);
 	return 0;
 }
 
 int CNetConsole::Send(int ClientID, const char *pLine)
 {
+	lock_wait(m_Lock);
+	int Result = -1;
 	if(m_aSlots[ClientID].m_Connection.State() == NET_CONNSTATE_ONLINE)
-		return m_aSlots[ClientID].m_Connection.Send(pLine);
-	else
-		return -1;
+	{
+		Result = m_aSlots[ClientID].m_Connection.Send(pLine);
+		UpdatePollEvents(ClientID);
+	}
+	lock_unlock(m_Lock);
+	return Result;
 }
 
 void CNetConsole::SetLingerState(int State)
 {
 	net_tcp_set_linger(m_Socket, State);
 }
+
+void CNetConsole::SetMaxClientsPerIP(int MaxClientsPerIP)
+{
+	m_MaxClientsPerIP = clamp(MaxClientsPerIP, 1, int(NET_MAX_CONSOLE_CLIENTS));
+}
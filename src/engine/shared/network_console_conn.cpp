@@ -15,6 +15,12 @@ void CConsoleNetConnection::Reset()
 	m_aBuffer[0] = 0;
 	m_BufferOffset = 0;
 
+	mem_free(m_pOutput);
+	m_pOutput = 0;
+	m_OutputStart = 0;
+	m_OutputEnd = 0;
+	m_NumDropped = 0;
+
 	m_LineEndingDetected = false;
 	#if defined(CONF_FAMILY_WINDOWS)
 		m_aLineEnding[0] = '\r';
@@ -34,6 +40,7 @@ void CConsoleNetConnection::Init(NETSOCKET Socket, const NETADDR *pAddr)
 	m_Socket = Socket;
 	net_set_non_blocking(m_Socket);
 
+	m_pOutput = (char *)mem_alloc(NET_CONSOLE_OUTPUT_SIZE);
 	m_PeerAddr = *pAddr;
 	m_State = NET_CONNSTATE_ONLINE;
 }
@@ -43,20 +50,37 @@ void CConsoleNetConnection::Disconnect(const char *pReason)
 	if(State() == NET_CONNSTATE_OFFLINE)
 		return;
 
+	// whatever fits into the socket buffer right now
 	if(pReason && pReason[0])
-		Send(pReason);
+		Queue(pReason);
+	Flush();
 
 	net_tcp_close(m_Socket);
 
 	Reset();
 }
 
+void CConsoleNetConnection::SetError(const char *pError)
+{
+	if(State() != NET_CONNSTATE_ONLINE)
+		return;
+
+	m_State = NET_CONNSTATE_ERROR;
+	str_copy(m_aErrorString, pError, sizeof(m_aErrorString));
+}
+
 int CConsoleNetConnection::Update()
 {
 	if(State() == NET_CONNSTATE_ONLINE)
 	{
-		if((int)(sizeof(m_aBuffer)) <= m_BufferOffset)
+		// wait until the lines got fetched, unless there are none
+		if(InputFull())
 		{
+			for(int i = 0; i < m_BufferOffset; i++)
+			{
+				if(m_aBuffer[i] == '\r' || m_aBuffer[i] == '\n')
+					return 0;
+			}
 			m_State = NET_CONNSTATE_ERROR;
 			str_copy(m_aErrorString, "too weak connection (out of buffer)", sizeof(m_aErrorString));
 			return -1;
@@ -151,11 +175,8 @@ int CConsoleNetConnection::Recv(char *pLine, int MaxLength)
 	return 0;
 }
 
-int CConsoleNetConnection::Send(const char *pLine)
+bool CConsoleNetConnection::Queue(const char *pLine)
 {
-	if(State() != NET_CONNSTATE_ONLINE)
-		return -1;
-
 	char aBuf[1024];
 	str_copy(aBuf, pLine, (int)(sizeof(aBuf))-2);
 	int Length = str_length(aBuf);
@@ -163,24 +184,62 @@ int CConsoleNetConnection::Send(const char *pLine)
 	aBuf[Length+1] = m_aLineEnding[1];
 	aBuf[Length+2] = m_aLineEnding[2];
 	Length += 3;
-	const char *pData = aBuf;
 
-	while(true)
+	if(m_OutputEnd+Length > NET_CONSOLE_OUTPUT_SIZE)
+	{
+		mem_move(m_pOutput, m_pOutput+m_OutputStart, m_OutputEnd-m_OutputStart);
+		m_OutputEnd -= m_OutputStart;
+		m_OutputStart = 0;
+		if(m_OutputEnd+Length > NET_CONSOLE_OUTPUT_SIZE)
+			return false;
+	}
+	mem_copy(m_pOutput+m_OutputEnd, aBuf, Length);
+	m_OutputEnd += Length;
+	return true;
+}
+
+int CConsoleNetConnection::Flush()
+{
+	while(State() == NET_CONNSTATE_ONLINE && HasOutput())
 	{
-		int Send = net_tcp_send(m_Socket, pData, Length);
-		if(Send < 0)
+		int Sent = net_tcp_send(m_Socket, m_pOutput+m_OutputStart, m_OutputEnd-m_OutputStart);
+		if(Sent < 0)
 		{
+			if(net_would_block())
+				return 0;
+
 			m_State = NET_CONNSTATE_ERROR;
 			str_copy(m_aErrorString, "failed to send packet", sizeof(m_aErrorString));
 			return -1;
 		}
+		m_OutputStart += Sent;
 
-		if(Send >= Length)
-			break;
-
-		pData += Send;
-		Length -= Send;
+		if(!HasOutput())
+		{
+			m_OutputStart = 0;
+			m_OutputEnd = 0;
+			if(m_NumDropped)
+			{
+				char aBuf[64];
+				str_format(aBuf, sizeof(aBuf), "[%d lines dropped]", m_NumDropped);
+				m_NumDropped = 0;
+				Queue(aBuf);
+			}
+		}
 	}
+	return 0;
+}
 
+int CConsoleNetConnection::Send(const char *pLine)
+{
+	if(State() != NET_CONNSTATE_ONLINE)
+		return -1;
+
+	// keep dropping until the client caught up, so the notice comes in order
+	if(m_NumDropped || !Queue(pLine))
+	{
+		m_NumDropped++;
+		return -1;
+	}
 	return 0;
 }
@@ -0,0 +1,114 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include "network.h"
+
+void CNetRateLimiter::Init()
+{
+	mem_zero(m_aEntries, sizeof(m_aEntries));
+	mem_zero(&m_Stats, sizeof(m_Stats));
+	secure_random_fill(&m_Seed, sizeof(m_Seed));
+	m_Interval = 0;
+	m_Tolerance = 0;
+}
+
+void CNetRateLimiter::SetRate(int PacketsPerSecond, int Burst)
+{
+	m_Interval = PacketsPerSecond > 0 ? maximum(time_freq()/PacketsPerSecond, (int64)1) : 0;
+	m_Tolerance = m_Interval*maximum(Burst, 1);
+}
+
+void CNetRateLimiter::MakeKey(const NETADDR *pAddr, unsigned *pKey)
+{
+	unsigned char aKey[NETADDR_SIZE_IPV6] = {0};
+	mem_copy(aKey, pAddr->ip, pAddr->type==NETTYPE_IPV4 ? NETADDR_SIZE_IPV4 : NETADDR_SIZE_IPV6/2);
+	mem_copy(pKey, aKey, sizeof(aKey));
+}
+
+unsigned CNetRateLimiter::Hash(const unsigned *pKey) const
+{
+	// seeded, so the slots can't be predicted from the addresses
+	unsigned Hash = m_Seed;
+	for(int i = 0; i < NETADDR_SIZE_IPV6/4; i++)
+	{
+		Hash = (Hash^pKey[i])*0x9e3779b1u;
+		Hash ^= Hash>>15;
+	}
+	return Hash;
+}
+
+bool CNetRateLimiter::Allow(const NETADDR *pAddr, int64 Now)
+{
+	if(!m_Interval)
+		return true;
+	m_Stats.m_NumChecked++;
+
+	unsigned aKey[NETADDR_SIZE_IPV6/4];
+	MakeKey(pAddr, aKey);
+	const unsigned Index = Hash(aKey);
+	CEntry *pEntry = 0;
+	CEntry *pOldest = 0;
+	for(int i = 0; i < NUM_PROBES; i++)
+	{
+		CEntry *pProbe = &m_aEntries[(Index+i)&(NUM_ENTRIES-1)];
+		if(pProbe->m_Type == pAddr->type && mem_comp(pProbe->m_aKey, aKey, sizeof(aKey)) == 0)
+		{
+			pEntry = pProbe;
+			break;
+		}
+		if(!pOldest || pProbe->m_Tat < pOldest->m_Tat)
+			pOldest = pProbe;
+	}
+
+	if(!pEntry)
+	{
+		// a full bucket is the same as none
+		if(pOldest->m_Tat > Now)
+			m_Stats.m_NumEvicted++;
+		pEntry = pOldest;
+		pEntry->m_Tat = Now;
+		mem_copy(pEntry->m_aKey, aKey, sizeof(aKey));
+		pEntry->m_Type = pAddr->type;
+	}
+
+	// every packet takes one interval of the tolerance, dropped ones don't
+	const int64 Tat = maximum(pEntry->m_Tat, Now)+m_Interval;
+	if(Tat-Now > m_Tolerance)
+	{
+		m_Stats.m_NumLimited++;
+		return false;
+	}
+	pEntry->m_Tat = Tat;
+	return true;
+}
+
+int CNetRateLimiter::NumTracked(int64 Now) const
+{
+	int Num = 0;
+	for(int i = 0; i < NUM_ENTRIES; i++)
+		Num += m_aEntries[i].m_Tat > Now;
+	return Num;
+}
+
+int CNetRateLimiter::GetLimited(NETADDR *pAddrs, int MaxAddrs, int64 Now) const
+{
+	if(!m_Interval)
+		return 0;
+
+	// the ones whose next packet would be dropped
+	int Num = 0;
+	for(int i = 0; i < NUM_ENTRIES && Num < MaxAddrs; i++)
+	{
+		const CEntry *pEntry = &m_aEntries[i];
+		if(pEntry->m_Tat+m_Interval-Now <= m_Tolerance)
+			continue;
+
+		mem_zero(&pAddrs[Num], sizeof(pAddrs[Num]));
+		pAddrs[Num].type = pEntry->m_Type;
+		mem_copy(pAddrs[Num].ip, pEntry->m_aKey, sizeof(pAddrs[Num].ip));
+		Num++;
+	}
+	return Num;
+}
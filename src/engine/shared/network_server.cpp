@@ -26,6 +26,7 @@ bool CNetServer::Open(NETADDR BindAddr, CConfig *pConfig, IConsole *pConsole, IE
 
 	m_TokenManager.Init(this);
 	m_TokenCache.Init(this, &m_TokenManager);
+	m_RateLimiter.Init();
 
 	m_NumClients = 0;
 	SetMaxClients(MaxClients);
@@ -88,6 +89,16 @@ int CNetServer::Update()
 	return 0;
 }
 
+bool CNetServer::HasSlot(const NETADDR *pAddr) const
+{
+	for(int i = 0; i < NET_MAX_CLIENTS; i++)
+	{
+		if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE && net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), pAddr, true) == 0)
+			return true;
+	}
+	return false;
+}
+
 /*
 	TODO: chopp up this function into smaller working parts
 */
@@ -108,6 +119,14 @@ int CNetServer::Recv(CNetChunk *pChunk, TOKEN *pResponseToken)
 
 		if(!Result)
 		{
+			// shed floods before doing anything else. connless packets are
+			// limited, control packets only without a connection, so keepalives
+			// and closes of established connections always get through
+			if(((m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS) ||
+				((m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONTROL) && !HasSlot(&Addr))) &&
+				!m_RateLimiter.Allow(&Addr, time_get()))
+				continue;
+
 			// check for bans
 			char aBuf[128];
 			int LastInfoQuery;
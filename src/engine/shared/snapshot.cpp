@@ -152,7 +152,7 @@ static int DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
 	return Needed;
 }
 
-static void UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, int *pDataRate)
+static void UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, int64 *pDataRate)
 {
 	while(Size)
 	{
@@ -263,6 +263,8 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pD
 					*pData++ = ItemSize/4;
 				pData += ItemSize/4;
 				pDelta->m_NumUpdateItems++;
+				m_aSnapshotDataRate[pCurItem->Type()] += ItemSize*8;
+				m_aSnapshotDataUpdates[pCurItem->Type()]++;
 			}
 		}
 		else
@@ -275,6 +277,8 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pD
 			mem_copy(pData, pCurItem->Data(), ItemSize);
 			pData += ItemSize/4;
 			pDelta->m_NumUpdateItems++;
+			m_aSnapshotDataRate[pCurItem->Type()] += ItemSize*8;
+			m_aSnapshotDataUpdates[pCurItem->Type()]++;
 		}
 	}
 
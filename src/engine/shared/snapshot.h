@@ -77,14 +77,17 @@ private:
 		MAX_NETOBJSIZES=64
 	};
 	short m_aItemSizes[MAX_NETOBJSIZES];
-	int m_aSnapshotDataRate[CSnapshot::MAX_TYPE + 1];
-	int m_aSnapshotDataUpdates[CSnapshot::MAX_TYPE + 1];
+
+	// bits and number of the updated items, counted in both directions.
+	// unpacking counts the packed size, creating the raw one
+	int64 m_aSnapshotDataRate[CSnapshot::MAX_TYPE + 1];
+	int64 m_aSnapshotDataUpdates[CSnapshot::MAX_TYPE + 1];
 	CData m_Empty;
 
 public:
 	CSnapshotDelta();
-	int GetDataRate(int Index) const { return m_aSnapshotDataRate[Index]; }
-	int GetDataUpdates(int Index) const { return m_aSnapshotDataUpdates[Index]; }
+	int64 GetDataRate(int Index) const { return m_aSnapshotDataRate[Index]; }
+	int64 GetDataUpdates(int Index) const { return m_aSnapshotDataUpdates[Index]; }
 	void SetStaticsize(int ItemType, int Size);
 	const CData *EmptyDelta() const;
 	int CreateDelta(const class CSnapshot *pFrom, class CSnapshot *pTo, void *pDstData);
@@ -14,7 +14,8 @@ class CStorage : public IStorage
 public:
 	enum
 	{
-		MAX_PATHS = 16
+		MAX_PATHS = 16,
+		NUM_IO_THREADS = 2,
 	};
 
 	char m_aaStoragePaths[MAX_PATHS][IO_MAX_PATH_LENGTH];
@@ -24,6 +25,10 @@ public:
 	char m_aCurrentDir[IO_MAX_PATH_LENGTH];
 	char m_aAppDir[IO_MAX_PATH_LENGTH];
 
+	// started with the first asynchronous read, the server never needs it
+	CJobPool m_IoPool;
+	bool m_IoPoolStarted;
+
 	CStorage()
 	{
 		mem_zero(m_aaStoragePaths, sizeof(m_aaStoragePaths));
@@ -32,6 +37,7 @@ public:
 		m_aUserDir[0] = 0;
 		m_aCurrentDir[0] = 0;
 		m_aAppDir[0] = 0;
+		m_IoPoolStarted = false;
 	}
 
 	int Init(const char *pApplicationName, int StorageType, int NumArgs, const char **ppArguments)
@@ -417,6 +423,39 @@ public:
 		return pResult;
 	}
 
+	static int FileReadJob(void *pUser)
+	{
+		CFileRead *pRead = (CFileRead *)pUser;
+		pRead->m_Success = pRead->m_pStorage->ReadFile(pRead->m_aFilename, pRead->m_StorageType, &pRead->m_pData, &pRead->m_DataSize);
+		if(pRead->m_pfnCallback)
+			pRead->m_pfnCallback(pRead);
+		return pRead->m_Success ? 0 : -1;
+	}
+
+	virtual void ReadFileAsync(CFileRead *pRead, const char *pFilename, int Type, CFileRead::FReadCallback pfnCallback, void *pUser, CJobGroup *pGroup)
+	{
+		if(!m_IoPoolStarted)
+		{
+			m_IoPool.Init(NUM_IO_THREADS);
+			m_IoPoolStarted = true;
+		}
+
+		str_copy(pRead->m_aFilename, pFilename, sizeof(pRead->m_aFilename));
+		pRead->m_StorageType = Type;
+		pRead->m_pStorage = this;
+		pRead->m_pfnCallback = pfnCallback;
+		pRead->m_pUser = pUser;
+		pRead->m_Success = false;
+		pRead->m_pData = 0;
+		pRead->m_DataSize = 0;
+		m_IoPool.Add(&pRead->m_Job, FileReadJob, pRead, pGroup);
+	}
+
+	virtual void WaitFileReads(CJobGroup *pGroup)
+	{
+		m_IoPool.Wait(pGroup);
+	}
+
 	struct CFindCBData
 	{
 		CStorage *m_pStorage;
@@ -32,6 +32,8 @@ public:
 	virtual bool IsSoundEnabled() = 0;
 
 	virtual CSampleHandle LoadWV(const char *pFilename) = 0;
+	// decodes a file that is already in memory, can run on other threads
+	virtual CSampleHandle LoadWVData(const void *pFileData, unsigned FileSize, const char *pFilename) = 0;
 
 	virtual void SetChannelVolume(int ChannelID, float Volume) = 0;
 	virtual void SetListenerPos(float x, float y) = 0;
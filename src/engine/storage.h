@@ -4,8 +4,30 @@
 #define ENGINE_STORAGE_H
 
 #include <base/hash.h>
+#include <engine/shared/jobs.h>
 #include "kernel.h"
 
+class CFileRead
+{
+public:
+	typedef void (*FReadCallback)(CFileRead *pRead);
+
+	CJob m_Job;
+	char m_aFilename[IO_MAX_PATH_LENGTH];
+	int m_StorageType;
+	class IStorage *m_pStorage;
+
+	// runs on the io thread once the file is read, also when it failed.
+	// it may decode the data, replace it or take it over
+	FReadCallback m_pfnCallback;
+	void *m_pUser;
+
+	// valid once the job is done, the data has to be freed with mem_free
+	bool m_Success;
+	void *m_pData;
+	unsigned m_DataSize;
+};
+
 class IStorage : public IInterface
 {
 	MACRO_INTERFACE("storage", 0)
@@ -27,6 +49,13 @@ public:
 	virtual IOHANDLE OpenFile(const char *pFilename, int Flags, int Type, char *pBuffer = 0, int BufferSize = 0, FCheckCallback pfnCheckCB = 0, const void *pCheckCBData = 0) = 0;
 	virtual bool ReadFile(const char *pFilename, int Type, void **ppResult, unsigned *pResultLen) = 0;
 	virtual char *ReadFileStr(const char *pFilename, int Type) = 0;
+
+	// reads the file on one of the io threads, poll pRead->m_Job.Status()
+	// or add it to a group and wait for that. call from the main thread
+	virtual void ReadFileAsync(CFileRead *pRead, const char *pFilename, int Type, CFileRead::FReadCallback pfnCallback = 0, void *pUser = 0, CJobGroup *pGroup = 0) = 0;
+	// reads files of the group on the calling thread as well until all are done
+	virtual void WaitFileReads(CJobGroup *pGroup) = 0;
+
 	virtual bool FindFile(const char *pFilename, const char *pPath, int Type, char *pBuffer, int BufferSize) = 0;
 	virtual bool FindFile(const char *pFilename, const char *pPath, int Type, char *pBuffer, int BufferSize, const SHA256_DIGEST *pWantedSha256, unsigned WantedCrc, unsigned WantedSize) = 0;
 	virtual bool RemoveFile(const char *pFilename, int Type) = 0;
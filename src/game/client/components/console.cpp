@@ -849,7 +849,7 @@ void CGameConsole::ConDumpCommands(IConsole::IResult *pResult, void *pUserData)
 }
 #endif
 
-void CGameConsole::ClientConsolePrintCallback(const char *pStr, void *pUserData, bool Highlighted)
+void CGameConsole::ClientConsolePrintCallback(const char *pStr, void *pUserData, int Level, const char *pFrom, bool Highlighted)
 {
 	((CGameConsole *)pUserData)->m_LocalConsole.PrintLine(pStr, Highlighted);
 }
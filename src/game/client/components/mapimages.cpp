@@ -16,6 +16,17 @@ CMapImages::CMapImages()
 	m_EasterIsLoaded = false;
 }
 
+void CMapImages::DecodeImage(CFileRead *pRead)
+{
+	CImageLoad *pLoad = (CImageLoad *)pRead->m_pUser;
+	pLoad->m_Decoded = false;
+	if(!pRead->m_Success)
+		return;
+	pLoad->m_Decoded = pLoad->m_pGraphics->LoadPNGData(&pLoad->m_Info, pRead->m_pData, pRead->m_DataSize, pRead->m_aFilename);
+	mem_free(pRead->m_pData);
+	pRead->m_pData = 0;
+}
+
 void CMapImages::LoadMapImages(IMap *pMap, class CLayers *pLayers, int MapType)
 {
 	if(MapType < 0 || MapType >= NUM_MAP_TYPES)
@@ -30,6 +41,25 @@ void CMapImages::LoadMapImages(IMap *pMap, class CLayers *pLayers, int MapType)
 	pMap->GetType(MAPITEMTYPE_IMAGE, &Start, &m_Info[MapType].m_Count);
 	m_Info[MapType].m_Count = clamp(m_Info[MapType].m_Count, 0, int(MAX_TEXTURES));
 
+	// start reading the external images, then decompress the embedded ones at once
+	int aImageData[MAX_TEXTURES];
+	int NumImageData = 0;
+	for(int i = 0; i < m_Info[MapType].m_Count; i++)
+	{
+		CMapItemImage *pImg = (CMapItemImage *)pMap->GetItem(Start+i, 0, 0);
+		if(!pImg->m_External && (pImg->m_Version == 1 || pImg->m_Format == CImageInfo::FORMAT_RGB || pImg->m_Format == CImageInfo::FORMAT_RGBA))
+			aImageData[NumImageData++] = pImg->m_ImageData;
+		else
+		{
+			char Buf[IO_MAX_PATH_LENGTH];
+			char *pName = (char *)pMap->GetData(pImg->m_ImageName);
+			str_format(Buf, sizeof(Buf), "mapres/%s.png", pName);
+			m_aImageLoads[i].m_pGraphics = Graphics();
+			Storage()->ReadFileAsync(&m_aImageLoads[i].m_Read, Buf, IStorage::TYPE_ALL, DecodeImage, &m_aImageLoads[i], &m_ImageLoads);
+		}
+	}
+	pMap->PrefetchData(aImageData, NumImageData);
+
 	// load new textures
 	for(int i = 0; i < m_Info[MapType].m_Count; i++)
 	{
@@ -50,10 +80,15 @@ void CMapImages::LoadMapImages(IMap *pMap, class CLayers *pLayers, int MapType)
 		CMapItemImage *pImg = (CMapItemImage *)pMap->GetItem(Start+i, 0, 0);
 		if(pImg->m_External || (pImg->m_Version > 1 && pImg->m_Format != CImageInfo::FORMAT_RGB && pImg->m_Format != CImageInfo::FORMAT_RGBA))
 		{
-			char Buf[IO_MAX_PATH_LENGTH];
-			char *pName = (char *)pMap->GetData(pImg->m_ImageName);
-			str_format(Buf, sizeof(Buf), "mapres/%s.png", pName);
-			m_Info[MapType].m_aTextures[i] = Graphics()->LoadTexture(Buf, IStorage::TYPE_ALL, CImageInfo::FORMAT_AUTO, TextureFlags);
+			CImageLoad *pLoad = &m_aImageLoads[i];
+			Storage()->WaitFileReads(&m_ImageLoads);
+			if(pLoad->m_Decoded)
+			{
+				m_Info[MapType].m_aTextures[i] = Graphics()->LoadTextureRaw(pLoad->m_Info.m_Width, pLoad->m_Info.m_Height, pLoad->m_Info.m_Format, pLoad->m_Info.m_pData, pLoad->m_Info.m_Format, TextureFlags);
+				mem_free(pLoad->m_Info.m_pData);
+			}
+			else // logs the error and gives the invalid texture
+				m_Info[MapType].m_aTextures[i] = Graphics()->LoadTexture(pLoad->m_Read.m_aFilename, IStorage::TYPE_ALL, CImageInfo::FORMAT_AUTO, TextureFlags);
 		}
 		else
 		{
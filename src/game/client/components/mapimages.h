@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #ifndef GAME_CLIENT_COMPONENTS_MAPIMAGES_H
 #define GAME_CLIENT_COMPONENTS_MAPIMAGES_H
+#include <engine/storage.h>
 #include <game/client/component.h>
 
 class CMapImages : public CComponent
@@ -23,6 +24,17 @@ class CMapImages : public CComponent
 	IGraphics::CTextureHandle m_EasterTexture;
 	bool m_EasterIsLoaded;
 
+	// external images are read and decoded by the io threads
+	struct CImageLoad
+	{
+		CFileRead m_Read;
+		IGraphics *m_pGraphics;
+		bool m_Decoded;
+		CImageInfo m_Info;
+	} m_aImageLoads[MAX_TEXTURES];
+	CJobGroup m_ImageLoads;
+
+	static void DecodeImage(CFileRead *pRead);
 	void LoadMapImages(class IMap *pMap, class CLayers *pLayers, int MapType);
 
 public:
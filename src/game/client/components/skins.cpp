@@ -44,37 +44,59 @@ int CSkins::SkinPartScan(const char *pName, int IsDir, int DirType, void *pUser)
 	str_copy(Part.m_aName, pName, minimum<int>(PartNameSize + 1, sizeof(Part.m_aName)));
 	if(pSelf->FindSkinPart(pSelf->m_ScanningPart, Part.m_aName, true) != -1)
 		return 0;
-
-	char aBuf[IO_MAX_PATH_LENGTH];
-	str_format(aBuf, sizeof(aBuf), "skins/%s/%s", CSkins::ms_apSkinPartNames[pSelf->m_ScanningPart], pName);
-	CImageInfo Info;
-	if(!pSelf->Graphics()->LoadPNG(&Info, aBuf, DirType))
-	{
-		str_format(aBuf, sizeof(aBuf), "failed to load skin part '%s'", pName);
-		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
-		return 0;
-	}
-	if(Info.m_Format != CImageInfo::FORMAT_RGBA)
+	for(int i = 0; i < pSelf->m_lpPartLoads.size(); i++)
 	{
-		str_format(aBuf, sizeof(aBuf), "failed to load skin part '%s': must be RGBA format", pName);
-		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
-		return 0;
+		if(pSelf->m_lpPartLoads[i]->m_Type == pSelf->m_ScanningPart && str_comp(pSelf->m_lpPartLoads[i]->m_Part.m_aName, Part.m_aName) == 0)
+			return 0;
 	}
-
-	Part.m_OrgTexture = pSelf->Graphics()->LoadTextureRaw(Info.m_Width, Info.m_Height, Info.m_Format, Info.m_pData, Info.m_Format, 0);
 	Part.m_BloodColor = vec3(1.0f, 1.0f, 1.0f);
 
-	const int Step = Info.GetPixelSize();
-	unsigned char *pData = (unsigned char *)Info.m_pData;
+	// set skin part data
+	Part.m_Flags = 0;
+	if(pName[0] == 'x' && pName[1] == '_')
+		Part.m_Flags |= SKINFLAG_SPECIAL;
+	if(DirType != IStorage::TYPE_SAVE)
+		Part.m_Flags |= SKINFLAG_STANDARD;
+
+	CSkinPartLoad *pLoad = new CSkinPartLoad;
+	pLoad->m_pSkins = pSelf;
+	pLoad->m_Type = pSelf->m_ScanningPart;
+	str_copy(pLoad->m_aFilename, pName, sizeof(pLoad->m_aFilename));
+	pLoad->m_Part = Part;
+	pLoad->m_Decoded = false;
+	pLoad->m_pColorlessData = 0;
+	pSelf->m_lpPartLoads.add(pLoad);
+
+	char aBuf[IO_MAX_PATH_LENGTH];
+	str_format(aBuf, sizeof(aBuf), "skins/%s/%s", CSkins::ms_apSkinPartNames[pSelf->m_ScanningPart], pName);
+	pSelf->Storage()->ReadFileAsync(&pLoad->m_Read, aBuf, DirType, SkinPartDecode, pLoad, &pSelf->m_PartLoads);
+	return 0;
+}
+
+void CSkins::SkinPartDecode(CFileRead *pRead)
+{
+	// runs on an io thread, the textures are created on the main thread
+	CSkinPartLoad *pLoad = (CSkinPartLoad *)pRead->m_pUser;
+	if(!pRead->m_Success)
+		return;
+	pLoad->m_Decoded = pLoad->m_pSkins->Graphics()->LoadPNGData(&pLoad->m_Info, pRead->m_pData, pRead->m_DataSize, pRead->m_aFilename);
+	mem_free(pRead->m_pData);
+	pRead->m_pData = 0;
+	if(!pLoad->m_Decoded || pLoad->m_Info.m_Format != CImageInfo::FORMAT_RGBA)
+		return;
+
+	CImageInfo *pInfo = &pLoad->m_Info;
+	const int Step = pInfo->GetPixelSize();
+	const unsigned char *pData = (const unsigned char *)pInfo->m_pData;
 
 	// dig out blood color
-	if(pSelf->m_ScanningPart == SKINPART_BODY)
+	if(pLoad->m_Type == SKINPART_BODY)
 	{
-		int Pitch = Info.m_Width * Step;
-		int PartX = Info.m_Width/2;
+		int Pitch = pInfo->m_Width * Step;
+		int PartX = pInfo->m_Width/2;
 		int PartY = 0;
-		int PartWidth = Info.m_Width/2;
-		int PartHeight = Info.m_Height/2;
+		int PartWidth = pInfo->m_Width/2;
+		int PartHeight = pInfo->m_Height/2;
 
 		int aColors[3] = {0};
 		for(int y = PartY; y < PartY+PartHeight; y++)
@@ -83,35 +105,52 @@ int CSkins::SkinPartScan(const char *pName, int IsDir, int DirType, void *pUser)
 					for(int c = 0; c < 3; c++)
 						aColors[c] += pData[y*Pitch+x*Step+c];
 
-		Part.m_BloodColor = normalize(vec3(aColors[0], aColors[1], aColors[2]));
+		pLoad->m_Part.m_BloodColor = normalize(vec3(aColors[0], aColors[1], aColors[2]));
 	}
 
 	// create colorless version
-	for(int i = 0; i < Info.m_Width*Info.m_Height; i++)
+	unsigned char *pColorless = (unsigned char *)mem_alloc(pInfo->m_Width*pInfo->m_Height*Step);
+	for(int i = 0; i < pInfo->m_Width*pInfo->m_Height; i++)
 	{
 		const int Average = (pData[i*Step]+pData[i*Step+1]+pData[i*Step+2])/3;
-		pData[i*Step] = Average;
-		pData[i*Step+1] = Average;
-		pData[i*Step+2] = Average;
+		pColorless[i*Step] = Average;
+		pColorless[i*Step+1] = Average;
+		pColorless[i*Step+2] = Average;
+		pColorless[i*Step+3] = pData[i*Step+3];
 	}
+	pLoad->m_pColorlessData = pColorless;
+}
 
-	Part.m_ColorTexture = pSelf->Graphics()->LoadTextureRaw(Info.m_Width, Info.m_Height, Info.m_Format, Info.m_pData, Info.m_Format, 0);
-	mem_free(Info.m_pData);
+void CSkins::AddSkinPart(CSkinPartLoad *pLoad)
+{
+	char aBuf[IO_MAX_PATH_LENGTH + 64];
+	if(!pLoad->m_Decoded)
+	{
+		str_format(aBuf, sizeof(aBuf), "failed to load skin part '%s'", pLoad->m_aFilename);
+		Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
+		return;
+	}
+	if(pLoad->m_Info.m_Format != CImageInfo::FORMAT_RGBA)
+	{
+		str_format(aBuf, sizeof(aBuf), "failed to load skin part '%s': must be RGBA format", pLoad->m_aFilename);
+		Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
+		mem_free(pLoad->m_Info.m_pData);
+		return;
+	}
 
-	// set skin part data
-	Part.m_Flags = 0;
-	if(pName[0] == 'x' && pName[1] == '_')
-		Part.m_Flags |= SKINFLAG_SPECIAL;
-	if(DirType != IStorage::TYPE_SAVE)
-		Part.m_Flags |= SKINFLAG_STANDARD;
-	if(pSelf->Config()->m_Debug)
+	CSkinPart Part = pLoad->m_Part;
+	const CImageInfo *pInfo = &pLoad->m_Info;
+	Part.m_OrgTexture = Graphics()->LoadTextureRaw(pInfo->m_Width, pInfo->m_Height, pInfo->m_Format, pInfo->m_pData, pInfo->m_Format, 0);
+	Part.m_ColorTexture = Graphics()->LoadTextureRaw(pInfo->m_Width, pInfo->m_Height, pInfo->m_Format, pLoad->m_pColorlessData, pInfo->m_Format, 0);
+	mem_free(pInfo->m_pData);
+	mem_free(pLoad->m_pColorlessData);
+
+	if(Config()->m_Debug)
 	{
 		str_format(aBuf, sizeof(aBuf), "load skin part %s", Part.m_aName);
-		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
+		Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "skins", aBuf);
 	}
-	pSelf->m_aaSkinParts[pSelf->m_ScanningPart].add(Part);
-
-	return 0;
+	m_aaSkinParts[pLoad->m_Type].add(Part);
 }
 
 int CSkins::SkinScan(const char *pName, int IsDir, int DirType, void *pUser)
@@ -254,11 +293,22 @@ void CSkins::OnInit()
 			m_aaSkinParts[p].add(NoneSkinPart);
 		}
 
-		// load skin parts
+		// find skin parts, the files of all parts are read and decoded in parallel
 		char aBuf[64];
 		str_format(aBuf, sizeof(aBuf), "skins/%s", ms_apSkinPartNames[p]);
 		m_ScanningPart = p;
 		Storage()->ListDirectory(IStorage::TYPE_ALL, aBuf, SkinPartScan, this);
+	}
+
+	// load skin parts
+	Storage()->WaitFileReads(&m_PartLoads);
+	for(int p = 0; p < NUM_SKINPARTS; p++)
+	{
+		for(int i = 0; i < m_lpPartLoads.size(); i++)
+		{
+			if(m_lpPartLoads[i]->m_Type == p)
+				AddSkinPart(m_lpPartLoads[i]);
+		}
 
 		// add dummy skin part
 		if(!m_aaSkinParts[p].size())
@@ -272,6 +322,9 @@ void CSkins::OnInit()
 
 		m_pClient->m_pMenus->RenderLoading(5);
 	}
+	for(int i = 0; i < m_lpPartLoads.size(); i++)
+		delete m_lpPartLoads[i];
+	m_lpPartLoads.clear();
 
 	// create dummy skin
 	m_DummySkin.m_Flags = SKINFLAG_STANDARD;
@@ -4,6 +4,7 @@
 #define GAME_CLIENT_COMPONENTS_SKINS_H
 #include <base/vmath.h>
 #include <base/tl/sorted_array.h>
+#include <engine/storage.h>
 #include <game/client/component.h>
 
 // todo: fix duplicate skins (different paths)
@@ -79,12 +80,29 @@ public:
 	bool SaveSkinfile(const char *pSaveSkinName);
 
 private:
+	// a skin part file being read and decoded by the io threads
+	struct CSkinPartLoad
+	{
+		CFileRead m_Read;
+		CSkins *m_pSkins;
+		int m_Type;
+		char m_aFilename[IO_MAX_PATH_LENGTH];
+		CSkinPart m_Part;
+		bool m_Decoded;
+		CImageInfo m_Info;
+		unsigned char *m_pColorlessData;
+	};
+
 	int m_ScanningPart;
 	sorted_array<CSkinPart> m_aaSkinParts[NUM_SKINPARTS];
 	sorted_array<CSkin> m_aSkins;
 	CSkin m_DummySkin;
+	array<CSkinPartLoad *> m_lpPartLoads;
+	CJobGroup m_PartLoads;
 
 	static int SkinPartScan(const char *pName, int IsDir, int DirType, void *pUser);
+	static void SkinPartDecode(CFileRead *pRead);
+	void AddSkinPart(CSkinPartLoad *pLoad);
 	static int SkinScan(const char *pName, int IsDir, int DirType, void *pUser);
 };
 
@@ -1,7 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
-#include <engine/engine.h>
 #include <engine/sound.h>
+#include <engine/storage.h>
 #include <engine/shared/config.h>
 #include <generated/client_data.h>
 #include <game/client/gameclient.h>
@@ -10,29 +10,27 @@
 #include "sounds.h"
 
 
-struct CUserData
-{
-	CGameClient *m_pGameClient;
-	bool m_Render;
-} g_UserData;
+static ISound *s_pSound = 0;
 
-static int LoadSoundsThread(void *pUser)
+// runs on the io threads, decoding is done there as well
+static void LoadSoundData(CFileRead *pRead)
 {
-	CUserData *pData = static_cast<CUserData *>(pUser);
-
-	for(int s = 0; s < g_pData->m_NumSounds; s++)
+	CDataSound *pSound = static_cast<CDataSound *>(pRead->m_pUser);
+	if(!pRead->m_Success)
 	{
-		for(int i = 0; i < g_pData->m_aSounds[s].m_NumSounds; i++)
-		{
-			ISound::CSampleHandle Id = pData->m_pGameClient->Sound()->LoadWV(g_pData->m_aSounds[s].m_aSounds[i].m_pFilename);
-			g_pData->m_aSounds[s].m_aSounds[i].m_Id = Id;
-		}
-
-		if(pData->m_Render)
-			pData->m_pGameClient->m_pMenus->RenderLoading(1);
+		dbg_msg("sound/wv", "failed to open file. filename='%s'", pRead->m_aFilename);
+		return;
 	}
 
-	return 0;
+	pSound->m_Id = s_pSound->LoadWVData(pRead->m_pData, pRead->m_DataSize, pRead->m_aFilename);
+	mem_free(pRead->m_pData);
+	pRead->m_pData = 0;
+}
+
+CSounds::CSounds()
+{
+	m_pSoundReads = 0;
+	m_WaitForSoundJob = false;
 }
 
 ISound::CSampleHandle CSounds::GetSampleId(int SetId)
@@ -60,7 +58,7 @@ ISound::CSampleHandle CSounds::GetSampleId(int SetId)
 
 int CSounds::GetInitAmount() const
 {
-	if(Config()->m_SndAsyncLoading)
+	if(Config()->m_SndAsyncLoading || !Sound()->IsSoundEnabled())
 		return 0;
 	return g_pData->m_NumSounds;
 }
@@ -77,20 +75,45 @@ void CSounds::OnInit()
 
 	ClearQueue();
 
-	// load sounds
-	if(Config()->m_SndAsyncLoading)
+	// no need to load sound when we are running with no sound
+	if(!Sound()->IsSoundEnabled())
+		return;
+
+	// load sounds, all files are read and decoded in parallel
+	s_pSound = Sound();
+	int NumFiles = 0;
+	for(int s = 0; s < g_pData->m_NumSounds; s++)
+		NumFiles += g_pData->m_aSounds[s].m_NumSounds;
+	m_pSoundReads = new CFileRead[NumFiles];
+	int FileIndex = 0;
+	for(int s = 0; s < g_pData->m_NumSounds; s++)
 	{
-		g_UserData.m_pGameClient = m_pClient;
-		g_UserData.m_Render = false;
-		m_pClient->Engine()->AddJob(&m_SoundJob, LoadSoundsThread, &g_UserData);
-		m_WaitForSoundJob = true;
+		for(int i = 0; i < g_pData->m_aSounds[s].m_NumSounds; i++)
+		{
+			CDataSound *pSound = &g_pData->m_aSounds[s].m_aSounds[i];
+			Storage()->ReadFileAsync(&m_pSoundReads[FileIndex++], pSound->m_pFilename, IStorage::TYPE_ALL, LoadSoundData, pSound, &m_SoundReads);
+		}
 	}
+
+	if(Config()->m_SndAsyncLoading)
+		m_WaitForSoundJob = true;
 	else
 	{
-		g_UserData.m_pGameClient = m_pClient;
-		g_UserData.m_Render = true;
-		LoadSoundsThread(&g_UserData);
-		m_WaitForSoundJob = false;
+		Storage()->WaitFileReads(&m_SoundReads);
+		m_pClient->m_pMenus->RenderLoading(g_pData->m_NumSounds);
+		delete[] m_pSoundReads;
+		m_pSoundReads = 0;
+	}
+}
+
+void CSounds::OnShutdown()
+{
+	// the reads point into the array
+	if(m_pSoundReads)
+	{
+		Storage()->WaitFileReads(&m_SoundReads);
+		delete[] m_pSoundReads;
+		m_pSoundReads = 0;
 	}
 }
 
@@ -114,10 +137,11 @@ void CSounds::OnRender()
 	// check for sound initialisation
 	if(m_WaitForSoundJob)
 	{
-		if(m_SoundJob.Status() == CJob::STATE_DONE)
-			m_WaitForSoundJob = false;
-		else
+		if(!m_SoundReads.Done())
 			return;
+		delete[] m_pSoundReads;
+		m_pSoundReads = 0;
+		m_WaitForSoundJob = false;
 	}
 
 	// set listener pos
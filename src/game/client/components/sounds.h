@@ -4,8 +4,8 @@
 #define GAME_CLIENT_COMPONENTS_SOUNDS_H
 
 #include <engine/sound.h>
-#include <game/client/component.h>
 #include <engine/shared/jobs.h>
+#include <game/client/component.h>
 
 class CSounds : public CComponent
 {
@@ -20,7 +20,8 @@ class CSounds : public CComponent
 	} m_aQueue[QUEUE_SIZE];
 	int m_QueuePos;
 	int64 m_QueueWaitTime;
-	class CJob m_SoundJob;
+	class CFileRead *m_pSoundReads;
+	CJobGroup m_SoundReads;
 	bool m_WaitForSoundJob;
 	
 	ISound::CSampleHandle GetSampleId(int SetId);
@@ -35,8 +36,11 @@ public:
 		CHN_GLOBAL,
 	};
 
+	CSounds();
+
 	virtual int GetInitAmount() const;
 	virtual void OnInit();
+	virtual void OnShutdown();
 	virtual void OnReset();
 	virtual void OnStateChange(int NewState, int OldState);
 	virtual void OnRender();
@@ -454,6 +454,7 @@ void CGameClient::OnConnected()
 {
 	m_Layers.Init(Kernel());
 	m_Collision.Init(Layers());
+	m_Prediction.Init(Collision());
 
 	for(int i = 0; i < m_All.m_Num; i++)
 	{
@@ -473,6 +474,7 @@ void CGameClient::OnReset()
 	{
 		// clear out the invalid pointers
 		m_LastNewPredictedTick = -1;
+		m_Prediction.Reset();
 		mem_zero(&m_Snap, sizeof(m_Snap));
 
 		for(int ClientID = 0; ClientID < MAX_CLIENTS; ClientID++)
@@ -1531,6 +1533,12 @@ void CGameClient::OnDemoRecSnap()
 	pGameInfo->m_MatchCurrent = m_GameInfo.m_MatchCurrent;
 }
 
+const CNetObj_PlayerInput *CGameClient::GetPredictionInput(int Tick, void *pUserData)
+{
+	CGameClient *pSelf = (CGameClient *)pUserData;
+	return (const CNetObj_PlayerInput *)pSelf->Client()->GetInput(Tick);
+}
+
 void CGameClient::OnPredict()
 {
 	// Here we predict player movements. For the local player, we also predict
@@ -1552,91 +1560,47 @@ void CGameClient::OnPredict()
 			m_aClients[i].m_PrevPredicted.Read(&m_Snap.m_aCharacters[i].m_Prev);
 			m_aClients[i].m_Predicted.Read(&m_Snap.m_aCharacters[i].m_Cur);
 		}
+		m_Prediction.Reset();
 
 		return;
 	}
 
-	// repredict character
-	CWorldCore World;
-	World.m_Tuning = m_Tuning;
+	// repredict characters, ticks that the newest snapshot confirmed are reused
+	const CNetObj_CharacterCore *apCharacters[MAX_CLIENTS];
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		apCharacters[i] = m_Snap.m_aCharacters[i].m_Active ? &m_Snap.m_aCharacters[i].m_Cur : 0;
+	m_Prediction.Predict(&m_Tuning, Client()->GameTick(), apCharacters, m_LocalClientID, Client()->PredGameTick(), GetPredictionInput, this);
 
-	// search for players
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		if(!m_Snap.m_aCharacters[i].m_Active)
 			continue;
 
-		m_aClients[i].m_Predicted.Init(&World, Collision());
-		World.m_apCharacters[i] = &m_aClients[i].m_Predicted;
-		m_aClients[i].m_Predicted.Read(&m_Snap.m_aCharacters[i].m_Cur);
+		// nothing to predict yet, the snapshot is the newest state
+		const CCharacterCore *pPredicted = m_Prediction.Get(Client()->PredGameTick(), i);
+		const CCharacterCore *pPrevPredicted = m_Prediction.Get(Client()->PredGameTick()-1, i);
+		if(pPredicted)
+			m_aClients[i].m_Predicted = *pPredicted;
+		else
+			m_aClients[i].m_Predicted.Read(&m_Snap.m_aCharacters[i].m_Cur);
+		if(pPrevPredicted)
+			m_aClients[i].m_PrevPredicted = *pPrevPredicted;
 	}
 
-	// predict
-	for(int Tick = Client()->GameTick() + 1;
-		Tick <= Client()->PredGameTick();
-		Tick++)
+	// check if we want to trigger effects
+	for(int Tick = maximum(m_LastNewPredictedTick+1, Client()->GameTick()+1); Tick <= Client()->PredGameTick(); Tick++)
 	{
-		// first calculate where everyone should move
-		for(int c = 0; c < MAX_CLIENTS; c++)
-		{
-			if(!World.m_apCharacters[c])
-				continue;
-
-			// Before running the last iteration, store our predictions. We use
-			// `Prev` because we haven't run the last iteration yet, so our
-			// data is from the previous tick.
-			if(Tick == Client()->PredGameTick())
-				m_aClients[c].m_PrevPredicted = *World.m_apCharacters[c];
-
-			mem_zero(&World.m_apCharacters[c]->m_Input, sizeof(World.m_apCharacters[c]->m_Input));
-
-			if(m_LocalClientID == c)
-			{
-				// apply player input
-				const int *pInput = Client()->GetInput(Tick);
-				if(pInput)
-					World.m_apCharacters[c]->m_Input = *((const CNetObj_PlayerInput*)pInput);
-
-				World.m_apCharacters[c]->Tick(true);
-			}
-			else
-			{
-				// don't apply inputs for non-local players
-				World.m_apCharacters[c]->Tick(false);
-			}
-		}
-
-		// move all players and quantize their data
-		for(int c = 0; c < MAX_CLIENTS; c++)
-		{
-			if (!World.m_apCharacters[c])
-				continue;
-
-			World.m_apCharacters[c]->AddDragVelocity();
-			World.m_apCharacters[c]->ResetDragVelocity();
-			World.m_apCharacters[c]->Move();
-			World.m_apCharacters[c]->Quantize();
-		}
-
-		// check if we want to trigger effects
-		if(Tick > m_LastNewPredictedTick)
-		{
-			m_LastNewPredictedTick = Tick;
-
-			// Only trigger effects for the local character here. Effects for
-			// non-local characters are triggered in `OnNewSnapshot`. Since we
-			// don't apply any inputs to non-local characters, it's not
-			// necessary to trigger events for them here. Also, our predictions
-			// for other players will often be wrong, so it's safer not to
-			// trigger events here.
-			if(m_LocalClientID != -1 && World.m_apCharacters[m_LocalClientID])
-			{
-				ProcessTriggeredEvents(
-					World.m_apCharacters[m_LocalClientID]->m_TriggeredEvents,
-					World.m_apCharacters[m_LocalClientID]->m_Pos
-				);
-			}
-		}
+		m_LastNewPredictedTick = Tick;
+
+		// Only trigger effects for the local character here. Effects for
+		// non-local characters are triggered in `OnNewSnapshot`. Since we
+		// don't apply any inputs to non-local characters, it's not
+		// necessary to trigger events for them here. Also, our predictions
+		// for other players will often be wrong, so it's safer not to
+		// trigger events here.
+		const CCharacterCore *pLocal = m_Prediction.Get(Tick, m_LocalClientID);
+		if(pLocal)
+			ProcessTriggeredEvents(pLocal->m_TriggeredEvents, pLocal->m_Pos);
 	}
 
 	m_PredictedTick = Client()->PredGameTick();
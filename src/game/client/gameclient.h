@@ -8,6 +8,7 @@
 #include <engine/console.h>
 #include <game/layers.h>
 #include <game/gamecore.h>
+#include <game/prediction.h>
 #include "render.h"
 #include "ui.h"
 
@@ -56,9 +57,12 @@ class CGameClient : public IGameClient
 	void ProcessTriggeredEvents(int Events, vec2 Pos);
 	void UpdatePositions();
 
+	CPrediction m_Prediction;
 	int m_PredictedTick;
 	int m_LastNewPredictedTick;
 
+	static const CNetObj_PlayerInput *GetPredictionInput(int Tick, void *pUserData);
+
 	int m_LastGameStartTick;
 	int m_LastFlagCarrierRed;
 	int m_LastFlagCarrierBlue;
@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <engine/client.h>
 #include <engine/console.h>
+#include <engine/engine.h>
 #include <engine/serverbrowser.h>
 #include <engine/storage.h>
 #include <game/gamecore.h> // StrToInts, IntsToStr
@@ -13,10 +14,11 @@ static int MakeVersion(int i, const T &v)
 
 int CEditor::Save(const char *pFilename)
 {
-	return m_Map.Save(Kernel()->RequestInterface<IStorage>(), pFilename);
+	IEngine *pEngine = Kernel()->RequestInterface<IEngine>();
+	return m_Map.Save(Kernel()->RequestInterface<IStorage>(), pFilename, pEngine ? pEngine->JobPool() : 0);
 }
 
-int CEditorMap::Save(class IStorage *pStorage, const char *pFileName)
+int CEditorMap::Save(class IStorage *pStorage, const char *pFileName, CJobPool *pJobPool)
 {
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "saving to '%s'...", pFileName);
@@ -28,6 +30,7 @@ int CEditorMap::Save(class IStorage *pStorage, const char *pFileName)
 		m_pEditor->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "editor", aBuf);
 		return 0;
 	}
+	df.SetCompression(m_pEditor->Config()->m_EdCompressionLevel, pJobPool);
 
 	// save version
 	{
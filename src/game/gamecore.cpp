@@ -87,7 +87,95 @@ void CCharacterCore::Reset()
 	m_Death = false;
 }
 
+// the other characters as seen by the per-character Tick() and Move(),
+// straight from the character pointers
+class CCharacterPointers
+{
+	const CWorldCore *m_pWorld;
+	const CCharacterCore *m_pSelf;
+
+public:
+	CCharacterPointers(const CWorldCore *pWorld, const CCharacterCore *pSelf) : m_pWorld(pWorld), m_pSelf(pSelf) {}
+
+	int Num() const { return MAX_CLIENTS; }
+	bool Get(int i, int *pID, vec2 *pPos) const
+	{
+		const CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
+		if(!pCharCore || pCharCore == m_pSelf)
+			return false;
+		*pID = i;
+		*pPos = pCharCore->m_Pos;
+		return true;
+	}
+};
+
+// the other characters as gathered by the batched step
+class CGatheredPositions
+{
+	const CWorldCore *m_pWorld;
+	int m_Self;
+
+public:
+	CGatheredPositions(const CWorldCore *pWorld, int Self) : m_pWorld(pWorld), m_Self(Self) {}
+
+	int Num() const { return m_pWorld->m_NumPositions; }
+	bool Get(int p, int *pID, vec2 *pPos) const
+	{
+		if(p == m_Self)
+			return false;
+		*pID = m_pWorld->m_aPositionIDs[p];
+		*pPos = vec2(m_pWorld->m_aPosX[p], m_pWorld->m_aPosY[p]);
+		return true;
+	}
+};
+
+void CWorldCore::GatherPositions()
+{
+	m_NumPositions = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(!m_apCharacters[i])
+			continue;
+		m_aPositionIDs[m_NumPositions] = i;
+		m_aPosX[m_NumPositions] = m_apCharacters[i]->m_Pos.x;
+		m_aPosY[m_NumPositions] = m_apCharacters[i]->m_Pos.y;
+		m_NumPositions++;
+	}
+}
+
+void CWorldCore::TickCharacters(const bool *pUseInput)
+{
+	// positions don't change during the tick, one gather is enough
+	GatherPositions();
+	for(int p = 0; p < m_NumPositions; p++)
+		m_apCharacters[m_aPositionIDs[p]]->DoTick(pUseInput && pUseInput[m_aPositionIDs[p]], CGatheredPositions(this, p));
+}
+
+void CWorldCore::MoveCharacters(bool Quantize)
+{
+	GatherPositions();
+	for(int p = 0; p < m_NumPositions; p++)
+	{
+		CCharacterCore *pCharCore = m_apCharacters[m_aPositionIDs[p]];
+		pCharCore->AddDragVelocity();
+		pCharCore->ResetDragVelocity();
+		pCharCore->DoMove(CGatheredPositions(this, p));
+		if(Quantize)
+			pCharCore->Quantize();
+
+		// the following characters collide with the new position
+		m_aPosX[p] = pCharCore->m_Pos.x;
+		m_aPosY[p] = pCharCore->m_Pos.y;
+	}
+}
+
 void CCharacterCore::Tick(bool UseInput)
+{
+	DoTick(UseInput, CCharacterPointers(m_pWorld, this));
+}
+
+template<class TOthers>
+void CCharacterCore::DoTick(bool UseInput, const TOthers &Others)
 {
 	m_TriggeredEvents = 0;
 
@@ -208,21 +296,22 @@ void CCharacterCore::Tick(bool UseInput)
 		if(m_pWorld && m_pWorld->m_Tuning.m_PlayerHooking)
 		{
 			float Distance = 0.0f;
-			for(int i = 0; i < MAX_CLIENTS; i++)
+			for(int p = 0; p < Others.Num(); p++)
 			{
-				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-				if(!pCharCore || pCharCore == this)
+				int ID;
+				vec2 Pos;
+				if(!Others.Get(p, &ID, &Pos))
 					continue;
 
-				vec2 ClosestPoint = closest_point_on_line(m_HookPos, NewPos, pCharCore->m_Pos);
-				if(distance(pCharCore->m_Pos, ClosestPoint) < PHYS_SIZE+2.0f)
+				vec2 ClosestPoint = closest_point_on_line(m_HookPos, NewPos, Pos);
+				if(distance(Pos, ClosestPoint) < PHYS_SIZE+2.0f)
 				{
-					if(m_HookedPlayer == -1 || distance(m_HookPos, pCharCore->m_Pos) < Distance)
+					if(m_HookedPlayer == -1 || distance(m_HookPos, Pos) < Distance)
 					{
 						m_TriggeredEvents |= COREEVENTFLAG_HOOK_ATTACH_PLAYER;
 						m_HookState = HOOK_GRABBED;
-						m_HookedPlayer = i;
-						Distance = distance(m_HookPos, pCharCore->m_Pos);
+						m_HookedPlayer = ID;
+						Distance = distance(m_HookPos, Pos);
 					}
 				}
 			}
@@ -302,19 +391,16 @@ void CCharacterCore::Tick(bool UseInput)
 
 	if(m_pWorld)
 	{
-		for(int i = 0; i < MAX_CLIENTS; i++)
+		for(int p = 0; p < Others.Num(); p++)
 		{
-			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-			if(!pCharCore)
-				continue;
-
-			//player *p = (player*)ent;
-			if(pCharCore == this) // || !(p->flags&FLAG_ALIVE)
+			int ID;
+			vec2 Pos;
+			if(!Others.Get(p, &ID, &Pos))
 				continue; // make sure that we don't nudge our self
 
 			// handle player <-> player collision
-			float Distance = distance(m_Pos, pCharCore->m_Pos);
-			vec2 Dir = normalize(m_Pos - pCharCore->m_Pos);
+			float Distance = distance(m_Pos, Pos);
+			vec2 Dir = normalize(m_Pos - Pos);
 			if(m_pWorld->m_Tuning.m_PlayerCollision && Distance < PHYS_SIZE*1.25f && Distance > 0.0f)
 			{
 				float a = (PHYS_SIZE*1.45f - Distance);
@@ -330,8 +416,9 @@ void CCharacterCore::Tick(bool UseInput)
 			}
 
 			// handle hook influence
-			if(m_HookedPlayer == i && m_pWorld->m_Tuning.m_PlayerHooking)
+			if(m_HookedPlayer == ID && m_pWorld->m_Tuning.m_PlayerHooking)
 			{
+				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[m_HookedPlayer];
 				if(Distance > PHYS_SIZE*1.50f) // TODO: fix tweakable variable
 				{
 					float Accel = m_pWorld->m_Tuning.m_HookDragAccel * (Distance/m_pWorld->m_Tuning.m_HookLength);
@@ -370,6 +457,12 @@ void CCharacterCore::Move()
 	if(!m_pWorld)
 		return;
 
+	DoMove(CCharacterPointers(m_pWorld, this));
+}
+
+template<class TOthers>
+void CCharacterCore::DoMove(const TOthers &Others)
+{
 	float RampValue = VelocityRamp(length(m_Vel)*50, m_pWorld->m_Tuning.m_VelrampStart, m_pWorld->m_Tuning.m_VelrampRange, m_pWorld->m_Tuning.m_VelrampCurvature);
 
 	m_Vel.x = m_Vel.x*RampValue;
@@ -389,17 +482,18 @@ void CCharacterCore::Move()
 		{
 			float a = i/Distance;
 			vec2 Pos = mix(m_Pos, NewPos, a);
-			for(int p = 0; p < MAX_CLIENTS; p++)
+			for(int p = 0; p < Others.Num(); p++)
 			{
-				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[p];
-				if(!pCharCore || pCharCore == this)
+				int ID;
+				vec2 CharPos;
+				if(!Others.Get(p, &ID, &CharPos))
 					continue;
-				float D = distance(Pos, pCharCore->m_Pos);
+				float D = distance(Pos, CharPos);
 				if(D < PHYS_SIZE && D >= 0.0f)
 				{
 					if(a > 0.0f)
 						m_Pos = LastPos;
-					else if(distance(NewPos, pCharCore->m_Pos) > D)
+					else if(distance(NewPos, CharPos) > D)
 						m_Pos = NewPos;
 					return;
 				}
@@ -133,20 +133,46 @@ enum
 
 class CWorldCore
 {
+	friend class CCharacterCore;
+	friend class CGatheredPositions;
+
+	// positions of the registered characters in client id order, kept in
+	// contiguous arrays for the character <-> character loops
+	int m_NumPositions;
+	int m_aPositionIDs[MAX_CLIENTS];
+	float m_aPosX[MAX_CLIENTS];
+	float m_aPosY[MAX_CLIENTS];
+
+	void GatherPositions();
+
 public:
 	CWorldCore()
 	{
 		mem_zero(m_apCharacters, sizeof(m_apCharacters));
+		m_NumPositions = 0;
 	}
 
 	CTuningParams m_Tuning;
 	class CCharacterCore *m_apCharacters[MAX_CLIENTS];
+
+	// batched step of all registered characters in client id order. gives the
+	// same results as calling Tick() on every character followed by
+	// AddDragVelocity(), ResetDragVelocity(), Move() and Quantize() on each
+	void TickCharacters(const bool *pUseInput);
+	void MoveCharacters(bool Quantize);
 };
 
 class CCharacterCore
 {
+	friend class CWorldCore;
+
 	CWorldCore *m_pWorld;
 	CCollision *m_pCollision;
+
+	// the other characters come from the gathered positions when stepping
+	// the whole world, from the character pointers otherwise
+	template<class TOthers> void DoTick(bool UseInput, const TOthers &Others);
+	template<class TOthers> void DoMove(const TOthers &Others);
 public:
 	static const float PHYS_SIZE;
 	vec2 m_Pos;
@@ -0,0 +1,128 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include "prediction.h"
+
+CPrediction::CPrediction()
+{
+	m_pCollision = 0;
+	m_NumSimulatedTicks = 0;
+	Reset();
+}
+
+void CPrediction::Init(CCollision *pCollision)
+{
+	m_pCollision = pCollision;
+	Reset();
+}
+
+void CPrediction::Reset()
+{
+	m_BaseTick = -1;
+	m_PredictedTick = -1;
+	m_LocalClientID = -1;
+	m_NumCharacters = 0;
+}
+
+bool CPrediction::CanReuse(const CTuningParams *pTuning, int GameTick, const CNetObj_CharacterCore * const *ppCharacters, int LocalClientID) const
+{
+	if(m_PredictedTick < 0 || GameTick < OldestTick() || GameTick > m_PredictedTick || LocalClientID != m_LocalClientID ||
+		mem_comp(pTuning, &m_World.m_Tuning, sizeof(CTuningParams)) != 0)
+		return false;
+
+	// the snapshot has to match the prediction for its tick exactly
+	const CCharacterCore *pStates = m_aaStates[GameTick%MAX_TICKS];
+	int Slot = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(!ppCharacters[i])
+			continue;
+		if(Slot == m_NumCharacters || m_aCharacterIDs[Slot] != i)
+			return false;
+
+		CNetObj_CharacterCore Predicted;
+		CNetObj_CharacterCore Current = *ppCharacters[i];
+		mem_zero(&Predicted, sizeof(Predicted));
+		Current.m_Tick = 0;
+		pStates[Slot].Write(&Predicted);
+		if(mem_comp(&Predicted, &Current, sizeof(CNetObj_CharacterCore)) != 0)
+			return false;
+		Slot++;
+	}
+	return Slot == m_NumCharacters;
+}
+
+int CPrediction::Predict(const CTuningParams *pTuning, int GameTick, const CNetObj_CharacterCore * const *ppCharacters,
+	int LocalClientID, int PredTick, FGetInput pfnGetInput, void *pUserData)
+{
+	if(!CanReuse(pTuning, GameTick, ppCharacters, LocalClientID))
+	{
+		// start over from the snapshot
+		m_World.m_Tuning = *pTuning;
+		m_LocalClientID = LocalClientID;
+		m_NumCharacters = 0;
+		CCharacterCore *pStates = m_aaStates[GameTick%MAX_TICKS];
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(!ppCharacters[i])
+				continue;
+
+			CCharacterCore *pCore = &pStates[m_NumCharacters];
+			pCore->Reset();
+			pCore->Init(&m_World, m_pCollision);
+			pCore->Read(ppCharacters[i]);
+			m_aCharacterIDs[m_NumCharacters++] = i;
+		}
+		m_PredictedTick = GameTick;
+	}
+	m_BaseTick = GameTick;
+
+	const int FirstTick = m_PredictedTick+1;
+	if(FirstTick > PredTick)
+		return FirstTick;
+
+	// continue from the newest predicted state
+	mem_zero(m_World.m_apCharacters, sizeof(m_World.m_apCharacters));
+	bool aUseInput[MAX_CLIENTS] = { false };
+	for(int c = 0; c < m_NumCharacters; c++)
+	{
+		m_aCores[c] = m_aaStates[m_PredictedTick%MAX_TICKS][c];
+		m_World.m_apCharacters[m_aCharacterIDs[c]] = &m_aCores[c];
+	}
+	if(LocalClientID >= 0 && LocalClientID < MAX_CLIENTS)
+		aUseInput[LocalClientID] = true;
+
+	for(int Tick = FirstTick; Tick <= PredTick; Tick++)
+	{
+		for(int c = 0; c < m_NumCharacters; c++)
+		{
+			mem_zero(&m_aCores[c].m_Input, sizeof(m_aCores[c].m_Input));
+			if(m_aCharacterIDs[c] == LocalClientID)
+			{
+				// apply player input, the others are predicted without
+				const CNetObj_PlayerInput *pInput = pfnGetInput(Tick, pUserData);
+				if(pInput)
+					m_aCores[c].m_Input = *pInput;
+			}
+		}
+
+		m_World.TickCharacters(aUseInput);
+		m_World.MoveCharacters(true);
+		mem_copy(m_aaStates[Tick%MAX_TICKS], m_aCores, sizeof(CCharacterCore)*m_NumCharacters);
+		m_NumSimulatedTicks++;
+	}
+
+	m_PredictedTick = PredTick;
+	return FirstTick;
+}
+
+const CCharacterCore *CPrediction::Get(int Tick, int ClientID) const
+{
+	if(Tick < OldestTick() || Tick > m_PredictedTick)
+		return 0;
+	for(int c = 0; c < m_NumCharacters; c++)
+	{
+		if(m_aCharacterIDs[c] == ClientID)
+			return &m_aaStates[Tick%MAX_TICKS][c];
+	}
+	return 0;
+}
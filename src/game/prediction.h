@@ -0,0 +1,57 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef GAME_PREDICTION_H
+#define GAME_PREDICTION_H
+
+#include "gamecore.h"
+
+// Predicts the characters from the newest snapshot up to the prediction tick.
+// The newest predicted ticks are kept, so when the snapshot agrees with what
+// was predicted for its tick, only the ticks that were not predicted yet are
+// simulated instead of the whole range.
+class CPrediction
+{
+public:
+	enum
+	{
+		MAX_TICKS=64, // ticks kept, longer ranges are simulated from the snapshot every time
+	};
+
+	typedef const CNetObj_PlayerInput *(*FGetInput)(int Tick, void *pUserData);
+
+private:
+	CWorldCore m_World;
+	CCollision *m_pCollision;
+	CCharacterCore m_aCores[MAX_CLIENTS];
+
+	int m_BaseTick;
+	int m_PredictedTick;
+	int m_LocalClientID;
+	int m_NumCharacters;
+	int m_aCharacterIDs[MAX_CLIENTS];
+	CCharacterCore m_aaStates[MAX_TICKS][MAX_CLIENTS]; // per tick, indexed like m_aCharacterIDs
+
+	int m_NumSimulatedTicks;
+
+	int OldestTick() const { return maximum(m_BaseTick, m_PredictedTick-MAX_TICKS+1); }
+	bool CanReuse(const CTuningParams *pTuning, int GameTick, const CNetObj_CharacterCore * const *ppCharacters, int LocalClientID) const;
+
+public:
+	CPrediction();
+
+	void Init(CCollision *pCollision);
+	void Reset();
+
+	// ppCharacters holds the characters of the newest snapshot by client id,
+	// 0 for the ones not in the game. returns the first simulated tick
+	int Predict(const CTuningParams *pTuning, int GameTick, const CNetObj_CharacterCore * const *ppCharacters,
+		int LocalClientID, int PredTick, FGetInput pfnGetInput, void *pUserData);
+
+	// predicted state of a character, 0 if the tick is not predicted or
+	// not among the newest MAX_TICKS. the snapshot tick is included
+	const CCharacterCore *Get(int Tick, int ClientID) const;
+
+	int NumSimulatedTicks() const { return m_NumSimulatedTicks; }
+};
+
+#endif
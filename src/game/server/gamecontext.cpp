@@ -6,6 +6,7 @@
 #include <engine/shared/memheap.h>
 #include <engine/storage.h>
 #include <engine/map.h>
+#include <engine/metrics.h>
 
 #include <generated/server_data.h>
 #include <game/collision.h>
@@ -1647,6 +1648,13 @@ void CGameContext::OnInit()
 		}
 	}
 
+	IMetrics *pMetrics = Kernel()->RequestInterface<IMetrics>();
+	if(pMetrics)
+	{
+		pMetrics->RegisterCollector("tw_game_players", IMetrics::TYPE_GAUGE, "Players by team", CollectPlayers, this);
+		pMetrics->RegisterCollector("tw_game_entities", IMetrics::TYPE_GAUGE, "Entities in the game world by type", CollectEntities, this);
+	}
+
 	Console()->Chain("sv_motd", ConchainSpecialMotdupdate, this);
 
 	Console()->Chain("sv_vote_kick", ConchainSettingUpdate, this);
@@ -1676,6 +1684,35 @@ void CGameContext::OnInit()
 #endif
 }
 
+void CGameContext::CollectPlayers(IMetrics *pMetrics, void *pUser)
+{
+	CGameContext *pSelf = (CGameContext *)pUser;
+	int aNum[3] = { 0 };
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(pSelf->m_apPlayers[i])
+			aNum[pSelf->m_apPlayers[i]->GetTeam()-TEAM_SPECTATORS]++;
+	}
+	pMetrics->AddSample("team=\"spectators\"", aNum[0]);
+	pMetrics->AddSample("team=\"red\"", aNum[TEAM_RED-TEAM_SPECTATORS]);
+	pMetrics->AddSample("team=\"blue\"", aNum[TEAM_BLUE-TEAM_SPECTATORS]);
+}
+
+void CGameContext::CollectEntities(IMetrics *pMetrics, void *pUser)
+{
+	CGameContext *pSelf = (CGameContext *)pUser;
+	static const char *s_apTypes[CGameWorld::NUM_ENTTYPES] = { "projectile", "laser", "pickup", "character", "flag" };
+	char aLabels[32];
+	for(int Type = 0; Type < CGameWorld::NUM_ENTTYPES; Type++)
+	{
+		int Num = 0;
+		for(CEntity *pEnt = pSelf->m_World.FindFirst(Type); pEnt; pEnt = pEnt->TypeNext())
+			Num++;
+		str_format(aLabels, sizeof(aLabels), "type=\"%s\"", s_apTypes[Type]);
+		pMetrics->AddSample(aLabels, Num);
+	}
+}
+
 void CGameContext::OnShutdown()
 {
 	delete m_pController;
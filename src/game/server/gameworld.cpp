@@ -19,8 +19,12 @@ CGameWorld::CGameWorld()
 
 	m_Paused = false;
 	m_ResetRequested = false;
+	m_TrackTickTime = false;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
 		m_apFirstEntityTypes[i] = 0;
+		m_aTickTime[i] = 0;
+	}
 }
 
 CGameWorld::~CGameWorld()
@@ -183,20 +187,30 @@ void CGameWorld::Tick()
 	{
 		// update all objects
 		for(int i = 0; i < NUM_ENTTYPES; i++)
+		{
+			int64 StartTime = m_TrackTickTime ? time_get() : 0;
 			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 				pEnt->Tick();
 				pEnt = m_pNextTraverseEntity;
 			}
+			if(m_TrackTickTime)
+				m_aTickTime[i] += time_get()-StartTime;
+		}
 
 		for(int i = 0; i < NUM_ENTTYPES; i++)
+		{
+			int64 StartTime = m_TrackTickTime ? time_get() : 0;
 			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 				pEnt->TickDefered();
 				pEnt = m_pNextTraverseEntity;
 			}
+			if(m_TrackTickTime)
+				m_aTickTime[i] += time_get()-StartTime;
+		}
 	}
 
 	RemoveEntities();
@@ -46,6 +46,10 @@ public:
 	bool m_Paused;
 	CWorldCore m_Core;
 
+	// optional tick time accounting per entity type, used by the game benchmark
+	bool m_TrackTickTime;
+	int64 m_aTickTime[NUM_ENTTYPES];
+
 	CGameWorld();
 	~CGameWorld();
 
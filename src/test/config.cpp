@@ -0,0 +1,104 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/config.h>
+
+TEST(ConfigSnapshot, Publish)
+{
+	CConfigManager *pManager = new CConfigManager;
+	pManager->Reset();
+
+	const CConfigSnapshot *pFirst = pManager->AcquireSnapshot();
+	EXPECT_EQ(pFirst->Values()->m_SvPort, pManager->Values()->m_SvPort);
+
+	// nothing changed, nothing published
+	pManager->PublishSnapshot();
+	const CConfigSnapshot *pSame = pManager->AcquireSnapshot();
+	EXPECT_EQ(pSame, pFirst);
+	pManager->ReleaseSnapshot(pSame);
+
+	pManager->Values()->m_SvPort = 1234;
+	str_copy(pManager->Values()->m_SvName, "changed", sizeof(pManager->Values()->m_SvName));
+	EXPECT_NE(pFirst->Values()->m_SvPort, 1234);
+	pManager->PublishSnapshot();
+	{
+		CConfigSnapshotRef Config(pManager);
+		EXPECT_EQ(Config->m_SvPort, 1234);
+		EXPECT_STREQ(Config->m_SvName, "changed");
+		EXPECT_EQ(Config.Snapshot()->Version(), pFirst->Version()+1);
+	}
+
+	// the old one stays valid for its holder
+	EXPECT_NE(pFirst->Values()->m_SvPort, 1234);
+	pManager->ReleaseSnapshot(pFirst);
+	delete pManager;
+}
+
+struct CReaderData
+{
+	IConfigManager *m_pManager;
+	volatile bool m_Stop;
+	int m_NumInconsistent;
+	int m_NumAcquired;
+};
+
+static void ReaderThread(void *pUser)
+{
+	CReaderData *pData = (CReaderData *)pUser;
+	while(!pData->m_Stop)
+	{
+		CConfigSnapshotRef Config(pData->m_pManager);
+		if(Config->m_SvPort != Config->m_EcPort || Config->m_SvPort != str_toint(Config->m_SvName))
+			pData->m_NumInconsistent++;
+		pData->m_NumAcquired++;
+	}
+}
+
+TEST(ConfigSnapshot, ConcurrentReaders)
+{
+	CConfigManager *pManager = new CConfigManager;
+	pManager->Reset();
+	CConfig *pValues = pManager->Values();
+	pValues->m_SvPort = pValues->m_EcPort = 0;
+	str_copy(pValues->m_SvName, "0", sizeof(pValues->m_SvName));
+	pManager->PublishSnapshot();
+
+	static const int NUM_READERS = 4;
+	CReaderData aData[NUM_READERS];
+	void *apThreads[NUM_READERS];
+	for(int i = 0; i < NUM_READERS; i++)
+	{
+		aData[i].m_pManager = pManager;
+		aData[i].m_Stop = false;
+		aData[i].m_NumInconsistent = 0;
+		aData[i].m_NumAcquired = 0;
+		apThreads[i] = thread_init(ReaderThread, &aData[i]);
+	}
+
+	// readers see all changes made between two publishes or none
+	bool AllRead = false;
+	for(int i = 1; i <= 5000 || !AllRead; i++)
+	{
+		pValues->m_SvPort = i;
+		pValues->m_EcPort = i;
+		str_format(pValues->m_SvName, sizeof(pValues->m_SvName), "%d", i);
+		pManager->PublishSnapshot();
+		if(i%100 == 0)
+		{
+			thread_yield();
+			AllRead = true;
+			for(int r = 0; r < NUM_READERS; r++)
+				AllRead = AllRead && aData[r].m_NumAcquired > 0;
+		}
+	}
+
+	for(int i = 0; i < NUM_READERS; i++)
+	{
+		aData[i].m_Stop = true;
+		thread_wait(apThreads[i]);
+		EXPECT_EQ(aData[i].m_NumInconsistent, 0);
+	}
+	delete pManager;
+}
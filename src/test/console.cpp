@@ -0,0 +1,75 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <gtest/gtest.h>
+
+#include <engine/console.h>
+#include <engine/shared/config.h>
+
+static void ConCount(IConsole::IResult *pResult, void *pUserData)
+{
+	(*(int *)pUserData) += pResult->NumArguments() ? pResult->GetInteger(0) : 1;
+}
+
+TEST(Console, FindCommand)
+{
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+
+	// enough commands to share hash buckets
+	static char s_aaNames[2000][16];
+	int aCalls[2000] = {0};
+	for(int i = 0; i < 2000; i++)
+	{
+		str_format(s_aaNames[i], sizeof(s_aaNames[i]), "cmd_%d", i);
+		pConsole->Register(s_aaNames[i], "?i", CFGFLAG_SERVER, ConCount, &aCalls[i], "");
+	}
+
+	pConsole->ExecuteLine("cmd_0; CMD_1999 5; Cmd_1000 2; cmd_2000");
+	EXPECT_EQ(aCalls[0], 1);
+	EXPECT_EQ(aCalls[1999], 5);
+	EXPECT_EQ(aCalls[1000], 2);
+	EXPECT_EQ(aCalls[1], 0);
+
+	const IConsole::CCommandInfo *pInfo = pConsole->GetCommandInfo("Cmd_42", CFGFLAG_SERVER, false);
+	ASSERT_TRUE(pInfo);
+	EXPECT_STREQ(pInfo->m_pName, "cmd_42");
+	EXPECT_FALSE(pConsole->GetCommandInfo("cmd_42", CFGFLAG_CLIENT, false));
+	EXPECT_FALSE(pConsole->GetCommandInfo("cmd_42", CFGFLAG_SERVER, true));
+	EXPECT_EQ(pConsole->PossibleCommands("cmd_199", CFGFLAG_SERVER, false), 11);
+
+	// registering again replaces the callback
+	int Replaced = 0;
+	pConsole->Register(s_aaNames[7], "?i", CFGFLAG_SERVER, ConCount, &Replaced, "");
+	pConsole->ExecuteLine("cmd_7");
+	EXPECT_EQ(aCalls[7], 0);
+	EXPECT_EQ(Replaced, 1);
+
+	delete pConsole;
+}
+
+TEST(Console, TempCommands)
+{
+	IConsole *pConsole = CreateConsole(CFGFLAG_CLIENT);
+	EXPECT_FALSE(pConsole->GetCommandInfo("remote_cmd", CFGFLAG_SERVER, true));
+
+	pConsole->RegisterTemp("remote_cmd", "", CFGFLAG_SERVER, "");
+	pConsole->RegisterTemp("other_cmd", "", CFGFLAG_SERVER, "");
+	ASSERT_TRUE(pConsole->GetCommandInfo("REMOTE_CMD", CFGFLAG_SERVER, true));
+	EXPECT_FALSE(pConsole->GetCommandInfo("remote_cmd", CFGFLAG_SERVER, false));
+	EXPECT_TRUE(pConsole->GetCommandInfo("echo", CFGFLAG_CLIENT, false));
+
+	// removed ones are recycled under a different name
+	pConsole->DeregisterTemp("remote_cmd");
+	EXPECT_FALSE(pConsole->GetCommandInfo("remote_cmd", CFGFLAG_SERVER, true));
+	pConsole->RegisterTemp("recycled_cmd", "", CFGFLAG_SERVER, "");
+	EXPECT_FALSE(pConsole->GetCommandInfo("remote_cmd", CFGFLAG_SERVER, true));
+	EXPECT_TRUE(pConsole->GetCommandInfo("recycled_cmd", CFGFLAG_SERVER, true));
+	EXPECT_EQ(pConsole->PossibleCommands("_cmd", CFGFLAG_SERVER, true), 2);
+
+	pConsole->DeregisterTempAll();
+	EXPECT_FALSE(pConsole->GetCommandInfo("recycled_cmd", CFGFLAG_SERVER, true));
+	EXPECT_FALSE(pConsole->GetCommandInfo("other_cmd", CFGFLAG_SERVER, true));
+	EXPECT_EQ(pConsole->PossibleCommands("_cmd", CFGFLAG_SERVER, true), 0);
+	EXPECT_TRUE(pConsole->GetCommandInfo("echo", CFGFLAG_CLIENT, false));
+
+	delete pConsole;
+}
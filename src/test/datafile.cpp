@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 
 #include <engine/shared/datafile.h>
+#include <engine/shared/jobs.h>
 #include <engine/storage.h>
 
 TEST(Datafile, RoundtripItemDataAndSize)
@@ -65,3 +66,256 @@ TEST(Datafile, RoundtripItemDataAndSize)
 
 	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
 }
+
+TEST(Datafile, TruncatedData)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	Info.Filename(aFilename, sizeof(aFilename), ".datafile");
+	IStorage *pStorage = CreateTestStorage();
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, aFilename));
+
+	char aData[1024];
+	for(unsigned i = 0; i < sizeof(aData); i++)
+		aData[i] = i*i;
+	int Index = Writer.AddData(sizeof(aData), aData);
+	int Index2 = Writer.AddData(sizeof(aData), aData);
+	int aItem[2] = {Index, Index2};
+	Writer.AddItem(1, 0, sizeof(aItem), aItem);
+	EXPECT_TRUE(Writer.Finish());
+
+	// cut off the end of the last data block
+	void *pFile;
+	unsigned FileSize;
+	ASSERT_TRUE(pStorage->ReadFile(aFilename, IStorage::TYPE_SAVE, &pFile, &FileSize));
+	IOHANDLE File = pStorage->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	io_write(File, pFile, FileSize-8);
+	io_close(File);
+	mem_free(pFile);
+
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+	ASSERT_EQ(Reader.GetItemSize(0), sizeof(aItem));
+	EXPECT_TRUE(mem_comp(Reader.GetItem(0, 0, 0), aItem, sizeof(aItem)) == 0);
+	ASSERT_TRUE(Reader.GetData(Index));
+	EXPECT_TRUE(mem_comp(Reader.GetData(Index), aData, sizeof(aData)) == 0);
+	EXPECT_FALSE(Reader.GetData(Index2));
+	EXPECT_TRUE(Reader.Close());
+
+	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
+}
+
+TEST(Datafile, PrefetchData)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	Info.Filename(aFilename, sizeof(aFilename), ".datafile");
+	IStorage *pStorage = CreateTestStorage();
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, aFilename));
+
+	static const int NUM_DATA = 24;
+	int aIndices[NUM_DATA];
+	int aData[NUM_DATA*64];
+	for(int i = 0; i < NUM_DATA*64; i++)
+		aData[i] = i*i;
+	for(int i = 0; i < NUM_DATA; i++)
+		aIndices[i] = Writer.AddData((i+1)*64, aData);
+	EXPECT_TRUE(Writer.Finish());
+
+	// the blocks decompressed up front have to match the ones loaded on access
+	CDataFileReader Prefetched;
+	CDataFileReader Reader;
+	ASSERT_TRUE(Prefetched.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+	ASSERT_TRUE(Reader.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+	CJobPool Pool;
+	Pool.Init(3);
+	Prefetched.PrefetchData(aIndices, NUM_DATA/2, &Pool);
+	Prefetched.PrefetchData(0, 0);
+	for(int i = 0; i < NUM_DATA; i++)
+	{
+		ASSERT_EQ(Prefetched.GetDataSize(aIndices[i]), (i+1)*64);
+		ASSERT_EQ(Reader.GetDataSize(aIndices[i]), (i+1)*64);
+		EXPECT_TRUE(mem_comp(Prefetched.GetData(aIndices[i]), Reader.GetData(aIndices[i]), (i+1)*64) == 0);
+	}
+	EXPECT_TRUE(Prefetched.Close());
+	EXPECT_TRUE(Reader.Close());
+
+	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
+}
+
+TEST(Datafile, BrokenData)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	Info.Filename(aFilename, sizeof(aFilename), ".datafile");
+	IStorage *pStorage = CreateTestStorage();
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, aFilename));
+	int aData[64];
+	for(int i = 0; i < 64; i++)
+		aData[i] = i;
+	int Index = Writer.AddData(sizeof(aData), aData);
+	int Index2 = Writer.AddData(sizeof(aData), aData);
+	EXPECT_TRUE(Writer.Finish());
+
+	// the last block ends the file, break its checksum
+	void *pFile;
+	unsigned FileSize;
+	ASSERT_TRUE(pStorage->ReadFile(aFilename, IStorage::TYPE_SAVE, &pFile, &FileSize));
+	((unsigned char *)pFile)[FileSize-1] ^= 0xff;
+	IOHANDLE File = pStorage->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	io_write(File, pFile, FileSize);
+	io_close(File);
+	mem_free(pFile);
+
+	// the broken block isn't loaded, neither on access nor prefetched
+	CDataFileReader Prefetched;
+	CDataFileReader Reader;
+	ASSERT_TRUE(Prefetched.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+	ASSERT_TRUE(Reader.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+	CJobPool Pool;
+	Pool.Init(2);
+	Prefetched.PrefetchData(0, 0, &Pool);
+	ASSERT_TRUE(Prefetched.GetData(Index));
+	EXPECT_TRUE(mem_comp(Prefetched.GetData(Index), aData, sizeof(aData)) == 0);
+	EXPECT_FALSE(Prefetched.GetData(Index2));
+	ASSERT_TRUE(Reader.GetData(Index));
+	EXPECT_FALSE(Reader.GetData(Index2));
+	EXPECT_TRUE(Prefetched.Close());
+	EXPECT_TRUE(Reader.Close());
+
+	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
+}
+
+TEST(Datafile, FileDataUnchanged)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	Info.Filename(aFilename, sizeof(aFilename), ".datafile");
+	IStorage *pStorage = CreateTestStorage();
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, aFilename));
+	int aData[64];
+	for(int i = 0; i < 64; i++)
+		aData[i] = i;
+	int Index = Writer.AddData(sizeof(aData), aData);
+	Writer.AddItem(1, 0, sizeof(aData), aData);
+	EXPECT_TRUE(Writer.Finish());
+
+	// changing items and data doesn't change what is served as the file
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+	int *pItem = (int *)Reader.GetItem(0, 0, 0);
+	int *pData = (int *)Reader.GetData(Index);
+	ASSERT_TRUE(pItem && pData);
+	pItem[0] = -1;
+	pData[0] = -1;
+
+	void *pFile;
+	unsigned FileSize;
+	ASSERT_TRUE(pStorage->ReadFile(aFilename, IStorage::TYPE_SAVE, &pFile, &FileSize));
+	unsigned Size;
+	const void *pFileData = Reader.FileData(&Size);
+	ASSERT_TRUE(pFileData);
+	ASSERT_EQ(Size, FileSize);
+	EXPECT_TRUE(mem_comp(pFileData, pFile, FileSize) == 0);
+	EXPECT_TRUE(sha256(pFileData, Size) == Reader.Sha256());
+	mem_free(pFile);
+	EXPECT_TRUE(Reader.Close());
+
+	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
+}
+
+TEST(Datafile, FileChanged)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	Info.Filename(aFilename, sizeof(aFilename), ".datafile");
+	IStorage *pStorage = CreateTestStorage();
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, aFilename));
+	int aData[64];
+	for(int i = 0; i < 64; i++)
+		aData[i] = i;
+	Writer.AddData(sizeof(aData), aData);
+	EXPECT_TRUE(Writer.Finish());
+
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+	EXPECT_FALSE(Reader.FileChanged());
+
+	// truncating the file is noticed
+	IOHANDLE File = pStorage->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	io_close(File);
+	EXPECT_TRUE(Reader.FileChanged());
+	EXPECT_TRUE(Reader.Close());
+
+	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
+}
+
+static void WriteCompressed(IStorage *pStorage, const char *pFilename, const int *pData, int NumData, int Level, CJobPool *pPool)
+{
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, pFilename));
+	Writer.SetCompression(Level, pPool);
+	for(int i = 0; i < NumData; i++)
+		Writer.AddData((i+1)*64, pData);
+	EXPECT_TRUE(Writer.Finish());
+}
+
+TEST(Datafile, CompressionLevelAndThreads)
+{
+	CTestInfo Info;
+	char aSequential[64];
+	char aParallel[64];
+	char aStored[64];
+	Info.Filename(aSequential, sizeof(aSequential), ".datafile");
+	Info.Filename(aParallel, sizeof(aParallel), "-parallel.datafile");
+	Info.Filename(aStored, sizeof(aStored), "-stored.datafile");
+	IStorage *pStorage = CreateTestStorage();
+
+	static const int NUM_DATA = 24;
+	int aData[NUM_DATA*64];
+	for(int i = 0; i < NUM_DATA*64; i++)
+		aData[i] = i%37;
+	CJobPool Pool;
+	Pool.Init(3);
+	WriteCompressed(pStorage, aSequential, aData, NUM_DATA, 6, 0);
+	WriteCompressed(pStorage, aParallel, aData, NUM_DATA, 6, &Pool);
+	WriteCompressed(pStorage, aStored, aData, NUM_DATA, 0, &Pool);
+
+	// the number of threads doesn't change the file
+	void *pSequential;
+	void *pParallel;
+	unsigned SequentialSize;
+	unsigned ParallelSize;
+	ASSERT_TRUE(pStorage->ReadFile(aSequential, IStorage::TYPE_SAVE, &pSequential, &SequentialSize));
+	ASSERT_TRUE(pStorage->ReadFile(aParallel, IStorage::TYPE_SAVE, &pParallel, &ParallelSize));
+	ASSERT_EQ(SequentialSize, ParallelSize);
+	EXPECT_TRUE(mem_comp(pSequential, pParallel, SequentialSize) == 0);
+	mem_free(pSequential);
+	mem_free(pParallel);
+
+	// stored blocks are bigger but read back the same
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage, aStored, IStorage::TYPE_ALL));
+	for(int i = 0; i < NUM_DATA; i++)
+	{
+		ASSERT_EQ(Reader.GetDataSize(i), (i+1)*64);
+		EXPECT_TRUE(mem_comp(Reader.GetData(i), aData, (i+1)*64) == 0);
+	}
+	EXPECT_TRUE(Reader.Close());
+	IOHANDLE File = pStorage->OpenFile(aStored, IOFLAG_READ, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	EXPECT_GT(io_length(File), (long)SequentialSize);
+	io_close(File);
+
+	EXPECT_TRUE(pStorage->RemoveFile(aSequential, IStorage::TYPE_SAVE));
+	EXPECT_TRUE(pStorage->RemoveFile(aParallel, IStorage::TYPE_SAVE));
+	EXPECT_TRUE(pStorage->RemoveFile(aStored, IStorage::TYPE_SAVE));
+}
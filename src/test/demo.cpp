@@ -0,0 +1,203 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include "test.h"
+
+#include <gtest/gtest.h>
+
+#include <base/hash.h>
+
+#include <engine/console.h>
+#include <engine/shared/config.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/snapshot.h>
+#include <engine/storage.h>
+
+static const char *s_pNetVersion = "0.7 test";
+
+class CTestDemoListener : public CDemoPlayer::IListener
+{
+public:
+	int m_SnapshotSize;
+	char m_aSnapshot[CSnapshot::MAX_SIZE];
+	int m_NumMessages;
+
+	CTestDemoListener() : m_SnapshotSize(-1), m_NumMessages(0) {}
+
+	void OnDemoPlayerSnapshot(void *pData, int Size)
+	{
+		m_SnapshotSize = Size;
+		mem_copy(m_aSnapshot, pData, Size);
+	}
+	void OnDemoPlayerMessage(void *pData, int Size) { m_NumMessages++; }
+};
+
+// a snapshot every StepTicks ticks, with a few items that change over time
+static void RecordDemo(IStorage *pStorage, IConsole *pConsole, const char *pFilename, const char *pMapName, int NumTicks, int StepTicks)
+{
+	CSnapshotDelta Delta;
+	CDemoRecorder Recorder(&Delta);
+	Recorder.Init(pConsole, pStorage);
+	ASSERT_EQ(Recorder.Start(pFilename, s_pNetVersion, pMapName, sha256("", 0), 0, "server"), 0);
+
+	for(int Tick = 1; Tick <= NumTicks; Tick += StepTicks)
+	{
+		CSnapshotBuilder Builder;
+		Builder.Init();
+		for(int i = 0; i < 4; i++)
+		{
+			int *pItem = (int *)Builder.NewItem(1+i, i, 3*sizeof(int));
+			pItem[0] = Tick;
+			pItem[1] = i*100+Tick/50;
+			pItem[2] = i;
+		}
+		char aData[CSnapshot::MAX_SIZE];
+		int Size = Builder.Finish(aData);
+		Recorder.RecordSnapshot(Tick, aData, Size);
+
+		if(Tick%7 == 0)
+		{
+			int aMessage[2] = {Tick, 0};
+			Recorder.RecordMessage(aMessage, sizeof(aMessage));
+		}
+	}
+	EXPECT_EQ(Recorder.Stop(), 0);
+
+	// everything queued was written
+	EXPECT_GT(Recorder.Stats()->m_QueuePeak, 0);
+	EXPECT_EQ(Recorder.Stats()->m_NumErrors, 0);
+}
+
+// the recorder needs the map, an empty one is enough
+static void CreateTestMap(IStorage *pStorage, const char *pMapFilename)
+{
+	pStorage->CreateFolder("maps", IStorage::TYPE_SAVE);
+	IOHANDLE MapFile = pStorage->OpenFile(pMapFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(MapFile);
+	io_close(MapFile);
+}
+
+static void RemoveTestMap(IStorage *pStorage, const char *pMapFilename)
+{
+	EXPECT_TRUE(pStorage->RemoveFile(pMapFilename, IStorage::TYPE_SAVE));
+	fs_remove("maps");
+}
+
+static void ExpectSamePlayback(const CDemoPlayer *pA, const CTestDemoListener *pListenerA, const CDemoPlayer *pB, const CTestDemoListener *pListenerB)
+{
+	EXPECT_EQ(pA->Info()->m_PreviousTick, pB->Info()->m_PreviousTick);
+	EXPECT_EQ(pA->BaseInfo()->m_CurrentTick, pB->BaseInfo()->m_CurrentTick);
+	EXPECT_EQ(pA->Info()->m_NextTick, pB->Info()->m_NextTick);
+	ASSERT_GT(pListenerA->m_SnapshotSize, 0);
+	ASSERT_EQ(pListenerA->m_SnapshotSize, pListenerB->m_SnapshotSize);
+	EXPECT_TRUE(mem_comp(pListenerA->m_aSnapshot, pListenerB->m_aSnapshot, pListenerA->m_SnapshotSize) == 0);
+}
+
+TEST(Demo, KeyFrameIndexMatchesScan)
+{
+	CTestInfo Info;
+	char aIndexed[64];
+	char aScanned[64];
+	char aMapFilename[128];
+	Info.Filename(aIndexed, sizeof(aIndexed), ".demo");
+	Info.Filename(aScanned, sizeof(aScanned), "-scanned.demo");
+	str_format(aMapFilename, sizeof(aMapFilename), "maps/%s.map", Info.m_aFilenamePrefix);
+
+	IStorage *pStorage = CreateTestStorage();
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	CreateTestMap(pStorage, aMapFilename);
+
+	// every snapshot is a keyframe, enough of them to need several index chunks
+	RecordDemo(pStorage, pConsole, aIndexed, Info.m_aFilenamePrefix, 1500*300, 300);
+
+	// the same demo without the trailer, so the player has to scan it
+	void *pData;
+	unsigned DataSize;
+	ASSERT_TRUE(pStorage->ReadFile(aIndexed, IStorage::TYPE_SAVE, &pData, &DataSize));
+	IOHANDLE File = pStorage->OpenFile(aScanned, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	io_write(File, pData, DataSize-64);
+	io_close(File);
+	mem_free(pData);
+
+	CSnapshotDelta Delta;
+	CDemoPlayer Indexed(&Delta);
+	CDemoPlayer Scanned(&Delta);
+	CTestDemoListener IndexedListener;
+	CTestDemoListener ScannedListener;
+	Indexed.Init(pConsole, pStorage);
+	Scanned.Init(pConsole, pStorage);
+	Indexed.SetListener(&IndexedListener);
+	Scanned.SetListener(&ScannedListener);
+	ASSERT_FALSE(Indexed.Load(aIndexed, IStorage::TYPE_SAVE, s_pNetVersion));
+	ASSERT_FALSE(Scanned.Load(aScanned, IStorage::TYPE_SAVE, s_pNetVersion));
+
+	EXPECT_EQ(Indexed.Info()->m_SeekablePoints, 1500);
+	EXPECT_EQ(Indexed.Info()->m_SeekablePoints, Scanned.Info()->m_SeekablePoints);
+	EXPECT_EQ(Indexed.BaseInfo()->m_FirstTick, Scanned.BaseInfo()->m_FirstTick);
+	EXPECT_EQ(Indexed.BaseInfo()->m_LastTick, Scanned.BaseInfo()->m_LastTick);
+
+	// seeking has to land on the same snapshots
+	static const int s_aTicks[] = {1, 2000, 301*300, 1024*300+17, 1499*300};
+	for(unsigned i = 0; i < sizeof(s_aTicks)/sizeof(s_aTicks[0]); i++)
+	{
+		EXPECT_EQ(Indexed.SetPos(s_aTicks[i]), 0);
+		EXPECT_EQ(Scanned.SetPos(s_aTicks[i]), 0);
+		ExpectSamePlayback(&Indexed, &IndexedListener, &Scanned, &ScannedListener);
+	}
+
+	// the index at the end is skipped like unknown chunks, playback pauses at the end
+	EXPECT_EQ(Indexed.SetPos(Indexed.BaseInfo()->m_LastTick), 0);
+	EXPECT_TRUE(Indexed.IsPlaying());
+	EXPECT_GT(IndexedListener.m_NumMessages, 0);
+
+	Indexed.Stop();
+	Scanned.Stop();
+	EXPECT_TRUE(pStorage->RemoveFile(aIndexed, IStorage::TYPE_SAVE));
+	EXPECT_TRUE(pStorage->RemoveFile(aScanned, IStorage::TYPE_SAVE));
+	RemoveTestMap(pStorage, aMapFilename);
+	delete pConsole;
+	delete pStorage;
+}
+
+TEST(Demo, SeekFromSnapshotCache)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	char aMapFilename[128];
+	Info.Filename(aFilename, sizeof(aFilename), ".demo");
+	str_format(aMapFilename, sizeof(aMapFilename), "maps/%s.map", Info.m_aFilenamePrefix);
+
+	IStorage *pStorage = CreateTestStorage();
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	CreateTestMap(pStorage, aMapFilename);
+	RecordDemo(pStorage, pConsole, aFilename, Info.m_aFilenamePrefix, 6000, 1);
+
+	CSnapshotDelta Delta;
+	CDemoPlayer Cached(&Delta);
+	CTestDemoListener CachedListener;
+	Cached.Init(pConsole, pStorage);
+	Cached.SetListener(&CachedListener);
+	ASSERT_FALSE(Cached.Load(aFilename, IStorage::TYPE_SAVE, s_pNetVersion));
+
+	// scrub forward and back, every seek has to match a fresh player seeking from the keyframe
+	static const int s_aTicks[] = {100, 400, 1320, 1000, 700, 2600, 2590, 2575, 1333, 5990, 3000, 30, 5000};
+	for(unsigned i = 0; i < sizeof(s_aTicks)/sizeof(s_aTicks[0]); i++)
+	{
+		CDemoPlayer Fresh(&Delta);
+		CTestDemoListener FreshListener;
+		Fresh.Init(pConsole, pStorage);
+		Fresh.SetListener(&FreshListener);
+		ASSERT_FALSE(Fresh.Load(aFilename, IStorage::TYPE_SAVE, s_pNetVersion));
+		EXPECT_EQ(Fresh.SetPos(s_aTicks[i]), 0);
+		EXPECT_EQ(Cached.SetPos(s_aTicks[i]), 0);
+		ExpectSamePlayback(&Cached, &CachedListener, &Fresh, &FreshListener);
+		Fresh.Stop();
+	}
+	EXPECT_GT(Cached.SnapshotCache()->NumEntries(), 0);
+
+	Cached.Stop();
+	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
+	RemoveTestMap(pStorage, aMapFilename);
+	delete pConsole;
+	delete pStorage;
+}
@@ -0,0 +1,252 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdio.h> // sscanf
+
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/shared/config.h>
+#include <engine/shared/econ.h>
+#include <engine/shared/netban.h>
+#include <engine/shared/network.h>
+
+static int s_NumNew = 0;
+static int s_NumDel = 0;
+
+static int NewClient(int ClientID, void *pUser)
+{
+	s_NumNew++;
+	return 0;
+}
+
+static int DelClient(int ClientID, const char *pReason, void *pUser)
+{
+	s_NumDel++;
+	return 0;
+}
+
+static bool OpenConsole(CNetConsole *pConsole, NETADDR *pAddr)
+{
+	for(int Port = 28400; Port < 28500; Port++)
+	{
+		net_addr_from_str(pAddr, "127.0.0.1");
+		pAddr->port = Port;
+		if(pConsole->Open(*pAddr, 0, 4, NewClient, DelClient, 0))
+			return true;
+	}
+	return false;
+}
+
+static NETSOCKET Connect(const NETADDR *pAddr)
+{
+	NETADDR BindAddr;
+	mem_zero(&BindAddr, sizeof(BindAddr));
+	BindAddr.type = NETTYPE_IPV4;
+	NETSOCKET Socket = net_tcp_create(BindAddr);
+	EXPECT_EQ(net_tcp_connect(Socket, pAddr), 0);
+	net_set_non_blocking(Socket);
+	return Socket;
+}
+
+// reads one line at a time, without the line ending
+class CLineReader
+{
+	NETSOCKET m_Socket;
+	char m_aBuffer[4096];
+	int m_Size;
+
+public:
+	CLineReader(NETSOCKET Socket) : m_Socket(Socket), m_Size(0) {}
+
+	bool Next(char *pLine, int LineSize, CEcon *pEcon = 0)
+	{
+		int64 Deadline = time_get()+10*time_freq();
+		while(time_get() < Deadline)
+		{
+			for(int i = 0; i < m_Size; i++)
+			{
+				if(m_aBuffer[i] != '\n')
+					continue;
+				int Start = 0;
+				while(Start < i && (m_aBuffer[Start] == 0 || m_aBuffer[Start] == '\r'))
+					Start++;
+				str_truncate(pLine, LineSize, m_aBuffer+Start, i-Start);
+				mem_move(m_aBuffer, m_aBuffer+i+1, m_Size-i-1);
+				m_Size -= i+1;
+				return true;
+			}
+
+			if(pEcon)
+				pEcon->Update();
+			int Bytes = net_tcp_recv(m_Socket, m_aBuffer+m_Size, sizeof(m_aBuffer)-m_Size);
+			if(Bytes > 0)
+				m_Size += Bytes;
+			else if(Bytes == 0 || !net_would_block())
+				return false;
+			else
+				thread_sleep(1);
+		}
+		return false;
+	}
+};
+
+static bool WaitForClients(CNetConsole *pConsole, int *pCounter, int Num)
+{
+	int64 Deadline = time_get()+5*time_freq();
+	while(*pCounter < Num && time_get() < Deadline)
+	{
+		pConsole->Update();
+		thread_sleep(1);
+	}
+	return *pCounter == Num;
+}
+
+TEST(NetConsole, OutputBackpressure)
+{
+	CNetConsole Console;
+	NETADDR Addr;
+	ASSERT_TRUE(OpenConsole(&Console, &Addr));
+	s_NumNew = s_NumDel = 0;
+	NETSOCKET Client = Connect(&Addr);
+	ASSERT_TRUE(WaitForClients(&Console, &s_NumNew, 1));
+
+	// the client doesn't read, so the socket and the 64 KiB buffer fill up
+	char aPadding[900];
+	for(unsigned i = 0; i < sizeof(aPadding); i++)
+		aPadding[i] = i+1 < sizeof(aPadding) ? 'x' : 0;
+	int NumSent = 0;
+	int NumDropped = 0;
+	int Line = 0;
+	for(; Line < 100000 && NumDropped < 10; Line++)
+	{
+		char aLine[1024];
+		str_format(aLine, sizeof(aLine), "line %d %s", Line, aPadding);
+		if(Console.Send(0, aLine) == 0)
+			NumSent++;
+		else
+			NumDropped++;
+	}
+	EXPECT_EQ(NumDropped, 10);
+
+	// every line arrives in order, the dropped ones are counted after them
+	CLineReader Reader(Client);
+	int NumReceived = 0;
+	int NumNoticed = 0;
+	int LastLine = -1;
+	char aLine[1024];
+	while(NumReceived+NumNoticed < Line && Reader.Next(aLine, sizeof(aLine)))
+	{
+		int Number, Dropped;
+		if(sscanf(aLine, "line %d", &Number) == 1)
+		{
+			EXPECT_GT(Number, LastLine);
+			LastLine = Number;
+			NumReceived++;
+		}
+		else if(sscanf(aLine, "[%d lines dropped]", &Dropped) == 1)
+			NumNoticed += Dropped;
+	}
+	EXPECT_EQ(NumReceived, NumSent);
+	EXPECT_EQ(NumNoticed, NumDropped);
+
+	net_tcp_close(Client);
+	Console.Close();
+}
+
+TEST(NetConsole, HangupDropsClient)
+{
+	CNetConsole Console;
+	NETADDR Addr;
+	ASSERT_TRUE(OpenConsole(&Console, &Addr));
+	s_NumNew = s_NumDel = 0;
+	NETSOCKET Client = Connect(&Addr);
+	ASSERT_TRUE(WaitForClients(&Console, &s_NumNew, 1));
+
+	// fill the input buffer with lines nobody fetches, then reset the connection
+	char aLines[NET_MAX_PACKETSIZE*2];
+	for(unsigned i = 0; i < sizeof(aLines); i++)
+		aLines[i] = i%4 == 3 ? '\n' : 'a';
+	EXPECT_EQ(net_tcp_send(Client, aLines, sizeof(aLines)), (int)sizeof(aLines));
+	thread_sleep(50);
+	net_tcp_set_linger(Client, 1);
+	net_tcp_close(Client);
+
+	EXPECT_TRUE(WaitForClients(&Console, &s_NumDel, 1));
+	Console.Close();
+}
+
+TEST(Econ, Subscribe)
+{
+	CConfig Config;
+	mem_zero(&Config, sizeof(Config));
+	str_copy(Config.m_EcBindaddr, "127.0.0.1", sizeof(Config.m_EcBindaddr));
+	str_copy(Config.m_EcPassword, "secret", sizeof(Config.m_EcPassword));
+	Config.m_EcMaxClients = 4;
+	Config.m_EcMaxClientsPerIP = 4;
+	Config.m_EcAuthTimeout = 30;
+	Config.m_EcOutputLevel = IConsole::OUTPUT_LEVEL_STANDARD;
+
+	// find a free port, the econ only tries to open once a minute
+	NETADDR Addr;
+	net_addr_from_str(&Addr, "127.0.0.1");
+	for(Addr.port = 28500; Addr.port < 28600; Addr.port++)
+	{
+		NETSOCKET Socket = net_tcp_create(Addr);
+		bool Free = Socket.type && net_tcp_listen(Socket, 1) == 0;
+		net_tcp_close(Socket);
+		if(Free)
+			break;
+	}
+	Config.m_EcPort = Addr.port;
+
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER|CFGFLAG_ECON);
+	CNetBan NetBan;
+	NetBan.Init(pConsole, 0);
+	CEcon Econ;
+	Econ.Init(&Config, pConsole, &NetBan);
+	Econ.Update();
+
+	NETSOCKET Client = Connect(&Addr);
+	CLineReader Reader(Client);
+	char aLine[256];
+	ASSERT_TRUE(Reader.Next(aLine, sizeof(aLine), &Econ));
+	EXPECT_STREQ(aLine, "Enter password:");
+	net_tcp_send(Client, "secret\n", 7);
+	ASSERT_TRUE(Reader.Next(aLine, sizeof(aLine), &Econ));
+	EXPECT_TRUE(str_find(aLine, "Authentication successful"));
+
+	// a line is received if it's the next one that contains pText
+	#define EXPECT_NEXT(pText) do { \
+		while(Reader.Next(aLine, sizeof(aLine), &Econ) && str_find(aLine, "[econ]") && !str_find(aLine, pText)); \
+		EXPECT_TRUE(str_find(aLine, pText)) << aLine; \
+	} while(0)
+
+	// all systems by default
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "test", "first");
+	EXPECT_NEXT("[test]: first");
+
+	// only the given systems
+	net_tcp_send(Client, "subscribe 0 other\n", 18);
+	EXPECT_NEXT("subscribed to level 0 of other");
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "test", "second");
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "other", "third");
+	EXPECT_NEXT("[other]: third");
+
+	// nothing, but command output still gets through
+	net_tcp_send(Client, "unsubscribe\n", 12);
+	for(int i = 0; i < 100; i++)
+	{
+		Econ.Update();
+		thread_sleep(1);
+	}
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "other", "fourth");
+	net_tcp_send(Client, "subscribe 0\n", 12);
+	EXPECT_NEXT("subscribed to level 0 of all systems");
+	#undef EXPECT_NEXT
+
+	net_tcp_close(Client);
+	Econ.Shutdown();
+	delete pConsole;
+}
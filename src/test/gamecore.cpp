@@ -0,0 +1,590 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <gtest/gtest.h>
+
+#include <engine/map.h>
+#include <game/collision.h>
+#include <game/gamecore.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+#include <game/prediction.h>
+
+// box with a few platforms, enough to get the characters to collide and hook
+class CTestMap : public IMap
+{
+	enum
+	{
+		WIDTH=48,
+		HEIGHT=24,
+	};
+
+	CMapItemGroup m_Group;
+	CMapItemLayerTilemap m_Layer;
+	CTile m_aTiles[WIDTH*HEIGHT];
+
+public:
+	CTestMap()
+	{
+		mem_zero(&m_Group, sizeof(m_Group));
+		m_Group.m_Version = CMapItemGroup::CURRENT_VERSION;
+		m_Group.m_StartLayer = 0;
+		m_Group.m_NumLayers = 1;
+
+		mem_zero(&m_Layer, sizeof(m_Layer));
+		m_Layer.m_Layer.m_Type = LAYERTYPE_TILES;
+		m_Layer.m_Version = CMapItemLayerTilemap::CURRENT_VERSION;
+		m_Layer.m_Width = WIDTH;
+		m_Layer.m_Height = HEIGHT;
+		m_Layer.m_Flags = TILESLAYERFLAG_GAME;
+		m_Layer.m_Data = 0;
+
+		mem_zero(m_aTiles, sizeof(m_aTiles));
+		for(int y = 0; y < HEIGHT; y++)
+		{
+			for(int x = 0; x < WIDTH; x++)
+			{
+				if(x == 0 || y == 0 || x == WIDTH-1 || y == HEIGHT-1)
+					m_aTiles[y*WIDTH+x].m_Index = TILE_SOLID;
+				else if(y%6 == 0 && x%12 > 3)
+					m_aTiles[y*WIDTH+x].m_Index = x%12 == 4 ? TILE_NOHOOK : TILE_SOLID;
+			}
+		}
+	}
+
+	void *GetData(int Index) { return m_aTiles; }
+	void *GetDataSwapped(int Index) { return m_aTiles; }
+	void UnloadData(int Index) {}
+	void PrefetchData(const int *pIndices, int Num) {}
+	void *GetItem(int Index, int *pType, int *pID)
+	{
+		if(pType)
+			*pType = Index == 0 ? MAPITEMTYPE_GROUP : MAPITEMTYPE_LAYER;
+		if(pID)
+			*pID = 0;
+		return Index == 0 ? (void *)&m_Group : (void *)&m_Layer;
+	}
+	void GetType(int Type, int *pStart, int *pNum)
+	{
+		*pStart = Type == MAPITEMTYPE_LAYER ? 1 : 0;
+		*pNum = Type == MAPITEMTYPE_GROUP || Type == MAPITEMTYPE_LAYER ? 1 : 0;
+	}
+	void *FindItem(int Type, int ID) { return 0; }
+	int NumItems() { return 2; }
+};
+
+// copy of CCharacterCore::Tick() and Move() from before the character
+// loops were changed, the steps of the world are compared against it
+static void ReferenceTick(CCharacterCore *pCore, CWorldCore *pWorld, CCollision *pCollision, bool UseInput)
+{
+	pCore->m_TriggeredEvents = 0;
+
+	// get ground state
+	const bool Grounded =
+		pCollision->CheckPoint(pCore->m_Pos.x+CCharacterCore::PHYS_SIZE/2, pCore->m_Pos.y+CCharacterCore::PHYS_SIZE/2+5)
+		|| pCollision->CheckPoint(pCore->m_Pos.x-CCharacterCore::PHYS_SIZE/2, pCore->m_Pos.y+CCharacterCore::PHYS_SIZE/2+5);
+
+	vec2 TargetDirection = normalize(vec2(pCore->m_Input.m_TargetX, pCore->m_Input.m_TargetY));
+
+	pCore->m_Vel.y += pWorld->m_Tuning.m_Gravity;
+
+	float MaxSpeed = Grounded ? pWorld->m_Tuning.m_GroundControlSpeed : pWorld->m_Tuning.m_AirControlSpeed;
+	float Accel = Grounded ? pWorld->m_Tuning.m_GroundControlAccel : pWorld->m_Tuning.m_AirControlAccel;
+	float Friction = Grounded ? pWorld->m_Tuning.m_GroundFriction : pWorld->m_Tuning.m_AirFriction;
+
+	// handle input
+	if(UseInput)
+	{
+		pCore->m_Direction = pCore->m_Input.m_Direction;
+		pCore->m_Angle = (int)(angle(vec2(pCore->m_Input.m_TargetX, pCore->m_Input.m_TargetY))*256.0f);
+
+		// handle jump
+		if(pCore->m_Input.m_Jump)
+		{
+			if(!(pCore->m_Jumped&1))
+			{
+				if(Grounded)
+				{
+					pCore->m_TriggeredEvents |= COREEVENTFLAG_GROUND_JUMP;
+					pCore->m_Vel.y = -pWorld->m_Tuning.m_GroundJumpImpulse;
+					pCore->m_Jumped |= 1;
+				}
+				else if(!(pCore->m_Jumped&2))
+				{
+					pCore->m_TriggeredEvents |= COREEVENTFLAG_AIR_JUMP;
+					pCore->m_Vel.y = -pWorld->m_Tuning.m_AirJumpImpulse;
+					pCore->m_Jumped |= 3;
+				}
+			}
+		}
+		else
+			pCore->m_Jumped &= ~1;
+
+		// handle hook
+		if(pCore->m_Input.m_Hook)
+		{
+			if(pCore->m_HookState == HOOK_IDLE)
+			{
+				pCore->m_HookState = HOOK_FLYING;
+				pCore->m_HookPos = pCore->m_Pos+TargetDirection*CCharacterCore::PHYS_SIZE*1.5f;
+				pCore->m_HookDir = TargetDirection;
+				pCore->m_HookedPlayer = -1;
+				pCore->m_HookTick = 0;
+				//pCore->m_TriggeredEvents |= COREEVENTFLAG_HOOK_LAUNCH;
+			}
+		}
+		else
+		{
+			pCore->m_HookedPlayer = -1;
+			pCore->m_HookState = HOOK_IDLE;
+			pCore->m_HookPos = pCore->m_Pos;
+		}
+	}
+
+	// add the speed modification according to players wanted direction
+	if(pCore->m_Direction < 0)
+		pCore->m_Vel.x = SaturatedAdd(-MaxSpeed, MaxSpeed, pCore->m_Vel.x, -Accel);
+	if(pCore->m_Direction > 0)
+		pCore->m_Vel.x = SaturatedAdd(-MaxSpeed, MaxSpeed, pCore->m_Vel.x, Accel);
+	if(pCore->m_Direction == 0)
+		pCore->m_Vel.x *= Friction;
+
+	// handle jumping
+	// 1 bit = to keep track if a jump has been made on this input
+	// 2 bit = to keep track if a air-jump has been made
+	if(Grounded)
+		pCore->m_Jumped &= ~2;
+
+	// do hook
+	if(pCore->m_HookState == HOOK_IDLE)
+	{
+		pCore->m_HookedPlayer = -1;
+		pCore->m_HookState = HOOK_IDLE;
+		pCore->m_HookPos = pCore->m_Pos;
+	}
+	else if(pCore->m_HookState >= HOOK_RETRACT_START && pCore->m_HookState < HOOK_RETRACT_END)
+	{
+		pCore->m_HookState++;
+	}
+	else if(pCore->m_HookState == HOOK_RETRACT_END)
+	{
+		pCore->m_HookState = HOOK_RETRACTED;
+		//pCore->m_TriggeredEvents |= COREEVENTFLAG_HOOK_RETRACT;
+	}
+	else if(pCore->m_HookState == HOOK_FLYING)
+	{
+		vec2 NewPos = pCore->m_HookPos+pCore->m_HookDir*pWorld->m_Tuning.m_HookFireSpeed;
+		if(distance(pCore->m_Pos, NewPos) > pWorld->m_Tuning.m_HookLength)
+		{
+			pCore->m_HookState = HOOK_RETRACT_START;
+			NewPos = pCore->m_Pos + normalize(NewPos-pCore->m_Pos) * pWorld->m_Tuning.m_HookLength;
+		}
+
+		// make sure that the hook doesn't go though the ground
+		bool GoingToHitGround = false;
+		bool GoingToRetract = false;
+		int Hit = pCollision->IntersectLine(pCore->m_HookPos, NewPos, &NewPos, 0);
+		if(Hit)
+		{
+			if(Hit&CCollision::COLFLAG_NOHOOK)
+				GoingToRetract = true;
+			else
+				GoingToHitGround = true;
+		}
+
+		// Check against other players first
+		if(pWorld && pWorld->m_Tuning.m_PlayerHooking)
+		{
+			float Distance = 0.0f;
+			for(int i = 0; i < MAX_CLIENTS; i++)
+			{
+				CCharacterCore *pCharCore = pWorld->m_apCharacters[i];
+				if(!pCharCore || pCharCore == pCore)
+					continue;
+
+				vec2 ClosestPoint = closest_point_on_line(pCore->m_HookPos, NewPos, pCharCore->m_Pos);
+				if(distance(pCharCore->m_Pos, ClosestPoint) < CCharacterCore::PHYS_SIZE+2.0f)
+				{
+					if(pCore->m_HookedPlayer == -1 || distance(pCore->m_HookPos, pCharCore->m_Pos) < Distance)
+					{
+						pCore->m_TriggeredEvents |= COREEVENTFLAG_HOOK_ATTACH_PLAYER;
+						pCore->m_HookState = HOOK_GRABBED;
+						pCore->m_HookedPlayer = i;
+						Distance = distance(pCore->m_HookPos, pCharCore->m_Pos);
+					}
+				}
+			}
+		}
+
+		if(pCore->m_HookState == HOOK_FLYING)
+		{
+			// check against ground
+			if(GoingToHitGround)
+			{
+				pCore->m_TriggeredEvents |= COREEVENTFLAG_HOOK_ATTACH_GROUND;
+				pCore->m_HookState = HOOK_GRABBED;
+			}
+			else if(GoingToRetract)
+			{
+				pCore->m_TriggeredEvents |= COREEVENTFLAG_HOOK_HIT_NOHOOK;
+				pCore->m_HookState = HOOK_RETRACT_START;
+			}
+
+			pCore->m_HookPos = NewPos;
+		}
+	}
+
+	if(pCore->m_HookState == HOOK_GRABBED)
+	{
+		if(pCore->m_HookedPlayer != -1)
+		{
+			CCharacterCore *pCharCore = pWorld->m_apCharacters[pCore->m_HookedPlayer];
+			if(pCharCore)
+				pCore->m_HookPos = pCharCore->m_Pos;
+			else
+			{
+				// release hook
+				pCore->m_HookedPlayer = -1;
+				pCore->m_HookState = HOOK_RETRACTED;
+				pCore->m_HookPos = pCore->m_Pos;
+			}
+
+			// keep players hooked for a max of 1.5sec
+			//if(Server()->Tick() > hook_tick+(Server()->TickSpeed()*3)/2)
+				//release_hooked();
+		}
+
+		// don't do this hook routine when we are already hooked to a player
+		if(pCore->m_HookedPlayer == -1 && distance(pCore->m_HookPos, pCore->m_Pos) > 46.0f)
+		{
+			vec2 HookVel = normalize(pCore->m_HookPos-pCore->m_Pos)*pWorld->m_Tuning.m_HookDragAccel;
+			// the hook as more power to drag you up then down.
+			// this makes it easier to get on top of an platform
+			if(HookVel.y > 0)
+				HookVel.y *= 0.3f;
+
+			// the hook will boost it's power if the player wants to move
+			// in that direction. otherwise it will dampen everything abit
+			if((HookVel.x < 0 && pCore->m_Direction < 0) || (HookVel.x > 0 && pCore->m_Direction > 0))
+				HookVel.x *= 0.95f;
+			else
+				HookVel.x *= 0.75f;
+
+			vec2 NewVel = pCore->m_Vel+HookVel;
+
+			// check if we are under the legal limit for the hook
+			if(length(NewVel) < pWorld->m_Tuning.m_HookDragSpeed || length(NewVel) < length(pCore->m_Vel))
+				pCore->m_Vel = NewVel; // no problem. apply
+
+		}
+
+		// release hook (max hook time is 1.25
+		pCore->m_HookTick++;
+		if(pCore->m_HookedPlayer != -1 && (pCore->m_HookTick > SERVER_TICK_SPEED+SERVER_TICK_SPEED/5 || !pWorld->m_apCharacters[pCore->m_HookedPlayer]))
+		{
+			pCore->m_HookedPlayer = -1;
+			pCore->m_HookState = HOOK_RETRACTED;
+			pCore->m_HookPos = pCore->m_Pos;
+		}
+	}
+
+	if(pWorld)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			CCharacterCore *pCharCore = pWorld->m_apCharacters[i];
+			if(!pCharCore)
+				continue;
+
+			//player *p = (player*)ent;
+			if(pCharCore == pCore) // || !(p->flags&FLAG_ALIVE)
+				continue; // make sure that we don't nudge our self
+
+			// handle player <-> player collision
+			float Distance = distance(pCore->m_Pos, pCharCore->m_Pos);
+			vec2 Dir = normalize(pCore->m_Pos - pCharCore->m_Pos);
+			if(pWorld->m_Tuning.m_PlayerCollision && Distance < CCharacterCore::PHYS_SIZE*1.25f && Distance > 0.0f)
+			{
+				float a = (CCharacterCore::PHYS_SIZE*1.45f - Distance);
+				float Velocity = 0.5f;
+
+				// make sure that we don't add excess force by checking the
+				// direction against the current velocity. if not zero.
+				if(length(pCore->m_Vel) > 0.0001)
+					Velocity = 1-(dot(normalize(pCore->m_Vel), Dir)+1)/2;
+
+				pCore->m_Vel += Dir*a*(Velocity*0.75f);
+				pCore->m_Vel *= 0.85f;
+			}
+
+			// handle hook influence
+			if(pCore->m_HookedPlayer == i && pWorld->m_Tuning.m_PlayerHooking)
+			{
+				if(Distance > CCharacterCore::PHYS_SIZE*1.50f) // TODO: fix tweakable variable
+				{
+					float Accel = pWorld->m_Tuning.m_HookDragAccel * (Distance/pWorld->m_Tuning.m_HookLength);
+
+					// add force to the hooked player
+					pCharCore->m_HookDragVel += Dir*Accel*1.5f;
+
+					// add a little bit force to the guy who has the grip
+					pCore->m_HookDragVel -= Dir*Accel*0.25f;
+				}
+			}
+		}
+	}
+
+	// clamp the velocity to something sane
+	if(length(pCore->m_Vel) > 6000)
+		pCore->m_Vel = normalize(pCore->m_Vel) * 6000;
+}
+
+static void ReferenceMove(CCharacterCore *pCore, CWorldCore *pWorld, CCollision *pCollision)
+{
+	if(!pWorld)
+		return;
+
+	float RampValue = VelocityRamp(length(pCore->m_Vel)*50, pWorld->m_Tuning.m_VelrampStart, pWorld->m_Tuning.m_VelrampRange, pWorld->m_Tuning.m_VelrampCurvature);
+
+	pCore->m_Vel.x = pCore->m_Vel.x*RampValue;
+
+	vec2 NewPos = pCore->m_Pos;
+	pCollision->MoveBox(&NewPos, &pCore->m_Vel, vec2(CCharacterCore::PHYS_SIZE, CCharacterCore::PHYS_SIZE), 0, &pCore->m_Death);
+
+	pCore->m_Vel.x = pCore->m_Vel.x*(1.0f/RampValue);
+
+	if(pWorld->m_Tuning.m_PlayerCollision)
+	{
+		// check player collision
+		float Distance = distance(pCore->m_Pos, NewPos);
+		int End = Distance+1;
+		vec2 LastPos = pCore->m_Pos;
+		for(int i = 0; i < End; i++)
+		{
+			float a = i/Distance;
+			vec2 Pos = mix(pCore->m_Pos, NewPos, a);
+			for(int p = 0; p < MAX_CLIENTS; p++)
+			{
+				CCharacterCore *pCharCore = pWorld->m_apCharacters[p];
+				if(!pCharCore || pCharCore == pCore)
+					continue;
+				float D = distance(Pos, pCharCore->m_Pos);
+				if(D < CCharacterCore::PHYS_SIZE && D >= 0.0f)
+				{
+					if(a > 0.0f)
+						pCore->m_Pos = LastPos;
+					else if(distance(NewPos, pCharCore->m_Pos) > D)
+						pCore->m_Pos = NewPos;
+					return;
+				}
+			}
+			LastPos = Pos;
+		}
+	}
+
+	pCore->m_Pos = NewPos;
+}
+
+static void RandomInput(CNetObj_PlayerInput *pInput, unsigned *pSeed)
+{
+	*pSeed = *pSeed*1103515245u+12345u;
+	unsigned Rand = *pSeed>>8;
+	if(Rand%8 == 0)
+		pInput->m_Direction = (int)(Rand/8%3)-1;
+	if(Rand%5 == 0)
+	{
+		pInput->m_TargetX = (int)(Rand/16%400)-200;
+		pInput->m_TargetY = (int)(Rand/4096%400)-200;
+	}
+	pInput->m_Jump = Rand%13 == 0;
+	if(Rand%17 == 0)
+		pInput->m_Hook ^= 1;
+}
+
+static void ExpectEqualCores(const CCharacterCore *pA, const CCharacterCore *pB, int Tick, int ClientID)
+{
+	CNetObj_CharacterCore A, B;
+	mem_zero(&A, sizeof(A));
+	mem_zero(&B, sizeof(B));
+	pA->Write(&A);
+	pB->Write(&B);
+	EXPECT_TRUE(mem_comp(&A, &B, sizeof(A)) == 0) << "tick " << Tick << " client " << ClientID;
+	EXPECT_TRUE(mem_comp(&pA->m_Pos, &pB->m_Pos, sizeof(pA->m_Pos)) == 0);
+	EXPECT_TRUE(mem_comp(&pA->m_Vel, &pB->m_Vel, sizeof(pA->m_Vel)) == 0);
+	EXPECT_EQ(pA->m_TriggeredEvents, pB->m_TriggeredEvents);
+	EXPECT_EQ(pA->m_Death, pB->m_Death);
+}
+
+TEST(GameCore, StepsMatchReference)
+{
+	CTestMap Map;
+	CLayers Layers;
+	Layers.Init(0, &Map);
+	CCollision Collision;
+	Collision.Init(&Layers);
+
+	// register the characters with gaps in the client ids
+	static const int s_aClientIDs[] = {0, 1, 3, 4, 7, 12, 13, 20, 33, 63};
+	static const int NUM_CHARACTERS = sizeof(s_aClientIDs)/sizeof(s_aClientIDs[0]);
+	CWorldCore WorldReference;
+	CWorldCore WorldBatched;
+	CWorldCore WorldSingle;
+	CCharacterCore aReference[NUM_CHARACTERS];
+	CCharacterCore aBatched[NUM_CHARACTERS];
+	CCharacterCore aSingle[NUM_CHARACTERS];
+	for(int i = 0; i < NUM_CHARACTERS; i++)
+	{
+		aReference[i].Reset();
+		aReference[i].Init(&WorldReference, &Collision);
+		mem_zero(&aReference[i].m_Input, sizeof(aReference[i].m_Input));
+		aReference[i].m_Input.m_TargetX = 1;
+		aReference[i].m_Pos = vec2(100.0f+i*40.0f, 100.0f+(i%3)*150.0f);
+		aReference[i].m_Direction = 0;
+		aReference[i].m_Angle = 0;
+		WorldReference.m_apCharacters[s_aClientIDs[i]] = &aReference[i];
+
+		aBatched[i] = aReference[i];
+		aBatched[i].Init(&WorldBatched, &Collision);
+		WorldBatched.m_apCharacters[s_aClientIDs[i]] = &aBatched[i];
+
+		aSingle[i] = aReference[i];
+		aSingle[i].Init(&WorldSingle, &Collision);
+		WorldSingle.m_apCharacters[s_aClientIDs[i]] = &aSingle[i];
+	}
+
+	unsigned Seed = 1;
+	int NumPlayerHooks = 0;
+	for(int Tick = 0; Tick < 3000; Tick++)
+	{
+		bool aUseInput[MAX_CLIENTS] = { false };
+		for(int i = 0; i < NUM_CHARACTERS; i++)
+		{
+			RandomInput(&aReference[i].m_Input, &Seed);
+			aBatched[i].m_Input = aReference[i].m_Input;
+			aSingle[i].m_Input = aReference[i].m_Input;
+			aUseInput[s_aClientIDs[i]] = i%4 != 3;
+		}
+
+		for(int c = 0; c < MAX_CLIENTS; c++)
+			if(WorldReference.m_apCharacters[c])
+				ReferenceTick(WorldReference.m_apCharacters[c], &WorldReference, &Collision, aUseInput[c]);
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			if(!WorldReference.m_apCharacters[c])
+				continue;
+			WorldReference.m_apCharacters[c]->AddDragVelocity();
+			WorldReference.m_apCharacters[c]->ResetDragVelocity();
+			ReferenceMove(WorldReference.m_apCharacters[c], &WorldReference, &Collision);
+			WorldReference.m_apCharacters[c]->Quantize();
+		}
+
+		WorldBatched.TickCharacters(aUseInput);
+		WorldBatched.MoveCharacters(true);
+
+		for(int c = 0; c < MAX_CLIENTS; c++)
+			if(WorldSingle.m_apCharacters[c])
+				WorldSingle.m_apCharacters[c]->Tick(aUseInput[c]);
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			if(!WorldSingle.m_apCharacters[c])
+				continue;
+			WorldSingle.m_apCharacters[c]->AddDragVelocity();
+			WorldSingle.m_apCharacters[c]->ResetDragVelocity();
+			WorldSingle.m_apCharacters[c]->Move();
+			WorldSingle.m_apCharacters[c]->Quantize();
+		}
+
+		for(int i = 0; i < NUM_CHARACTERS; i++)
+		{
+			ExpectEqualCores(&aReference[i], &aBatched[i], Tick, s_aClientIDs[i]);
+			ExpectEqualCores(&aReference[i], &aSingle[i], Tick, s_aClientIDs[i]);
+			NumPlayerHooks += aReference[i].m_HookedPlayer != -1;
+		}
+		if(::testing::Test::HasFailure())
+			return;
+
+		// drop a character every now and then
+		if(Tick%500 == 250)
+		{
+			int c = s_aClientIDs[Tick/500];
+			WorldReference.m_apCharacters[c] = WorldReference.m_apCharacters[c] ? 0 : &aReference[Tick/500];
+			WorldBatched.m_apCharacters[c] = WorldBatched.m_apCharacters[c] ? 0 : &aBatched[Tick/500];
+			WorldSingle.m_apCharacters[c] = WorldSingle.m_apCharacters[c] ? 0 : &aSingle[Tick/500];
+		}
+	}
+
+	// make sure the characters actually interacted
+	EXPECT_GT(NumPlayerHooks, 0);
+}
+
+static const CNetObj_PlayerInput *PredictionInput(int Tick, void *pUserData)
+{
+	static CNetObj_PlayerInput s_Input;
+	mem_zero(&s_Input, sizeof(s_Input));
+	s_Input.m_Direction = Tick/20%2 ? 1 : -1;
+	s_Input.m_TargetX = 1;
+	s_Input.m_Jump = Tick%30 == 0;
+	return &s_Input;
+}
+
+TEST(Prediction, RangeLongerThanKept)
+{
+	CTestMap Map;
+	CLayers Layers;
+	Layers.Init(0, &Map);
+	CCollision Collision;
+	Collision.Init(&Layers);
+	CTuningParams Tuning;
+
+	CWorldCore World;
+	CNetObj_CharacterCore aCores[2];
+	const CNetObj_CharacterCore *apCharacters[MAX_CLIENTS] = { 0 };
+	for(int i = 0; i < 2; i++)
+	{
+		CCharacterCore Core;
+		Core.Reset();
+		Core.Init(&World, &Collision);
+		Core.m_Pos = vec2(200.0f+i*300.0f, 100.0f);
+		Core.m_Direction = 0;
+		Core.m_Angle = 0;
+		mem_zero(&aCores[i], sizeof(aCores[i]));
+		Core.Write(&aCores[i]);
+	}
+	apCharacters[0] = &aCores[0];
+	apCharacters[5] = &aCores[1];
+
+	// without a range there is only the snapshot
+	CPrediction Prediction;
+	Prediction.Init(&Collision);
+	Prediction.Predict(&Tuning, 100, apCharacters, 0, 100, PredictionInput, 0);
+	ASSERT_TRUE(Prediction.Get(100, 5));
+	EXPECT_EQ(round_to_int(Prediction.Get(100, 5)->m_Pos.x), aCores[1].m_X);
+	EXPECT_FALSE(Prediction.Get(99, 5));
+
+	// only the newest ticks are kept of a long range
+	const int PredTick = 100+CPrediction::MAX_TICKS*3;
+	Prediction.Predict(&Tuning, 100, apCharacters, 0, PredTick, PredictionInput, 0);
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		EXPECT_EQ(Prediction.Get(PredTick, i) != 0, apCharacters[i] != 0);
+		EXPECT_EQ(Prediction.Get(PredTick-1, i) != 0, apCharacters[i] != 0);
+	}
+	EXPECT_FALSE(Prediction.Get(100, 0));
+	EXPECT_FALSE(Prediction.Get(PredTick-CPrediction::MAX_TICKS, 0));
+
+	// the same as predicting the whole range at once
+	CPrediction Fresh;
+	Fresh.Init(&Collision);
+	Fresh.Predict(&Tuning, 100, apCharacters, 0, PredTick, PredictionInput, 0);
+	for(int Tick = PredTick-CPrediction::MAX_TICKS+1; Tick <= PredTick; Tick++)
+	{
+		ASSERT_TRUE(Prediction.Get(Tick, 0) && Fresh.Get(Tick, 0));
+		ExpectEqualCores(Prediction.Get(Tick, 0), Fresh.Get(Tick, 0), Tick, 0);
+		ExpectEqualCores(Prediction.Get(Tick, 5), Fresh.Get(Tick, 5), Tick, 5);
+	}
+
+	// a snapshot older than the kept ticks is predicted from scratch
+	const int Simulated = Prediction.NumSimulatedTicks();
+	Prediction.Predict(&Tuning, 101, apCharacters, 0, PredTick+1, PredictionInput, 0);
+	EXPECT_EQ(Prediction.NumSimulatedTicks()-Simulated, PredTick-100);
+	EXPECT_TRUE(Prediction.Get(PredTick+1, 0));
+}
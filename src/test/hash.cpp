@@ -42,3 +42,12 @@ TEST(Hash, Sha256Eq)
 {
 	EXPECT_EQ(sha256("", 0), sha256("", 0));
 }
+
+TEST(Hash, Sha256FromStr)
+{
+	SHA256_DIGEST Sha256;
+	EXPECT_EQ(sha256_from_str(&Sha256, "E3B0C44298FC1C149AFBF4C8996FB92427AE41E4649B934CA495991B7852B855"), 0);
+	EXPECT_EQ(Sha256, sha256("", 0));
+	EXPECT_NE(sha256_from_str(&Sha256, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b85"), 0);
+	EXPECT_NE(sha256_from_str(&Sha256, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b85x"), 0);
+}
@@ -63,3 +63,36 @@ TEST(Io, ReadBom6)
 {
 	TestFileRead("\xef\xbb\xbfxyz\xef\xbb\xbf", true, "xyz\xef\xbb\xbf");
 }
+
+TEST(Io, Map)
+{
+	CTestInfo Info;
+	static const char s_aData[] = "mapped file contents";
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	EXPECT_EQ(io_write(File, s_aData, sizeof(s_aData)), sizeof(s_aData));
+	EXPECT_FALSE(io_close(File));
+
+	File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	unsigned Size;
+	const char *pData = (const char *)io_map(File, &Size);
+	EXPECT_FALSE(io_close(File));
+	ASSERT_TRUE(pData);
+	ASSERT_EQ(Size, sizeof(s_aData));
+	EXPECT_TRUE(mem_comp(pData, s_aData, sizeof(s_aData)) == 0);
+
+	io_unmap(pData, Size);
+
+	// empty files can't be mapped
+	File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	EXPECT_FALSE(io_close(File));
+	File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	EXPECT_FALSE(io_map(File, &Size));
+	EXPECT_EQ(Size, 0);
+	EXPECT_FALSE(io_close(File));
+
+	fs_remove(Info.m_aFilename);
+}
@@ -0,0 +1,213 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/jobs.h>
+
+#include <stdio.h>
+
+static int Square(void *pData)
+{
+	int *pValue = (int *)pData;
+	return *pValue * *pValue;
+}
+
+TEST(Jobs, Add)
+{
+	CJobPool Pool;
+	Pool.Init(2);
+
+	static const int NUM_JOBS = 200;
+	CJob aJobs[NUM_JOBS];
+	int aValues[NUM_JOBS];
+	CJobGroup Group;
+	for(int i = 0; i < NUM_JOBS; i++)
+	{
+		aValues[i] = i;
+		Pool.Add(&aJobs[i], Square, &aValues[i], &Group);
+	}
+	Pool.Wait(&Group);
+	EXPECT_TRUE(Group.Done());
+	for(int i = 0; i < NUM_JOBS; i++)
+	{
+		EXPECT_EQ(aJobs[i].Status(), CJob::STATE_DONE);
+		EXPECT_EQ(aJobs[i].Result(), i*i);
+	}
+}
+
+TEST(Jobs, WaitWithoutThreads)
+{
+	// the waiting thread does all the work
+	CJobPool Pool;
+	CJob Job;
+	int Value = 7;
+	CJobGroup Group;
+	Pool.Add(&Job, Square, &Value, &Group);
+	EXPECT_EQ(Job.Status(), CJob::STATE_PENDING);
+	Pool.Wait(&Group);
+	EXPECT_EQ(Job.Status(), CJob::STATE_DONE);
+	EXPECT_EQ(Job.Result(), 49);
+}
+
+TEST(Jobs, WaitOnlyRunsGroup)
+{
+	// a thread that isn't a worker leaves other jobs alone, they run
+	// when the pool shuts down
+	int Value = 3;
+	CJob Other;
+	CJob Job;
+	CJobGroup Group;
+	CJobPool Pool;
+	Pool.Add(&Other, Square, &Value);
+	Pool.Add(&Job, Square, &Value, &Group);
+	Pool.Wait(&Group);
+	EXPECT_EQ(Job.Status(), CJob::STATE_DONE);
+	EXPECT_EQ(Other.Status(), CJob::STATE_PENDING);
+}
+
+TEST(Jobs, Shutdown)
+{
+	// queued jobs still run, later ones are refused
+	CJobPool Pool;
+	CJob Job;
+	int Value = 5;
+	CJobGroup Group;
+	Pool.Add(&Job, Square, &Value, &Group);
+	Pool.Shutdown();
+	EXPECT_TRUE(Group.Done());
+	EXPECT_EQ(Job.Result(), 25);
+
+	EXPECT_EQ(Pool.Add(&Job, Square, &Value, &Group), -1);
+	EXPECT_EQ(Job.Status(), CJob::STATE_DONE);
+	Pool.Wait(&Group);
+	EXPECT_TRUE(Group.Done());
+}
+
+struct CFibData
+{
+	CJobPool *m_pPool;
+	int m_N;
+};
+
+static int Fib(void *pData)
+{
+	CFibData *pFib = (CFibData *)pData;
+	if(pFib->m_N < 2)
+		return pFib->m_N;
+
+	// the children go to the deque of this worker, idle ones steal them
+	CFibData aChildren[2] = { { pFib->m_pPool, pFib->m_N-1 }, { pFib->m_pPool, pFib->m_N-2 } };
+	CJob aJobs[2];
+	CJobGroup Group;
+	pFib->m_pPool->Add(&aJobs[0], Fib, &aChildren[0], &Group);
+	pFib->m_pPool->Add(&aJobs[1], Fib, &aChildren[1], &Group);
+	pFib->m_pPool->Wait(&Group);
+	return aJobs[0].Result() + aJobs[1].Result();
+}
+
+TEST(Jobs, Nested)
+{
+	CJobPool Pool;
+	Pool.Init(4);
+	CFibData Fib = { &Pool, 16 };
+	CJob Job;
+	CJobGroup Group;
+	Pool.Add(&Job, ::Fib, &Fib, &Group);
+	Pool.Wait(&Group);
+	EXPECT_EQ(Job.Result(), 987);
+}
+
+struct CRangeData
+{
+	CJobPool *m_pPool;
+	volatile unsigned *m_pVisits;
+};
+
+static void VisitRange(int Begin, int End, void *pUser)
+{
+	CRangeData *pData = (CRangeData *)pUser;
+	for(int i = Begin; i < End; i++)
+		pData->m_pVisits[i]++;
+}
+
+static void NestedRange(int Begin, int End, void *pUser)
+{
+	CRangeData *pData = (CRangeData *)pUser;
+	for(int i = Begin; i < End; i++)
+	{
+		CRangeData Inner = { pData->m_pPool, pData->m_pVisits + i*64 };
+		pData->m_pPool->ParallelFor(0, 64, 4, VisitRange, &Inner);
+	}
+}
+
+TEST(Jobs, ParallelFor)
+{
+	CJobPool Pool;
+	Pool.Init(3);
+
+	static const int NUM = 64*64;
+	static volatile unsigned s_aVisits[NUM];
+	CRangeData Data = { &Pool, s_aVisits };
+	for(int Grain = 1; Grain <= NUM*2; Grain *= 7)
+	{
+		mem_zero((void *)s_aVisits, sizeof(s_aVisits));
+		Pool.ParallelFor(0, NUM, Grain, VisitRange, &Data);
+		for(int i = 0; i < NUM; i++)
+			ASSERT_EQ(s_aVisits[i], 1u);
+	}
+
+	// empty ranges do nothing
+	Pool.ParallelFor(5, 5, 1, VisitRange, 0);
+	Pool.ParallelFor(5, 0, 1, VisitRange, 0);
+
+	// from within jobs
+	mem_zero((void *)s_aVisits, sizeof(s_aVisits));
+	Pool.ParallelFor(0, 64, 1, NestedRange, &Data);
+	for(int i = 0; i < NUM; i++)
+		ASSERT_EQ(s_aVisits[i], 1u);
+}
+
+struct CScalingData
+{
+	unsigned m_aResults[1024];
+};
+
+static void HashRange(int Begin, int End, void *pUser)
+{
+	CScalingData *pData = (CScalingData *)pUser;
+	for(int i = Begin; i < End; i++)
+	{
+		unsigned Hash = 2166136261u^i;
+		for(int k = 0; k < 20000; k++)
+			Hash = (Hash^k)*16777619u;
+		pData->m_aResults[i] = Hash;
+	}
+}
+
+TEST(Jobs, Scaling)
+{
+	// not a pass or fail, prints the speedup over the calling thread alone
+	static const int s_aThreads[] = { 1, 2, 4, 8 };
+	static CScalingData s_Expected;
+	HashRange(0, 1024, &s_Expected);
+
+	int64 BaseTime = 0;
+	for(unsigned t = 0; t < sizeof(s_aThreads)/sizeof(s_aThreads[0]); t++)
+	{
+		CJobPool Pool;
+		Pool.Init(s_aThreads[t]-1);
+
+		static CScalingData s_Data;
+		mem_zero(&s_Data, sizeof(s_Data));
+		int64 Start = time_get();
+		Pool.ParallelFor(0, 1024, 1, HashRange, &s_Data);
+		int64 Time = time_get()-Start;
+		EXPECT_EQ(mem_comp(&s_Data, &s_Expected, sizeof(s_Data)), 0);
+
+		if(t == 0)
+			BaseTime = Time;
+		printf("[ JOBS     ] %d threads (%d cores): %.2f ms, %.2fx\n", s_aThreads[t], cpu_count(),
+			Time*1000.0/time_freq(), Time ? BaseTime/(double)Time : 0.0);
+	}
+}
@@ -0,0 +1,134 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdio.h> // sscanf
+
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+enum
+{
+	NUM_THREADS = 4,
+	NUM_MESSAGES = 5000,
+};
+
+// loggers can't be removed, this one only counts while a test wants it to
+static volatile bool s_Collect = false;
+static int s_aLastMessage[NUM_THREADS];
+static int s_NumReceived = 0;
+static int s_NumOutOfOrder = 0;
+
+static void CollectLogger(const char *pLine, void *pUser)
+{
+	int Thread, Message;
+	const char *pMessage = str_find(pLine, "]: ");
+	if(!s_Collect || !pMessage || sscanf(pMessage, "]: thread %d message %d", &Thread, &Message) != 2 || Thread < 0 || Thread >= NUM_THREADS)
+		return;
+
+	if(Message <= s_aLastMessage[Thread])
+		s_NumOutOfOrder++;
+	s_aLastMessage[Thread] = Message;
+	s_NumReceived++;
+}
+
+static void LogMessages(void *pUser)
+{
+	int Thread = *(int *)pUser;
+	for(int i = 0; i < NUM_MESSAGES; i++)
+		dbg_msg("test", "thread %d message %d", Thread, i);
+}
+
+TEST(Logger, Async)
+{
+	static bool s_Registered = false;
+	if(!s_Registered)
+		dbg_logger(CollectLogger, 0, 0);
+	s_Registered = true;
+
+	for(int i = 0; i < NUM_THREADS; i++)
+		s_aLastMessage[i] = -1;
+	s_NumReceived = 0;
+	s_NumOutOfOrder = 0;
+
+	DBG_LOGGER_STATS Before;
+	dbg_logger_stats(&Before);
+	s_Collect = true;
+	dbg_logger_async_start();
+
+	int aThreadIDs[NUM_THREADS];
+	void *apThreads[NUM_THREADS];
+	for(int i = 0; i < NUM_THREADS; i++)
+	{
+		aThreadIDs[i] = i;
+		apThreads[i] = thread_init(LogMessages, &aThreadIDs[i]);
+	}
+	for(int i = 0; i < NUM_THREADS; i++)
+	{
+		thread_wait(apThreads[i]);
+		thread_destroy(apThreads[i]);
+	}
+	dbg_logger_async_stop();
+	s_Collect = false;
+
+	// every message was either written or counted as dropped, each thread's in order
+	DBG_LOGGER_STATS After;
+	dbg_logger_stats(&After);
+	EXPECT_EQ(s_NumReceived, (int)(After.num_logged-Before.num_logged));
+	EXPECT_EQ(s_NumReceived+(int)(After.num_dropped-Before.num_dropped), NUM_THREADS*NUM_MESSAGES);
+	EXPECT_GT(s_NumReceived, 0);
+	EXPECT_EQ(s_NumOutOfOrder, 0);
+
+	// synchronous again
+	s_Collect = true;
+	dbg_msg("test", "thread 0 message %d", NUM_MESSAGES);
+	s_Collect = false;
+	EXPECT_EQ(s_aLastMessage[0], NUM_MESSAGES);
+}
+
+static void StopLogger(void *pUser)
+{
+	dbg_logger_async_stop();
+}
+
+TEST(Logger, ConcurrentStop)
+{
+	for(int Round = 0; Round < 20; Round++)
+	{
+		dbg_logger_async_start();
+		void *apThreads[NUM_THREADS];
+		for(int i = 0; i < NUM_THREADS; i++)
+			apThreads[i] = thread_init(StopLogger, 0);
+		for(int i = 0; i < NUM_THREADS; i++)
+		{
+			thread_wait(apThreads[i]);
+			thread_destroy(apThreads[i]);
+		}
+	}
+	dbg_logger_async_stop();
+}
+
+static void LogOnce(void *pUser)
+{
+	dbg_msg("test", "ring reuse");
+}
+
+TEST(Logger, RingsReused)
+{
+	DBG_LOGGER_STATS Before;
+	dbg_logger_stats(&Before);
+	dbg_logger_async_start();
+
+	// far more threads than rings one after another, all of them queue
+	enum { NUM_SEQUENTIAL = 100 };
+	for(int i = 0; i < NUM_SEQUENTIAL; i++)
+	{
+		void *pThread = thread_init(LogOnce, 0);
+		thread_wait(pThread);
+		thread_destroy(pThread);
+	}
+	dbg_logger_async_stop();
+
+	DBG_LOGGER_STATS After;
+	dbg_logger_stats(&After);
+	EXPECT_EQ(After.num_logged-Before.num_logged, (unsigned)NUM_SEQUENTIAL);
+}
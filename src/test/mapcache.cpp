@@ -0,0 +1,63 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include "test.h"
+
+#include <gtest/gtest.h>
+
+#include <engine/shared/mapcache.h>
+#include <engine/storage.h>
+
+static void WriteFile(IStorage *pStorage, const char *pFilename)
+{
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	io_close(File);
+}
+
+TEST(MapCache, IndexByFilename)
+{
+	CTestInfo Info;
+	IStorage *pStorage = CreateTestStorage();
+	ASSERT_TRUE(pStorage->CreateFolder(Info.m_aFilenamePrefix, IStorage::TYPE_SAVE));
+
+	SHA256_DIGEST Empty = sha256("", 0);
+	SHA256_DIGEST Test = sha256("test\n", 5);
+	char aEmpty[SHA256_MAXSTRSIZE];
+	sha256_str(Empty, aEmpty, sizeof(aEmpty));
+
+	// only names ending in a valid hash are indexed
+	char aCached[IO_MAX_PATH_LENGTH];
+	char aInvalid[IO_MAX_PATH_LENGTH];
+	char aPlain[IO_MAX_PATH_LENGTH];
+	str_format(aCached, sizeof(aCached), "%s/dm1_%s.map", Info.m_aFilenamePrefix, aEmpty);
+	str_format(aInvalid, sizeof(aInvalid), "%s/dm1_%.63sx.map", Info.m_aFilenamePrefix, aEmpty);
+	str_format(aPlain, sizeof(aPlain), "%s/dm1.map", Info.m_aFilenamePrefix);
+	WriteFile(pStorage, aCached);
+	WriteFile(pStorage, aInvalid);
+	WriteFile(pStorage, aPlain);
+
+	CMapCache Cache;
+	Cache.Init(pStorage, Info.m_aFilenamePrefix);
+	EXPECT_EQ(Cache.Num(), 1);
+	ASSERT_TRUE(Cache.Find(Empty));
+	EXPECT_STREQ(Cache.Find(Empty), aCached);
+	EXPECT_FALSE(Cache.Find(Test));
+
+	// a path that got different content moves to the new hash
+	Cache.Add(Test, aPlain);
+	EXPECT_EQ(Cache.Num(), 2);
+	Cache.Add(Empty, aPlain);
+	EXPECT_EQ(Cache.Num(), 1);
+	EXPECT_STREQ(Cache.Find(Empty), aPlain);
+	EXPECT_FALSE(Cache.Find(Test));
+
+	Cache.Remove(aPlain);
+	EXPECT_EQ(Cache.Num(), 0);
+	EXPECT_FALSE(Cache.Find(Empty));
+
+	EXPECT_TRUE(pStorage->RemoveFile(aCached, IStorage::TYPE_SAVE));
+	EXPECT_TRUE(pStorage->RemoveFile(aInvalid, IStorage::TYPE_SAVE));
+	EXPECT_TRUE(pStorage->RemoveFile(aPlain, IStorage::TYPE_SAVE));
+	fs_remove(Info.m_aFilenamePrefix);
+	delete pStorage;
+}
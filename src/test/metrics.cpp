@@ -0,0 +1,63 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/metrics.h>
+
+static void AppendLine(const char *pLine, void *pUser)
+{
+	str_append((char *)pUser, pLine, 4096);
+	str_append((char *)pUser, "\n", 4096);
+}
+
+static void CollectPair(IMetrics *pMetrics, void *pUser)
+{
+	pMetrics->AddSample("side=\"left\"", 1);
+	pMetrics->AddSample("side=\"right\"", *(int *)pUser);
+}
+
+TEST(Metrics, Export)
+{
+	CMetrics Metrics;
+	IMetrics::CCounter *pCounter = Metrics.RegisterCounter("test_total", "A counter");
+	pCounter->Add();
+	pCounter->Add(2);
+	EXPECT_EQ(Metrics.RegisterCounter("test_total", "Same counter"), pCounter);
+	Metrics.RegisterGauge("test_gauge", "A gauge")->Set(-5);
+
+	static const int64 s_aBounds[] = { 10, 100 };
+	IMetrics::CHistogram *pHistogram = Metrics.RegisterHistogram("test_duration", "A histogram", s_aBounds, 2);
+	pHistogram->Observe(5);
+	pHistogram->Observe(10);
+	pHistogram->Observe(50);
+	pHistogram->Observe(1000);
+
+	int Right = 7;
+	Metrics.RegisterCollector("test_pair", IMetrics::TYPE_GAUGE, "A collector", CollectPair, &Right);
+
+	char aOutput[4096] = { 0 };
+	Metrics.Export(AppendLine, aOutput);
+	EXPECT_STREQ(aOutput,
+		"# HELP test_total A counter\n"
+		"# TYPE test_total counter\n"
+		"test_total 3\n"
+		"# HELP test_gauge A gauge\n"
+		"# TYPE test_gauge gauge\n"
+		"test_gauge -5\n"
+		"# HELP test_duration A histogram\n"
+		"# TYPE test_duration histogram\n"
+		"test_duration_bucket{le=\"10\"} 2\n"
+		"test_duration_bucket{le=\"100\"} 3\n"
+		"test_duration_bucket{le=\"+Inf\"} 4\n"
+		"test_duration_sum 1065\n"
+		"test_duration_count 4\n"
+		"# HELP test_pair A collector\n"
+		"# TYPE test_pair gauge\n"
+		"test_pair{side=\"left\"} 1\n"
+		"test_pair{side=\"right\"} 7\n"
+		"# EOF\n");
+
+	// samples outside of an export go nowhere
+	Metrics.AddSample("side=\"left\"", 1);
+}
@@ -0,0 +1,199 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include "test.h"
+
+#include <gtest/gtest.h>
+
+#include <base/tl/array.h>
+
+#include <engine/console.h>
+#include <engine/shared/config.h>
+#include <engine/shared/netban.h>
+#include <engine/storage.h>
+
+static NETADDR RandomAddr(unsigned *pSeed, int Type)
+{
+	NETADDR Addr;
+	mem_zero(&Addr, sizeof(Addr));
+	Addr.type = Type;
+	for(int i = 0; i < (Type == NETTYPE_IPV4 ? NETADDR_SIZE_IPV4 : NETADDR_SIZE_IPV6); i++)
+	{
+		*pSeed = *pSeed*1103515245+12345;
+		Addr.ip[i] = (*pSeed>>16)&0xff;
+	}
+	// keep some addresses close together, so ranges nest and overlap
+	if(Type == NETTYPE_IPV4)
+		Addr.ip[0] = 10+Addr.ip[0]%3;
+	else
+		Addr.ip[0] = 0x20;
+	return Addr;
+}
+
+static bool InRange(const CNetRange *pRange, const NETADDR *pAddr)
+{
+	int Size = pAddr->type == NETTYPE_IPV4 ? NETADDR_SIZE_IPV4 : NETADDR_SIZE_IPV6;
+	return pRange->m_LB.type == pAddr->type && mem_comp(pRange->m_LB.ip, pAddr->ip, Size) <= 0 && mem_comp(pRange->m_UB.ip, pAddr->ip, Size) >= 0;
+}
+
+static bool IsBannedLinear(const array<NETADDR> &lAddrs, const array<CNetRange> &lRanges, const NETADDR *pAddr)
+{
+	for(int i = 0; i < lAddrs.size(); i++)
+		if(net_addr_comp(&lAddrs[i], pAddr, false) == 0)
+			return true;
+	for(int i = 0; i < lRanges.size(); i++)
+		if(InRange(&lRanges[i], pAddr))
+			return true;
+	return false;
+}
+
+TEST(NetBan, MatchesLinearSearch)
+{
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	CNetBan NetBan;
+	NetBan.Init(pConsole, 0);
+
+	// more than the old limit of 1024 bans per pool
+	unsigned Seed = 1;
+	array<NETADDR> lAddrs;
+	array<CNetRange> lRanges;
+	for(int i = 0; i < 3000; i++)
+	{
+		int Type = i%4 ? NETTYPE_IPV4 : NETTYPE_IPV6;
+		NETADDR Addr = RandomAddr(&Seed, Type);
+		if(i%3 == 0)
+		{
+			EXPECT_EQ(NetBan.BanAddr(&Addr, 0, "test"), 0);
+			lAddrs.add(Addr);
+			continue;
+		}
+
+		CNetRange Range;
+		Range.m_LB = Addr;
+		Range.m_UB = RandomAddr(&Seed, Type);
+		if(mem_comp(Range.m_LB.ip, Range.m_UB.ip, sizeof(Range.m_LB.ip)) > 0)
+		{
+			NETADDR Tmp = Range.m_LB;
+			Range.m_LB = Range.m_UB;
+			Range.m_UB = Tmp;
+		}
+		// mostly small ranges with odd bounds
+		if(i%5)
+			mem_copy(Range.m_UB.ip, Range.m_LB.ip, Type == NETTYPE_IPV4 ? 2 : 12);
+		if(!Range.IsValid())
+			continue;
+		EXPECT_EQ(NetBan.BanRange(&Range, 0, "test"), 0);
+		lRanges.add(Range);
+	}
+
+	for(int i = 0; i < 20000; i++)
+	{
+		NETADDR Addr = i%2 ? RandomAddr(&Seed, i%4 == 1 ? NETTYPE_IPV6 : NETTYPE_IPV4) : lRanges[i%lRanges.size()].m_UB;
+		char aBuf[128];
+		EXPECT_EQ(NetBan.IsBanned(&Addr, aBuf, sizeof(aBuf), 0), IsBannedLinear(lAddrs, lRanges, &Addr));
+	}
+
+	// removing bans prunes the trie without losing overlapping ones
+	for(int i = 0; i < lRanges.size(); i += 2)
+		EXPECT_EQ(NetBan.UnbanByRange(&lRanges[i]), 0);
+	for(int i = 0; i < lAddrs.size(); i += 2)
+		EXPECT_EQ(NetBan.UnbanByAddr(&lAddrs[i]), 0);
+	array<NETADDR> lAddrsLeft;
+	array<CNetRange> lRangesLeft;
+	for(int i = 1; i < lRanges.size(); i += 2)
+		lRangesLeft.add(lRanges[i]);
+	for(int i = 1; i < lAddrs.size(); i += 2)
+		lAddrsLeft.add(lAddrs[i]);
+	for(int i = 0; i < 20000; i++)
+	{
+		NETADDR Addr = i%2 ? RandomAddr(&Seed, i%4 == 1 ? NETTYPE_IPV6 : NETTYPE_IPV4) : lRanges[i%lRanges.size()].m_LB;
+		EXPECT_EQ(NetBan.IsBanned(&Addr, 0, 0, 0), IsBannedLinear(lAddrsLeft, lRangesLeft, &Addr));
+	}
+
+	NetBan.UnbanAll();
+	EXPECT_FALSE(NetBan.IsBanned(&lAddrs[1], 0, 0, 0));
+	delete pConsole;
+}
+
+TEST(NetBan, Import)
+{
+	CTestInfo Info;
+	IStorage *pStorage = CreateTestStorage();
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	CNetBan NetBan;
+	NetBan.Init(pConsole, pStorage);
+
+	IOHANDLE File = pStorage->OpenFile(Info.m_aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	const char aList[] =
+		"# blocklist\n"
+		"10.1.2.3\n"
+		"10.2.0.0/16 spam\n"
+		"  10.3.0.5-10.3.0.9\n"
+		"[2001:db8::]/32\n"
+		"10.4.4.4/32\n"
+		"192.0.0.0/3\n"
+		"10.2.0.0/16\n"
+		"127.0.0.1\n"
+		"10.5.0.0/33\n"
+		"10.6.0.0/\n"
+		"garbage\n";
+	io_write(File, aList, sizeof(aList)-1);
+	io_close(File);
+
+	EXPECT_EQ(NetBan.ImportBans(Info.m_aFilename, 0, "test"), 7);
+
+	static const char *s_apBanned[] = {"10.1.2.3", "10.2.0.0", "10.2.255.255", "10.3.0.5", "10.3.0.9", "[2001:db8:ffff::1]", "10.4.4.4", "200.1.2.3"};
+	static const char *s_apNotBanned[] = {"10.1.2.4", "10.1.255.255", "10.3.0.4", "10.3.0.10", "[2001:db9::]", "10.4.4.5", "127.0.0.1", "224.0.0.0", "10.6.0.0"};
+	for(unsigned i = 0; i < sizeof(s_apBanned)/sizeof(s_apBanned[0]); i++)
+	{
+		NETADDR Addr;
+		ASSERT_EQ(net_addr_from_str(&Addr, s_apBanned[i]), 0);
+		EXPECT_TRUE(NetBan.IsBanned(&Addr, 0, 0, 0)) << s_apBanned[i];
+	}
+	for(unsigned i = 0; i < sizeof(s_apNotBanned)/sizeof(s_apNotBanned[0]); i++)
+	{
+		NETADDR Addr;
+		ASSERT_EQ(net_addr_from_str(&Addr, s_apNotBanned[i]), 0);
+		EXPECT_FALSE(NetBan.IsBanned(&Addr, 0, 0, 0)) << s_apNotBanned[i];
+	}
+
+	EXPECT_EQ(NetBan.ImportBans("does_not_exist.txt", 0, "test"), -1);
+	EXPECT_TRUE(pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE));
+	delete pConsole;
+	delete pStorage;
+}
+
+TEST(NetBan, MaxBans)
+{
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	CNetBan NetBan;
+	NetBan.Init(pConsole, 0);
+	NetBan.SetMaxBans(3);
+
+	NETADDR aAddrs[4];
+	for(int i = 0; i < 4; i++)
+	{
+		char aBuf[32];
+		str_format(aBuf, sizeof(aBuf), "10.0.0.%d", i+1);
+		ASSERT_EQ(net_addr_from_str(&aAddrs[i], aBuf), 0);
+	}
+	CNetRange Range;
+	ASSERT_EQ(net_addr_from_str(&Range.m_LB, "10.1.0.0"), 0);
+	ASSERT_EQ(net_addr_from_str(&Range.m_UB, "10.1.0.255"), 0);
+
+	// addresses and ranges count together, updates don't need room
+	EXPECT_EQ(NetBan.BanAddr(&aAddrs[0], 0, "test"), 0);
+	EXPECT_EQ(NetBan.BanRange(&Range, 0, "test"), 0);
+	EXPECT_EQ(NetBan.BanAddr(&aAddrs[1], 0, "test"), 0);
+	EXPECT_EQ(NetBan.BanAddr(&aAddrs[2], 0, "test"), -1);
+	EXPECT_EQ(NetBan.BanAddr(&aAddrs[1], 60, "test"), 1);
+	EXPECT_FALSE(NetBan.IsBanned(&aAddrs[2], 0, 0, 0));
+
+	EXPECT_EQ(NetBan.UnbanByAddr(&aAddrs[0]), 0);
+	EXPECT_EQ(NetBan.BanAddr(&aAddrs[2], 0, "test"), 0);
+	EXPECT_TRUE(NetBan.IsBanned(&aAddrs[2], 0, 0, 0));
+
+	NetBan.SetMaxBans(0);
+	EXPECT_EQ(NetBan.BanAddr(&aAddrs[3], 0, "test"), 0);
+	delete pConsole;
+}
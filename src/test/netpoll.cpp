@@ -0,0 +1,84 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+static NETSOCKET OpenUdp(NETADDR *pAddr)
+{
+	NETSOCKET Socket;
+	mem_zero(&Socket, sizeof(Socket));
+	for(int Port = 28300; Port < 28400; Port++)
+	{
+		net_addr_from_str(pAddr, "127.0.0.1");
+		pAddr->port = Port;
+		Socket = net_udp_create(*pAddr, 0);
+		if(Socket.type)
+			break;
+	}
+	return Socket;
+}
+
+static void WakeThread(void *pUser)
+{
+	thread_sleep(20);
+	net_poll_wake((NETPOLL)pUser);
+}
+
+TEST(NetPoll, Events)
+{
+	NETADDR Addr;
+	NETSOCKET Socket = OpenUdp(&Addr);
+	ASSERT_TRUE(Socket.type);
+	NETADDR OtherAddr;
+	NETSOCKET Other = OpenUdp(&OtherAddr);
+	ASSERT_TRUE(Other.type);
+
+	NETPOLL Poll = net_poll_create();
+	ASSERT_TRUE(Poll);
+	NETPOLL_EVENT aEvents[4];
+	EXPECT_EQ(net_poll_add(Poll, Socket, NETPOLL_READ, &Socket), 0);
+	EXPECT_EQ(net_poll_wait(Poll, aEvents, 4, 0), 0);
+
+	const char aData[] = "ping";
+	net_udp_send(Other, &Addr, aData, sizeof(aData));
+	ASSERT_EQ(net_poll_wait(Poll, aEvents, 4, 1000), 1);
+	EXPECT_EQ(aEvents[0].user, &Socket);
+	EXPECT_TRUE(aEvents[0].events&NETPOLL_READ);
+
+	// stays ready until the data is read
+	ASSERT_EQ(net_poll_wait(Poll, aEvents, 4, 0), 1);
+	NETADDR From;
+	unsigned char aBuf[64];
+	EXPECT_EQ(net_udp_recv(Socket, &From, aBuf, sizeof(aBuf)), (int)sizeof(aData));
+	EXPECT_EQ(net_poll_wait(Poll, aEvents, 4, 0), 0);
+
+	EXPECT_EQ(net_poll_modify(Poll, Socket, NETPOLL_READ|NETPOLL_WRITE, &Other), 0);
+	ASSERT_EQ(net_poll_wait(Poll, aEvents, 4, 1000), 1);
+	EXPECT_EQ(aEvents[0].user, &Other);
+	EXPECT_EQ(aEvents[0].events, (int)NETPOLL_WRITE);
+
+	EXPECT_EQ(net_poll_remove(Poll, Socket), 0);
+	EXPECT_EQ(net_poll_wait(Poll, aEvents, 4, 0), 0);
+
+	net_poll_destroy(Poll);
+	net_udp_close(Socket);
+	net_udp_close(Other);
+}
+
+TEST(NetPoll, Wake)
+{
+	NETPOLL Poll = net_poll_create();
+	ASSERT_TRUE(Poll);
+
+	// an endless wait returns once woken up from another thread
+	void *pThread = thread_init(WakeThread, Poll);
+	NETPOLL_EVENT aEvents[4];
+	EXPECT_EQ(net_poll_wait(Poll, aEvents, 4, -1), 0);
+	thread_wait(pThread);
+
+	// a wake up before the wait isn't lost
+	net_poll_wake(Poll);
+	EXPECT_EQ(net_poll_wait(Poll, aEvents, 4, -1), 0);
+	net_poll_destroy(Poll);
+}
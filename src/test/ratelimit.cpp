@@ -0,0 +1,94 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/network.h>
+
+static NETADDR MakeAddr(const char *pStr)
+{
+	NETADDR Addr;
+	EXPECT_EQ(net_addr_from_str(&Addr, pStr), 0);
+	return Addr;
+}
+
+TEST(RateLimit, Burst)
+{
+	CNetRateLimiter *pLimiter = new CNetRateLimiter;
+	pLimiter->Init();
+	NETADDR Addr = MakeAddr("10.0.0.1:8303");
+	EXPECT_TRUE(pLimiter->Allow(&Addr, 0));
+	pLimiter->SetRate(10, 5);
+	EXPECT_TRUE(pLimiter->Enabled());
+
+	const int64 Interval = time_freq()/10;
+	const int64 Now = time_freq()*100;
+	for(int i = 0; i < 5; i++)
+		EXPECT_TRUE(pLimiter->Allow(&Addr, Now));
+	EXPECT_FALSE(pLimiter->Allow(&Addr, Now));
+
+	// other ports of the same address share the bucket, other addresses don't
+	NETADDR OtherPort = MakeAddr("10.0.0.1:8304");
+	EXPECT_FALSE(pLimiter->Allow(&OtherPort, Now));
+	NETADDR Other = MakeAddr("10.0.0.2:8303");
+	EXPECT_TRUE(pLimiter->Allow(&Other, Now));
+
+	NETADDR aLimited[4];
+	ASSERT_EQ(pLimiter->GetLimited(aLimited, 4, Now), 1);
+	EXPECT_EQ(net_addr_comp(&aLimited[0], &Addr, false), 0);
+
+	// refills at the configured rate
+	EXPECT_TRUE(pLimiter->Allow(&Addr, Now+Interval));
+	EXPECT_FALSE(pLimiter->Allow(&Addr, Now+Interval));
+	int Allowed = 0;
+	for(int64 Time = Now+Interval; Time < Now+Interval+time_freq()*10; Time += Interval/10)
+		Allowed += pLimiter->Allow(&Addr, Time);
+	EXPECT_NEAR(Allowed, 100, 1);
+	EXPECT_TRUE(pLimiter->Stats()->m_NumLimited > 0);
+
+	// idle sources are not tracked anymore
+	EXPECT_EQ(pLimiter->NumTracked(Now+time_freq()*20), 0);
+
+	pLimiter->SetRate(0, 5);
+	EXPECT_TRUE(pLimiter->Allow(&Addr, Now+Interval));
+	delete pLimiter;
+}
+
+TEST(RateLimit, Ipv6Prefix)
+{
+	CNetRateLimiter *pLimiter = new CNetRateLimiter;
+	pLimiter->Init();
+	pLimiter->SetRate(1, 2);
+
+	NETADDR Addr1 = MakeAddr("[2001:db8:1:2::1]:8303");
+	NETADDR Addr2 = MakeAddr("[2001:db8:1:2:ffff::2]:8303");
+	NETADDR Addr3 = MakeAddr("[2001:db8:1:3::1]:8303");
+	EXPECT_TRUE(pLimiter->Allow(&Addr1, 0));
+	EXPECT_TRUE(pLimiter->Allow(&Addr2, 0));
+	EXPECT_FALSE(pLimiter->Allow(&Addr1, 0));
+	EXPECT_TRUE(pLimiter->Allow(&Addr3, 0));
+	delete pLimiter;
+}
+
+TEST(RateLimit, SpoofedFlood)
+{
+	CNetRateLimiter *pLimiter = new CNetRateLimiter;
+	pLimiter->Init();
+	pLimiter->SetRate(10, 10);
+
+	// far more sources than the table holds, one attacker among them
+	NETADDR Attacker = MakeAddr("192.168.0.1");
+	int AttackerAllowed = 0;
+	for(int i = 0; i < 100000; i++)
+	{
+		NETADDR Addr = MakeAddr("10.0.0.0");
+		Addr.ip[1] = (i>>16)&0xff;
+		Addr.ip[2] = (i>>8)&0xff;
+		Addr.ip[3] = i&0xff;
+		EXPECT_TRUE(pLimiter->Allow(&Addr, 0));
+		AttackerAllowed += pLimiter->Allow(&Attacker, 0);
+	}
+	EXPECT_TRUE(pLimiter->Stats()->m_NumEvicted > 0);
+	EXPECT_EQ(AttackerAllowed, 10);
+	delete pLimiter;
+}
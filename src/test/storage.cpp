@@ -43,3 +43,52 @@ TEST(Storage, FindFile)
 
 	EXPECT_TRUE(pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE));
 }
+
+static void CountBytes(CFileRead *pRead)
+{
+	// runs on an io thread, the result is read after the wait
+	if(pRead->m_Success)
+		*(unsigned *)pRead->m_pUser = pRead->m_DataSize;
+}
+
+TEST(Storage, ReadFileAsync)
+{
+	CTestInfo Info;
+	IStorage *pStorage = CreateTestStorage();
+	IOHANDLE File = pStorage->OpenFile(Info.m_aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	EXPECT_EQ(io_write(File, "test\n", 5), 5);
+	EXPECT_FALSE(io_close(File));
+
+	static const int NUM_READS = 8;
+	CFileRead aReads[NUM_READS];
+	unsigned aSizes[NUM_READS] = { 0 };
+	CJobGroup Group;
+	for(int i = 0; i < NUM_READS; i++)
+		pStorage->ReadFileAsync(&aReads[i], Info.m_aFilename, IStorage::TYPE_ALL, CountBytes, &aSizes[i], &Group);
+
+	char aMissing[128];
+	Info.Filename(aMissing, sizeof(aMissing), ".missing");
+	CFileRead Missing;
+	pStorage->ReadFileAsync(&Missing, aMissing, IStorage::TYPE_ALL);
+
+	pStorage->WaitFileReads(&Group);
+	for(int i = 0; i < NUM_READS; i++)
+	{
+		EXPECT_EQ(aReads[i].m_Job.Status(), CJob::STATE_DONE);
+		ASSERT_TRUE(aReads[i].m_Success);
+		EXPECT_EQ(aReads[i].m_DataSize, 5u);
+		EXPECT_EQ(aSizes[i], 5u);
+		EXPECT_EQ(mem_comp(aReads[i].m_pData, "test\n", 5), 0);
+		mem_free(aReads[i].m_pData);
+	}
+
+	while(Missing.m_Job.Status() != CJob::STATE_DONE)
+		thread_yield();
+	EXPECT_FALSE(Missing.m_Success);
+	EXPECT_EQ(Missing.m_Job.Result(), -1);
+	EXPECT_FALSE(Missing.m_pData);
+
+	EXPECT_TRUE(pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE));
+	delete pStorage;
+}
@@ -24,6 +24,7 @@ int main(int argc, const char **argv)
 	cmdline_fix(&argc, &argv);
 	::testing::InitGoogleTest(&argc, const_cast<char **>(argv));
 	net_init();
+	secure_random_init();
 	int Result = RUN_ALL_TESTS();
 	secure_random_uninit();
 	cmdline_free(argc, argv);
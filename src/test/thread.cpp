@@ -3,6 +3,8 @@
 #include <gtest/gtest.h>
 
 #include <base/system.h>
+#include <base/tl/queue.h>
+#include <base/tl/threading.h>
 
 static void Nothing(void *pUser)
 {
@@ -89,3 +91,201 @@ TEST(Thread, Semaphore)
 	lock_destroy(Context.k_lock);
 	sphore_destroy(&Context.sem);
 }
+
+TEST(Thread, Atomics)
+{
+	volatile unsigned Value = 5;
+	EXPECT_EQ(atomic_add(&Value, 3), 8u);
+	EXPECT_EQ(atomic_exchange(&Value, 1), 8u);
+	EXPECT_EQ(atomic_compswap(&Value, 2, 3), 1u);
+	EXPECT_EQ(atomic_compswap(&Value, 1, 3), 1u);
+	EXPECT_EQ(atomic_load(&Value), 3u);
+	atomic_store(&Value, 4u);
+	EXPECT_EQ(Value, 4u);
+
+	int A, B;
+	int *volatile pPointer = &A;
+	EXPECT_EQ(atomic_compswap(&pPointer, &B, &B), &A);
+	EXPECT_EQ(atomic_compswap(&pPointer, &A, &B), &A);
+	EXPECT_EQ(atomic_load(&pPointer), &B);
+}
+
+static const int NUM_STRESS_THREADS = 4;
+
+struct CCounterData
+{
+	volatile unsigned m_Counter;
+	volatile unsigned m_Start;
+};
+
+static void CountThread(void *pUser)
+{
+	CCounterData *pData = (CCounterData *)pUser;
+	while(!atomic_load(&pData->m_Start))
+		atomic_wait(&pData->m_Start, 0);
+	for(int i = 0; i < 100000; i++)
+		atomic_inc(&pData->m_Counter);
+}
+
+TEST(Thread, AtomicCounter)
+{
+	CCounterData Data;
+	Data.m_Counter = 0;
+	Data.m_Start = 0;
+	void *apThreads[NUM_STRESS_THREADS];
+	for(int i = 0; i < NUM_STRESS_THREADS; i++)
+		apThreads[i] = thread_init(CountThread, &Data);
+
+	// release all of them at once
+	atomic_store(&Data.m_Start, 1u);
+	atomic_notify_all(&Data.m_Start);
+	for(int i = 0; i < NUM_STRESS_THREADS; i++)
+	{
+		thread_wait(apThreads[i]);
+		thread_destroy(apThreads[i]);
+	}
+	EXPECT_EQ(Data.m_Counter, NUM_STRESS_THREADS*100000u);
+}
+
+static void PingThread(void *pUser)
+{
+	// answers every odd value with the next even one
+	volatile unsigned *pValue = (volatile unsigned *)pUser;
+	for(unsigned i = 1; i < 2000; i += 2)
+	{
+		while(atomic_load(pValue) != i)
+			atomic_wait(pValue, i-1);
+		atomic_store(pValue, i+1);
+		atomic_notify_one(pValue);
+	}
+}
+
+TEST(Thread, WaitNotify)
+{
+	volatile unsigned Value = 0;
+	void *pThread = thread_init(PingThread, (void *)&Value);
+	for(unsigned i = 0; i < 2000; i += 2)
+	{
+		while(atomic_load(&Value) != i)
+			atomic_wait(&Value, i-1);
+		atomic_store(&Value, i+1);
+		atomic_notify_one(&Value);
+	}
+	thread_wait(pThread);
+	thread_destroy(pThread);
+	EXPECT_EQ(Value, 2000u);
+
+	// a changed value returns right away
+	atomic_wait(&Value, 1);
+}
+
+static const unsigned NUM_QUEUE_ITEMS = 200000;
+
+static void SpscProducer(void *pUser)
+{
+	spsc_queue<unsigned, 64> *pQueue = (spsc_queue<unsigned, 64> *)pUser;
+	for(unsigned i = 0; i < NUM_QUEUE_ITEMS; i++)
+	{
+		while(!pQueue->push(i))
+			thread_yield();
+	}
+}
+
+TEST(Thread, SpscQueue)
+{
+	spsc_queue<unsigned, 64> *pQueue = new spsc_queue<unsigned, 64>;
+	unsigned Item;
+	EXPECT_FALSE(pQueue->pop(&Item));
+
+	void *pThread = thread_init(SpscProducer, pQueue);
+	unsigned NumOutOfOrder = 0;
+	for(unsigned i = 0; i < NUM_QUEUE_ITEMS; i++)
+	{
+		while(!pQueue->pop(&Item))
+			thread_yield();
+		if(Item != i)
+			NumOutOfOrder++;
+	}
+	thread_wait(pThread);
+	thread_destroy(pThread);
+	EXPECT_EQ(NumOutOfOrder, 0u);
+	EXPECT_EQ(pQueue->size(), 0);
+
+	// full is full
+	for(int i = 0; i < 64; i++)
+		EXPECT_TRUE(pQueue->push(i));
+	EXPECT_FALSE(pQueue->push(64));
+	EXPECT_EQ(pQueue->size(), 64);
+	delete pQueue;
+}
+
+typedef mpmc_queue<unsigned, 256> CStressQueue;
+
+struct CMpmcData
+{
+	CStressQueue m_Queue;
+	volatile unsigned m_NumPopped;
+	volatile unsigned m_aSeen[NUM_STRESS_THREADS*NUM_QUEUE_ITEMS/4];
+	volatile unsigned m_NextProducer;
+};
+
+static void MpmcProducer(void *pUser)
+{
+	CMpmcData *pData = (CMpmcData *)pUser;
+	const unsigned Producer = atomic_inc(&pData->m_NextProducer)-1;
+	const unsigned PerProducer = NUM_QUEUE_ITEMS/4;
+	for(unsigned i = 0; i < PerProducer; i++)
+	{
+		while(!pData->m_Queue.push(Producer*PerProducer+i))
+			thread_yield();
+	}
+}
+
+static void MpmcConsumer(void *pUser)
+{
+	CMpmcData *pData = (CMpmcData *)pUser;
+	const unsigned Total = NUM_STRESS_THREADS*NUM_QUEUE_ITEMS/4;
+	unsigned Item;
+	while(atomic_load(&pData->m_NumPopped) < Total)
+	{
+		if(pData->m_Queue.pop(&Item))
+		{
+			atomic_inc(&pData->m_aSeen[Item]);
+			atomic_inc(&pData->m_NumPopped);
+		}
+		else
+			thread_yield();
+	}
+}
+
+TEST(Thread, MpmcQueue)
+{
+	CMpmcData *pData = new CMpmcData;
+	mem_zero((void *)pData->m_aSeen, sizeof(pData->m_aSeen));
+	pData->m_NumPopped = 0;
+	pData->m_NextProducer = 0;
+
+	void *apThreads[NUM_STRESS_THREADS*2];
+	for(int i = 0; i < NUM_STRESS_THREADS; i++)
+	{
+		apThreads[i*2] = thread_init(MpmcProducer, pData);
+		apThreads[i*2+1] = thread_init(MpmcConsumer, pData);
+	}
+	for(int i = 0; i < NUM_STRESS_THREADS*2; i++)
+	{
+		thread_wait(apThreads[i]);
+		thread_destroy(apThreads[i]);
+	}
+
+	// every item exactly once
+	unsigned NumWrong = 0;
+	for(unsigned i = 0; i < NUM_STRESS_THREADS*NUM_QUEUE_ITEMS/4; i++)
+	{
+		if(pData->m_aSeen[i] != 1)
+			NumWrong++;
+	}
+	EXPECT_EQ(NumWrong, 0u);
+	unsigned Item;
+	EXPECT_FALSE(pData->m_Queue.pop(&Item));
+	delete pData;
+}
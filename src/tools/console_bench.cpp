@@ -0,0 +1,156 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/config.h>
+#include <engine/console.h>
+#include <engine/kernel.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+
+/*
+	Console execution benchmark.
+
+	Registers a number of extra commands the way mods register their
+	commands and tunings, writes a config file that sets variables and
+	calls those commands, partly several statements per line like votes
+	do, and executes it several rounds. With -f the given file is executed
+	instead. Reports the time per round and per executed line.
+
+	Usage: console_bench [-c commands] [-l lines] [-n rounds] [-f file]
+*/
+
+static const char *s_pConfigFilename = "console_bench.cfg";
+
+static int s_NumCalls = 0;
+
+static void ConBench(IConsole::IResult *pResult, void *pUserData)
+{
+	s_NumCalls++;
+}
+
+static bool WriteConfig(IStorage *pStorage, int NumCommands, int NumLines)
+{
+	IOHANDLE File = pStorage->OpenFile(s_pConfigFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+		return false;
+
+	static const char *s_apVariables[] = { "sv_name", "sv_motd", "sv_max_clients", "sv_scorelimit", "sv_timelimit", "sv_warmup", "sv_rcon_password" };
+	const int NumVariables = sizeof(s_apVariables)/sizeof(s_apVariables[0]);
+	char aLine[256];
+	for(int i = 0; i < NumLines; i++)
+	{
+		switch(i%4)
+		{
+		case 0: str_format(aLine, sizeof(aLine), "%s \"%d\"", s_apVariables[i%NumVariables], i%20+1); break;
+		case 1: str_format(aLine, sizeof(aLine), "bench_cmd_%d %d", (i*7)%NumCommands, i); break;
+		case 2: str_format(aLine, sizeof(aLine), "Bench_Cmd_%d %d; bench_cmd_%d; %s", (i*13)%NumCommands, i, (i*31)%NumCommands, s_apVariables[i%NumVariables]); break;
+		default: str_format(aLine, sizeof(aLine), "echo line %d", i);
+		}
+		io_write(File, aLine, str_length(aLine));
+		io_write_newline(File);
+	}
+	io_close(File);
+	return true;
+}
+
+int main(int argc, const char **argv)
+{
+	cmdline_fix(&argc, &argv);
+
+	int NumCommands = 500;
+	int NumLines = 20000;
+	int NumRounds = 10;
+	const char *pFilename = 0;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-c") == 0 && i+1 < argc)
+			NumCommands = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-l") == 0 && i+1 < argc)
+			NumLines = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-n") == 0 && i+1 < argc)
+			NumRounds = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-f") == 0 && i+1 < argc)
+			pFilename = argv[++i];
+		else
+		{
+			dbg_logger_stdout();
+			dbg_msg("console_bench", "usage: %s [-c commands] [-l lines] [-n rounds] [-f file]", argv[0]);
+			return -1;
+		}
+	}
+
+	IKernel *pKernel = IKernel::Create();
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_SERVER, argc, argv);
+	IConfigManager *pConfigManager = CreateConfigManager();
+	if(!pStorage || !pKernel->RegisterInterface(pConsole) || !pKernel->RegisterInterface(pStorage) || !pKernel->RegisterInterface(pConfigManager))
+		return -1;
+	pConfigManager->Init(CFGFLAG_SERVER);
+	pConsole->Init();
+
+	// the names have to outlive the console
+	char (*paNames)[32] = new char[NumCommands][32];
+	for(int i = 0; i < NumCommands; i++)
+	{
+		str_format(paNames[i], sizeof(paNames[i]), "bench_cmd_%d", i);
+		pConsole->Register(paNames[i], "?i", CFGFLAG_SERVER, ConBench, 0, "Benchmark command");
+	}
+
+	if(!pFilename)
+	{
+		if(!WriteConfig(pStorage, NumCommands, NumLines))
+			return -1;
+		pFilename = s_pConfigFilename;
+	}
+
+	// count the lines once, the console prints nothing without a print callback
+	int NumExecuted = 0;
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(File)
+	{
+		char aBuf[4096];
+		unsigned Bytes;
+		while((Bytes = io_read(File, aBuf, sizeof(aBuf))) > 0)
+			for(unsigned i = 0; i < Bytes; i++)
+				NumExecuted += aBuf[i] == '\n';
+		io_close(File);
+	}
+
+	int64 Best = 0;
+	int64 Total = 0;
+	bool Failed = false;
+	for(int Round = 0; Round < NumRounds && !Failed; Round++)
+	{
+		int64 Start = time_get();
+		Failed = !pConsole->ExecuteFile(pFilename);
+		int64 Time = time_get()-Start;
+		Total += Time;
+		if(Round == 0 || Time < Best)
+			Best = Time;
+	}
+
+	if(pFilename == s_pConfigFilename)
+		pStorage->RemoveFile(s_pConfigFilename, IStorage::TYPE_SAVE);
+
+	dbg_logger_stdout();
+	if(Failed)
+		dbg_msg("console_bench", "failed to execute '%s'", pFilename);
+	else
+	{
+		const float Scale = 1000.0f/time_freq();
+		dbg_msg("console_bench", "%d extra commands, %d lines, %d command calls per round", NumCommands, NumExecuted, s_NumCalls/NumRounds);
+		dbg_msg("console_bench", "per round: average %.3f ms, best %.3f ms, %.3f us per line",
+			Total*Scale/NumRounds, Best*Scale, NumExecuted ? Best*Scale*1000.0f/NumExecuted : 0.0f);
+	}
+
+	delete pConsole;
+	delete pStorage;
+	delete pConfigManager;
+	delete pKernel;
+	delete[] paNames;
+	cmdline_free(argc, argv);
+	return Failed ? 1 : 0;
+}
@@ -0,0 +1,510 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+#include <base/tl/array.h>
+#include <engine/console.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/jobs.h>
+#include <engine/shared/jsonwriter.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/snapshot.h>
+#include <game/gamecore.h>
+#include <game/version.h>
+#include <generated/protocol.h>
+
+/*
+	Headless demo processor.
+
+	Plays demos as fast as they can be read instead of following the clock
+	like the client does, decodes the snapshots into their network objects
+	and writes the characters and scores of every tick together with the
+	kills as json, or one line per character and tick as csv. The demos are
+	processed in parallel on a job pool, one demo per job.
+
+	Usage: demo_stats [-f json|csv] [-j threads] [-o directory] <demo or directory>...
+*/
+
+enum
+{
+	FORMAT_JSON=0,
+	FORMAT_CSV,
+
+	// items up to here have a static size in the snapshot delta, like in the game
+	OLD_NUM_NETOBJTYPES=23,
+};
+
+struct CKill
+{
+	int m_Tick;
+	int m_Killer;
+	int m_Victim;
+	int m_Weapon;
+};
+
+class CDemoJob
+{
+public:
+	char m_aDemoFile[IO_MAX_PATH_LENGTH];
+	char m_aOutputFile[IO_MAX_PATH_LENGTH];
+	int m_Format;
+	IStorage *m_pStorage;
+	IConsole *m_pConsole;
+	CJob m_Job;
+
+	// results
+	bool m_Success;
+	int m_NumTicks;
+	int m_NumInvalidItems;
+	unsigned m_DemoSize;
+};
+
+class CStatsExtractor : public CDemoPlayer::IListener
+{
+	const CDemoPlayer *m_pPlayer;
+	CNetObjHandler m_NetObjHandler;
+	IOHANDLE m_File;
+	CJsonWriter *m_pJson;
+	int m_Format;
+
+	int m_LastTick;
+	int m_NumTicks;
+	int m_NumInvalidItems;
+	int m_aNumMessages[NUM_NETMSGTYPES];
+	array<CKill> m_lKills;
+
+	char m_aaNames[MAX_CLIENTS][MAX_NAME_LENGTH];
+	int m_aTeams[MAX_CLIENTS];
+
+	void WriteCharacter(int ClientID, const CNetObj_Character *pCharacter, const CNetObj_PlayerInfo *pInfo)
+	{
+		if(m_Format == FORMAT_CSV)
+		{
+			char aBuf[256];
+			str_format(aBuf, sizeof(aBuf), "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", m_LastTick, ClientID,
+				pCharacter->m_X, pCharacter->m_Y, pCharacter->m_VelX, pCharacter->m_VelY,
+				pCharacter->m_Weapon, pCharacter->m_Health, pCharacter->m_Armor, pInfo ? pInfo->m_Score : 0);
+			io_write(m_File, aBuf, str_length(aBuf));
+			return;
+		}
+
+		m_pJson->BeginObject();
+		m_pJson->WriteAttribute("id");
+		m_pJson->WriteIntValue(ClientID);
+		m_pJson->WriteAttribute("x");
+		m_pJson->WriteIntValue(pCharacter->m_X);
+		m_pJson->WriteAttribute("y");
+		m_pJson->WriteIntValue(pCharacter->m_Y);
+		m_pJson->WriteAttribute("vel_x");
+		m_pJson->WriteIntValue(pCharacter->m_VelX);
+		m_pJson->WriteAttribute("vel_y");
+		m_pJson->WriteIntValue(pCharacter->m_VelY);
+		m_pJson->WriteAttribute("weapon");
+		m_pJson->WriteIntValue(pCharacter->m_Weapon);
+		m_pJson->WriteAttribute("health");
+		m_pJson->WriteIntValue(pCharacter->m_Health);
+		m_pJson->WriteAttribute("armor");
+		m_pJson->WriteIntValue(pCharacter->m_Armor);
+		m_pJson->WriteAttribute("score");
+		if(pInfo)
+			m_pJson->WriteIntValue(pInfo->m_Score);
+		else
+			m_pJson->WriteNullValue();
+		m_pJson->EndObject();
+	}
+
+public:
+	CStatsExtractor(const CDemoPlayer *pPlayer, IOHANDLE File, int Format)
+	{
+		m_pPlayer = pPlayer;
+		m_File = File;
+		m_pJson = Format == FORMAT_JSON ? new CJsonWriter(File) : 0;
+		m_Format = Format;
+		m_LastTick = -1;
+		m_NumTicks = 0;
+		m_NumInvalidItems = 0;
+		mem_zero(m_aNumMessages, sizeof(m_aNumMessages));
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			m_aaNames[i][0] = 0;
+			m_aTeams[i] = TEAM_SPECTATORS;
+		}
+	}
+
+	~CStatsExtractor()
+	{
+		// the json writer closes the file
+		if(m_pJson)
+			delete m_pJson;
+		else
+			io_close(m_File);
+	}
+
+	int NumTicks() const { return m_NumTicks; }
+	int NumInvalidItems() const { return m_NumInvalidItems; }
+
+	void Begin(const char *pDemoName)
+	{
+		if(m_Format == FORMAT_CSV)
+		{
+			static const char s_aHeader[] = "tick,id,x,y,vel_x,vel_y,weapon,health,armor,score\n";
+			io_write(m_File, s_aHeader, str_length(s_aHeader));
+			return;
+		}
+
+		const CDemoHeader *pHeader = &m_pPlayer->Info()->m_Header;
+		m_pJson->BeginObject();
+		m_pJson->WriteAttribute("demo");
+		m_pJson->WriteStrValue(pDemoName);
+		m_pJson->WriteAttribute("map");
+		m_pJson->WriteStrValue(pHeader->m_aMapName);
+		m_pJson->WriteAttribute("type");
+		m_pJson->WriteStrValue(pHeader->m_aType);
+		m_pJson->WriteAttribute("first_tick");
+		m_pJson->WriteIntValue(m_pPlayer->BaseInfo()->m_FirstTick);
+		m_pJson->WriteAttribute("last_tick");
+		m_pJson->WriteIntValue(m_pPlayer->BaseInfo()->m_LastTick);
+		m_pJson->WriteAttribute("ticks");
+		m_pJson->BeginArray();
+	}
+
+	void End()
+	{
+		if(m_Format == FORMAT_CSV)
+			return;
+
+		m_pJson->EndArray();
+
+		m_pJson->WriteAttribute("kills");
+		m_pJson->BeginArray();
+		for(int i = 0; i < m_lKills.size(); i++)
+		{
+			m_pJson->BeginObject();
+			m_pJson->WriteAttribute("tick");
+			m_pJson->WriteIntValue(m_lKills[i].m_Tick);
+			m_pJson->WriteAttribute("killer");
+			m_pJson->WriteIntValue(m_lKills[i].m_Killer);
+			m_pJson->WriteAttribute("victim");
+			m_pJson->WriteIntValue(m_lKills[i].m_Victim);
+			m_pJson->WriteAttribute("weapon");
+			m_pJson->WriteIntValue(m_lKills[i].m_Weapon);
+			m_pJson->EndObject();
+		}
+		m_pJson->EndArray();
+
+		m_pJson->WriteAttribute("clients");
+		m_pJson->BeginArray();
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(!m_aaNames[i][0])
+				continue;
+			m_pJson->BeginObject();
+			m_pJson->WriteAttribute("id");
+			m_pJson->WriteIntValue(i);
+			m_pJson->WriteAttribute("name");
+			m_pJson->WriteStrValue(m_aaNames[i]);
+			m_pJson->WriteAttribute("team");
+			m_pJson->WriteIntValue(m_aTeams[i]);
+			m_pJson->EndObject();
+		}
+		m_pJson->EndArray();
+
+		m_pJson->WriteAttribute("messages");
+		m_pJson->BeginObject();
+		for(int i = 0; i < NUM_NETMSGTYPES; i++)
+		{
+			if(!m_aNumMessages[i])
+				continue;
+			m_pJson->WriteAttribute(m_NetObjHandler.GetMsgName(i));
+			m_pJson->WriteIntValue(m_aNumMessages[i]);
+		}
+		m_pJson->EndObject();
+
+		m_pJson->WriteAttribute("invalid_items");
+		m_pJson->WriteIntValue(m_NumInvalidItems);
+		m_pJson->EndObject();
+	}
+
+	void OnDemoPlayerSnapshot(void *pData, int Size)
+	{
+		const CSnapshot *pSnap = (const CSnapshot *)pData;
+		m_LastTick = m_pPlayer->BaseInfo()->m_CurrentTick;
+		m_NumTicks++;
+
+		if(m_Format == FORMAT_JSON)
+		{
+			m_pJson->BeginObject();
+			m_pJson->WriteAttribute("tick");
+			m_pJson->WriteIntValue(m_LastTick);
+			m_pJson->WriteAttribute("characters");
+			m_pJson->BeginArray();
+		}
+
+		for(int i = 0; i < pSnap->NumItems(); i++)
+		{
+			const CSnapshotItem *pItem = pSnap->GetItem(i);
+			const int ItemSize = pSnap->GetItemSize(i);
+			if(m_NetObjHandler.ValidateObj(pItem->Type(), pItem->Data(), ItemSize) != 0)
+			{
+				m_NumInvalidItems++;
+				continue;
+			}
+
+			if(pItem->Type() == NETOBJTYPE_DE_CLIENTINFO && pItem->ID() >= 0 && pItem->ID() < MAX_CLIENTS)
+			{
+				const CNetObj_De_ClientInfo *pInfo = (const CNetObj_De_ClientInfo *)pItem->Data();
+				IntsToStr(pInfo->m_aName, 4, m_aaNames[pItem->ID()]);
+				m_aTeams[pItem->ID()] = pInfo->m_Team;
+			}
+			else if(pItem->Type() == NETOBJTYPE_CHARACTER)
+			{
+				// the score is in the player info with the same id
+				const CNetObj_PlayerInfo *pPlayerInfo = 0;
+				const int InfoIndex = pSnap->GetItemIndex((NETOBJTYPE_PLAYERINFO<<16)|pItem->ID());
+				if(InfoIndex >= 0 && m_NetObjHandler.ValidateObj(NETOBJTYPE_PLAYERINFO, pSnap->GetItem(InfoIndex)->Data(), pSnap->GetItemSize(InfoIndex)) == 0)
+					pPlayerInfo = (const CNetObj_PlayerInfo *)pSnap->GetItem(InfoIndex)->Data();
+				WriteCharacter(pItem->ID(), (const CNetObj_Character *)pItem->Data(), pPlayerInfo);
+			}
+		}
+
+		if(m_Format == FORMAT_JSON)
+		{
+			m_pJson->EndArray();
+			m_pJson->EndObject();
+		}
+	}
+
+	void OnDemoPlayerMessage(void *pData, int Size)
+	{
+		CUnpacker Unpacker;
+		Unpacker.Reset(pData, Size);
+		int Msg = Unpacker.GetInt();
+		const bool Sys = Msg&1;
+		Msg >>= 1;
+		if(Unpacker.Error() || Sys || Msg < 0 || Msg >= NUM_NETMSGTYPES)
+			return;
+
+		void *pRawMsg = m_NetObjHandler.SecureUnpackMsg(Msg, &Unpacker);
+		if(!pRawMsg)
+			return;
+		m_aNumMessages[Msg]++;
+
+		if(Msg == NETMSGTYPE_SV_KILLMSG)
+		{
+			const CNetMsg_Sv_KillMsg *pKillMsg = (const CNetMsg_Sv_KillMsg *)pRawMsg;
+			CKill Kill;
+			Kill.m_Tick = m_pPlayer->BaseInfo()->m_CurrentTick;
+			Kill.m_Killer = pKillMsg->m_Killer;
+			Kill.m_Victim = pKillMsg->m_Victim;
+			Kill.m_Weapon = pKillMsg->m_Weapon;
+			m_lKills.add(Kill);
+		}
+	}
+};
+
+static int ProcessDemo(void *pUser)
+{
+	CDemoJob *pJob = (CDemoJob *)pUser;
+	pJob->m_Success = false;
+	pJob->m_NumTicks = 0;
+	pJob->m_NumInvalidItems = 0;
+	pJob->m_DemoSize = 0;
+
+	// every job has its own state, only storage and console are shared
+	CSnapshotDelta *pSnapshotDelta = new CSnapshotDelta();
+	CNetObjHandler NetObjHandler;
+	for(int i = 0; i < OLD_NUM_NETOBJTYPES; i++)
+		pSnapshotDelta->SetStaticsize(i, NetObjHandler.GetObjSize(i));
+
+	CDemoPlayer *pPlayer = new CDemoPlayer(pSnapshotDelta);
+	pPlayer->Init(pJob->m_pConsole, pJob->m_pStorage);
+	pPlayer->EnableSnapshotCache(false);
+	if(pPlayer->Load(pJob->m_aDemoFile, IStorage::TYPE_ALL, GAME_NETVERSION))
+	{
+		delete pPlayer;
+		delete pSnapshotDelta;
+		return -1;
+	}
+
+	IOHANDLE File = io_open(pJob->m_aOutputFile, IOFLAG_WRITE);
+	if(!File)
+	{
+		dbg_msg("demo_stats", "failed to open '%s' for writing", pJob->m_aOutputFile);
+		pPlayer->Stop();
+		delete pPlayer;
+		delete pSnapshotDelta;
+		return -1;
+	}
+
+	IOHANDLE DemoFile = pJob->m_pStorage->OpenFile(pJob->m_aDemoFile, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(DemoFile)
+	{
+		pJob->m_DemoSize = io_length(DemoFile);
+		io_close(DemoFile);
+	}
+
+	CStatsExtractor *pExtractor = new CStatsExtractor(pPlayer, File, pJob->m_Format);
+	pPlayer->SetListener(pExtractor);
+	pExtractor->Begin(pJob->m_aDemoFile);
+	while(pPlayer->NextTick() == 0)
+		;
+	pExtractor->End();
+	pPlayer->Stop();
+
+	pJob->m_NumTicks = pExtractor->NumTicks();
+	pJob->m_NumInvalidItems = pExtractor->NumInvalidItems();
+	pJob->m_Success = true;
+
+	delete pExtractor;
+	delete pPlayer;
+	delete pSnapshotDelta;
+	return 0;
+}
+
+struct CDemoList
+{
+	const char *m_pDirectory;
+	array<CDemoJob *> *m_plJobs;
+};
+
+static void AddDemo(array<CDemoJob *> *plJobs, const char *pDemoFile)
+{
+	CDemoJob *pJob = new CDemoJob();
+	str_copy(pJob->m_aDemoFile, pDemoFile, sizeof(pJob->m_aDemoFile));
+	plJobs->add(pJob);
+}
+
+static int DemolistCallback(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	CDemoList *pList = (CDemoList *)pUser;
+	int Length = str_length(pName);
+	if(IsDir || Length < 5 || str_comp(pName+Length-5, ".demo") != 0)
+		return 0;
+
+	char aBuf[IO_MAX_PATH_LENGTH];
+	str_format(aBuf, sizeof(aBuf), "%s/%s", pList->m_pDirectory, pName);
+	AddDemo(pList->m_plJobs, aBuf);
+	return 0;
+}
+
+int main(int argc, const char **argv)
+{
+	cmdline_fix(&argc, &argv);
+	dbg_logger_stdout();
+
+	int Format = FORMAT_JSON;
+	int NumThreads = 4;
+	bool Usage = false;
+	const char *pOutputDir = ".";
+	array<CDemoJob *> lJobs;
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+	if(!pStorage)
+	{
+		dbg_msg("demo_stats", "failed to initialize storage");
+		return -1;
+	}
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-f") == 0 && i+1 < argc)
+		{
+			i++;
+			if(str_comp(argv[i], "csv") == 0)
+				Format = FORMAT_CSV;
+			else if(str_comp(argv[i], "json") == 0)
+				Format = FORMAT_JSON;
+			else
+				Usage = true;
+		}
+		else if(str_comp(argv[i], "-j") == 0 && i+1 < argc)
+			NumThreads = str_toint(argv[++i]);
+		else if(str_comp(argv[i], "-o") == 0 && i+1 < argc)
+			pOutputDir = argv[++i];
+		else if(str_length(argv[i]) > 5 && str_comp(argv[i]+str_length(argv[i])-5, ".demo") == 0)
+			AddDemo(&lJobs, argv[i]);
+		else
+		{
+			// everything else is a directory with demos
+			CDemoList List;
+			List.m_pDirectory = argv[i];
+			List.m_plJobs = &lJobs;
+			pStorage->ListDirectory(IStorage::TYPE_ALL, argv[i], DemolistCallback, &List);
+		}
+	}
+
+	if(Usage || NumThreads <= 0 || lJobs.size() == 0)
+	{
+		dbg_msg("demo_stats", "usage: %s [-f json|csv] [-j threads] [-o directory] <demo or directory>...", argv[0]);
+		delete pStorage;
+		return -1;
+	}
+
+	// nothing registers a print callback, so the console can be shared by the jobs
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+
+	fs_makedir(pOutputDir);
+	for(int i = 0; i < lJobs.size(); i++)
+	{
+		CDemoJob *pJob = lJobs[i];
+		// the output is named like the demo, without its directory and extension
+		const char *pName = pJob->m_aDemoFile;
+		for(const char *pChr = pJob->m_aDemoFile; *pChr; pChr++)
+		{
+			if(*pChr == '/' || *pChr == '\\')
+				pName = pChr+1;
+		}
+		char aName[IO_MAX_PATH_LENGTH];
+		int NameLength = str_length(pName);
+		if(NameLength > 5 && str_comp(pName+NameLength-5, ".demo") == 0)
+			NameLength -= 5;
+		str_copy(aName, pName, minimum((int)sizeof(aName), NameLength+1));
+		str_format(pJob->m_aOutputFile, sizeof(pJob->m_aOutputFile), "%s/%s.%s", pOutputDir, aName, Format == FORMAT_CSV ? "csv" : "json");
+		pJob->m_Format = Format;
+		pJob->m_pStorage = pStorage;
+		pJob->m_pConsole = pConsole;
+	}
+
+	int64 StartTime = time_get();
+	CJobPool Pool;
+	Pool.Init(NumThreads);
+	for(int i = 0; i < lJobs.size(); i++)
+		Pool.Add(&lJobs[i]->m_Job, ProcessDemo, lJobs[i]);
+
+	int NumFailed = 0;
+	int NumTicks = 0;
+	int64 NumBytes = 0;
+	for(int i = 0; i < lJobs.size(); i++)
+	{
+		CDemoJob *pJob = lJobs[i];
+		while(pJob->m_Job.Status() != CJob::STATE_DONE)
+			thread_sleep(1);
+
+		if(!pJob->m_Success)
+		{
+			dbg_msg("demo_stats", "failed to process '%s'", pJob->m_aDemoFile);
+			NumFailed++;
+			continue;
+		}
+		if(pJob->m_NumInvalidItems)
+			dbg_msg("demo_stats", "'%s': %d invalid snapshot items skipped", pJob->m_aDemoFile, pJob->m_NumInvalidItems);
+		NumTicks += pJob->m_NumTicks;
+		NumBytes += pJob->m_DemoSize;
+	}
+	Pool.Shutdown();
+
+	const float Seconds = (time_get()-StartTime)/(float)time_freq();
+	dbg_msg("demo_stats", "%d demos (%d failed) with %d ticks, %.2f MiB in %.2f s on %d threads",
+		lJobs.size(), NumFailed, NumTicks, NumBytes/(1024.0f*1024.0f), Seconds, NumThreads);
+	if(Seconds > 0.0f)
+		dbg_msg("demo_stats", "%.2f MiB/s, %.0f ticks/s, %.0fx real time",
+			NumBytes/(1024.0f*1024.0f)/Seconds, NumTicks/Seconds, NumTicks/(float)SERVER_TICK_SPEED/Seconds);
+
+	for(int i = 0; i < lJobs.size(); i++)
+		delete lJobs[i];
+	delete pConsole;
+	delete pStorage;
+	cmdline_free(argc, argv);
+	return NumFailed ? 1 : 0;
+}
@@ -0,0 +1,543 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/hash.h>
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/message.h>
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+#include <generated/protocol.h>
+#include <game/version.h>
+
+/*
+	Synthetic client load generator.
+
+	Opens many connections to a server from one process, runs the
+	connect/map/ready/entergame handshake, sends inputs at the client
+	rate, acks snapshots and answers pings. Reports the traffic seen,
+	snapshot sizes and the round trip time distribution.
+
+	The server has to allow enough clients from one address, e.g.
+	"sv_max_clients 64" "sv_max_clients_per_ip 64".
+
+	Usage: fake_client [-a address] [-n clients] [-t seconds] [-p password] [-d] [-l]
+		-d downloads the map on every connection instead of pretending to have it
+		-l requests the map package by package even if the server streams it
+*/
+
+enum
+{
+	RTT_BUCKET_SIZE_US=100,
+	NUM_RTT_BUCKETS=10000, // up to one second
+};
+
+class CStats
+{
+public:
+	int m_NumEntered;
+	int64 m_HandshakeTimeSum;
+	int64 m_HandshakeTimeMax;
+	int m_NumSnapshots;
+	int64 m_SnapshotBytes;
+	int m_SnapshotMax;
+	int m_NumEmptySnapshots;
+	int m_NumInputs;
+	int m_NumDisconnects;
+	int m_NumRtt;
+	int m_aRttBuckets[NUM_RTT_BUCKETS+1];
+
+	CStats() { mem_zero(this, sizeof(*this)); }
+
+	void AddRtt(int64 Time)
+	{
+		int Bucket = (int)(Time*1000000/time_freq()/RTT_BUCKET_SIZE_US);
+		m_aRttBuckets[clamp(Bucket, 0, (int)NUM_RTT_BUCKETS)]++;
+		m_NumRtt++;
+	}
+
+	float RttPercentile(float Percentile) const
+	{
+		int Wanted = minimum((int)(m_NumRtt*Percentile), m_NumRtt-1);
+		int Count = 0;
+		for(int i = 0; i <= NUM_RTT_BUCKETS; i++)
+		{
+			Count += m_aRttBuckets[i];
+			if(Count > Wanted)
+				return (i+1)*RTT_BUCKET_SIZE_US/1000.0f;
+		}
+		return 0.0f;
+	}
+};
+
+static CStats s_Stats;
+static const char *s_pPassword = "";
+static bool s_DownloadMap = false;
+static bool s_LegacyMapDownload = false;
+
+class CFakeClient
+{
+	enum
+	{
+		STATE_OFFLINE=0,
+		STATE_CONNECTING,
+		STATE_LOADING,
+		STATE_READY,
+		STATE_ENTERING,
+		STATE_ONLINE,
+	};
+
+	CNetClient m_Net;
+	int m_State;
+	int m_Index;
+	int64 m_ConnectTime;
+	int64 m_NextInputTime;
+	int64 m_PingStartTime;
+	int64 m_NextPingTime;
+
+	// snapshot tracking
+	int m_AckGameTick;
+	int m_RecvTick;
+	unsigned m_SnapshotParts;
+	int m_SnapshotSize;
+
+	// map download
+	int m_MapSize;
+	int m_MapChunkSize;
+	int m_MapChunkNum;
+	int m_MapChunk;
+	int m_MapAmount;
+	int m_MapWindow;
+	int m_MapAcked;
+
+	CNetObj_PlayerInput m_Input;
+
+	int SendMsg(CMsgPacker *pMsg, int Flags)
+	{
+		CNetChunk Packet;
+		mem_zero(&Packet, sizeof(CNetChunk));
+		Packet.m_ClientID = 0;
+		Packet.m_pData = pMsg->Data();
+		Packet.m_DataSize = pMsg->Size();
+		if(Flags&MSGFLAG_VITAL)
+			Packet.m_Flags |= NETSENDFLAG_VITAL;
+		if(Flags&MSGFLAG_FLUSH)
+			Packet.m_Flags |= NETSENDFLAG_FLUSH;
+		return m_Net.Send(&Packet);
+	}
+
+	template<class T>
+	int SendPackMsg(T *pMsg, int Flags)
+	{
+		CMsgPacker Packer(pMsg->MsgID(), false);
+		if(pMsg->Pack(&Packer))
+			return -1;
+		return SendMsg(&Packer, Flags);
+	}
+
+	void SendInfo()
+	{
+		CMsgPacker Msg(NETMSG_INFO, true);
+		Msg.AddString(GAME_NETVERSION, 128);
+		Msg.AddString(s_pPassword, 128);
+		Msg.AddInt(CLIENT_VERSION);
+		SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+	}
+
+	void SendMapRequest()
+	{
+		CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA, true);
+		if(m_MapWindow)
+		{
+			Msg.AddInt(m_MapWindow);
+			Msg.AddInt(m_MapChunk);
+			m_MapAcked = m_MapChunk;
+		}
+		SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+	}
+
+	void SendStartInfo()
+	{
+		static const char *s_apSkinPartNames[NUM_SKINPARTS] = {"standard", "", "", "standard", "standard", "standard"};
+		char aName[MAX_NAME_LENGTH];
+		str_format(aName, sizeof(aName), "fake%d", m_Index);
+
+		CNetMsg_Cl_StartInfo Msg;
+		Msg.m_pName = aName;
+		Msg.m_pClan = "";
+		Msg.m_Country = -1;
+		for(int p = 0; p < NUM_SKINPARTS; p++)
+		{
+			Msg.m_apSkinPartNames[p] = s_apSkinPartNames[p];
+			Msg.m_aUseCustomColors[p] = 0;
+			Msg.m_aSkinPartColors[p] = 0;
+		}
+		SendPackMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+	}
+
+	void SendInput()
+	{
+		// move around a bit, the actual gameplay is not important here
+		if(random_int()%25 == 0)
+			m_Input.m_Direction = random_int()%3-1;
+		if(random_int()%10 == 0)
+		{
+			m_Input.m_TargetX = random_int()%512-256;
+			m_Input.m_TargetY = random_int()%512-256;
+		}
+		m_Input.m_Jump = random_int()%20 == 0;
+		if(random_int()%8 == 0)
+			m_Input.m_Fire = (m_Input.m_Fire+1)&INPUT_STATE_MASK;
+
+		CMsgPacker Msg(NETMSG_INPUT, true);
+		Msg.AddInt(m_AckGameTick);
+		Msg.AddInt(m_RecvTick+2);
+		Msg.AddInt(sizeof(m_Input));
+		const int *pData = (const int *)&m_Input;
+		for(unsigned i = 0; i < sizeof(m_Input)/sizeof(int); i++)
+			Msg.AddInt(pData[i]);
+		Msg.AddInt(0); // ping correction
+		SendMsg(&Msg, MSGFLAG_FLUSH);
+		s_Stats.m_NumInputs++;
+	}
+
+	void OnEnterGame()
+	{
+		CMsgPacker Msg(NETMSG_ENTERGAME, true);
+		SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+
+		int64 HandshakeTime = time_get()-m_ConnectTime;
+		s_Stats.m_NumEntered++;
+		s_Stats.m_HandshakeTimeSum += HandshakeTime;
+		s_Stats.m_HandshakeTimeMax = maximum(s_Stats.m_HandshakeTimeMax, HandshakeTime);
+		m_State = STATE_ONLINE;
+	}
+
+	void OnSnapshot(CMsgUnpacker *pUnpacker)
+	{
+		const int GameTick = pUnpacker->GetInt();
+		pUnpacker->GetInt(); // delta tick
+
+		int NumParts = 1;
+		int Part = 0;
+		if(pUnpacker->Type() == NETMSG_SNAP)
+		{
+			NumParts = pUnpacker->GetInt();
+			Part = pUnpacker->GetInt();
+			if(NumParts < 1 || NumParts > CSnapshot::MAX_PARTS || Part < 0 || Part >= NumParts)
+				return;
+		}
+
+		int PartSize = 0;
+		if(pUnpacker->Type() != NETMSG_SNAPEMPTY)
+		{
+			pUnpacker->GetInt(); // crc
+			PartSize = pUnpacker->GetInt();
+			if(PartSize < 0 || PartSize > MAX_SNAPSHOT_PACKSIZE)
+				return;
+			if(PartSize > 0)
+				pUnpacker->GetRaw(PartSize);
+		}
+		if(pUnpacker->Error() || GameTick < m_RecvTick)
+			return;
+
+		if(GameTick != m_RecvTick)
+		{
+			m_SnapshotParts = 0;
+			m_SnapshotSize = 0;
+			m_RecvTick = GameTick;
+		}
+		m_SnapshotParts |= 1<<Part;
+		m_SnapshotSize += PartSize;
+
+		if(m_SnapshotParts == (unsigned)((1<<NumParts)-1))
+		{
+			// the delta is not unpacked, acking the tick is enough to keep the server sending deltas
+			m_AckGameTick = GameTick;
+			m_SnapshotParts = 0;
+			s_Stats.m_NumSnapshots++;
+			s_Stats.m_SnapshotBytes += m_SnapshotSize;
+			s_Stats.m_SnapshotMax = maximum(s_Stats.m_SnapshotMax, m_SnapshotSize);
+			if(pUnpacker->Type() == NETMSG_SNAPEMPTY)
+				s_Stats.m_NumEmptySnapshots++;
+		}
+	}
+
+	void ProcessPacket(CNetChunk *pPacket)
+	{
+		CMsgUnpacker Unpacker(pPacket->m_pData, pPacket->m_DataSize);
+		if(Unpacker.Error())
+			return;
+
+		const bool Vital = (pPacket->m_Flags&NET_CHUNKFLAG_VITAL) != 0;
+		if(!Unpacker.System())
+		{
+			if(Vital && Unpacker.Type() == NETMSGTYPE_SV_READYTOENTER && m_State == STATE_ENTERING)
+				OnEnterGame();
+			return;
+		}
+
+		if(Vital && Unpacker.Type() == NETMSG_MAP_CHANGE)
+		{
+			Unpacker.GetString(CUnpacker::SANITIZE_CC|CUnpacker::SKIP_START_WHITESPACES);
+			Unpacker.GetInt(); // crc
+			m_MapSize = Unpacker.GetInt();
+			m_MapChunkNum = Unpacker.GetInt();
+			m_MapChunkSize = Unpacker.GetInt();
+			if(Unpacker.Error())
+				return;
+			Unpacker.GetRaw(sizeof(SHA256_DIGEST));
+			m_MapWindow = Unpacker.GetInt();
+			if(Unpacker.Error() || s_LegacyMapDownload)
+				m_MapWindow = 0;
+
+			m_MapChunk = 0;
+			m_MapAmount = 0;
+			m_MapAcked = 0;
+			if(s_DownloadMap && m_MapSize > 0)
+				SendMapRequest();
+			else
+			{
+				CMsgPacker Msg(NETMSG_READY, true);
+				SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+				m_State = STATE_READY;
+			}
+		}
+		else if(Vital && Unpacker.Type() == NETMSG_MAP_DATA)
+		{
+			const int Size = minimum(m_MapChunkSize, m_MapSize-m_MapAmount);
+			if(Size <= 0)
+				return;
+			Unpacker.GetRaw(Size);
+			if(Unpacker.Error())
+				return;
+
+			++m_MapChunk;
+			m_MapAmount += Size;
+			if(m_MapAmount == m_MapSize)
+			{
+				CMsgPacker Msg(NETMSG_READY, true);
+				SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+				m_State = STATE_READY;
+			}
+			else if(m_MapWindow ? m_MapChunk-m_MapAcked >= maximum(m_MapWindow/4, 1) : m_MapChunk%m_MapChunkNum == 0)
+				SendMapRequest();
+		}
+		else if(Vital && Unpacker.Type() == NETMSG_CON_READY)
+		{
+			SendStartInfo();
+			m_State = STATE_ENTERING;
+		}
+		else if(Unpacker.Type() == NETMSG_PING)
+		{
+			CMsgPacker Msg(NETMSG_PING_REPLY, true);
+			SendMsg(&Msg, MSGFLAG_FLUSH);
+		}
+		else if(Unpacker.Type() == NETMSG_PING_REPLY)
+		{
+			if(m_PingStartTime)
+				s_Stats.AddRtt(time_get()-m_PingStartTime);
+			m_PingStartTime = 0;
+		}
+		else if(Unpacker.Type() == NETMSG_SNAP || Unpacker.Type() == NETMSG_SNAPSINGLE || Unpacker.Type() == NETMSG_SNAPEMPTY)
+		{
+			if(m_State == STATE_ONLINE)
+				OnSnapshot(&Unpacker);
+		}
+	}
+
+public:
+	CFakeClient() { m_State = STATE_OFFLINE; }
+
+	bool Connect(int Index, NETADDR *pAddr, CConfig *pConfig)
+	{
+		NETADDR BindAddr;
+		mem_zero(&BindAddr, sizeof(BindAddr));
+		BindAddr.type = pAddr->type;
+		if(!m_Net.Open(BindAddr, pConfig, 0, 0, NETCREATE_FLAG_RANDOMPORT))
+			return false;
+
+		m_Index = Index;
+		m_ConnectTime = time_get();
+		m_NextInputTime = 0;
+		m_PingStartTime = 0;
+		m_NextPingTime = 0;
+		m_AckGameTick = -1;
+		m_RecvTick = 0;
+		m_SnapshotParts = 0;
+		m_SnapshotSize = 0;
+		mem_zero(&m_Input, sizeof(m_Input));
+		m_Input.m_TargetX = 1;
+		m_Net.Connect(pAddr);
+		m_State = STATE_CONNECTING;
+		return true;
+	}
+
+	void Close()
+	{
+		if(m_State != STATE_OFFLINE)
+			m_Net.Close();
+		m_State = STATE_OFFLINE;
+	}
+
+	bool Online() const { return m_State == STATE_ONLINE; }
+
+	void Update(int64 Now)
+	{
+		if(m_State == STATE_OFFLINE)
+			return;
+
+		m_Net.Update();
+		if(m_Net.State() == NETSTATE_OFFLINE)
+		{
+			dbg_msg("fake_client", "client %d disconnected: %s", m_Index, m_Net.ErrorString());
+			s_Stats.m_NumDisconnects++;
+			Close();
+			return;
+		}
+		if(m_State == STATE_CONNECTING && m_Net.State() == NETSTATE_ONLINE)
+		{
+			SendInfo();
+			m_State = STATE_LOADING;
+		}
+
+		CNetChunk Packet;
+		while(m_Net.Recv(&Packet))
+		{
+			if(!(Packet.m_Flags&NETSENDFLAG_CONNLESS))
+				ProcessPacket(&Packet);
+		}
+
+		if(m_State == STATE_ONLINE && m_RecvTick > 0 && Now >= m_NextInputTime)
+		{
+			SendInput();
+			m_NextInputTime = Now + time_freq()/SERVER_TICK_SPEED;
+		}
+		if(m_State == STATE_ONLINE && !m_PingStartTime && Now >= m_NextPingTime)
+		{
+			CMsgPacker Msg(NETMSG_PING, true);
+			SendMsg(&Msg, MSGFLAG_FLUSH);
+			m_PingStartTime = Now;
+			m_NextPingTime = Now + time_freq()/10;
+		}
+	}
+};
+
+int main(int argc, const char **argv)
+{
+	cmdline_fix(&argc, &argv);
+	dbg_logger_stdout();
+
+	const char *pAddress = "127.0.0.1:8303";
+	int NumClients = 16;
+	int Seconds = 30;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-a") == 0 && i+1 < argc)
+			pAddress = argv[++i];
+		else if(str_comp(argv[i], "-n") == 0 && i+1 < argc)
+			NumClients = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-t") == 0 && i+1 < argc)
+			Seconds = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-p") == 0 && i+1 < argc)
+			s_pPassword = argv[++i];
+		else if(str_comp(argv[i], "-d") == 0)
+			s_DownloadMap = true;
+		else if(str_comp(argv[i], "-l") == 0)
+			s_LegacyMapDownload = true;
+		else
+		{
+			dbg_msg("fake_client", "usage: %s [-a address] [-n clients] [-t seconds] [-p password] [-d] [-l]", argv[0]);
+			return -1;
+		}
+	}
+
+	NETADDR Addr;
+	if(net_addr_from_str(&Addr, pAddress) != 0 && net_host_lookup(pAddress, &Addr, NETTYPE_ALL) != 0)
+	{
+		dbg_msg("fake_client", "could not resolve '%s'", pAddress);
+		return -1;
+	}
+	if(!Addr.port)
+		Addr.port = 8303;
+
+	if(secure_random_init() != 0)
+	{
+		dbg_msg("fake_client", "could not initialize secure RNG");
+		return -1;
+	}
+	net_init();
+
+	CConfigManager ConfigManager;
+	ConfigManager.Reset();
+
+	CFakeClient *pClients = new CFakeClient[NumClients];
+	int NumConnected = 0;
+
+	NETSTATS StartStats;
+	net_stats(&StartStats);
+	const int64 StartTime = time_get();
+	const int64 EndTime = StartTime + Seconds*time_freq();
+	const int64 ConnectInterval = time_freq()/50;
+	int64 NextConnectTime = StartTime;
+	int64 NextReportTime = StartTime + time_freq();
+	CStats LastStats;
+
+	while(time_get() < EndTime)
+	{
+		int64 Now = time_get();
+
+		// connect the clients one after another to not trip the connection flood protection
+		if(NumConnected < NumClients && Now >= NextConnectTime)
+		{
+			if(!pClients[NumConnected].Connect(NumConnected, &Addr, ConfigManager.Values()))
+				dbg_msg("fake_client", "client %d could not open a socket", NumConnected);
+			NumConnected++;
+			NextConnectTime = Now + ConnectInterval;
+		}
+
+		for(int i = 0; i < NumConnected; i++)
+			pClients[i].Update(Now);
+
+		if(Now >= NextReportTime)
+		{
+			int NumOnline = 0;
+			for(int i = 0; i < NumConnected; i++)
+				NumOnline += pClients[i].Online();
+			dbg_msg("fake_client", "online=%d snapshots/s=%d inputs/s=%d rtt_p50=%.1fms", NumOnline,
+				s_Stats.m_NumSnapshots-LastStats.m_NumSnapshots, s_Stats.m_NumInputs-LastStats.m_NumInputs, s_Stats.RttPercentile(0.5f));
+			LastStats.m_NumSnapshots = s_Stats.m_NumSnapshots;
+			LastStats.m_NumInputs = s_Stats.m_NumInputs;
+			NextReportTime += time_freq();
+		}
+
+		thread_sleep(1);
+	}
+
+	NETSTATS EndStats;
+	net_stats(&EndStats);
+	const float Duration = (time_get()-StartTime)/(float)time_freq();
+
+	for(int i = 0; i < NumConnected; i++)
+		pClients[i].Close();
+	delete[] pClients;
+
+	// report, received traffic is what the server sent to all connections
+	dbg_msg("fake_client", "clients: %d connected, %d entered the game, %d disconnected", NumConnected, s_Stats.m_NumEntered, s_Stats.m_NumDisconnects);
+	if(s_Stats.m_NumEntered)
+		dbg_msg("fake_client", "handshake: avg %.1f ms, max %.1f ms", s_Stats.m_HandshakeTimeSum*1000.0f/time_freq()/s_Stats.m_NumEntered, s_Stats.m_HandshakeTimeMax*1000.0f/time_freq());
+	dbg_msg("fake_client", "server -> clients: %.1f KiB/s, %.1f packets/s", (EndStats.recv_bytes-StartStats.recv_bytes)/1024.0f/Duration, (EndStats.recv_packets-StartStats.recv_packets)/Duration);
+	dbg_msg("fake_client", "clients -> server: %.1f KiB/s, %.1f packets/s", (EndStats.sent_bytes-StartStats.sent_bytes)/1024.0f/Duration, (EndStats.sent_packets-StartStats.sent_packets)/Duration);
+	if(s_Stats.m_NumSnapshots)
+		dbg_msg("fake_client", "snapshots: %d received, %d empty, avg %.1f bytes, max %d bytes", s_Stats.m_NumSnapshots, s_Stats.m_NumEmptySnapshots,
+			s_Stats.m_SnapshotBytes/(float)s_Stats.m_NumSnapshots, s_Stats.m_SnapshotMax);
+	if(s_Stats.m_NumRtt)
+		dbg_msg("fake_client", "rtt: %d samples, p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms", s_Stats.m_NumRtt,
+			s_Stats.RttPercentile(0.5f), s_Stats.RttPercentile(0.9f), s_Stats.RttPercentile(0.99f), s_Stats.RttPercentile(1.0f));
+
+	secure_random_uninit();
+	cmdline_free(argc, argv);
+	return 0;
+}
@@ -0,0 +1,424 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdio.h> // sscanf
+#include <stdlib.h> // srand
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/config.h>
+#include <engine/console.h>
+#include <engine/map.h>
+#include <engine/metrics.h>
+#include <engine/server.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+#include <engine/shared/linereader.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+
+#include <game/server/entity.h>
+#include <game/server/gamecontext.h>
+
+/*
+	Headless game simulation benchmark.
+
+	Loads a map, adds a number of dummy players driven by recorded or
+	pseudo random input streams and runs the game world without any
+	networking as fast as possible. Reports the tick rate, the tick cost
+	per entity type and a checksum over all snapshots, which must not
+	change when optimizing physics or entities.
+
+	Usage: game_bench [-n players] [-t ticks] [-s seed] [-i inputfile] [-r recordfile] [console commands]
+	Example: game_bench -n 16 -t 20000 "sv_map ctf5" "sv_gametype ctf" "sv_player_slots 16"
+*/
+
+static const char *s_apEntityTypeNames[CGameWorld::NUM_ENTTYPES] = { "projectile", "laser", "pickup", "character", "flag" };
+
+static bool s_LogMuted = false;
+static int s_NumMutedLines = 0;
+
+static void LoggerBench(const char *pLine, void *pUser)
+{
+	if(s_LogMuted)
+		s_NumMutedLines++;
+	else
+	{
+		io_write(io_stdout(), pLine, str_length(pLine));
+		io_write_newline(io_stdout());
+	}
+}
+
+class CBenchServer : public IServer
+{
+	enum
+	{
+		MAX_IDS=16*1024,
+	};
+
+	int m_aFreeIDs[MAX_IDS];
+	int m_NumFreeIDs;
+	char m_aaNames[MAX_CLIENTS][MAX_NAME_ARRAY_SIZE];
+	CSnapshotBuilder m_SnapshotBuilder;
+
+public:
+	int m_NumMessages;
+	int m_SnapshotSize;
+
+	CBenchServer()
+	{
+		m_CurrentGameTick = 0;
+		m_TickSpeed = SERVER_TICK_SPEED;
+		m_NumFreeIDs = MAX_IDS;
+		for(int i = 0; i < MAX_IDS; i++)
+			m_aFreeIDs[i] = MAX_IDS-i-1;
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			str_format(m_aaNames[i], sizeof(m_aaNames[i]), "bench%d", i);
+		m_NumMessages = 0;
+		m_SnapshotSize = 0;
+	}
+
+	void SetTick(int Tick) { m_CurrentGameTick = Tick; }
+
+	// builds the snapshot for a client and returns its crc
+	int Snap(IGameServer *pGameServer, int ClientID, char *pData)
+	{
+		m_SnapshotBuilder.Init();
+		pGameServer->OnSnap(ClientID);
+		m_SnapshotSize += m_SnapshotBuilder.Finish(pData);
+		return ((CSnapshot *)pData)->Crc();
+	}
+
+	virtual const char *ClientName(int ClientID) const { return m_aaNames[ClientID]; }
+	virtual const char *ClientClan(int ClientID) const { return ""; }
+	virtual int ClientCountry(int ClientID) const { return -1; }
+	virtual bool ClientIngame(int ClientID) const { return false; }
+	virtual int GetClientInfo(int ClientID, CClientInfo *pInfo) const { return 0; }
+	virtual void GetClientAddr(int ClientID, char *pAddrStr, int Size) const { str_copy(pAddrStr, "bench", Size); }
+	virtual int GetClientVersion(int ClientID) const { return 0; }
+
+	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID) { m_NumMessages++; return 0; }
+
+	virtual void SetClientName(int ClientID, char const *pName) { str_copy(m_aaNames[ClientID], pName, sizeof(m_aaNames[ClientID])); }
+	virtual void SetClientClan(int ClientID, char const *pClan) {}
+	virtual void SetClientCountry(int ClientID, int Country) {}
+	virtual void SetClientScore(int ClientID, int Score) {}
+
+	virtual int SnapNewID()
+	{
+		dbg_assert(m_NumFreeIDs > 0, "id error");
+		return m_aFreeIDs[--m_NumFreeIDs];
+	}
+	virtual void SnapFreeID(int ID) { m_aFreeIDs[m_NumFreeIDs++] = ID; }
+	virtual void *SnapNewItem(int Type, int ID, int Size) { return m_SnapshotBuilder.NewItem(Type, ID, Size); }
+	virtual void SnapSetStaticsize(int ItemType, int Size) {}
+
+	virtual void SetRconCID(int ClientID) {}
+	virtual bool IsAuthed(int ClientID) const { return false; }
+	virtual bool IsBanned(int ClientID) { return false; }
+	virtual void Kick(int ClientID, const char *pReason) {}
+	virtual void ChangeMap(const char *pMap) {}
+
+	virtual void DemoRecorder_HandleAutoStart() {}
+	virtual bool DemoRecorder_IsRecording() { return false; }
+};
+
+// deterministic pseudo random input stream for one player
+class CInputGenerator
+{
+	unsigned m_State;
+
+	unsigned Next()
+	{
+		m_State ^= m_State<<13;
+		m_State ^= m_State>>17;
+		m_State ^= m_State<<5;
+		return m_State;
+	}
+	int Range(int Min, int Max) { return Min + (int)(Next()%(unsigned)(Max-Min+1)); }
+	bool Chance(int OneIn) { return Next()%(unsigned)OneIn == 0; }
+
+public:
+	void Init(unsigned Seed) { m_State = Seed ? Seed : 1; }
+
+	void Update(CNetObj_PlayerInput *pInput)
+	{
+		if(Chance(12))
+			pInput->m_Direction = Range(-1, 1);
+		if(Chance(6))
+		{
+			pInput->m_TargetX = Range(-256, 256);
+			pInput->m_TargetY = Range(-256, 256);
+		}
+		pInput->m_Jump = Chance(16);
+		if(Chance(24))
+			pInput->m_Hook ^= 1;
+		if(Chance(4))
+			pInput->m_Fire = (pInput->m_Fire+1)&INPUT_STATE_MASK;
+		if(Chance(80))
+			pInput->m_WantedWeapon = Range(1, NUM_WEAPONS);
+	}
+};
+
+class CInputRecording
+{
+	IOHANDLE m_File;
+	CLineReader m_LineReader;
+	const char *m_pPendingLine;
+
+public:
+	CInputRecording() { m_File = 0; m_pPendingLine = 0; }
+
+	bool OpenRead(IStorage *pStorage, const char *pFilename)
+	{
+		m_File = pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+		if(!m_File)
+			return false;
+		m_LineReader.Init(m_File);
+		m_pPendingLine = m_LineReader.Get();
+		return true;
+	}
+
+	bool OpenWrite(IStorage *pStorage, const char *pFilename)
+	{
+		m_File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		return m_File != 0;
+	}
+
+	void Close()
+	{
+		if(m_File)
+			io_close(m_File);
+		m_File = 0;
+	}
+
+	// applies all recorded input changes up to the given tick
+	void Read(int Tick, CNetObj_PlayerInput *paInputs)
+	{
+		for(; m_pPendingLine; m_pPendingLine = m_LineReader.Get())
+		{
+			int LineTick, ClientID;
+			CNetObj_PlayerInput Input;
+			if(sscanf(m_pPendingLine, "%d %d %d %d %d %d %d %d %d %d %d %d", &LineTick, &ClientID,
+				&Input.m_Direction, &Input.m_TargetX, &Input.m_TargetY, &Input.m_Jump, &Input.m_Fire,
+				&Input.m_Hook, &Input.m_PlayerFlags, &Input.m_WantedWeapon, &Input.m_NextWeapon, &Input.m_PrevWeapon) != 12 ||
+				ClientID < 0 || ClientID >= MAX_CLIENTS)
+				continue;
+			if(LineTick > Tick)
+				break;
+			paInputs[ClientID] = Input;
+		}
+	}
+
+	void Write(int Tick, int ClientID, const CNetObj_PlayerInput *pInput)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "%d %d %d %d %d %d %d %d %d %d %d %d", Tick, ClientID,
+			pInput->m_Direction, pInput->m_TargetX, pInput->m_TargetY, pInput->m_Jump, pInput->m_Fire,
+			pInput->m_Hook, pInput->m_PlayerFlags, pInput->m_WantedWeapon, pInput->m_NextWeapon, pInput->m_PrevWeapon);
+		io_write(m_File, aBuf, str_length(aBuf));
+		io_write_newline(m_File);
+	}
+};
+
+int main(int argc, const char **argv)
+{
+	cmdline_fix(&argc, &argv);
+	dbg_logger(LoggerBench, 0, 0);
+
+	int NumPlayers = 16;
+	int NumTicks = 10*60*SERVER_TICK_SPEED;
+	unsigned Seed = 1;
+	const char *pInputFile = 0;
+	const char *pRecordFile = 0;
+
+	// benchmark options, everything after them is passed to the console
+	int ArgIndex = 1;
+	for(; ArgIndex+1 < argc && argv[ArgIndex][0] == '-'; ArgIndex += 2)
+	{
+		if(str_comp(argv[ArgIndex], "-n") == 0)
+			NumPlayers = clamp(str_toint(argv[ArgIndex+1]), 1, (int)MAX_CLIENTS);
+		else if(str_comp(argv[ArgIndex], "-t") == 0)
+			NumTicks = maximum(str_toint(argv[ArgIndex+1]), 1);
+		else if(str_comp(argv[ArgIndex], "-s") == 0)
+			Seed = str_toint(argv[ArgIndex+1]);
+		else if(str_comp(argv[ArgIndex], "-i") == 0)
+			pInputFile = argv[ArgIndex+1];
+		else if(str_comp(argv[ArgIndex], "-r") == 0)
+			pRecordFile = argv[ArgIndex+1];
+		else
+		{
+			dbg_msg("game_bench", "usage: %s [-n players] [-t ticks] [-s seed] [-i inputfile] [-r recordfile] [console commands]", argv[0]);
+			return -1;
+		}
+	}
+
+	CBenchServer *pServer = new CBenchServer();
+	IKernel *pKernel = IKernel::Create();
+	IEngineMap *pEngineMap = CreateEngineMap();
+	IGameServer *pGameServer = CreateGameServer();
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_SERVER, argc, argv);
+	IConfigManager *pConfigManager = CreateConfigManager();
+	IMetrics *pMetrics = CreateMetrics();
+
+	{
+		bool RegisterFail = false;
+
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IServer*>(pServer));
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IEngineMap*>(pEngineMap)); // register as both
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(static_cast<IMap*>(pEngineMap));
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pGameServer);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pConsole);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pStorage);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pConfigManager);
+		RegisterFail = RegisterFail || !pKernel->RegisterInterface(pMetrics);
+
+		if(RegisterFail)
+			return -1;
+	}
+
+	pConfigManager->Init(CFGFLAG_SERVER);
+	pConsole->Init();
+	pGameServer->OnConsoleInit();
+	if(ArgIndex < argc)
+		pConsole->ParseArguments(argc-ArgIndex, &argv[ArgIndex]);
+	pConfigManager->RestoreStrings();
+	CConfig *pConfig = pConfigManager->Values();
+
+	char aMapFile[IO_MAX_PATH_LENGTH];
+	str_format(aMapFile, sizeof(aMapFile), "maps/%s.map", pConfig->m_SvMap);
+	if(!pEngineMap->Load(aMapFile))
+	{
+		dbg_msg("game_bench", "failed to load map. mapname='%s'", pConfig->m_SvMap);
+		return -1;
+	}
+
+	CInputRecording Inputs;
+	if(pInputFile && !Inputs.OpenRead(pStorage, pInputFile))
+	{
+		dbg_msg("game_bench", "failed to open input file '%s'", pInputFile);
+		return -1;
+	}
+	CInputRecording Recording;
+	if(pRecordFile && !Recording.OpenWrite(pStorage, pRecordFile))
+	{
+		dbg_msg("game_bench", "failed to open record file '%s'", pRecordFile);
+		return -1;
+	}
+
+	// the game itself uses rand(), seed it to make runs reproducible
+	srand(Seed);
+	pGameServer->OnInit();
+	CGameContext *pGameContext = static_cast<CGameContext *>(pGameServer);
+	CGameWorld *pWorld = &pGameContext->m_World;
+	pWorld->m_TrackTickTime = true;
+
+	CInputGenerator aGenerators[MAX_CLIENTS];
+	CNetObj_PlayerInput aInputs[MAX_CLIENTS];
+	CNetObj_PlayerInput aLastInputs[MAX_CLIENTS];
+	mem_zero(aInputs, sizeof(aInputs));
+	for(int i = 0; i < NumPlayers; i++)
+	{
+		aGenerators[i].Init(Seed*0x9E3779B9u + i + 1);
+		aInputs[i].m_TargetX = 1;
+		if(!pGameContext->m_apPlayers[i])
+			pGameContext->OnClientConnected(i, true, false);
+		pGameServer->OnClientEnter(i);
+	}
+	mem_copy(aLastInputs, aInputs, sizeof(aLastInputs));
+
+	dbg_msg("game_bench", "map=%s gametype=%s players=%d ticks=%d seed=%u", pConfig->m_SvMap, pGameServer->GameType(), NumPlayers, NumTicks, Seed);
+
+	int64 TickTime = 0;
+	int64 SnapTime = 0;
+	int NumSnaps = 0;
+	int aNumEntities[CGameWorld::NUM_ENTTYPES] = {0};
+	unsigned Checksum = 0;
+	static char s_aSnapData[CSnapshot::MAX_SIZE];
+
+	s_LogMuted = true;
+	for(int Tick = 1; Tick <= NumTicks; Tick++)
+	{
+		pServer->SetTick(Tick);
+
+		// generate and apply input
+		if(pInputFile)
+			Inputs.Read(Tick, aInputs);
+		for(int i = 0; i < NumPlayers; i++)
+		{
+			if(!pInputFile)
+				aGenerators[i].Update(&aInputs[i]);
+			if(pRecordFile && (Tick == 1 || mem_comp(&aInputs[i], &aLastInputs[i], sizeof(CNetObj_PlayerInput)) != 0))
+				Recording.Write(Tick, i, &aInputs[i]);
+			aLastInputs[i] = aInputs[i];
+		}
+
+		for(int e = 0; e < CGameWorld::NUM_ENTTYPES; e++)
+			for(CEntity *pEnt = pWorld->FindFirst(e); pEnt; pEnt = pEnt->TypeNext())
+				aNumEntities[e]++;
+
+		int64 StartTime = time_get();
+		for(int i = 0; i < NumPlayers; i++)
+		{
+			CNetObj_PlayerInput Input = aInputs[i];
+			pGameServer->OnClientDirectInput(i, &Input);
+			Input = aInputs[i];
+			pGameServer->OnClientPredictedInput(i, &Input);
+		}
+		pGameServer->OnTick();
+		TickTime += time_get()-StartTime;
+
+		// snap like a server without high bandwidth clients does
+		if((Tick%2) == 0)
+		{
+			StartTime = time_get();
+			pGameServer->OnPreSnap();
+			for(int i = 0; i < NumPlayers; i++)
+				pServer->Snap(pGameServer, i, s_aSnapData);
+			int Crc = pServer->Snap(pGameServer, -1, s_aSnapData);
+			pGameServer->OnPostSnap();
+			SnapTime += time_get()-StartTime;
+			NumSnaps++;
+
+			Checksum = (Checksum*31) ^ (unsigned)Crc;
+		}
+	}
+	s_LogMuted = false;
+
+	Inputs.Close();
+	Recording.Close();
+
+	// report
+	const double Freq = (double)time_freq();
+	const double TotalSeconds = TickTime/Freq;
+	dbg_msg("game_bench", "ticks: %d in %.3f s, %.1f ticks/s, %.4f ms/tick", NumTicks, TotalSeconds, NumTicks/TotalSeconds, TotalSeconds*1000.0/NumTicks);
+	dbg_msg("game_bench", "snaps: %d, %.4f ms/snap, %.1f bytes/snapshot", NumSnaps, SnapTime*1000.0/Freq/maximum(NumSnaps, 1), pServer->m_SnapshotSize/(double)maximum(NumSnaps*(NumPlayers+1), 1));
+
+	int64 WorldTime = 0;
+	dbg_msg("game_bench", "%-12s %12s %12s %12s", "entity type", "avg count", "us/tick", "ns/entity");
+	for(int e = 0; e < CGameWorld::NUM_ENTTYPES; e++)
+	{
+		WorldTime += pWorld->m_aTickTime[e];
+		const double Microseconds = pWorld->m_aTickTime[e]*1000000.0/Freq;
+		dbg_msg("game_bench", "%-12s %12.2f %12.3f %12.1f", s_apEntityTypeNames[e], aNumEntities[e]/(double)NumTicks,
+			Microseconds/NumTicks, aNumEntities[e] ? Microseconds*1000.0/aNumEntities[e] : 0.0);
+	}
+	dbg_msg("game_bench", "%-12s %12s %12.3f", "other", "", (TickTime-WorldTime)*1000000.0/Freq/NumTicks);
+	dbg_msg("game_bench", "messages: %d, log lines: %d", pServer->m_NumMessages, s_NumMutedLines);
+	dbg_msg("game_bench", "checksum: %08x", Checksum);
+
+	pGameServer->OnShutdown();
+
+	delete pKernel;
+	delete pEngineMap;
+	delete pGameServer;
+	delete pConsole;
+	delete pStorage;
+	delete pConfigManager;
+	delete pMetrics;
+	delete pServer;
+
+	cmdline_free(argc, argv);
+	return 0;
+}
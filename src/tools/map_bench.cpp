@@ -0,0 +1,191 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <base/tl/array.h>
+#include <engine/shared/datafile.h>
+#include <engine/shared/jobs.h>
+#include <engine/storage.h>
+
+/*
+	Map loading benchmark.
+
+	Opens every map in the given directory the way the map loader does and
+	reads all of its data, several rounds per map, and reports how long
+	opening the file, getting the data and closing it again took.
+
+	With -j the data is decompressed up front on that many threads, 0 uses
+	one thread per processor. With -w every map is also saved again the way
+	map_resave does, using the given compression level, on the -j threads
+	if given.
+
+	Usage: map_bench [-d directory] [-n rounds] [-j threads] [-w level]
+*/
+
+static const char *s_pResaveFilename = "map_bench_resave.map";
+
+struct CMapFile
+{
+	char m_aFilename[IO_MAX_PATH_LENGTH];
+	int m_StorageType;
+	int64 m_aTimes[4]; // open, data, close, save
+	int64 m_DataSize;
+};
+
+struct CMapList
+{
+	const char *m_pDirectory;
+	array<CMapFile> *m_plMaps;
+};
+
+static int MaplistCallback(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	CMapList *pList = (CMapList *)pUser;
+	int Length = str_length(pName);
+	if(IsDir || Length < 4 || str_comp(pName+Length-4, ".map") != 0)
+		return 0;
+
+	CMapFile Map;
+	mem_zero(&Map, sizeof(Map));
+	str_format(Map.m_aFilename, sizeof(Map.m_aFilename), "%s/%s", pList->m_pDirectory, pName);
+	Map.m_StorageType = StorageType;
+	pList->m_plMaps->add(Map);
+	return 0;
+}
+
+static bool ResaveMap(IStorage *pStorage, CDataFileReader *pReader, int Level, CJobPool *pPool)
+{
+	CDataFileWriter Writer;
+	if(!Writer.Open(pStorage, s_pResaveFilename))
+		return false;
+	Writer.SetCompression(Level, pPool);
+
+	for(int i = 0; i < pReader->NumItems(); i++)
+	{
+		int Type, ID;
+		void *pItem = pReader->GetItem(i, &Type, &ID);
+		Writer.AddItem(Type, ID, pReader->GetItemSize(i), pItem);
+	}
+	for(int i = 0; i < pReader->NumData(); i++)
+		Writer.AddData(pReader->GetDataSize(i), pReader->GetData(i));
+	return Writer.Finish() != 0;
+}
+
+static bool LoadMap(IStorage *pStorage, CMapFile *pMap, CJobPool *pPool, int Level)
+{
+	CDataFileReader Reader;
+	int64 Start = time_get();
+	if(!Reader.Open(pStorage, pMap->m_aFilename, pMap->m_StorageType))
+		return false;
+	int64 Opened = time_get();
+
+	pMap->m_DataSize = 0;
+	if(pPool)
+		Reader.PrefetchData(0, 0, pPool);
+	for(int i = 0; i < Reader.NumData(); i++)
+	{
+		if(Reader.GetData(i))
+			pMap->m_DataSize += Reader.GetDataSize(i);
+	}
+	int64 Loaded = time_get();
+
+	bool Saved = true;
+	if(Level >= 0)
+		Saved = ResaveMap(pStorage, &Reader, Level, pPool);
+	int64 Resaved = time_get();
+
+	Reader.Close();
+	int64 Closed = time_get();
+
+	pMap->m_aTimes[0] += Opened-Start;
+	pMap->m_aTimes[1] += Loaded-Opened;
+	pMap->m_aTimes[2] += Closed-Resaved;
+	pMap->m_aTimes[3] += Resaved-Loaded;
+	return Saved;
+}
+
+int main(int argc, const char **argv)
+{
+	cmdline_fix(&argc, &argv);
+
+	const char *pDirectory = "maps";
+	int NumRounds = 10;
+	int NumThreads = -1;
+	int Level = -1;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-d") == 0 && i+1 < argc)
+			pDirectory = argv[++i];
+		else if(str_comp(argv[i], "-n") == 0 && i+1 < argc)
+			NumRounds = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-j") == 0 && i+1 < argc)
+			NumThreads = maximum(str_toint(argv[++i]), 0);
+		else if(str_comp(argv[i], "-w") == 0 && i+1 < argc)
+			Level = clamp(str_toint(argv[++i]), 0, 9);
+		else
+		{
+			dbg_logger_stdout();
+			dbg_msg("map_bench", "usage: %s [-d directory] [-n rounds] [-j threads] [-w level]", argv[0]);
+			return -1;
+		}
+	}
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+	if(!pStorage)
+		return -1;
+
+	array<CMapFile> lMaps;
+	CMapList List;
+	List.m_pDirectory = pDirectory;
+	List.m_plMaps = &lMaps;
+	pStorage->ListDirectory(IStorage::TYPE_ALL, pDirectory, MaplistCallback, &List);
+
+	// the calling thread helps out
+	CJobPool Pool;
+	if(NumThreads >= 0)
+		Pool.Init((NumThreads ? NumThreads : cpu_count())-1);
+
+	// the datafile reader logs every access, only the results are printed
+	int NumFailed = 0;
+	for(int Round = 0; Round < NumRounds; Round++)
+	{
+		for(int i = 0; i < lMaps.size(); i++)
+		{
+			if(!LoadMap(pStorage, &lMaps[i], NumThreads >= 0 ? &Pool : 0, Level))
+				NumFailed++;
+		}
+	}
+
+	if(Level >= 0)
+		pStorage->RemoveFile(s_pResaveFilename, IStorage::TYPE_SAVE);
+
+	dbg_logger_stdout();
+	if(lMaps.size() == 0)
+	{
+		dbg_msg("map_bench", "no maps found in '%s'", pDirectory);
+		delete pStorage;
+		return -1;
+	}
+
+	const float Scale = 1000.0f/time_freq()/NumRounds;
+	int64 aTotal[4] = {0, 0, 0, 0};
+	int64 TotalSize = 0;
+	for(int i = 0; i < lMaps.size(); i++)
+	{
+		const CMapFile *pMap = &lMaps[i];
+		dbg_msg("map_bench", "%-32s %7.2f MiB  open %7.3f ms  data %7.3f ms  close %7.3f ms  save %7.3f ms", pMap->m_aFilename,
+			pMap->m_DataSize/(1024.0f*1024.0f), pMap->m_aTimes[0]*Scale, pMap->m_aTimes[1]*Scale, pMap->m_aTimes[2]*Scale, pMap->m_aTimes[3]*Scale);
+		for(int t = 0; t < 4; t++)
+			aTotal[t] += pMap->m_aTimes[t];
+		TotalSize += pMap->m_DataSize;
+	}
+	dbg_msg("map_bench", "%d maps, %.2f MiB of data, per round: open %.3f ms, data %.3f ms, close %.3f ms, save %.3f ms, total %.3f ms",
+		lMaps.size(), TotalSize/(1024.0f*1024.0f), aTotal[0]*Scale, aTotal[1]*Scale, aTotal[2]*Scale, aTotal[3]*Scale, (aTotal[0]+aTotal[1]+aTotal[2]+aTotal[3])*Scale);
+	if(NumFailed)
+		dbg_msg("map_bench", "%d loads failed", NumFailed);
+
+	delete pStorage;
+	cmdline_free(argc, argv);
+	return NumFailed ? 1 : 0;
+}
@@ -1,24 +1,54 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 #include <engine/shared/datafile.h>
+#include <engine/shared/jobs.h>
 #include <engine/storage.h>
 
+/*
+	Usage: map_resave [-l level] [-j threads] <source> <destination>
+
+	The data is compressed with the given zlib level (default 6) on that
+	many threads (default one per processor).
+*/
+
 int main(int argc, const char **argv)
 {
 	cmdline_fix(&argc, &argv);
 
+	int Level = 6;
+	int NumThreads = 0;
+	const char *apFiles[2] = {0, 0};
+	int NumFiles = 0;
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-l") == 0 && i+1 < argc)
+			Level = str_toint(argv[++i]);
+		else if(str_comp(argv[i], "-j") == 0 && i+1 < argc)
+			NumThreads = maximum(str_toint(argv[++i]), 0);
+		else if(NumFiles < 2)
+			apFiles[NumFiles++] = argv[i];
+		else
+			NumFiles++;
+	}
+
 	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
-	if(!pStorage || argc != 3)
+	if(!pStorage || NumFiles != 2)
 		return -1;
 
 	CDataFileReader Reader;
-	if(!Reader.Open(pStorage, argv[1], IStorage::TYPE_ALL))
+	if(!Reader.Open(pStorage, apFiles[0], IStorage::TYPE_ALL))
 		return -1;
 
+	// the calling thread helps out
+	CJobPool Pool;
+	Pool.Init((NumThreads ? NumThreads : cpu_count())-1);
+
 	CDataFileWriter Writer;
-	if(!Writer.Open(pStorage, argv[2]))
+	if(!Writer.Open(pStorage, apFiles[1]))
 		return -1;
+	Writer.SetCompression(Level, &Pool);
 
 	// add all items
 	for(int Index = 0; Index < Reader.NumItems(); Index++)
@@ -30,6 +60,7 @@ int main(int argc, const char **argv)
 	}
 
 	// add all data
+	Reader.PrefetchData(0, 0, &Pool);
 	for(int Index = 0; Index < Reader.NumData(); Index++)
 	{
 		void *pPtr = Reader.GetData(Index);
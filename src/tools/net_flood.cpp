@@ -0,0 +1,145 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+
+/*
+	Token request flood generator.
+
+	Sends token requests, the most expensive packets a server answers
+	without a connection, from several sockets of one address and counts
+	the tokens that come back. With the rate limit enabled the server
+	should answer about sv_rate_limit of them per second, after the first
+	sv_rate_limit_burst.
+
+	Usage: net_flood [-a address] [-r packets per second] [-t seconds] [-s sockets]
+		a rate of 0 sends as fast as possible
+*/
+
+class CFlooder : public CNetBase
+{
+public:
+	bool Open(CConfig *pConfig)
+	{
+		NETADDR BindAddr;
+		mem_zero(&BindAddr, sizeof(BindAddr));
+		BindAddr.type = NETTYPE_ALL;
+		NETSOCKET Socket = net_udp_create(BindAddr, 1);
+		if(!Socket.type)
+			return false;
+		Init(Socket, pConfig, 0, 0);
+		return true;
+	}
+
+	int Receive()
+	{
+		int NumTokens = 0;
+		NETADDR Addr;
+		unsigned char aBuffer[NET_MAX_PACKETSIZE];
+		CNetPacketConstruct Packet;
+		int Result;
+		while((Result = UnpackPacket(&Addr, aBuffer, &Packet)) <= 0)
+		{
+			if(Result == 0 && (Packet.m_Flags&NET_PACKETFLAG_CONTROL) && Packet.m_aChunkData[0] == NET_CTRLMSG_TOKEN)
+				NumTokens++;
+		}
+		return NumTokens;
+	}
+};
+
+int main(int argc, const char **argv)
+{
+	cmdline_fix(&argc, &argv);
+	dbg_logger_stdout();
+
+	const char *pAddress = "127.0.0.1:8303";
+	int Rate = 0;
+	int Seconds = 10;
+	int NumSockets = 4;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-a") == 0 && i+1 < argc)
+			pAddress = argv[++i];
+		else if(str_comp(argv[i], "-r") == 0 && i+1 < argc)
+			Rate = maximum(str_toint(argv[++i]), 0);
+		else if(str_comp(argv[i], "-t") == 0 && i+1 < argc)
+			Seconds = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-s") == 0 && i+1 < argc)
+			NumSockets = maximum(str_toint(argv[++i]), 1);
+		else
+		{
+			dbg_msg("net_flood", "usage: %s [-a address] [-r packets per second] [-t seconds] [-s sockets]", argv[0]);
+			return -1;
+		}
+	}
+
+	NETADDR Addr;
+	if(net_addr_from_str(&Addr, pAddress) != 0 && net_host_lookup(pAddress, &Addr, NETTYPE_ALL) != 0)
+	{
+		dbg_msg("net_flood", "could not resolve '%s'", pAddress);
+		return -1;
+	}
+	if(!Addr.port)
+		Addr.port = 8303;
+	net_init();
+
+	CConfigManager ConfigManager;
+	ConfigManager.Reset();
+
+	CFlooder *pFlooders = new CFlooder[NumSockets];
+	for(int i = 0; i < NumSockets; i++)
+	{
+		if(!pFlooders[i].Open(ConfigManager.Values()))
+		{
+			dbg_msg("net_flood", "could not open socket %d", i);
+			return -1;
+		}
+	}
+
+	const int64 StartTime = time_get();
+	const int64 EndTime = StartTime + Seconds*time_freq();
+	int64 NextReportTime = StartTime + time_freq();
+	int64 NumSent = 0;
+	int64 NumTokens = 0;
+	int64 LastSent = 0;
+	int64 LastTokens = 0;
+
+	int64 Now;
+	while((Now = time_get()) < EndTime)
+	{
+		// catch up with the wanted rate, in batches when flooding
+		const int64 Wanted = Rate ? (Now-StartTime)*Rate/time_freq() : NumSent+64;
+		for(; NumSent < Wanted; NumSent++)
+			pFlooders[NumSent%NumSockets].SendControlMsgWithToken(&Addr, NET_TOKEN_NONE, 0, NET_CTRLMSG_TOKEN, (TOKEN)NumSent&NET_TOKEN_MASK, true);
+		for(int i = 0; i < NumSockets; i++)
+			NumTokens += pFlooders[i].Receive();
+
+		if(Now >= NextReportTime)
+		{
+			dbg_msg("net_flood", "sent/s=%lld tokens/s=%lld", NumSent-LastSent, NumTokens-LastTokens);
+			LastSent = NumSent;
+			LastTokens = NumTokens;
+			NextReportTime += time_freq();
+		}
+
+		if(Rate)
+			thread_sleep(1);
+	}
+
+	// late answers
+	thread_sleep(100);
+	for(int i = 0; i < NumSockets; i++)
+		NumTokens += pFlooders[i].Receive();
+
+	dbg_msg("net_flood", "sent %lld token requests in %d seconds, got %lld tokens (%.1f per second)",
+		NumSent, Seconds, NumTokens, (float)NumTokens/Seconds);
+
+	for(int i = 0; i < NumSockets; i++)
+		pFlooders[i].Shutdown();
+	delete[] pFlooders;
+	cmdline_free(argc, argv);
+	return 0;
+}
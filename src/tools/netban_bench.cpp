@@ -0,0 +1,156 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+#include <engine/shared/netban.h>
+
+/*
+	Ban list benchmark.
+
+	Bans the given number of pseudo random addresses and address ranges,
+	half of each, and measures how long IsBanned takes for random
+	addresses, half of them inside a banned range. With -i the bans are
+	written to a blocklist file and imported with bans_import instead.
+
+	Usage: netban_bench [-n bans] [-q queries] [-i]
+*/
+
+static const char *s_pListFilename = "netban_bench.txt";
+
+static unsigned s_Seed = 1;
+
+static unsigned Random()
+{
+	s_Seed = s_Seed*1103515245+12345;
+	return s_Seed>>8;
+}
+
+static NETADDR RandomAddr()
+{
+	NETADDR Addr;
+	mem_zero(&Addr, sizeof(Addr));
+	Addr.type = NETTYPE_IPV4;
+	unsigned Value = Random()^(Random()<<16);
+	for(int i = 0; i < 4; i++)
+		Addr.ip[i] = (Value>>(i*8))&0xff;
+	if(Addr.ip[0] == 127)
+		Addr.ip[0] = 128;
+	return Addr;
+}
+
+// a block of 4 to 65536 addresses, or any range within one
+static CNetRange RandomRange()
+{
+	CNetRange Range;
+	Range.m_LB = Range.m_UB = RandomAddr();
+	int Bits = 2+Random()%15;
+	unsigned Value = (Range.m_LB.ip[0]<<24)|(Range.m_LB.ip[1]<<16)|(Range.m_LB.ip[2]<<8)|Range.m_LB.ip[3];
+	unsigned Lower = Value&~((1u<<Bits)-1);
+	unsigned Upper = Value|((1u<<Bits)-1);
+	if(Random()%2)
+	{
+		Lower += Random()%(1u<<(Bits-1));
+		Upper -= Random()%(1u<<(Bits-1));
+	}
+	for(int i = 0; i < 4; i++)
+	{
+		Range.m_LB.ip[i] = (Lower>>(24-i*8))&0xff;
+		Range.m_UB.ip[i] = (Upper>>(24-i*8))&0xff;
+	}
+	return Range;
+}
+
+int main(int argc, const char **argv)
+{
+	cmdline_fix(&argc, &argv);
+
+	int NumBans = 100000;
+	int NumQueries = 1000000;
+	bool Import = false;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-n") == 0 && i+1 < argc)
+			NumBans = maximum(str_toint(argv[++i]), 2);
+		else if(str_comp(argv[i], "-q") == 0 && i+1 < argc)
+			NumQueries = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-i") == 0)
+			Import = true;
+		else
+		{
+			dbg_logger_stdout();
+			dbg_msg("netban_bench", "usage: %s [-n bans] [-q queries] [-i]", argv[0]);
+			return -1;
+		}
+	}
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	if(!pStorage)
+		return -1;
+	CNetBan NetBan;
+	NetBan.Init(pConsole, pStorage);
+
+	CNetRange *pRanges = new CNetRange[NumBans/2];
+	for(int i = 0; i < NumBans/2; i++)
+		pRanges[i] = RandomRange();
+
+	// the ban messages go nowhere, only the results are printed
+	int64 Start = time_get();
+	if(Import)
+	{
+		IOHANDLE File = pStorage->OpenFile(s_pListFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		if(!File)
+			return -1;
+		char aLine[128], aLB[NETADDR_MAXSTRSIZE], aUB[NETADDR_MAXSTRSIZE];
+		for(int i = 0; i < NumBans/2; i++)
+		{
+			NETADDR Addr = RandomAddr();
+			net_addr_str(&Addr, aLB, sizeof(aLB), false);
+			io_write(File, aLB, str_length(aLB));
+			io_write_newline(File);
+			net_addr_str(&pRanges[i].m_LB, aLB, sizeof(aLB), false);
+			net_addr_str(&pRanges[i].m_UB, aUB, sizeof(aUB), false);
+			str_format(aLine, sizeof(aLine), "%s-%s", aLB, aUB);
+			io_write(File, aLine, str_length(aLine));
+			io_write_newline(File);
+		}
+		io_close(File);
+		Start = time_get();
+		NetBan.ImportBans(s_pListFilename, 0, "Blocklist");
+		pStorage->RemoveFile(s_pListFilename, IStorage::TYPE_SAVE);
+	}
+	else
+	{
+		for(int i = 0; i < NumBans/2; i++)
+		{
+			NETADDR Addr = RandomAddr();
+			NetBan.BanAddr(&Addr, 0, "Benchmark");
+			NetBan.BanRange(&pRanges[i], 0, "Benchmark");
+		}
+	}
+	int64 Banned = time_get();
+
+	int NumHits = 0;
+	for(int i = 0; i < NumQueries; i++)
+	{
+		NETADDR Addr = i%2 ? RandomAddr() : pRanges[Random()%(NumBans/2)].m_UB;
+		if(NetBan.IsBanned(&Addr, 0, 0, 0))
+			NumHits++;
+	}
+	int64 Queried = time_get();
+
+	dbg_logger_stdout();
+	dbg_msg("netban_bench", "%s %d bans in %.3f ms", Import ? "imported" : "added", NumBans, (Banned-Start)*1000.0f/time_freq());
+	dbg_msg("netban_bench", "%d queries, %d banned, %.3f us per IsBanned", NumQueries, NumHits, (Queried-Banned)*1000000.0f/time_freq()/NumQueries);
+
+	delete[] pRanges;
+	delete pConsole;
+	delete pStorage;
+	cmdline_free(argc, argv);
+	return 0;
+}
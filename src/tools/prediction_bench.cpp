@@ -0,0 +1,261 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/storage.h>
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/prediction.h>
+
+/*
+	Client prediction benchmark.
+
+	Simulates a game on the given map, then replays it as a client at
+	different latencies would see it: snapshots arrive every second tick
+	half a round trip late and the prediction runs up to half a round trip
+	ahead. Every prediction is done twice, once from scratch like before and
+	once reusing the ticks the snapshots confirmed, and the results are
+	compared.
+
+	Usage: prediction_bench [-m map] [-n characters] [-t seconds] [-f fps]
+*/
+
+enum
+{
+	SNAP_RATE=2,
+	LOCAL_CLIENT=0,
+};
+
+class CGameHistory
+{
+public:
+	int m_NumCharacters;
+	int m_NumTicks;
+	CNetObj_CharacterCore *m_pCores;
+	CNetObj_PlayerInput *m_pLocalInputs;
+
+	const CNetObj_CharacterCore *Core(int Tick, int ClientID) const { return &m_pCores[Tick*m_NumCharacters+ClientID]; }
+};
+
+static unsigned s_Seed = 1;
+
+static int Random()
+{
+	s_Seed = s_Seed*1103515245u+12345u;
+	return (int)(s_Seed>>8);
+}
+
+static void RandomInput(CNetObj_PlayerInput *pInput, int Activity)
+{
+	// hold inputs for a while, players don't change them every tick
+	if(Random()%Activity)
+		return;
+	pInput->m_Direction = Random()%3-1;
+	pInput->m_TargetX = Random()%400-200;
+	pInput->m_TargetY = Random()%400-200;
+	pInput->m_Jump = Random()%4 == 0;
+	pInput->m_Hook = Random()%3 == 0;
+}
+
+static void SimulateGame(CCollision *pCollision, CGameHistory *pHistory)
+{
+	CWorldCore World;
+	CCharacterCore *pCores = new CCharacterCore[pHistory->m_NumCharacters];
+	CNetObj_PlayerInput *pInputs = new CNetObj_PlayerInput[pHistory->m_NumCharacters];
+	bool aUseInput[MAX_CLIENTS] = { false };
+	for(int c = 0; c < pHistory->m_NumCharacters; c++)
+	{
+		// find a free spot
+		vec2 Pos;
+		do
+			Pos = vec2(Random()%(pCollision->GetWidth()*32), Random()%(pCollision->GetHeight()*32));
+		while(pCollision->TestBox(Pos, vec2(CCharacterCore::PHYS_SIZE, CCharacterCore::PHYS_SIZE)) || pCollision->CheckPoint(Pos, CCollision::COLFLAG_DEATH));
+
+		pCores[c].Reset();
+		pCores[c].Init(&World, pCollision);
+		pCores[c].m_Pos = Pos;
+		pCores[c].m_Direction = 0;
+		pCores[c].m_Angle = 0;
+		mem_zero(&pInputs[c], sizeof(pInputs[c]));
+		pInputs[c].m_TargetX = 1;
+		World.m_apCharacters[c] = &pCores[c];
+		aUseInput[c] = true;
+	}
+
+	for(int Tick = 0; Tick < pHistory->m_NumTicks; Tick++)
+	{
+		for(int c = 0; c < pHistory->m_NumCharacters; c++)
+		{
+			RandomInput(&pInputs[c], c == LOCAL_CLIENT ? 10 : 25);
+			pCores[c].m_Input = pInputs[c];
+		}
+		pHistory->m_pLocalInputs[Tick] = pInputs[LOCAL_CLIENT];
+
+		World.TickCharacters(aUseInput);
+		World.MoveCharacters(true);
+
+		for(int c = 0; c < pHistory->m_NumCharacters; c++)
+		{
+			CNetObj_CharacterCore *pCore = &pHistory->m_pCores[Tick*pHistory->m_NumCharacters+c];
+			mem_zero(pCore, sizeof(*pCore));
+			pCores[c].Write(pCore);
+			pCore->m_Tick = Tick;
+		}
+	}
+
+	delete[] pCores;
+	delete[] pInputs;
+}
+
+static const CNetObj_PlayerInput *GetInput(int Tick, void *pUserData)
+{
+	const CGameHistory *pHistory = (const CGameHistory *)pUserData;
+	return Tick >= 0 && Tick < pHistory->m_NumTicks ? &pHistory->m_pLocalInputs[Tick] : 0;
+}
+
+static bool RunLatency(CCollision *pCollision, const CGameHistory *pHistory, int Latency, int Fps)
+{
+	CPrediction *pFull = new CPrediction();
+	CPrediction *pIncremental = new CPrediction();
+	pFull->Init(pCollision);
+	pIncremental->Init(pCollision);
+	CTuningParams Tuning;
+
+	const int HalfRtt = Latency*SERVER_TICK_SPEED/2000; // in ticks
+	int LastGameTick = -1;
+	int LastPredTick = -1;
+	int NumPredictions = 0;
+	int NumMismatches = 0;
+	int64 FullTime = 0;
+	int64 IncrementalTime = 0;
+
+	const int NumFrames = (pHistory->m_NumTicks-2*HalfRtt-SERVER_TICK_SPEED)*Fps/SERVER_TICK_SPEED;
+	for(int Frame = 0; Frame < NumFrames; Frame++)
+	{
+		// server tick at the time of the frame
+		const int ServerTick = Frame*SERVER_TICK_SPEED/Fps + HalfRtt + SNAP_RATE;
+		const int GameTick = (ServerTick-HalfRtt)/SNAP_RATE*SNAP_RATE;
+		const int PredTick = ServerTick+HalfRtt+1;
+		if(GameTick == LastGameTick && PredTick <= LastPredTick)
+			continue;
+		LastGameTick = GameTick;
+		LastPredTick = PredTick;
+
+		const CNetObj_CharacterCore *apCharacters[MAX_CLIENTS] = { 0 };
+		for(int c = 0; c < pHistory->m_NumCharacters; c++)
+			apCharacters[c] = pHistory->Core(GameTick, c);
+
+		int64 Start = time_get();
+		pFull->Reset();
+		pFull->Predict(&Tuning, GameTick, apCharacters, LOCAL_CLIENT, PredTick, GetInput, (void *)pHistory);
+		int64 Mid = time_get();
+		pIncremental->Predict(&Tuning, GameTick, apCharacters, LOCAL_CLIENT, PredTick, GetInput, (void *)pHistory);
+		int64 End = time_get();
+		FullTime += Mid-Start;
+		IncrementalTime += End-Mid;
+		NumPredictions++;
+
+		for(int c = 0; c < pHistory->m_NumCharacters; c++)
+		{
+			for(int Tick = PredTick-1; Tick <= PredTick; Tick++)
+			{
+				CNetObj_CharacterCore Full, Incremental;
+				mem_zero(&Full, sizeof(Full));
+				mem_zero(&Incremental, sizeof(Incremental));
+				pFull->Get(Tick, c)->Write(&Full);
+				pIncremental->Get(Tick, c)->Write(&Incremental);
+				if(mem_comp(&Full, &Incremental, sizeof(Full)) != 0)
+					NumMismatches++;
+			}
+		}
+	}
+
+	const float Freq = (float)time_freq();
+	dbg_msg("prediction_bench", "latency %d ms: %d predictions, %d ticks ahead", Latency, NumPredictions, 2*HalfRtt+1);
+	if(NumPredictions)
+	{
+		dbg_msg("prediction_bench", "  full:        %6.2f ticks/prediction, %7.2f us/prediction",
+			pFull->NumSimulatedTicks()/(float)NumPredictions, FullTime*1000000.0f/Freq/NumPredictions);
+		dbg_msg("prediction_bench", "  incremental: %6.2f ticks/prediction, %7.2f us/prediction (%.1fx)",
+			pIncremental->NumSimulatedTicks()/(float)NumPredictions, IncrementalTime*1000000.0f/Freq/NumPredictions,
+			IncrementalTime ? FullTime/(float)IncrementalTime : 0.0f);
+	}
+	if(NumMismatches)
+		dbg_msg("prediction_bench", "  %d predicted characters differ between full and incremental prediction", NumMismatches);
+
+	delete pFull;
+	delete pIncremental;
+	return NumMismatches == 0;
+}
+
+int main(int argc, const char **argv)
+{
+	cmdline_fix(&argc, &argv);
+	dbg_logger_stdout();
+
+	const char *pMapName = "dm1";
+	int NumCharacters = 8;
+	int Seconds = 120;
+	int Fps = 144;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-m") == 0 && i+1 < argc)
+			pMapName = argv[++i];
+		else if(str_comp(argv[i], "-n") == 0 && i+1 < argc)
+			NumCharacters = clamp(str_toint(argv[++i]), 1, (int)MAX_CLIENTS);
+		else if(str_comp(argv[i], "-t") == 0 && i+1 < argc)
+			Seconds = maximum(str_toint(argv[++i]), 10);
+		else if(str_comp(argv[i], "-f") == 0 && i+1 < argc)
+			Fps = maximum(str_toint(argv[++i]), 1);
+		else
+		{
+			dbg_msg("prediction_bench", "usage: %s [-m map] [-n characters] [-t seconds] [-f fps]", argv[0]);
+			return -1;
+		}
+	}
+
+	IKernel *pKernel = IKernel::Create();
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+	IEngineMap *pMap = CreateEngineMap();
+	if(!pStorage || !pKernel->RegisterInterface(pStorage) || !pKernel->RegisterInterface(pMap))
+	{
+		dbg_msg("prediction_bench", "failed to initialize");
+		return -1;
+	}
+
+	char aMapFilename[IO_MAX_PATH_LENGTH];
+	str_format(aMapFilename, sizeof(aMapFilename), "maps/%s.map", pMapName);
+	if(!pMap->Load(aMapFilename, pStorage))
+	{
+		dbg_msg("prediction_bench", "failed to load map '%s'", aMapFilename);
+		return -1;
+	}
+
+	CLayers Layers;
+	Layers.Init(pKernel, pMap);
+	CCollision Collision;
+	Collision.Init(&Layers);
+
+	CGameHistory History;
+	History.m_NumCharacters = NumCharacters;
+	History.m_NumTicks = Seconds*SERVER_TICK_SPEED;
+	History.m_pCores = new CNetObj_CharacterCore[History.m_NumTicks*History.m_NumCharacters];
+	History.m_pLocalInputs = new CNetObj_PlayerInput[History.m_NumTicks];
+	SimulateGame(&Collision, &History);
+
+	static const int s_aLatencies[] = {50, 150, 300, 1500};
+	bool Identical = true;
+	for(unsigned i = 0; i < sizeof(s_aLatencies)/sizeof(s_aLatencies[0]); i++)
+		Identical &= RunLatency(&Collision, &History, s_aLatencies[i], Fps);
+
+	delete[] History.m_pCores;
+	delete[] History.m_pLocalInputs;
+	delete pKernel;
+	delete pMap;
+	delete pStorage;
+	cmdline_free(argc, argv);
+	return Identical ? 0 : 1;
+}